@@ -0,0 +1,139 @@
+// CPU bilinear demosaic: checks every instruction set bit-exact against the scalar reference, with and without the
+// fused colour stage, then measures Mpix/s at the viewer's frame size for each instruction set, output format and
+// thread count.
+#include "myCode/demosaic.h"
+#include "myCode/frame_clock.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BENCH_WIDTH 2048
+#define BENCH_HEIGHT 1536
+#define ITERATIONS 50
+
+// a white balance, a colour twist with an offset, a black level and a display gamma
+static const color_params_t benchColor = {
+    .ccm = {{1.6f, -0.4f, -0.2f, 0.01f}, {-0.3f, 1.5f, -0.2f, 0.0f}, {-0.1f, -0.5f, 1.6f, -0.02f}},
+    .gains = {1.8f, 1.0f, 1.4f},
+    .blackLevel = 12.0f,
+    .gamma = 2.2f};
+static demosaic_color_t color;
+
+static void fill_bayer(uint8_t *bayer, int width, int height, size_t stride)
+{
+    srand(1);
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            bayer[y * stride + x] = (uint8_t)((x * 255 / width + ((x / 7 + y / 5) & 1) * 96 + rand() % 64) & 0xFF);
+}
+
+// odd sizes and padded strides exercise the scalar head and tail of every row, the pool splits rows in bands
+static int check(worker_pool_t *pool, demosaic_isa_t isa, int width, int height, int channels, const demosaic_color_t *fused)
+{
+    size_t srcStride = width + 5, dstStride = (size_t)width * channels + 7;
+    uint8_t *bayer = malloc(srcStride * height);
+    uint8_t *expected = calloc(dstStride * height, 1);
+    uint8_t *actual = calloc(dstStride * height, 1);
+    int failures = 0;
+    fill_bayer(bayer, width, height, srcStride);
+
+    for (int pattern = BAYER_RG; pattern <= BAYER_BG; pattern++)
+    {
+        demosaic_frame_t frame = {bayer, srcStride, width, height, pattern, expected, dstStride, channels};
+        if (fused)
+            demosaic_fused_reference(&frame, fused);
+        else
+            demosaic_bilinear_reference(&frame);
+        frame.dst = actual;
+        if (fused)
+            demosaic_fused(pool, &frame, fused, isa);
+        else
+            demosaic_bilinear(pool, &frame, isa);
+        for (int y = 0; y < height; y++)
+        {
+            if (memcmp(expected + y * dstStride, actual + y * dstStride, (size_t)width * channels))
+            {
+                printf("  %s%s %s %dx%d %s: row %d differs from the reference!\n", demosaic_isa_name(isa), fused ? " fused" : "",
+                       bayer_pixel_format(pattern), width, height, channels == 4 ? "RGBA8" : "RGB8", y);
+                failures++;
+                break;
+            }
+        }
+    }
+    free(bayer);
+    free(expected);
+    free(actual);
+    return failures;
+}
+
+static void run(worker_pool_t *pool, demosaic_isa_t isa, const demosaic_frame_t *frame, const demosaic_color_t *fused)
+{
+    if (fused)
+        demosaic_fused(pool, frame, fused, isa);
+    else
+        demosaic_bilinear(pool, frame, isa);
+}
+
+static void bench(worker_pool_t *pool, demosaic_isa_t isa, int channels, const demosaic_color_t *fused, const uint8_t *bayer, uint8_t *rgb)
+{
+    demosaic_frame_t frame = {bayer, BENCH_WIDTH, BENCH_WIDTH, BENCH_HEIGHT, BAYER_RG, rgb, (size_t)BENCH_WIDTH * channels, channels};
+    run(pool, isa, &frame, fused); // warm up, faults the destination in
+    uint64_t start = frame_clock_ns();
+    for (int i = 0; i < ITERATIONS; i++)
+        run(pool, isa, &frame, fused);
+    double perFrame = (frame_clock_ns() - start) / (double)ITERATIONS;
+    printf("  %-7s %-6s %-8s %2d thread%s %8.3f ms %8.1f Mpix/s\n", demosaic_isa_name(isa), channels == 4 ? "RGBA8" : "RGB8",
+           fused ? "fused" : "demosaic", pool ? pool->threads : 1, pool && pool->threads > 1 ? "s" : " ", perFrame / 1e6,
+           BENCH_WIDTH * BENCH_HEIGHT / (perFrame / 1e3));
+}
+
+int main()
+{
+    demosaic_isa_t best = demosaic_best_isa();
+    int failures = 0;
+    worker_pool_t checkPool;
+    worker_pool_init(&checkPool, 3, -1);
+    demosaic_color_prepare(&color, &benchColor);
+    printf("best instruction set: %s\n", demosaic_isa_name(best));
+    for (demosaic_isa_t isa = DEMOSAIC_ISA_SCALAR; isa <= best; isa++)
+        for (int channels = 3; channels <= 4; channels++)
+            for (int fused = 0; fused <= 1; fused++)
+            {
+                const demosaic_color_t *stage = fused ? &color : NULL;
+                failures += check(NULL, isa, 97, 33, channels, stage);
+                failures += check(NULL, isa, 2, 2, channels, stage);
+                failures += check(&checkPool, isa, 640, 480, channels, stage);
+            }
+    worker_pool_destroy(&checkPool);
+    printf("bit-exact against the reference: %s\n", failures ? "FAIL" : "ok");
+
+    uint8_t *bayer = aligned_alloc(64, BENCH_WIDTH * BENCH_HEIGHT);
+    uint8_t *rgb = aligned_alloc(64, BENCH_WIDTH * BENCH_HEIGHT * 4);
+    fill_bayer(bayer, BENCH_WIDTH, BENCH_HEIGHT, BENCH_WIDTH);
+
+    printf("\n%dx%d BayerRG8, %d frames:\n", BENCH_WIDTH, BENCH_HEIGHT, ITERATIONS);
+    for (demosaic_isa_t isa = DEMOSAIC_ISA_SCALAR; isa <= best; isa++)
+        for (int channels = 3; channels <= 4; channels++)
+        {
+            bench(NULL, isa, channels, NULL, bayer, rgb);
+            bench(NULL, isa, channels, &color, bayer, rgb);
+        }
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int threads = 2; threads <= cpus && threads <= WORKER_POOL_MAX_THREADS; threads *= 2)
+    {
+        worker_pool_t pool;
+        worker_pool_init(&pool, threads, -1);
+        for (int channels = 3; channels <= 4; channels++)
+        {
+            bench(&pool, best, channels, NULL, bayer, rgb);
+            bench(&pool, best, channels, &color, bayer, rgb);
+        }
+        worker_pool_destroy(&pool);
+    }
+
+    free(bayer);
+    free(rgb);
+    return failures ? 1 : 0;
+}
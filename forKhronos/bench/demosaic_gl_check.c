@@ -0,0 +1,271 @@
+// Renders shaders/fragmentShader.frag on a headless EGL context (Mesa llvmpipe works) for every Bayer pattern and
+// demosaic quality, plus a colour corrected and a flat field corrected case, and compares the result with a CPU
+// reference of the same filters.
+// Run from the forKhronos directory: `make demosaic-check`
+#define STB_IMAGE_IMPLEMENTATION
+#include "myCode/demosaic_gl.h"
+#include "myCode/color_gl.h"
+#include "myCode/flat_field_gl.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK_WIDTH 96
+#define CHECK_HEIGHT 64
+// GPU float math against the double reference, both rounded to 8 bits
+#define CHECK_TOLERANCE 1
+// the tone curve is linearly interpolated between COLOR_LUT_SIZE entries, gamma 2.2 is steep just above black
+#define CHECK_CURVE_TOLERANCE 2
+
+static const GLfloat quad[] = {
+    1.0f, 1.0f, 0.0f, 1.0f, 1.0f,
+    1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+    -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+    -1.0f, 1.0f, 0.0f, 0.0f, 1.0f};
+static const GLuint quadIndices[] = {0, 1, 3, 1, 2, 3};
+
+static uint8_t bayer[CHECK_WIDTH * CHECK_HEIGHT];
+// maps larger than the frame, the frame sits at FLAT_SHIFT_X, FLAT_SHIFT_Y in them
+#define FLAT_SHIFT_X 4
+#define FLAT_SHIFT_Y 2
+static flat_field_t flat;
+static int flatRound;
+
+// myCode/flat_field.h, in double
+static double calibrated(int x, int y, int *defect)
+{
+    size_t m = (size_t)(y + FLAT_SHIFT_Y) * flat.width + x + FLAT_SHIFT_X;
+    double dark = flat.dark[m] / (256.0 * 255.0), gain = flat.gain[m] / 4096.0;
+    double v = (bayer[y * CHECK_WIDTH + x] / 255.0 - dark) * gain;
+    *defect = !flat.gain[m];
+    return v < 0 ? 0 : (v > 1 ? 1 : v);
+}
+
+static double raw(int x, int y)
+{
+    x = abs(x), y = abs(y);
+    if (x > CHECK_WIDTH - 1)
+        x = 2 * (CHECK_WIDTH - 1) - x;
+    if (y > CHECK_HEIGHT - 1)
+        y = 2 * (CHECK_HEIGHT - 1) - y;
+    if (!flatRound)
+        return bayer[y * CHECK_WIDTH + x] / 255.0;
+    int defect, bad;
+    double v = calibrated(x, y, &defect), sum = 0;
+    if (!defect)
+        return v;
+    static const int offsets[4][2] = {{-2, 0}, {2, 0}, {0, -2}, {0, 2}};
+    int count = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        int nx = x + offsets[i][0], ny = y + offsets[i][1];
+        if (nx < 0 || ny < 0 || nx >= CHECK_WIDTH || ny >= CHECK_HEIGHT)
+            continue;
+        double c = calibrated(nx, ny, &bad);
+        if (!bad)
+            sum += c, count++;
+    }
+    return count ? sum / count : bayer[y * CHECK_WIDTH + x] / 255.0;
+}
+
+static void reference(int x, int y, bayer_pattern_t pattern, demosaic_quality_t quality, double rgb[3])
+{
+    int px = (x + bayer_red_x(pattern)) & 1, py = (y + bayer_red_y(pattern)) & 1;
+    double c = raw(x, y);
+    double n1 = raw(x - 1, y) + raw(x + 1, y), m1 = raw(x, y - 1) + raw(x, y + 1);
+    double d1 = raw(x - 1, y - 1) + raw(x + 1, y - 1) + raw(x - 1, y + 1) + raw(x + 1, y + 1);
+    double atRB, otherRB, h, v;
+
+    if (quality == DEMOSAIC_BILINEAR)
+    {
+        atRB = (n1 + m1) / 4, otherRB = d1 / 4, h = n1 / 2, v = m1 / 2;
+    }
+    else
+    {
+        double n2 = raw(x - 2, y) + raw(x + 2, y), m2 = raw(x, y - 2) + raw(x, y + 2);
+        atRB = (4 * c + 2 * (n1 + m1) - (n2 + m2)) / 8;
+        otherRB = (6 * c + 2 * d1 - 1.5 * (n2 + m2)) / 8;
+        h = (5 * c + 4 * n1 - d1 - n2 + 0.5 * m2) / 8;
+        v = (5 * c + 4 * m1 - d1 - m2 + 0.5 * n2) / 8;
+    }
+    if (!px && !py)
+        rgb[0] = c, rgb[1] = atRB, rgb[2] = otherRB;
+    else if (px && py)
+        rgb[0] = otherRB, rgb[1] = atRB, rgb[2] = c;
+    else if (px)
+        rgb[0] = h, rgb[1] = c, rgb[2] = v;
+    else
+        rgb[0] = v, rgb[1] = c, rgb[2] = h;
+}
+
+static double clamp01(double v)
+{
+    return v < 0 ? 0 : (v > 1 ? 1 : v);
+}
+
+// myCode/color.h, in double
+static void correct(const color_params_t *params, double rgb[3])
+{
+    double black = params->blackLevel / 255.0, in[3];
+    for (int c = 0; c < 3; c++)
+    {
+        in[c] = clamp01(rgb[c]) - black;
+        in[c] = (in[c] < 0 ? 0 : in[c]) / (1 - black) * params->gains[c];
+    }
+    for (int r = 0; r < 3; r++)
+    {
+        const float *row = params->ccm[r];
+        rgb[r] = pow(clamp01(row[0] * in[0] + row[1] * in[1] + row[2] * in[2] + row[3]), 1.0 / params->gamma);
+    }
+}
+
+static int create_context()
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    EGLDisplay display = getPlatformDisplay ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL)
+                                            : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major, minor;
+    if (!eglInitialize(display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API))
+    {
+        printf("EGL initialization failed - %x\n", eglGetError());
+        return -1;
+    }
+    EGLint attributes[] = {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+                           EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+    EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        printf("EGL context creation failed - %x\n", eglGetError());
+        return -1;
+    }
+    if (!load_glad((GLADloadproc)eglGetProcAddress))
+        return -1;
+    printf("%s, OpenGL %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+    return 0;
+}
+
+int main()
+{
+    if (create_context())
+        return 1;
+
+    GLuint shaders[2];
+    shaders[0] = load_shader_from_file("./shaders/vertexShader.vert", GL_VERTEX_SHADER);
+    shaders[1] = load_shader_from_file("./shaders/fragmentShader.frag", GL_FRAGMENT_SHADER);
+    GLuint program = create_program(shaders, 2);
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked)
+        return 1;
+    use_program(program);
+
+    GLuint *VAOs = generate_VAOs(1);
+    GLuint *VBOs = generate_VBOs(1);
+    GLuint *EBOs = generate_EBOs(1);
+    bind_VAOs(VAOs[0]);
+    bind_buffer_set_data(GL_ARRAY_BUFFER, VBOs[0], sizeof(quad), quad, GL_STATIC_DRAW);
+    bind_buffer_set_data(GL_ELEMENT_ARRAY_BUFFER, EBOs[0], sizeof(quadIndices), quadIndices, GL_STATIC_DRAW);
+    enable_vertex_attrib_array(0, 3, GL_FLOAT, 5 * sizeof(float), (float *)0);
+    enable_vertex_attrib_array(1, 2, GL_FLOAT, 5 * sizeof(float), (void *)(3 * sizeof(float)));
+
+    // noise on top of gradients and hard edges, so every neighbour of the 5x5 kernels matters
+    srand(1);
+    for (int y = 0; y < CHECK_HEIGHT; y++)
+        for (int x = 0; x < CHECK_WIDTH; x++)
+            bayer[y * CHECK_WIDTH + x] = (uint8_t)((x * 255 / CHECK_WIDTH + ((x / 7 + y / 5) & 1) * 96 + rand() % 32) & 0xFF);
+
+    GLuint *tex = create_textures(2);
+    video_texture_t raw;
+    create_video_texture(&raw, tex[0], GL_R8, CHECK_WIDTH, CHECK_HEIGHT, MIP_NONE, 1);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    update_texture_from_buffer(GL_TEXTURE_2D, 0, 0, CHECK_WIDTH, CHECK_HEIGHT, GL_RED, GL_UNSIGNED_BYTE, bayer);
+
+    video_texture_t target;
+    create_video_texture(&target, tex[1], GL_RGBA8, CHECK_WIDTH, CHECK_HEIGHT, MIP_NONE, 1);
+    GLuint fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex[1], 0);
+    set_viewport(0, 0, CHECK_WIDTH, CHECK_HEIGHT);
+    bind_texture(tex[0]);
+
+    // a colour twist with an offset, white balance gains, a black level and a display gamma
+    color_params_t identity, corrected = {
+        .ccm = {{0.2f, 0.9f, 0.0f, 0.05f}, {0.0f, 1.0f, 0.3f, 0.0f}, {1.5f, -0.25f, 0.0f, -0.1f}},
+        .gains = {1.1f, 0.9f, 1.6f},
+        .blackLevel = 16.0f,
+        .gamma = 2.2f};
+    color_params_identity(&identity);
+    color_gl_t color;
+    if (color_gl_create(&color, program, 0, &identity))
+        return 1;
+
+    // dark levels up to 24 counts, gains 0.75 to 2 and a sprinkle of defects, some next to each other
+    flat.width = CHECK_WIDTH + 2 * FLAT_SHIFT_X;
+    flat.height = CHECK_HEIGHT + 2 * FLAT_SHIFT_Y;
+    flat.dark = malloc(flat.width * flat.height * sizeof(uint16_t));
+    flat.gain = malloc(flat.width * flat.height * sizeof(uint16_t));
+    for (int i = 0; i < flat.width * flat.height; i++)
+    {
+        flat.dark[i] = (uint16_t)(rand() % (24 << FLAT_FIELD_DARK_BITS));
+        flat.gain[i] = rand() % 53 ? (uint16_t)(3072 + rand() % 5120) : 0;
+    }
+    flat.gain[(FLAT_SHIFT_Y + 10) * flat.width + FLAT_SHIFT_X + 10] = 0;
+    flat.gain[(FLAT_SHIFT_Y + 10) * flat.width + FLAT_SHIFT_X + 12] = 0;
+    flat_field_gl_t flatMaps = {0, 0};
+    flat_field_gl_init(program);
+    flat_field_gl_upload(&flatMaps, &flat);
+
+    static uint8_t rendered[CHECK_WIDTH * CHECK_HEIGHT * 4];
+    const char *qualities[] = {"none", "bilinear", "malvar", "ccm", "flat"};
+    int failures = 0;
+    for (int quality = DEMOSAIC_BILINEAR; quality <= DEMOSAIC_MALVAR + 2; quality++)
+    {
+        // the last rounds repeat Malvar through the colour correction and through the flat field
+        flatRound = quality == DEMOSAIC_MALVAR + 2;
+        flat_field_gl_use(program, flatRound ? &flatMaps : NULL, FLAT_SHIFT_X, FLAT_SHIFT_Y);
+        for (int pattern = BAYER_RG; pattern <= BAYER_BG; pattern++)
+        {
+            int colorRound = quality == DEMOSAIC_MALVAR + 1;
+            const color_params_t *params = colorRound ? &corrected : &identity;
+            int tolerance = colorRound ? CHECK_CURVE_TOLERANCE : CHECK_TOLERANCE;
+            color_gl_set(&color, params);
+            color_gl_apply(&color);
+            demosaic_gl_set(program, quality > DEMOSAIC_MALVAR ? DEMOSAIC_MALVAR : quality, pattern);
+            bind_vertex_object_and_draw_it(VAOs[0], GL_TRIANGLES, 6);
+            glReadPixels(0, 0, CHECK_WIDTH, CHECK_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, rendered);
+
+            int worst = 0, mismatches = 0;
+            for (int y = 0; y < CHECK_HEIGHT; y++)
+            {
+                // the vertex shader flips rows, framebuffer row 0 shows the last image row
+                const uint8_t *row = rendered + (CHECK_HEIGHT - 1 - y) * CHECK_WIDTH * 4;
+                for (int x = 0; x < CHECK_WIDTH; x++)
+                {
+                    double rgb[3];
+                    reference(x, y, pattern, quality > DEMOSAIC_MALVAR ? DEMOSAIC_MALVAR : quality, rgb);
+                    correct(params, rgb);
+                    for (int c = 0; c < 3; c++)
+                    {
+                        int diff = abs(row[x * 4 + c] - (int)lround(clamp01(rgb[c]) * 255.0));
+                        if (diff > worst)
+                            worst = diff;
+                        mismatches += diff > tolerance;
+                    }
+                }
+            }
+            printf("%-8s %s: max difference %d, %d values over %d %s\n", qualities[quality], bayer_pixel_format(pattern),
+                   worst, mismatches, tolerance, mismatches ? "FAIL" : "ok");
+            failures += mismatches != 0;
+        }
+    }
+    color_gl_destroy(&color);
+    flat_field_gl_destroy(&flatMaps);
+    free(flat.dark);
+    free(flat.gain);
+    return failures ? 1 : 0;
+}
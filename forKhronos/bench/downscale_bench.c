@@ -0,0 +1,134 @@
+// Downscale: checks every instruction set bit-exact against the scalar reference for raw Bayer, RGB8 and RGBA8
+// sources with both filters, then measures the 1/2, 1/4, 1/8 pyramid of a frame of the viewer's size.
+#include "myCode/downscale.h"
+#include "myCode/frame_clock.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BENCH_WIDTH 2048
+#define BENCH_HEIGHT 1536
+#define ITERATIONS 50
+#define LEVELS 3
+
+static const char *filterNames[] = {"box", "lanczos"};
+
+static void fill(uint8_t *data, size_t stride, int width, int height, int channels)
+{
+    srand(1);
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width * channels; x++)
+            data[y * stride + x] = (uint8_t)((x * 255 / (width * channels) + ((x / 7 + y / 5) & 1) * 96 + rand() % 64) & 0xFF);
+}
+
+// odd sizes and padded strides exercise the scalar tails and the mirrored borders
+static int check(worker_pool_t *pool, demosaic_isa_t isa, int width, int height, int channels, downscale_filter_t filter,
+                 bayer_pattern_t pattern)
+{
+    downscale_image_t src = {NULL, (size_t)width * channels + 5, width, height, channels};
+    downscale_image_t expected = {NULL, (size_t)width / 2 * 4 + 7, width / 2, height / 2, 4};
+    downscale_image_t actual = expected;
+    src.data = malloc(src.stride * height);
+    expected.data = calloc(expected.stride * expected.height, 1);
+    actual.data = calloc(actual.stride * actual.height, 1);
+    fill(src.data, src.stride, width, height, channels);
+    int failures = 0;
+
+    downscale_half_reference(&src, pattern, &expected, filter);
+    downscale_half(pool, &src, pattern, &actual, filter, isa);
+    for (int y = 0; y < expected.height; y++)
+    {
+        if (memcmp(expected.data + y * expected.stride, actual.data + y * actual.stride, (size_t)expected.width * 4))
+        {
+            printf("  %s %s %dx%d %d channel%s: row %d differs from the reference!\n", demosaic_isa_name(isa),
+                   channels == 1 ? bayer_pixel_format(pattern) : filterNames[filter], width, height, channels,
+                   channels > 1 ? "s" : "", y);
+            failures++;
+            break;
+        }
+    }
+    free(src.data);
+    free(expected.data);
+    free(actual.data);
+    return failures;
+}
+
+static void bench(worker_pool_t *pool, demosaic_isa_t isa, const downscale_image_t *src, const downscale_image_t *levels,
+                  downscale_filter_t filter)
+{
+    downscale_pyramid(pool, src, BAYER_RG, levels, LEVELS, filter, isa);
+    uint64_t start = frame_clock_ns();
+    for (int i = 0; i < ITERATIONS; i++)
+        downscale_pyramid(pool, src, BAYER_RG, levels, LEVELS, filter, isa);
+    double perFrame = (frame_clock_ns() - start) / (double)ITERATIONS;
+    printf("  %-7s %-7s %2d thread%s %8.3f ms %8.1f Mpix/s\n", demosaic_isa_name(isa),
+           src->channels == 1 ? "raw" : filterNames[filter], pool ? pool->threads : 1, pool && pool->threads > 1 ? "s" : " ",
+           perFrame / 1e6, src->width * src->height / (perFrame / 1e3));
+}
+
+static void bench_source(int channels, downscale_filter_t filter)
+{
+    downscale_image_t src = {NULL, (size_t)BENCH_WIDTH * channels, BENCH_WIDTH, BENCH_HEIGHT, channels};
+    downscale_image_t levels[LEVELS];
+    src.data = aligned_alloc(64, src.stride * BENCH_HEIGHT);
+    fill(src.data, src.stride, BENCH_WIDTH, BENCH_HEIGHT, channels);
+    for (int i = 0; i < LEVELS; i++)
+    {
+        int width = BENCH_WIDTH >> (i + 1), height = BENCH_HEIGHT >> (i + 1);
+        levels[i] = (downscale_image_t){aligned_alloc(64, (size_t)width * 4 * height), (size_t)width * 4, width, height, 4};
+    }
+
+    demosaic_isa_t best = demosaic_best_isa();
+    for (demosaic_isa_t isa = DEMOSAIC_ISA_SCALAR; isa <= best; isa++)
+        bench(NULL, isa, &src, levels, filter);
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int threads = 2; threads <= cpus && threads <= WORKER_POOL_MAX_THREADS; threads *= 2)
+    {
+        worker_pool_t pool;
+        worker_pool_init(&pool, threads, -1);
+        bench(&pool, best, &src, levels, filter);
+        worker_pool_destroy(&pool);
+    }
+
+    free(src.data);
+    for (int i = 0; i < LEVELS; i++)
+        free(levels[i].data);
+}
+
+int main()
+{
+    demosaic_isa_t best = demosaic_best_isa();
+    worker_pool_t checkPool;
+    worker_pool_init(&checkPool, 3, -1);
+    int failures = 0;
+    for (demosaic_isa_t isa = DEMOSAIC_ISA_SCALAR; isa <= best; isa++)
+    {
+        for (int pattern = BAYER_RG; pattern <= BAYER_BG; pattern++)
+        {
+            failures += check(NULL, isa, 97, 33, 1, DOWNSCALE_BOX, pattern);
+            failures += check(&checkPool, isa, 1000, 700, 1, DOWNSCALE_BOX, pattern);
+        }
+        for (downscale_filter_t filter = DOWNSCALE_BOX; filter <= DOWNSCALE_LANCZOS; filter++)
+            for (int channels = 3; channels <= 4; channels++)
+            {
+                failures += check(NULL, isa, 97, 33, channels, filter, BAYER_RG);
+                failures += check(NULL, isa, 5, 3, channels, filter, BAYER_RG);
+                failures += check(&checkPool, isa, 1000, 700, channels, filter, BAYER_RG);
+            }
+    }
+    worker_pool_destroy(&checkPool);
+    printf("bit-exact against the reference: %s\n", failures ? "FAIL" : "ok");
+
+    int weights[DOWNSCALE_TAPS];
+    downscale_lanczos_weights(DOWNSCALE_V_BITS, weights);
+    printf("lanczos taps /%d:", 1 << DOWNSCALE_V_BITS);
+    for (int k = 0; k < DOWNSCALE_TAPS; k++)
+        printf(" %d", weights[k]);
+
+    printf("\n\n%dx%d to 1/2, 1/4 and 1/8, %d frames:\n", BENCH_WIDTH, BENCH_HEIGHT, ITERATIONS);
+    bench_source(1, DOWNSCALE_BOX);
+    bench_source(4, DOWNSCALE_BOX);
+    bench_source(4, DOWNSCALE_LANCZOS);
+    return failures ? 1 : 0;
+}
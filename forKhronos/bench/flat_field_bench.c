@@ -0,0 +1,178 @@
+// Flat field: builds maps from synthetic dark and flat references (vignetting, hot and dead pixels), checks that the
+// defects are found, the file round trip, that every instruction set matches the scalar reference bit-exact over
+// regions of the maps, then measures Mpix/s at the viewer's frame size.
+#include "myCode/flat_field.h"
+#include "myCode/frame_clock.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BENCH_WIDTH 2048
+#define BENCH_HEIGHT 1536
+#define ITERATIONS 100
+#define REFERENCE_FRAMES 8
+#define HOT_PIXELS 40
+#define DEAD_PIXELS 20
+#define BENCH_FILE "/tmp/flat_field_bench.bin"
+
+static const flat_field_config_t config = {.hotCounts = 24.0, .maxResponseDeviation = 0.5};
+
+static uint32_t defectAt[HOT_PIXELS + DEAD_PIXELS];
+
+// radial falloff to 60% in the corners, a dark level of 12 and noise
+static uint8_t synthetic(int x, int y, flat_field_reference_t reference)
+{
+    double dx = (x - BENCH_WIDTH / 2.0) / (BENCH_WIDTH / 2.0), dy = (y - BENCH_HEIGHT / 2.0) / (BENCH_HEIGHT / 2.0);
+    double v = 12 + rand() % 3 + (reference == FLAT_FIELD_FLAT ? 180 * (1 - 0.2 * (dx * dx + dy * dy)) : 0);
+    return (uint8_t)v;
+}
+
+static void capture_reference(flat_field_capture_t *capture, flat_field_reference_t reference, uint8_t *frame)
+{
+    flat_field_capture_start(capture, reference, REFERENCE_FRAMES, BENCH_WIDTH, BENCH_HEIGHT, 0, 0, 1);
+    for (int f = 0; f < REFERENCE_FRAMES; f++)
+    {
+        for (int y = 0; y < BENCH_HEIGHT; y++)
+            for (int x = 0; x < BENCH_WIDTH; x++)
+                frame[y * BENCH_WIDTH + x] = synthetic(x, y, reference);
+        for (int i = 0; i < HOT_PIXELS + DEAD_PIXELS; i++)
+            frame[defectAt[i]] = i < HOT_PIXELS ? 200 : (reference == FLAT_FIELD_FLAT ? 14 : 12);
+        flat_field_capture_add(capture, frame, BENCH_WIDTH);
+    }
+}
+
+static int check_build(flat_field_t *ff, uint8_t *frame)
+{
+    flat_field_capture_t capture = {0};
+    srand(1);
+    for (int i = 0; i < HOT_PIXELS + DEAD_PIXELS; i++)
+        defectAt[i] = (uint32_t)(((uint64_t)rand() * 7919) % (BENCH_WIDTH * BENCH_HEIGHT));
+    capture_reference(&capture, FLAT_FIELD_DARK, frame);
+    capture_reference(&capture, FLAT_FIELD_FLAT, frame);
+    int failures = flat_field_build(ff, &capture, &config) != 0;
+    flat_field_capture_free(&capture);
+    if (failures)
+        return 1;
+    for (int i = 0; i < HOT_PIXELS + DEAD_PIXELS; i++)
+        if (ff->gain[defectAt[i]])
+        {
+            printf("  pixel %u is not marked defective\n", defectAt[i]);
+            failures++;
+        }
+    // a corner pixel sees 60% of the centre's light, its gain makes up for it
+    double corner = ff->gain[1] / (double)(1 << FLAT_FIELD_GAIN_BITS);
+    double centre = ff->gain[BENCH_HEIGHT / 2 * BENCH_WIDTH + BENCH_WIDTH / 2 + 1] / (double)(1 << FLAT_FIELD_GAIN_BITS);
+    printf("defects %u (%d planted), gain centre %.3f corner %.3f\n", ff->defectCount, HOT_PIXELS + DEAD_PIXELS, centre,
+           corner);
+    if (fabs(corner / centre - 1 / 0.6) > 0.05 || ff->defectCount < HOT_PIXELS + DEAD_PIXELS)
+        failures++;
+    return failures;
+}
+
+static int check_file(const flat_field_t *ff)
+{
+    flat_field_t loaded;
+    size_t mapBytes = (size_t)ff->width * ff->height * sizeof(uint16_t);
+    if (flat_field_save(ff, BENCH_FILE) || flat_field_load(&loaded, BENCH_FILE))
+        return 1;
+    int failures = loaded.width != ff->width || loaded.height != ff->height || loaded.defectCount != ff->defectCount ||
+                   memcmp(loaded.dark, ff->dark, mapBytes) || memcmp(loaded.gain, ff->gain, mapBytes) ||
+                   memcmp(loaded.defects, ff->defects, ff->defectCount * sizeof(uint32_t));
+    printf("file round trip: %s\n", failures ? "FAIL" : "ok");
+    flat_field_free(&loaded);
+    unlink(BENCH_FILE);
+    return failures;
+}
+
+// odd sizes and padded strides exercise the scalar tails, shifts read the middle of the maps
+static int check(worker_pool_t *pool, demosaic_isa_t isa, const flat_field_t *ff, const uint8_t *frame, int width,
+                 int height, int shiftX, int shiftY)
+{
+    size_t srcStride = width + 5, dstStride = width + 3;
+    uint8_t *src = malloc(srcStride * height);
+    uint8_t *expected = calloc(dstStride * height, 1);
+    uint8_t *actual = calloc(dstStride * height, 1);
+    int failures = 0;
+    for (int y = 0; y < height; y++)
+        memcpy(src + y * srcStride, frame + (y + shiftY) * BENCH_WIDTH + shiftX, width);
+
+    flat_field_apply_reference(ff, shiftX, shiftY, src, srcStride, expected, dstStride, width, height);
+    flat_field_apply(pool, ff, shiftX, shiftY, src, srcStride, actual, dstStride, width, height, isa);
+    for (int y = 0; y < height; y++)
+    {
+        if (memcmp(expected + y * dstStride, actual + y * dstStride, width))
+        {
+            printf("  %s %dx%d at %d,%d: row %d differs from the reference!\n", demosaic_isa_name(isa), width, height,
+                   shiftX, shiftY, y);
+            failures++;
+            break;
+        }
+    }
+    free(src);
+    free(expected);
+    free(actual);
+    return failures;
+}
+
+static void bench(worker_pool_t *pool, demosaic_isa_t isa, const flat_field_t *ff, const uint8_t *src, uint8_t *dst)
+{
+    flat_field_apply(pool, ff, 0, 0, src, BENCH_WIDTH, dst, BENCH_WIDTH, BENCH_WIDTH, BENCH_HEIGHT, isa);
+    uint64_t start = frame_clock_ns();
+    for (int i = 0; i < ITERATIONS; i++)
+        flat_field_apply(pool, ff, 0, 0, src, BENCH_WIDTH, dst, BENCH_WIDTH, BENCH_WIDTH, BENCH_HEIGHT, isa);
+    double perFrame = (frame_clock_ns() - start) / (double)ITERATIONS;
+    printf("  %-7s %2d thread%s %8.3f ms %8.1f Mpix/s\n", demosaic_isa_name(isa), pool ? pool->threads : 1,
+           pool && pool->threads > 1 ? "s" : " ", perFrame / 1e6, BENCH_WIDTH * BENCH_HEIGHT / (perFrame / 1e3));
+}
+
+int main()
+{
+    uint8_t *frame = aligned_alloc(64, BENCH_WIDTH * BENCH_HEIGHT);
+    uint8_t *dst = aligned_alloc(64, BENCH_WIDTH * BENCH_HEIGHT);
+    flat_field_t ff;
+    int failures = check_build(&ff, frame);
+    if (!ff.gain)
+    {
+        printf("flat field build failed\n");
+        return 1;
+    }
+    failures += check_file(&ff);
+
+    // a frame with every planted defect in it
+    srand(2);
+    for (int y = 0; y < BENCH_HEIGHT; y++)
+        for (int x = 0; x < BENCH_WIDTH; x++)
+            frame[y * BENCH_WIDTH + x] = (uint8_t)rand();
+
+    demosaic_isa_t best = demosaic_best_isa();
+    worker_pool_t checkPool;
+    worker_pool_init(&checkPool, 3, -1);
+    for (demosaic_isa_t isa = DEMOSAIC_ISA_SCALAR; isa <= best; isa++)
+    {
+        failures += check(NULL, isa, &ff, frame, 97, 33, 0, 0);
+        failures += check(NULL, isa, &ff, frame, 3, 2, 6, 10);
+        failures += check(&checkPool, isa, &ff, frame, 1000, 700, 512, 384);
+        failures += check(&checkPool, isa, &ff, frame, BENCH_WIDTH, BENCH_HEIGHT, 0, 0);
+    }
+    worker_pool_destroy(&checkPool);
+    printf("bit-exact against the reference: %s\n", failures ? "FAIL" : "ok");
+
+    printf("\n%dx%d raw, %d frames:\n", BENCH_WIDTH, BENCH_HEIGHT, ITERATIONS);
+    for (demosaic_isa_t isa = DEMOSAIC_ISA_SCALAR; isa <= best; isa++)
+        bench(NULL, isa, &ff, frame, dst);
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int threads = 2; threads <= cpus && threads <= WORKER_POOL_MAX_THREADS; threads *= 2)
+    {
+        worker_pool_t pool;
+        worker_pool_init(&pool, threads, -1);
+        bench(&pool, best, &ff, frame, dst);
+        worker_pool_destroy(&pool);
+    }
+
+    flat_field_free(&ff);
+    free(frame);
+    free(dst);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,92 @@
+// frame_copy against memcpy at the viewer's frame sizes.
+// Destinations rotate through a set of buffers larger than the last level cache, like the PBOs of an upload ring.
+#include "myCode/frame_copy.h"
+#include "myCode/frame_clock.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DESTINATIONS 8
+#define ITERATIONS 100
+
+typedef struct frame_size_t
+{
+    const char *name;
+    size_t bytes;
+} frame_size_t;
+
+static const frame_size_t frameSizes[] = {
+    {"2048x1536 RGB8", 2048 * 1536 * 3},
+    {"2048x1536 Bayer8", 2048 * 1536},
+};
+
+static uint8_t *destinations[DESTINATIONS];
+static uint8_t *source;
+
+static void report(const char *name, size_t bytes, uint64_t elapsed)
+{
+    double perFrame = elapsed / (double)ITERATIONS;
+    printf("  %-22s %8.3f ms %8.2f GB/s\n", name, perFrame / 1e6, bytes / perFrame);
+}
+
+static void bench_memcpy(size_t bytes)
+{
+    uint64_t start = frame_clock_ns();
+    for (int i = 0; i < ITERATIONS; i++)
+        memcpy(destinations[i % DESTINATIONS], source, bytes);
+    report("memcpy", bytes, frame_clock_ns() - start);
+}
+
+static void bench_frame_copy(frame_copy_t *fc, const char *name, size_t bytes)
+{
+    uint64_t start = frame_clock_ns();
+    for (int i = 0; i < ITERATIONS; i++)
+        frame_copy(fc, destinations[i % DESTINATIONS], source, bytes);
+    report(name, bytes, frame_clock_ns() - start);
+}
+
+int main()
+{
+    size_t largest = frameSizes[0].bytes;
+    source = aligned_alloc(4096, largest);
+    for (size_t i = 0; i < largest; i++)
+        source[i] = (uint8_t)(i * 31 + (i >> 11));
+    for (int i = 0; i < DESTINATIONS; i++)
+    {
+        destinations[i] = aligned_alloc(4096, largest);
+        memset(destinations[i], 0, largest); // fault the pages in before timing
+    }
+
+    frame_copy_t automatic;
+    frame_copy_init(&automatic, 0, largest);
+
+    for (size_t s = 0; s < sizeof(frameSizes) / sizeof(frameSizes[0]); s++)
+    {
+        size_t bytes = frameSizes[s].bytes;
+        printf("\n%s, %.1f MB, %d frames:\n", frameSizes[s].name, bytes / (1024.0 * 1024.0), ITERATIONS);
+        bench_memcpy(bytes);
+        for (int threads = 1; threads <= FRAME_COPY_MAX_THREADS && threads <= automatic.threads * 2; threads *= 2)
+        {
+            frame_copy_t fixed;
+            char name[32];
+            frame_copy_init(&fixed, threads, 0);
+            snprintf(name, sizeof(name), "frame_copy %d thread%s", threads, threads > 1 ? "s" : "");
+            bench_frame_copy(&fixed, name, bytes);
+            frame_copy_destroy(&fixed);
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "frame_copy auto (%d)", automatic.threads);
+        bench_frame_copy(&automatic, name, bytes);
+
+        // the copy has to be exact, including the unaligned head and tail
+        frame_copy(&automatic, destinations[0] + 3, source + 1, bytes - 7);
+        if (memcmp(destinations[0] + 3, source + 1, bytes - 7))
+            printf("  frame_copy output differs from the source!\n");
+    }
+
+    frame_copy_destroy(&automatic);
+    for (int i = 0; i < DESTINATIONS; i++)
+        free(destinations[i]);
+    free(source);
+    return 0;
+}
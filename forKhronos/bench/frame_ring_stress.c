@@ -0,0 +1,118 @@
+// Frame ring under a producer thread pushing as fast as it can and a render thread popping with random pauses, with
+// a release callback like the zero-copy and queued modes. Every frame must come out exactly once, either popped or
+// released, popped frames must be newer than the previous one, and no descriptor may mix two frames.
+// Usage: frame_ring_stress [frames, default 20000000]
+#include "myCode/frame_ring.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static frame_ring_t ring;
+static atomic_uchar *seen; // per frame, popped or released
+static atomic_uint_fast64_t released, broken;
+static atomic_int producing;
+static uint64_t frames = 20000000;
+
+// every field derived from the frame number, a descriptor read while the slot was rewritten mixes two of them
+static frame_desc_t make_frame(uint64_t number)
+{
+    frame_desc_t frame = {.bufferHandle = number, .bufferID = (uint32_t)number, .timestamp = number * 3};
+    frame.base = (uint8_t *)(uintptr_t)(number * 64 + 64);
+    frame.receivedNs = number ^ 0x5555555555555555ull;
+    return frame;
+}
+
+static int account(const frame_desc_t *frame)
+{
+    uint64_t number = frame->bufferHandle;
+    frame_desc_t expected = make_frame(number);
+    if (number >= frames || frame->base != expected.base || frame->bufferID != expected.bufferID ||
+        frame->timestamp != expected.timestamp || frame->receivedNs != expected.receivedNs)
+    {
+        atomic_fetch_add(&broken, 1);
+        return -1;
+    }
+    atomic_fetch_add(&seen[number], 1);
+    return 0;
+}
+
+static void release(const frame_desc_t *frame, void *context)
+{
+    (void)context;
+    account(frame);
+    atomic_fetch_add(&released, 1);
+}
+
+static void *produce(void *arg)
+{
+    (void)arg;
+    for (uint64_t i = 0; i < frames; i++)
+    {
+        frame_desc_t frame = make_frame(i);
+        frame_ring_push(&ring, &frame);
+        if (!(i % 4096))
+            sched_yield();
+    }
+    atomic_store(&producing, 0);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        frames = strtoull(argv[1], NULL, 10);
+    seen = calloc(frames, sizeof(atomic_uchar));
+    if (!seen)
+        return 1;
+    frame_ring_init(&ring, release, NULL);
+    atomic_store(&producing, 1);
+    pthread_t producer;
+    if (pthread_create(&producer, NULL, produce, NULL))
+        return 1;
+
+    uint64_t popped = 0, reordered = 0, last = 0;
+    unsigned int seed = 1;
+    uint64_t start = frame_clock_ns();
+    for (int more = 1; more;)
+    {
+        more = atomic_load(&producing);
+        frame_desc_t frame;
+        // one more pop once the producer stopped, so the frames still in the ring are released
+        if (frame_ring_pop_latest(&ring, &frame))
+        {
+            if (!account(&frame))
+            {
+                reordered += popped && frame.bufferHandle <= last;
+                last = frame.bufferHandle;
+            }
+            popped++;
+        }
+        // the render thread falls behind by more than the ring now and then
+        int pause = rand_r(&seed) % 64;
+        if (!pause)
+            usleep(200);
+        else if (pause < 8)
+            sched_yield();
+    }
+    pthread_join(producer, NULL);
+    uint64_t elapsed = frame_clock_ns() - start;
+
+    uint64_t missing = 0, repeated = 0;
+    for (uint64_t i = 0; i < frames; i++)
+    {
+        unsigned char count = atomic_load(&seen[i]);
+        missing += !count;
+        repeated += count > 1;
+    }
+    frame_ring_print_stats(&ring);
+    printf("%lu frames in %.0f ms: %lu popped, %lu released, %lu missing, %lu seen twice, %lu torn, %lu out of order\n",
+           (unsigned long)frames, elapsed / 1e6, (unsigned long)popped, (unsigned long)atomic_load(&released),
+           (unsigned long)missing, (unsigned long)repeated, (unsigned long)atomic_load(&broken),
+           (unsigned long)reordered);
+    int failures = missing || repeated || atomic_load(&broken) || reordered;
+    printf("ring check: %s\n", failures ? "FAIL" : "ok");
+    free(seen);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,85 @@
+// frame_stats at the viewer's frame size: checks means, clipped counts and histogram totals against a plain loop
+// over the same samples, then times the grid steps. The budget is 1 ms per frame.
+#include "myCode/frame_stats.h"
+#include "myCode/frame_clock.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_WIDTH 2048
+#define BENCH_HEIGHT 1536
+#define ITERATIONS 200
+#define CLIP_LEVEL 250
+
+static uint8_t bayer[BENCH_WIDTH * BENCH_HEIGHT];
+
+static int check(bayer_pattern_t pattern, int width, int step)
+{
+    frame_stats_t stats;
+    double sum[3] = {0, 0, 0}, clipped[3] = {0, 0, 0}, pixels[3] = {0, 0, 0};
+    uint32_t samples[3] = {0, 0, 0};
+    int redX = bayer_red_x(pattern), redY = bayer_red_y(pattern);
+    frame_stats_compute(&stats, bayer, BENCH_WIDTH, width, BENCH_HEIGHT, 1, pattern, step, CLIP_LEVEL);
+    for (int y = 0; y + 1 < BENCH_HEIGHT; y += 2 * step)
+    {
+        for (int r = 0; r < 2; r++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                int px = (x + redX) & 1, py = (y + r + redY) & 1;
+                int color = px == py ? (px ? 2 : 0) : 1;
+                uint8_t v = bayer[(y + r) * BENCH_WIDTH + x];
+                sum[color] += v;
+                clipped[color] += v >= CLIP_LEVEL;
+                pixels[color]++;
+                samples[color] += (x / 2) % step == 0 && x / 2 * 2 + 1 < width;
+            }
+        }
+    }
+    int failures = 0;
+    for (int c = 0; c < 3; c++)
+    {
+        if (fabs(stats.mean[c] - sum[c] / pixels[c]) > 1e-9 || fabs(stats.clippedFraction[c] - clipped[c] / pixels[c]) > 1e-12 ||
+            stats.histogramSamples[c] != samples[c])
+        {
+            printf("  %s width %d step %d channel %d: mean %f / %f, clipped %f / %f, samples %u / %u differ!\n",
+                   bayer_pixel_format(pattern), width, step, c, stats.mean[c], sum[c] / pixels[c], stats.clippedFraction[c],
+                   clipped[c] / pixels[c], stats.histogramSamples[c], samples[c]);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+int main()
+{
+    srand(1);
+    for (int i = 0; i < BENCH_WIDTH * BENCH_HEIGHT; i++)
+        bayer[i] = (uint8_t)(rand() & 0xFF);
+
+    int failures = 0;
+    for (int pattern = BAYER_RG; pattern <= BAYER_BG; pattern++)
+        for (int step = 1; step <= 8; step *= 2)
+        {
+            failures += check(pattern, BENCH_WIDTH, step);
+            failures += check(pattern, BENCH_WIDTH - 37, step); // odd width, scalar tail
+        }
+    printf("stats against a plain loop: %s\n", failures ? "FAIL" : "ok");
+
+    printf("\n%dx%d BayerRG8, %d frames:\n", BENCH_WIDTH, BENCH_HEIGHT, ITERATIONS);
+    for (int step = 1; step <= 16; step *= 2)
+    {
+        frame_stats_t stats;
+        uint64_t total = 0, worst = 0;
+        for (int i = 0; i < ITERATIONS; i++)
+        {
+            frame_stats_compute(&stats, bayer, BENCH_WIDTH, BENCH_WIDTH, BENCH_HEIGHT, 1, BAYER_RG, step, CLIP_LEVEL);
+            total += stats.computeNs;
+            worst = stats.computeNs > worst ? stats.computeNs : worst;
+        }
+        printf("  grid step %2d: %7u histogram samples, mean %6.3f ms, worst %6.3f ms\n", step,
+               stats.histogramSamples[0] + stats.histogramSamples[1] + stats.histogramSamples[2],
+               total / (double)ITERATIONS / 1e6, worst / 1e6);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,118 @@
+// Pre-trigger buffer: pushes BayerRG8 frames of the viewer's size at 60 fps into a ring of PRE_SECONDS, triggers a
+// dump, keeps pushing for POST_SECONDS and then a while longer, and checks that the file holds exactly the frames from
+// PRE_SECONDS before the trigger to POST_SECONDS after it, in order and intact. Prints the time spent in
+// pretrigger_push, with and without a dump running, and whether the arena got huge pages.
+// Usage: pretrigger_bench [file, default /tmp/pretrigger_bench.seq]
+#include "myCode/pretrigger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_WIDTH 2048
+#define BENCH_HEIGHT 1536
+#define BENCH_FPS 60.0
+#define BENCH_FRAME_NS 16666667ull
+#define PRE_SECONDS 1.0
+#define POST_SECONDS 1.0
+// pushed before the trigger and after the dump's last frame
+#define LEAD_FRAMES 90
+#define TAIL_FRAMES 30
+
+static const pretrigger_config_t config = {
+    .preSeconds = PRE_SECONDS,
+    .postSeconds = POST_SECONDS,
+    .spareFrames = 30,
+    .hugePages = 1,
+    .recorder = {.slots = 24, .writers = 3, .preallocateSeconds = 2.0, .direct = 1, .backend = RECORDER_AUTO}};
+
+// frame number in the first bytes, a value depending on it everywhere else
+static void stamp(uint8_t *frame, size_t size, uint64_t number)
+{
+    memset(frame, (int)(number * 37 + 11) & 0xFF, size);
+    memcpy(frame, &number, sizeof(number));
+}
+
+static int verify(const char *path, size_t size, uint64_t first, uint64_t count)
+{
+    sequence_t seq;
+    if (sequence_open(&seq, path))
+        return 1;
+    uint8_t *expected = malloc(size);
+    int failures = 0;
+    if (seq.frameCount != count)
+    {
+        printf("  %lu frames, expected %lu\n", (unsigned long)seq.frameCount, (unsigned long)count);
+        failures++;
+    }
+    for (uint64_t i = 0; i < count && !failures; i++)
+    {
+        const sequence_entry_t *entry;
+        const uint8_t *frame = sequence_frame(&seq, i, &entry);
+        stamp(expected, size, first + i);
+        if (entry->flags || entry->bufferID != (uint32_t)(first + i) || memcmp(expected, frame, size))
+        {
+            printf("  frame %lu is not frame %lu\n", (unsigned long)i, (unsigned long)(first + i));
+            failures++;
+        }
+    }
+    sequence_close(&seq);
+    free(expected);
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "/tmp/pretrigger_bench.seq";
+    size_t size = (size_t)BENCH_WIDTH * BENCH_HEIGHT;
+    pretrigger_t *pt = calloc(1, sizeof(pretrigger_t));
+    uint8_t *source = malloc(size);
+    sequence_header_t format;
+    sequence_header_init(&format, "BayerRG8", BENCH_WIDTH, BENCH_HEIGHT, size, BENCH_FPS, NULL);
+    if (!pt || !source || pretrigger_init(pt, &config, &format))
+        return 1;
+
+    uint64_t preFrames = pt->preFrames, postFrames = pt->postFrames, trigger = LEAD_FRAMES;
+    uint64_t frames = trigger + postFrames + TAIL_FRAMES;
+    uint64_t pushNs[2] = {0}, worstPushNs[2] = {0}, pushes[2] = {0};
+    frame_desc_t frame = {0};
+    frame.base = source;
+    uint64_t start = frame_clock_ns();
+    for (uint64_t i = 0; i < frames; i++)
+    {
+        if (i == trigger)
+            pretrigger_trigger(pt, path);
+        stamp(source, size, i);
+        frame.bufferID = (uint32_t)i;
+        frame.timestamp = i * BENCH_FRAME_NS;
+        uint64_t due = start + i * BENCH_FRAME_NS, now = frame_clock_ns();
+        if (due > now)
+            nanosleep(&(struct timespec){(time_t)((due - now) / 1000000000), (long)((due - now) % 1000000000)}, NULL);
+        int dumping = atomic_load(&pt->dumping);
+        uint64_t before = frame_clock_ns();
+        pretrigger_push(pt, &frame);
+        uint64_t spent = frame_clock_ns() - before;
+        pushNs[dumping] += spent;
+        pushes[dumping]++;
+        worstPushNs[dumping] = spent > worstPushNs[dumping] ? spent : worstPushNs[dumping];
+    }
+    pretrigger_stats_t stats;
+    for (pretrigger_get_stats(pt, &stats); !stats.dumps; pretrigger_get_stats(pt, &stats))
+        usleep(10000);
+    pretrigger_destroy(pt);
+    pretrigger_print_stats(pt);
+    const char *names[2] = {"idle", "dumping"};
+    for (int d = 0; d < 2; d++)
+        printf("pretrigger_push %s: avg %.3f ms, max %.3f ms over %lu frames\n", names[d],
+               pushNs[d] / 1e6 / (pushes[d] ? pushes[d] : 1), worstPushNs[d] / 1e6, (unsigned long)pushes[d]);
+
+    // the ring had filled before the trigger, the frame pushed at the trigger is the first one after it
+    int failures = verify(path, size, trigger - preFrames, preFrames + postFrames);
+    failures += stats.dropped != 0;
+    printf("file check: %s\n", failures ? "FAIL" : "ok");
+    unlink(path);
+    free(source);
+    free(pt);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,154 @@
+// Runs shaders/downscale.comp on a headless EGL context (Mesa llvmpipe works) and compares every level with the CPU
+// pyramid of myCode/downscale.h: raw Bayer sources for every pattern, an RGB source, both filters. The levels come
+// back through the asynchronous readback of myCode/pyramid_gl.h, which is polled until the fences signal.
+// Run from the forKhronos directory: `make pyramid-check`
+#define STB_IMAGE_IMPLEMENTATION
+#include "myCode/pyramid_gl.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// odd level sizes on the way down
+#define CHECK_WIDTH 200
+#define CHECK_HEIGHT 136
+// the shader has the CPU's integer arithmetic
+#define CHECK_TOLERANCE 0
+
+static int create_context()
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    EGLDisplay display = getPlatformDisplay ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL)
+                                            : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major, minor;
+    if (!eglInitialize(display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API))
+    {
+        printf("EGL initialization failed - %x\n", eglGetError());
+        return -1;
+    }
+    // compute shaders
+    EGLint attributes[] = {EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 3,
+                           EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+    EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        printf("EGL context creation failed - %x\n", eglGetError());
+        return -1;
+    }
+    if (!load_glad((GLADloadproc)eglGetProcAddress))
+        return -1;
+    printf("%s, OpenGL %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+    return 0;
+}
+
+static int compare(const downscale_image_t *gpu, const downscale_image_t *cpu, const char *name, int level)
+{
+    int worst = 0, mismatches = 0;
+    if (gpu->width != cpu->width || gpu->height != cpu->height)
+    {
+        printf("%-16s 1/%d: %dx%d, expected %dx%d FAIL\n", name, 2 << level, gpu->width, gpu->height, cpu->width, cpu->height);
+        return 1;
+    }
+    for (int y = 0; y < cpu->height; y++)
+        for (int x = 0; x < cpu->width * 4; x++)
+        {
+            int diff = abs(gpu->data[y * gpu->stride + x] - cpu->data[y * cpu->stride + x]);
+            if (diff > worst)
+                worst = diff;
+            mismatches += diff > CHECK_TOLERANCE;
+        }
+    printf("%-16s 1/%d %3dx%-3d: max difference %d, %d values over %d %s\n", name, 2 << level, cpu->width, cpu->height,
+           worst, mismatches, CHECK_TOLERANCE, mismatches ? "FAIL" : "ok");
+    return mismatches != 0;
+}
+
+// one update of the pyramid, then the readbacks as soon as they are done
+static int check(pyramid_gl_t *pyramid, const downscale_image_t *src, GLuint texture, demosaic_quality_t quality,
+                 bayer_pattern_t pattern, downscale_filter_t filter, const char *name)
+{
+    downscale_image_t levels[PYRAMID_LEVELS];
+    for (int i = 0; i < PYRAMID_LEVELS; i++)
+    {
+        int width = src->width >> (i + 1), height = src->height >> (i + 1);
+        levels[i] = (downscale_image_t){malloc((size_t)width * height * 4), (size_t)width * 4, width, height, 4};
+    }
+    downscale_pyramid(NULL, src, pattern, levels, PYRAMID_LEVELS, filter, DEMOSAIC_ISA_AUTO);
+
+    pyramid->filter = filter;
+    pyramid_gl_update(pyramid, texture, src->width, src->height, quality, pattern);
+    int failures = 0;
+    for (int i = 0; i < PYRAMID_LEVELS; i++)
+    {
+        downscale_image_t gpu;
+        uint64_t sequence = 0;
+        while (pyramid_gl_read(pyramid, i, &gpu, &sequence))
+            ;
+        if (sequence != pyramid->updates)
+        {
+            printf("%-16s 1/%d: readback of update %lu, expected %lu FAIL\n", name, 2 << i, (unsigned long)sequence,
+                   (unsigned long)pyramid->updates);
+            failures++;
+        }
+        failures += compare(&gpu, &levels[i], name, i);
+        free(levels[i].data);
+    }
+    return failures;
+}
+
+int main()
+{
+    if (create_context())
+        return 1;
+    pyramid_gl_t pyramid;
+    if (pyramid_gl_create(&pyramid, "./shaders/downscale.comp", DOWNSCALE_BOX))
+        return 1;
+    for (int i = 0; i < PYRAMID_LEVELS; i++)
+        pyramid_gl_subscribe(&pyramid, i, 1);
+
+    // noise on top of gradients and hard edges, so every tap of the Lanczos filter matters
+    static uint8_t pixels[CHECK_WIDTH * CHECK_HEIGHT * 3];
+    srand(1);
+    for (int i = 0; i < CHECK_WIDTH * CHECK_HEIGHT * 3; i++)
+    {
+        int x = i % (CHECK_WIDTH * 3), y = i / (CHECK_WIDTH * 3);
+        pixels[i] = (uint8_t)((x * 255 / (CHECK_WIDTH * 3) + ((x / 7 + y / 5) & 1) * 96 + rand() % 64) & 0xFF);
+    }
+    GLuint *tex = create_textures(2);
+    video_texture_t raw, rgb;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    create_video_texture(&raw, tex[0], GL_R8, CHECK_WIDTH, CHECK_HEIGHT, MIP_NONE, 1);
+    update_texture_from_buffer(GL_TEXTURE_2D, 0, 0, CHECK_WIDTH, CHECK_HEIGHT, GL_RED, GL_UNSIGNED_BYTE, pixels);
+    create_video_texture(&rgb, tex[1], GL_RGB8, CHECK_WIDTH, CHECK_HEIGHT, MIP_NONE, 1);
+    update_texture_from_buffer(GL_TEXTURE_2D, 0, 0, CHECK_WIDTH, CHECK_HEIGHT, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+
+    downscale_image_t bayer = {pixels, CHECK_WIDTH, CHECK_WIDTH, CHECK_HEIGHT, 1};
+    downscale_image_t color = {pixels, CHECK_WIDTH * 3, CHECK_WIDTH, CHECK_HEIGHT, 3};
+    int failures = 0;
+    for (downscale_filter_t filter = DOWNSCALE_BOX; filter <= DOWNSCALE_LANCZOS; filter++)
+    {
+        for (int pattern = BAYER_RG; pattern <= BAYER_BG; pattern++)
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "%s %s", bayer_pixel_format(pattern), filter == DOWNSCALE_BOX ? "box" : "lanczos");
+            failures += check(&pyramid, &bayer, tex[0], DEMOSAIC_MALVAR, pattern, filter, name);
+        }
+        failures += check(&pyramid, &color, tex[1], DEMOSAIC_NONE, BAYER_RG, filter,
+                          filter == DOWNSCALE_BOX ? "RGB8 box" : "RGB8 lanczos");
+    }
+
+    // nobody subscribed below 1/2: the deeper levels are neither computed nor read back
+    pyramid_gl_unsubscribe(&pyramid, 1, 1);
+    pyramid_gl_unsubscribe(&pyramid, 2, 1);
+    pyramid_gl_update(&pyramid, tex[0], CHECK_WIDTH, CHECK_HEIGHT, DEMOSAIC_MALVAR, BAYER_RG);
+    downscale_image_t unused;
+    int skipped = pyramid_gl_read(&pyramid, 1, &unused, NULL) && pyramid_gl_read(&pyramid, 2, &unused, NULL);
+    printf("unsubscribed levels skipped: %s\n", skipped ? "ok" : "FAIL");
+    failures += !skipped;
+
+    pyramid_gl_destroy(&pyramid);
+    delete_textures(2, tex);
+    return failures ? 1 : 0;
+}
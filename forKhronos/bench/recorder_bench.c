@@ -0,0 +1,148 @@
+// Recorder: pushes RGB8 frames of the viewer's size at 60 fps, then as fast as the callback can copy them, through
+// each backend, uncompressed and compressed in tiles. Opens the file as a sequence and checks that every frame taken is
+// there with its timestamp and buffer, and prints the time spent in recorder_push, the write throughput and the drops.
+// The file system of the path decides whether O_DIRECT applies.
+// Usage: recorder_bench [file, default /tmp/recorder_bench.raw]
+#include "myCode/recorder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_WIDTH 2048
+#define BENCH_HEIGHT 1536
+#define BENCH_CHANNELS 3
+#define PACED_FRAMES 180
+#define FLOOD_FRAMES 600
+#define BENCH_FPS 60.0
+#define BENCH_FRAME_NS 16666667ull
+
+static const recorder_config_t config = {
+    .slots = 24,
+    .writers = 3,
+    .preallocateSeconds = 2.0,
+    .direct = 1,
+    .compressionStrategy = Z_RLE,
+    .compressionThreads = 0,
+    .tileRows = 64};
+
+// frame number in the first bytes, a value depending on it everywhere else
+static void stamp(uint8_t *frame, size_t size, uint64_t number)
+{
+    memset(frame, (int)(number * 37 + 11) & 0xFF, size);
+    memcpy(frame, &number, sizeof(number));
+}
+
+// the n-th taken frame is frame n of the sequence
+static int verify(const char *path, size_t size, const uint64_t *numbers, uint64_t count)
+{
+    sequence_t seq;
+    if (sequence_open(&seq, path))
+        return 1;
+    uint8_t *expected = malloc(size), *frame = malloc(size);
+    int failures = 0;
+    if (seq.frameCount != count || seq.header->frameSize != size || seq.header->width != BENCH_WIDTH)
+    {
+        printf("  %lu frames of %lu bytes, expected %lu of %zu\n", (unsigned long)seq.frameCount,
+               (unsigned long)seq.header->frameSize, (unsigned long)count, size);
+        failures++;
+    }
+    for (uint64_t i = 0; i < count && !failures; i++)
+    {
+        const sequence_entry_t *entry;
+        sequence_frame(&seq, i, &entry);
+        stamp(expected, size, numbers[i]);
+        if (entry->offset % SEQUENCE_FRAME_ALIGNMENT || entry->flags || sequence_decode(&seq, i, NULL, frame) ||
+            memcmp(expected, frame, size) ||
+            entry->timestamp != numbers[i] * BENCH_FRAME_NS || entry->bufferID != (uint32_t)numbers[i])
+        {
+            printf("  frame %lu (pushed as %lu) differs\n", (unsigned long)i, (unsigned long)numbers[i]);
+            failures++;
+        }
+    }
+    sequence_close(&seq);
+    free(expected);
+    free(frame);
+    return failures;
+}
+
+static int run(const char *path, recorder_backend_t backend, int level, int frames, double fps)
+{
+    size_t size = (size_t)BENCH_WIDTH * BENCH_HEIGHT * BENCH_CHANNELS;
+    recorder_config_t c = config;
+    c.backend = backend;
+    c.compressionLevel = level;
+    recorder_t *rec = calloc(1, sizeof(recorder_t));
+    uint8_t *source = aligned_alloc(64, size);
+    uint64_t *numbers = calloc(frames, sizeof(uint64_t)), taken = 0, pushNs = 0, worstPushNs = 0;
+    sequence_header_t format;
+    sequence_header_init(&format, "RGB8", BENCH_WIDTH, BENCH_HEIGHT, size, BENCH_FPS, NULL);
+    if (recorder_start(rec, &c, path, &format))
+        return 1;
+
+    frame_desc_t frame = {0};
+    frame.base = source;
+    uint64_t start = frame_clock_ns();
+    for (int i = 0; i < frames; i++)
+    {
+        // the frame is written by the "grabber" before its callback
+        stamp(source, size, (uint64_t)i);
+        frame.timestamp = (uint64_t)i * BENCH_FRAME_NS;
+        frame.bufferID = (uint32_t)i;
+        if (fps > 0)
+        {
+            uint64_t due = start + (uint64_t)(i * 1e9 / fps), now = frame_clock_ns();
+            if (due > now)
+                nanosleep(&(struct timespec){(time_t)((due - now) / 1000000000), (long)((due - now) % 1000000000)}, NULL);
+        }
+        uint64_t before = frame_clock_ns();
+        if (recorder_push(rec, &frame))
+            numbers[taken++] = (uint64_t)i;
+        uint64_t spent = frame_clock_ns() - before;
+        pushNs += spent;
+        worstPushNs = spent > worstPushNs ? spent : worstPushNs;
+    }
+    recorder_stats_t stats;
+    recorder_get_stats(rec, &stats);
+    printf("  at the last push: backlog %u, dropped %lu\n", stats.backlog, (unsigned long)stats.dropped);
+    recorder_stop(rec);
+    printf("  ");
+    recorder_print_stats(rec);
+    printf("  recorder_push: avg %.3f ms, max %.3f ms\n", pushNs / 1e6 / frames, worstPushNs / 1e6);
+
+    int failures = verify(path, size, numbers, taken);
+    recorder_get_stats(rec, &stats);
+    if (stats.frames != taken || stats.writeErrors)
+        failures++;
+    // paced at the camera rate nothing may be dropped; the encoder keeps up only with enough CPUs
+    if (fps > 0 && stats.dropped && !level)
+        failures++;
+    else if (fps > 0 && stats.dropped)
+        printf("  the encoder is slower than the camera on %ld CPUs\n", sysconf(_SC_NPROCESSORS_ONLN));
+    printf("  file check: %s\n", failures ? "FAIL" : "ok");
+    unlink(path);
+    free(numbers);
+    free(source);
+    free(rec);
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "/tmp/recorder_bench.raw";
+    const char *names[] = {"auto", "io_uring", "pwrite threads"};
+    int failures = 0;
+    printf("%dx%d RGB8 frames (%.1f MB) to %s\n", BENCH_WIDTH, BENCH_HEIGHT,
+           BENCH_WIDTH * BENCH_HEIGHT * BENCH_CHANNELS / 1e6, path);
+    for (recorder_backend_t backend = RECORDER_IO_URING; backend <= RECORDER_THREADS; backend++)
+        for (int level = 0; level <= Z_BEST_SPEED; level += Z_BEST_SPEED)
+        {
+            const char *compressed = level ? ", compressed" : "";
+            printf("%s%s, %d frames at %.0f fps:\n", names[backend], compressed, PACED_FRAMES, BENCH_FPS);
+            failures += run(path, backend, level, PACED_FRAMES, BENCH_FPS);
+            printf("%s%s, %d frames unpaced:\n", names[backend], compressed, FLOOD_FRAMES);
+            failures += run(path, backend, level, FLOOD_FRAMES, 0);
+        }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,165 @@
+// Replay: records a sequence of RGB8 frames with uneven timestamps, then plays it into a frame ring at the recorded
+// rate, checking how late each frame is against its timestamp, and as fast as possible, with a consumer that reads
+// every frame it pops. The second run of the flood measures the page cache, the first the readahead from disk. Then the
+// same with a compressed recording, which the replay inflates before delivering; every frame is one byte value, so a
+// decoded buffer rewritten while the consumer reads it shows as a torn frame.
+// Usage: replay_bench [file, default /tmp/replay_bench.seq]
+#include "myCode/recorder.h"
+#include "myCode/replay.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_WIDTH 2048
+#define BENCH_HEIGHT 1536
+#define BENCH_FRAMES 120
+#define BENCH_FPS 60.0
+#define BENCH_FRAME_NS 16666667ull
+#define PACED_SECONDS 3.0
+#define FLOOD_SECONDS 2.0
+
+// keeps the reads of the consumer
+static volatile uint64_t consumed;
+
+typedef struct bench_consumer_t
+{
+    frame_ring_t ring;
+    uint64_t startNs;
+    uint64_t firstTimestamp;
+    uint64_t late, worstLateNs, delivered;
+    uint64_t lastTimestamp;
+    int backwards;
+    uint64_t torn;
+} bench_consumer_t;
+
+// the replay thread's side, where the grabber callback would push
+static void deliver(const frame_desc_t *frame, void *context)
+{
+    bench_consumer_t *c = (bench_consumer_t *)context;
+    if (!c->delivered)
+        c->firstTimestamp = frame->timestamp;
+    uint64_t due = c->startNs + (frame->timestamp - c->firstTimestamp), now = frame->receivedNs;
+    if (now > due)
+    {
+        c->late += now - due;
+        c->worstLateNs = now - due > c->worstLateNs ? now - due : c->worstLateNs;
+    }
+    c->backwards += c->delivered && frame->timestamp <= c->lastTimestamp;
+    c->lastTimestamp = frame->timestamp;
+    c->delivered++;
+    frame_ring_push(&c->ring, frame);
+}
+
+static int record(const char *path, int level)
+{
+    size_t size = (size_t)BENCH_WIDTH * BENCH_HEIGHT * 3;
+    recorder_config_t config = {.slots = 8, .writers = 2, .preallocateSeconds = 2.0, .direct = 1,
+                                .compressionLevel = level, .compressionStrategy = Z_RLE, .tileRows = 64};
+    sequence_header_t format;
+    sequence_header_init(&format, "RGB8", BENCH_WIDTH, BENCH_HEIGHT, size, BENCH_FPS, NULL);
+    recorder_t *rec = calloc(1, sizeof(recorder_t));
+    uint8_t *source = malloc(size);
+    if (!rec || !source || recorder_start(rec, &config, path, &format))
+        return -1;
+    frame_desc_t frame = {0};
+    frame.base = source;
+    uint64_t timestamp = 1000000000ull;
+    for (int i = 0; i < BENCH_FRAMES; i++)
+    {
+        memset(source, i & 0xFF, size);
+        frame.bufferID = (uint32_t)i;
+        frame.timestamp = timestamp;
+        // every tenth frame comes late, as after a lost one
+        timestamp += i % 10 == 9 ? 2 * BENCH_FRAME_NS : BENCH_FRAME_NS;
+        // the slots are never all full at the disk's pace, the recorder takes every frame
+        while (!recorder_push(rec, &frame))
+            usleep(1000);
+    }
+    recorder_stop(rec);
+    free(source);
+    free(rec);
+    return 0;
+}
+
+static int run(const char *path, double speed, double seconds, const char *name)
+{
+    replay_t *replay = calloc(1, sizeof(replay_t));
+    bench_consumer_t *c = calloc(1, sizeof(bench_consumer_t));
+    if (replay_open(replay, path))
+        return 1;
+    frame_ring_init(&c->ring, replay_release, replay);
+    replay_config_t config = {.speed = speed, .loop = 1, .readaheadFrames = 8, .decodeThreads = 0};
+    c->startNs = frame_clock_ns();
+    replay_start(replay, &config, deliver, c);
+
+    // the render loop: the newest frame, every page of it read once
+    uint64_t popped = 0, checksum = 0, end = c->startNs + (uint64_t)(seconds * 1e9);
+    frame_desc_t frame;
+    while (frame_clock_ns() < end)
+    {
+        if (!frame_ring_pop_latest(&c->ring, &frame))
+        {
+            if (speed > 0)
+                usleep(1000);
+            continue;
+        }
+        const uint64_t *words = (const uint64_t *)frame.base;
+        int mixed = 0;
+        for (size_t i = 0; i < (size_t)BENCH_WIDTH * BENCH_HEIGHT * 3 / 8; i += 512)
+        {
+            checksum += words[i];
+            mixed |= words[i] != words[0];
+        }
+        c->torn += mixed;
+        replay_release(&frame, replay);
+        popped++;
+    }
+    replay_stop(replay);
+    double elapsed = (frame_clock_ns() - c->startNs) / 1e9;
+    printf("%-18s %6.1f fps delivered, %6.1f fps consumed, %lu loops, %.0f MB/s read", name,
+           c->delivered / elapsed, popped / elapsed, (unsigned long)atomic_load(&replay->loops),
+           popped * (double)replay->seq.header->frameSize / elapsed / 1e6);
+    if (speed > 0)
+        printf(", late avg %.3f ms max %.3f ms", c->late / 1e6 / (c->delivered ? c->delivered : 1), c->worstLateNs / 1e6);
+    printf("\n");
+    consumed = checksum;
+    int failures = c->backwards != 0 || c->torn;
+    // the pacing loses no ground over the gaps and the loops; inflating keeps up only with enough CPUs
+    if (speed > 0 && c->delivered < (uint64_t)(seconds * BENCH_FPS * 0.9 * BENCH_FRAMES / (BENCH_FRAMES + BENCH_FRAMES / 10)))
+    {
+        if (replay->seq.header->compression == SEQUENCE_COMPRESSION_NONE)
+            failures++;
+        else
+            printf("  the decoder is slower than the recording on %ld CPUs\n", sysconf(_SC_NPROCESSORS_ONLN));
+    }
+    if (failures)
+        printf("  FAIL: %d timestamps went backwards, %lu torn frames, %lu frames delivered\n", c->backwards,
+               (unsigned long)c->torn, (unsigned long)c->delivered);
+    replay_close(replay);
+    free(replay);
+    free(c);
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "/tmp/replay_bench.seq";
+    int failures = 0;
+    for (int level = 0; level <= Z_BEST_SPEED; level += Z_BEST_SPEED)
+    {
+        // every frame taken, the encoder keeps up with the pushes or they wait
+        if (record(path, level))
+        {
+            printf("cannot record %s\n", path);
+            return 1;
+        }
+        failures += run(path, 1.0, PACED_SECONDS, level ? "compressed" : "recorded rate");
+        failures += run(path, 0.0, FLOOD_SECONDS, level ? "compressed, flood" : "flood");
+        if (!level)
+            failures += run(path, 0.0, FLOOD_SECONDS, "flood, cached");
+        unlink(path);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+// Tile codec: compresses a synthetic Bayer frame (a smooth scene with a different response per colour, edges and
+// sensor noise) and an RGB8 frame at the viewer's size. Compares the ratio and the single thread speed of the deflate
+// strategies with deflating the unfiltered frame in one stream and checks every round trip, then measures frames per
+// second of BENCH_STRATEGY over worker pools of 1, 2, 4 and 8 threads for the encoder and the decoder. The frame is
+// cut into tiles of BENCH_TILE_ROWS rows.
+#include "myCode/tile_codec.h"
+#include "myCode/frame_clock.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_WIDTH 2048
+#define BENCH_HEIGHT 1536
+#define BENCH_TILE_ROWS 64
+#define BENCH_LEVEL Z_BEST_SPEED
+#define BENCH_STRATEGY Z_RLE
+#define ITERATIONS 20
+// the recorder has to keep up with the camera
+#define BENCH_FPS 60.0
+
+// bars and a vignetted gradient, red and blue below green like a daylight scene on a Bayer sensor, +-3 counts of noise
+static uint8_t scene(int x, int y, int channel)
+{
+    static const double response[3] = {0.55, 1.0, 0.45};
+    double dx = (x - BENCH_WIDTH / 2.0) / BENCH_WIDTH, dy = (y - BENCH_HEIGHT / 2.0) / BENCH_HEIGHT;
+    double v = 40 + 120 * (1 - dx * dx - dy * dy) * (0.6 + 0.4 * ((x / 256 + y / 192) & 1)) * response[channel];
+    return (uint8_t)fmin(255, fmax(0, v + rand() % 7 - 3));
+}
+
+static void synthetic_frame(uint8_t *frame, uint32_t bytesPerPixel)
+{
+    srand(1);
+    for (int y = 0; y < BENCH_HEIGHT; y++)
+        for (int x = 0; x < BENCH_WIDTH; x++)
+            if (bytesPerPixel == 1)
+                frame[y * BENCH_WIDTH + x] = scene(x, y, (x & 1) + (y & 1)); // RGGB
+            else
+                for (int c = 0; c < 3; c++)
+                    frame[(y * BENCH_WIDTH + x) * 3 + c] = scene(x, y, c);
+}
+
+static int run(const char *name, uint32_t bytesPerPixel)
+{
+    size_t frameSize = (size_t)BENCH_WIDTH * BENCH_HEIGHT * bytesPerPixel;
+    uint8_t *frame = malloc(frameSize), *decoded = malloc(frameSize);
+    uLongf plainSize = compressBound((uLong)frameSize);
+    uint8_t *plain = malloc(plainSize);
+    if (!frame || !decoded || !plain)
+        return 1;
+    synthetic_frame(frame, bytesPerPixel);
+    compress2(plain, &plainSize, frame, (uLong)frameSize, BENCH_LEVEL);
+    printf("%s %dx%d, unfiltered single stream %.1f%% of the frame\n", name, BENCH_WIDTH, BENCH_HEIGHT,
+           100.0 * plainSize / frameSize);
+    free(plain);
+
+    const int strategies[] = {Z_DEFAULT_STRATEGY, Z_RLE, Z_HUFFMAN_ONLY};
+    const char *strategyNames[] = {"default", "Z_RLE", "Z_HUFFMAN_ONLY"};
+    int failures = 0;
+    tile_codec_t codec;
+    uint8_t *payload = NULL;
+    size_t size = 0;
+    for (int s = 0; s < 3; s++)
+    {
+        if (tile_codec_init(&codec, BENCH_WIDTH, BENCH_HEIGHT, bytesPerPixel, BENCH_TILE_ROWS, BENCH_LEVEL, strategies[s]))
+            return 1;
+        payload = realloc(payload, tile_codec_bound(&codec));
+        uint64_t start = frame_clock_ns();
+        size = tile_codec_encode(&codec, NULL, frame, payload);
+        double ms = (frame_clock_ns() - start) / 1e6;
+        int ok = size && tile_codec_decode(&codec, NULL, payload, size, decoded) == 0 && !memcmp(frame, decoded, frameSize);
+        printf("  %-15s %u tiles: %.1f%% of the frame, encode %.1f ms on one thread, round trip %s\n", strategyNames[s],
+               codec.tileCount, 100.0 * size / frameSize, ms, ok ? "ok" : "FAIL");
+        failures += !ok;
+        tile_codec_destroy(&codec);
+    }
+    if (tile_codec_init(&codec, BENCH_WIDTH, BENCH_HEIGHT, bytesPerPixel, BENCH_TILE_ROWS, BENCH_LEVEL, BENCH_STRATEGY))
+        return 1;
+    size = tile_codec_encode(&codec, NULL, frame, payload);
+
+    const int threadCounts[] = {1, 2, 4, 8};
+    for (int t = 0; t < 4 && !failures; t++)
+    {
+        worker_pool_t pool;
+        worker_pool_init(&pool, threadCounts[t], -1);
+        uint64_t start = frame_clock_ns();
+        for (int i = 0; i < ITERATIONS; i++)
+            size = tile_codec_encode(&codec, &pool, frame, payload);
+        double encodeFps = ITERATIONS / ((frame_clock_ns() - start) / 1e9);
+        start = frame_clock_ns();
+        for (int i = 0; i < ITERATIONS; i++)
+            failures += tile_codec_decode(&codec, &pool, payload, size, decoded) != 0;
+        double decodeFps = ITERATIONS / ((frame_clock_ns() - start) / 1e9);
+        failures += memcmp(frame, decoded, frameSize) != 0;
+        printf("  Z_RLE, %d threads: encode %6.1f fps (%6.1f MB/s in), decode %6.1f fps%s\n", threadCounts[t], encodeFps,
+               encodeFps * frameSize / 1e6, decodeFps, encodeFps < BENCH_FPS ? ", slower than the camera" : "");
+        worker_pool_destroy(&pool);
+    }
+    tile_codec_destroy(&codec);
+    free(payload);
+    free(frame);
+    free(decoded);
+    return failures;
+}
+
+int main()
+{
+    int failures = run("BayerRG8", 1);
+    failures += run("RGB8", 3);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,157 @@
+#ifndef acquisition_h
+#define acquisition_h
+
+#include "KAYA/KYFGLib.h"
+#include "myCode/frame_ring.h"
+#include "myCode/frame_loss.h"
+#include "myCode/zero_copy.h"
+#include "myCode/buffer_queue.h"
+#include "myCode/pretrigger.h"
+#include "myCode/recorder.h"
+#include "myCode/replay.h"
+
+#define ACQ_MAX_GRABBERS 4
+
+// acquisition modes
+// ACQ_MODE_AUTO_CYCLE - KYFGLib allocates and cycles buffers, every frame is copied into a PBO
+// ACQ_MODE_ZERO_COPY  - the grabber writes straight into persistently mapped PBOs, fenced until uploaded
+// ACQ_MODE_QUEUED     - KYFGLib allocated buffers are requeued only after the render loop has copied them
+#define ACQ_MODE_AUTO_CYCLE 0
+#define ACQ_MODE_ZERO_COPY 1
+#define ACQ_MODE_QUEUED 2
+
+// region of interest and pixel combining of the sensor. Offsets and sizes are in output pixels, after binning and
+// decimation, like the GenICam features. Offsets are rounded down to even so the Bayer phase stays the same
+typedef struct acq_geometry_t
+{
+    int64_t width, height;     // 0 for the whole (binned) sensor
+    int64_t offsetX, offsetY;  // -1 centres the region
+    int64_t binning;           // BinningHorizontal and BinningVertical, 1 for none
+    int64_t decimation;        // DecimationHorizontal and DecimationVertical, 1 for none
+    double frameRate;          // AcquisitionFrameRate, 0 for the rate the camera was opened with
+} acq_geometry_t;
+
+typedef struct acq_config_t
+{
+    int mode;
+    GLuint zeroCopyBuffers;
+    uint32_t autoCycleBuffers;
+    uint32_t queuedBuffers;    // 0 sizes the queue from the consumer latency and the camera frame rate
+    uint32_t maxQueuedBuffers; // upper bound of a queue sized from the latency, 0 for none
+    // sizes the first queued stream of every camera. Only a stream recreated by acq_camera_set_geometry is sized from
+    // the 99th percentile hold time measured on the stream before it
+    double expectedConsumerLatencyMs;
+    double lossSampleSeconds; // RXFrameCounter polling interval, 0 only reads it at start and stop
+    acq_geometry_t geometry;  // applied to every camera before its stream is created
+    replay_config_t replay;   // playback of the cameras opened by acq_engine_open_replay, which ignore the rest
+} acq_config_t;
+
+// Everything one camera needs to stream. Its address is the callback userContext, so cameras never share
+// a ring, a stream or a lock; the callback of one camera only ever touches its own acq_camera_t.
+typedef struct acq_camera_t
+{
+    int grabberIndex;
+    int cameraIndex;
+    FGHANDLE grabberHandle;
+    CAMHANDLE camHandle;
+    STREAM_HANDLE streamHandle;
+    int mode;
+    double fps;
+    int64_t width, height;             // of the frames the stream delivers, read back from the camera
+    int64_t offsetX, offsetY;          // of the region, in frame pixels
+    int64_t pixelScale;                // sensor pixels per frame pixel, binning times decimation
+    int64_t sensorWidth, sensorHeight; // largest unbinned region, read once
+    double defaultFrameRate;           // AcquisitionFrameRate before the first geometry
+    frame_ring_t ring;
+    frame_loss_t loss;
+    zero_copy_t zeroCopy;
+    buffer_queue_t queue;
+    uint64_t measuredHoldNs; // p99 consumer hold of the previous queued stream, sizes the next one; 0 until then
+    recorder_t recorder;     // copies every frame in the callback while started, copying modes only
+    pretrigger_t pretrigger; // keeps the last seconds of frames in the callback once set up, copying modes only
+    replay_t replay;         // recording delivered instead of a grabber's frames, see acq_camera_is_replay
+    int started;
+} acq_camera_t;
+
+// called once per opened camera, from that camera's grabber thread
+typedef void (*acq_setup_fn)(FGHANDLE handle, CAMHANDLE camHandle, int grabberIndex, int cameraIndex);
+
+typedef struct acq_engine_t
+{
+    FGHANDLE grabbers[ACQ_MAX_GRABBERS];
+    acq_camera_t *cameras; // grabber major, cameraCount entries
+    int cameraCount;
+    acq_config_t config;
+    uint64_t lossSampleNs;
+    uint64_t lastLossSampleNs;
+} acq_engine_t;
+
+// This function connects to every grabber found by KY_DeviceScan and opens all of their cameras, one thread per
+// grabber so slow camera discovery and XML download on one board does not hold up the others. setup runs on every
+// camera that opened. Returns the number of open cameras
+int acq_engine_open(
+    acq_engine_t *engine,
+    acq_setup_fn setup);
+
+// This function opens count recorded sequences as cameras whose frames come from a replay thread instead of a grabber,
+// through the same callback, ring and recorder. They run in ACQ_MODE_AUTO_CYCLE whatever the configured mode, the
+// frames stay in the file mapping or, compressed, in decoded buffers given back by acq_camera_release. Sequences of
+// another pixelFormat than the viewer expects are skipped. Returns the number of open cameras
+int acq_engine_open_replay(
+    acq_engine_t *engine,
+    const char *const *paths,
+    int count,
+    const char *pixelFormat);
+
+// This function tells a camera of acq_engine_open_replay: no grabber, no GenICam features
+static inline int acq_camera_is_replay(
+    const acq_camera_t *camera)
+{
+    return camera->grabberIndex < 0;
+}
+
+// This function creates one stream per open camera in the configured mode, registers the callback with the camera
+// as its context and starts acquisition. Zero-copy streams are GL buffers, so call it from the thread owning the
+// GL context. Returns the number of started cameras
+int acq_engine_start(
+    acq_engine_t *engine,
+    const acq_config_t *config);
+
+// This function changes the region of interest, binning and frame rate of a running camera: it stops the camera,
+// deletes its stream, writes the geometry and creates and starts a stream sized for the new frames. Frames popped
+// earlier must not be used any more. Same thread as acq_engine_start. A replayed camera keeps the recorded geometry.
+// Returns 0 if the camera runs again
+int acq_camera_set_geometry(
+    acq_engine_t *engine,
+    acq_camera_t *camera,
+    const acq_geometry_t *geometry);
+
+// This function takes the newest frame of one camera, see frame_ring_pop_latest. Render thread only
+int acq_camera_pop_latest(
+    acq_camera_t *camera,
+    frame_desc_t *frame);
+
+// This function hands a frame the render loop has copied out back to the grabber in queued mode, or its decoded
+// buffer back to a replay (zero-copy buffers go back through acq_engine_recycle, auto cycle buffers are never held)
+void acq_camera_release(
+    acq_camera_t *camera,
+    const frame_desc_t *frame);
+
+// This function requeues zero-copy buffers whose uploads have completed, on every camera. Call once per rendered frame
+void acq_engine_recycle(
+    acq_engine_t *engine);
+
+// This function samples RXFrameCounter of every camera once the loss sample interval has passed and prints the loss
+// breakdown of cameras that lost frames since the previous sample. Call from the render loop
+void acq_engine_poll(
+    acq_engine_t *engine);
+
+// This function stops every camera, prints per-camera frame loss and queue statistics and deletes the streams
+void acq_engine_stop(
+    acq_engine_t *engine);
+
+// This function closes the grabbers and frees the camera table
+void acq_engine_close(
+    acq_engine_t *engine);
+
+#endif //  acquisition_h
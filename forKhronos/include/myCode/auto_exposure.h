@@ -0,0 +1,49 @@
+#ifndef auto_exposure_h
+#define auto_exposure_h
+
+#include "myCode/frame_stats.h"
+#include <stdint.h>
+
+typedef struct auto_exposure_config_t
+{
+    double targetMean;         // green mean to hold, 8 bit counts
+    double blackLevel;         // pedestal of the sensor output, not scaled by exposure
+    double tolerance;          // relative error that is left alone, keeps the loop from hunting
+    double maxClippedFraction; // above this the exposure comes down whatever the mean says
+    double minExposureUs, maxExposureUs;
+    double minGain, maxGain;
+    double maxStep;            // largest change of exposure x gain per update, as a ratio
+    double updatesPerSecond;   // camera writes are rate limited, the sensor needs a few frames to apply one
+} auto_exposure_config_t;
+
+// Exposure and analog gain from frame statistics. Exposure is preferred over gain (less noise): the total
+// exposure x gain is moved towards the target and split into the longest exposure allowed, then gain.
+typedef struct auto_exposure_t
+{
+    auto_exposure_config_t config;
+    double exposureUs;
+    double gain;
+    uint64_t lastUpdateNs;
+    uint64_t updates;
+} auto_exposure_t;
+
+// This function starts the controller from the camera's current settings
+void auto_exposure_init(
+    auto_exposure_t *ae,
+    const auto_exposure_config_t *config,
+    double exposureUs,
+    double gain);
+
+// This function returns 1 if the rate limit allows an update at nowNs, so stats are only computed when they are used
+int auto_exposure_due(
+    const auto_exposure_t *ae,
+    uint64_t nowNs);
+
+// This function feeds the stats of a frame. Returns 1 if exposureUs or gain changed and should be written to the
+// camera, 0 if they stay (within tolerance or rate limited)
+int auto_exposure_update(
+    auto_exposure_t *ae,
+    const frame_stats_t *stats,
+    uint64_t nowNs);
+
+#endif //  auto_exposure_h
@@ -0,0 +1,79 @@
+#ifndef auto_white_balance_h
+#define auto_white_balance_h
+
+#include "myCode/bayer.h"
+#include "myCode/color_gl.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+typedef enum awb_method_t
+{
+    AWB_GRAY_WORLD,  // the scene averages to gray
+    AWB_WHITE_PATCH, // the brightest unclipped pixels are white
+    AWB_COMBINED     // the mean of both estimates, steadier on scenes that fool one of them
+} awb_method_t;
+
+typedef struct awb_config_t
+{
+    awb_method_t method;
+    int decimation;            // one 2x2 cell (one RGB sample) every decimation cells in both directions
+    double blackLevel;         // pedestal subtracted before the channel ratios, 8 bit counts
+    uint8_t clipLevel;         // samples with any channel at or above are left out
+    double whitePatchFraction; // brightest share of the samples the white patch averages
+    double smoothingSeconds;   // time constant of the gain filter, hides estimate noise and lighting flicker
+    double minGain, maxGain;
+    double updatesPerSecond;
+} awb_config_t;
+
+// Software white balance. The render thread hands over a decimated copy of a frame every so often, a background
+// thread estimates red and blue gains relative to green, smooths them and folds them into the display colour
+// correction through color_gl_set_gains. Handing over never waits: a frame is skipped while the last estimate
+// is still running.
+typedef struct awb_t
+{
+    awb_config_t config;
+    color_gl_t *color;
+    pthread_t thread;
+    sem_t wake;
+    int started;
+    atomic_int quit;
+    atomic_int busy;   // samples belong to the worker
+    uint8_t *samples;  // RGB triplets
+    int sampleCount;
+    int capacity;
+    uint64_t sampledNs;
+    uint64_t lastSubmitNs;
+    uint64_t lastEstimateNs;
+    float gains[3];    // smoothed, worker only
+    uint64_t estimates;
+} awb_t;
+
+// This function starts the estimator thread. gains are the starting gains, maxWidth x maxHeight the largest frame
+// that will be submitted. Returns 0 on success, -1 on failure
+int awb_start(
+    awb_t *awb,
+    const awb_config_t *config,
+    color_gl_t *color,
+    const float gains[3],
+    int maxWidth,
+    int maxHeight);
+
+// This function decimates a raw Bayer (channels 1), RGB8 (channels 3) or RGBA8 (channels 4) frame for the estimator if
+// an update is due and the estimator is idle. Returns 1 if the frame was taken
+int awb_submit(
+    awb_t *awb,
+    const uint8_t *src,
+    size_t stride,
+    int width,
+    int height,
+    int channels,
+    bayer_pattern_t pattern,
+    uint64_t nowNs);
+
+// This function stops and joins the estimator thread
+void awb_stop(
+    awb_t *awb);
+
+#endif //  auto_white_balance_h
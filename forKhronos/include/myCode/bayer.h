@@ -0,0 +1,41 @@
+#ifndef bayer_h
+#define bayer_h
+
+#include <string.h>
+
+// colour filter layout, named by the first two pixels of the first row like the GenICam BayerXX8 pixel formats
+typedef enum bayer_pattern_t
+{
+    BAYER_RG,
+    BAYER_GR,
+    BAYER_GB,
+    BAYER_BG
+} bayer_pattern_t;
+
+typedef enum demosaic_quality_t
+{
+    DEMOSAIC_NONE,     // the image is RGB already, the grabber demosaiced it
+    DEMOSAIC_BILINEAR,
+    DEMOSAIC_MALVAR    // Malvar-He-Cutler gradient corrected linear interpolation
+} demosaic_quality_t;
+
+// column of the red pixel in each 2x2 cell
+static inline int bayer_red_x(bayer_pattern_t pattern)
+{
+    return pattern == BAYER_GR || pattern == BAYER_BG;
+}
+
+// row of the red pixel in each 2x2 cell
+static inline int bayer_red_y(bayer_pattern_t pattern)
+{
+    return pattern == BAYER_GB || pattern == BAYER_BG;
+}
+
+// GenICam pixel format name of an 8 bit pattern
+static inline const char *bayer_pixel_format(bayer_pattern_t pattern)
+{
+    static const char *names[] = {"BayerRG8", "BayerGR8", "BayerGB8", "BayerBG8"};
+    return names[pattern];
+}
+
+#endif //  bayer_h
@@ -0,0 +1,65 @@
+#ifndef buffer_queue_h
+#define buffer_queue_h
+
+#include "KAYA/KYFGLib.h"
+#include "myCode/frame_ring.h"
+#include <stdatomic.h>
+
+// hold times in 1 ms buckets, the last one takes everything longer
+#define BUFFER_QUEUE_HOLD_BUCKETS 256
+
+// Explicitly queued acquisition: KYFGLib allocated buffers that only go back to the grabber's input queue
+// once the consumer has released them, so a frame can never be overwritten while it is being read.
+typedef struct buffer_queue_t
+{
+    STREAM_HANDLE streamHandle;
+    STREAM_BUFFER_HANDLE *buffers;
+    uint32_t count;
+    size_t size;
+    // consumer hold time (callback -> release), measured on the render thread
+    uint64_t holdMaxNs;
+    double holdAvgNs;
+    uint64_t releases;
+    uint32_t holdBuckets[BUFFER_QUEUE_HOLD_BUCKETS];
+    atomic_uint_fast64_t requeueFailures;
+} buffer_queue_t;
+
+// This function returns how many buffers keep the grabber fed when the consumer holds each frame for
+// consumerLatencyNs at fps frames per second: the frames arriving while one is held, one being filled and one spare
+uint32_t buffer_queue_count_for_latency(
+    double fps,
+    uint64_t consumerLatencyNs);
+
+// This function returns the hold time fraction (0..1) of the released frames stayed under, rounded up to the
+// bucket; 0 before the first release
+uint64_t buffer_queue_hold_percentile(
+    const buffer_queue_t *queue,
+    double fraction);
+
+// This function creates a queued stream with count KYFGLib allocated buffers and moves all of them to the input queue.
+// Returns 0 on success, -1 on failure
+int buffer_queue_create(
+    buffer_queue_t *queue,
+    CAMHANDLE camHandle,
+    uint32_t count);
+
+// This function hands a consumed frame back to the grabber and records how long it was held. Render thread only
+void buffer_queue_release(
+    buffer_queue_t *queue,
+    const frame_desc_t *frame);
+
+// frame_release_fn for the frame ring: frames that are never consumed go straight back to the grabber
+void buffer_queue_requeue(
+    const frame_desc_t *frame,
+    void *context);
+
+// This function prints measured hold times and the buffer count their 99th percentile calls for at fps
+void buffer_queue_print_stats(
+    buffer_queue_t *queue,
+    double fps);
+
+// This function deletes the stream and its buffers. Camera must be stopped
+void buffer_queue_destroy(
+    buffer_queue_t *queue);
+
+#endif //  buffer_queue_h
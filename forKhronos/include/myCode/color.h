@@ -0,0 +1,42 @@
+#ifndef color_h
+#define color_h
+
+#include <math.h>
+
+// entries of the tone curve lookup table shared by the shader and the CPU stage
+#define COLOR_LUT_SIZE 4096
+
+// colour correction of the demosaiced image, applied in this order:
+//   c = max(c - blackLevel, 0) / (1 - blackLevel)                  black level, on values normalised to 0..1
+//   c = c * gains                                                  per channel gain (white balance)
+//   c' = ccm * (r, g, b, 1)                                         3x4 matrix, the fourth column is an offset
+//   c'' = curve(clamp(c', 0, 1))                                    tone curve from a lookup table, see color_curve
+typedef struct color_params_t
+{
+    float ccm[3][4]; // rows R, G, B; columns R, G, B and offset, same as the grabber's ColorTransformationXY
+    float gains[3];
+    float blackLevel; // in 8 bit counts
+    float gamma;
+} color_params_t;
+
+// This function sets params to the identity: no black level, unit gains and matrix, linear
+static inline void color_params_identity(color_params_t *params)
+{
+    for (int r = 0; r < 3; r++)
+    {
+        for (int c = 0; c < 4; c++)
+            params->ccm[r][c] = r == c ? 1.0f : 0.0f;
+        params->gains[r] = 1.0f;
+    }
+    params->blackLevel = 0.0f;
+    params->gamma = 1.0f;
+}
+
+// This function is the tone curve the lookup tables are filled from, x and the result in 0..1. Only a display
+// gamma for now; anything else (a knee, a log curve) goes here and costs nothing per pixel
+static inline float color_curve(const color_params_t *params, float x)
+{
+    return params->gamma > 0.0f && params->gamma != 1.0f ? powf(x, 1.0f / params->gamma) : x;
+}
+
+#endif //  color_h
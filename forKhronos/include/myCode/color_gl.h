@@ -0,0 +1,66 @@
+#ifndef color_gl_h
+#define color_gl_h
+
+#include "myCode/opengl.h"
+#include "myCode/color.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+// std140 layout of the ColorCorrection uniform block of shaders/fragmentShader.frag
+typedef struct color_gl_block_t
+{
+    GLfloat ccm[3][4]; // with the gains and the black level rescale folded in
+    GLfloat tone[4];   // black level (0..1), scale and offset of the lookup table coordinate, unused
+} color_gl_block_t;
+
+// The colour correction of the display shader: a uniform buffer, and the tone curve as a 1D texture on
+// COLOR_GL_LUT_UNIT. Any thread may set new parameters, the render thread uploads them with color_gl_apply before
+// drawing, so a change costs one small buffer update (and a 8 KB texture update when the curve changed) and no
+// grabber round trips.
+#define COLOR_GL_LUT_UNIT 1
+
+typedef struct color_gl_t
+{
+    GLuint ubo;
+    GLuint binding;
+    GLuint lut;
+    float lutGamma; // curve the texture holds
+    pthread_mutex_t lock;
+    color_params_t pending;
+    atomic_int dirty;
+} color_gl_t;
+
+// This function creates the uniform buffer and the curve texture with params, binds them to binding and
+// COLOR_GL_LUT_UNIT and connects the ColorCorrection block of program to it. The program must be in use.
+// Returns 0 on success, -1 if the program has no such block
+int color_gl_create(
+    color_gl_t *color,
+    GLuint program,
+    GLuint binding,
+    const color_params_t *params);
+
+// This function queues new parameters, safe to call from any thread
+void color_gl_set(
+    color_gl_t *color,
+    const color_params_t *params);
+
+// This function queues new per channel gains and keeps the rest of the parameters, safe to call from any thread
+void color_gl_set_gains(
+    color_gl_t *color,
+    const float gains[3]);
+
+// This function copies the latest queued parameters into *params, safe to call from any thread
+void color_gl_get(
+    color_gl_t *color,
+    color_params_t *params);
+
+// This function uploads queued parameters, if any. Render thread, once per frame before drawing. Never waits for a
+// setter, parameters queued while one holds the lock are picked up the next frame
+void color_gl_apply(
+    color_gl_t *color);
+
+// This function deletes the uniform buffer
+void color_gl_destroy(
+    color_gl_t *color);
+
+#endif //  color_gl_h
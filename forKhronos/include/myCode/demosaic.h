@@ -0,0 +1,94 @@
+#ifndef demosaic_h
+#define demosaic_h
+
+#include "myCode/bayer.h"
+#include "myCode/color.h"
+#include "myCode/worker_pool.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// instruction set of the row kernels, DEMOSAIC_ISA_AUTO picks the best the CPU supports
+typedef enum demosaic_isa_t
+{
+    DEMOSAIC_ISA_AUTO,
+    DEMOSAIC_ISA_SCALAR,
+    DEMOSAIC_ISA_SSE41,
+    DEMOSAIC_ISA_AVX2
+} demosaic_isa_t;
+
+// rows per task handed to the worker pool; a band of source and destination rows stays in L2
+#define DEMOSAIC_ROWS_PER_TASK 32
+
+// one frame to demosaic. Every output row only reads source rows y - 1 .. y + 1, so bands of rows are independent
+typedef struct demosaic_frame_t
+{
+    const uint8_t *src;
+    size_t srcStride;
+    int width, height; // at least 2 x 2
+    bayer_pattern_t pattern;
+    uint8_t *dst;
+    size_t dstStride;
+    int channels; // 3 for RGB8, 4 for RGBA8 (alpha 255)
+} demosaic_frame_t;
+
+// fraction bits of the fixed point colour matrix
+#define DEMOSAIC_COEF_BITS 8
+
+// color_params_t turned into integer steps for the fused CPU stage: the black level is subtracted from the 8 bit
+// demosaiced values, gains and matrix map them to lookup table indices, the table holds the tone curve in 8 bits.
+// Matrix times gain over (1 - black level) must stay below 8 in magnitude to fit the 16 bit coefficients
+typedef struct demosaic_color_t
+{
+    uint8_t black;
+    int16_t coef[3][3];   // lookup table entries per 8 bit count, DEMOSAIC_COEF_BITS fraction bits
+    int32_t offset[3];    // same scale, rounding included
+    uint8_t lut[COLOR_LUT_SIZE];
+} demosaic_color_t;
+
+// This function returns the instruction set DEMOSAIC_ISA_AUTO resolves to on this CPU
+demosaic_isa_t demosaic_best_isa();
+
+// This function returns the name of an instruction set
+const char *demosaic_isa_name(
+    demosaic_isa_t isa);
+
+// This function demosaics a frame with bilinear interpolation, borders mirrored. Rows are split in bands over pool
+// (NULL runs on the calling thread). Every instruction set produces exactly the output of demosaic_bilinear_reference
+void demosaic_bilinear(
+    worker_pool_t *pool,
+    const demosaic_frame_t *frame,
+    demosaic_isa_t isa);
+
+// This function demosaics rows rowBegin .. rowEnd - 1 of a frame on the calling thread
+void demosaic_bilinear_rows(
+    const demosaic_frame_t *frame,
+    demosaic_isa_t isa,
+    int rowBegin,
+    int rowEnd);
+
+// This function prepares params for demosaic_fused. Cheap enough to redo whenever the parameters change
+void demosaic_color_prepare(
+    demosaic_color_t *color,
+    const color_params_t *params);
+
+// This function demosaics a frame and applies black level, gains, matrix and tone curve in the same pass, so the raw
+// frame is read once and the output written once; the same stage as the display shader, in fixed point. Matches
+// demosaic_fused_reference exactly for every instruction set
+void demosaic_fused(
+    worker_pool_t *pool,
+    const demosaic_frame_t *frame,
+    const demosaic_color_t *color,
+    demosaic_isa_t isa);
+
+// This function is demosaic_bilinear_reference followed by the colour steps of demosaic_fused, pixel by pixel
+void demosaic_fused_reference(
+    const demosaic_frame_t *frame,
+    const demosaic_color_t *color);
+
+// This function is the plain per pixel definition of the bilinear demosaic the SIMD kernels are checked against:
+// green (l + r + u + d + 2) >> 2 at red/blue, the other of red/blue from the four diagonals the same way, and red/blue at
+// green (a + b + 1) >> 1 from the pair of neighbours of that colour
+void demosaic_bilinear_reference(
+    const demosaic_frame_t *frame);
+
+#endif //  demosaic_h
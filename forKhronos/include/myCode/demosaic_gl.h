@@ -0,0 +1,14 @@
+#ifndef demosaic_gl_h
+#define demosaic_gl_h
+
+#include "myCode/opengl.h"
+#include "myCode/bayer.h"
+
+// This function selects the demosaic of shaders/fragmentShader.frag. With DEMOSAIC_NONE the bound texture is sampled
+// as RGB, otherwise it must be a single channel (GL_R8) raw Bayer texture in pattern. The program must be in use
+void demosaic_gl_set(
+    GLuint program,
+    demosaic_quality_t quality,
+    bayer_pattern_t pattern);
+
+#endif //  demosaic_gl_h
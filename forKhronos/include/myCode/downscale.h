@@ -0,0 +1,70 @@
+#ifndef downscale_h
+#define downscale_h
+
+#include "myCode/bayer.h"
+#include "myCode/demosaic.h"
+#include "myCode/worker_pool.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Halving of camera frames into RGBA8 (alpha 255), the CPU side of the image pyramid (myCode/pyramid_gl.h has the
+// compute shader one). A raw Bayer frame is halved by its 2x2 cells: red, the mean of both greens and blue, one cell
+// holds only one sample of each colour so there is nothing to filter. RGB8 and RGBA8 images are halved with
+//   DOWNSCALE_BOX      the mean of 2x2 pixels
+//   DOWNSCALE_LANCZOS  a separable Lanczos-2 filter, 8 taps per direction in fixed point, mirrored borders
+// Odd sizes lose their last column or row.
+typedef enum downscale_filter_t
+{
+    DOWNSCALE_BOX,
+    DOWNSCALE_LANCZOS
+} downscale_filter_t;
+
+#define DOWNSCALE_TAPS 8
+// fraction bits of the horizontal and the vertical Lanczos weights, the horizontal pass keeps 16 bit sums
+#define DOWNSCALE_H_BITS 6
+#define DOWNSCALE_V_BITS 7
+
+typedef struct downscale_image_t
+{
+    uint8_t *data;
+    size_t stride;
+    int width, height;
+    int channels; // 1 for raw Bayer, 3 for RGB8, 4 for RGBA8
+} downscale_image_t;
+
+// This function fills the taps of a Lanczos-2 halving, output pixel x reads input pixels 2x - 3 .. 2x + 4. They sum
+// to exactly 1 << bits
+void downscale_lanczos_weights(
+    int bits,
+    int weights[DOWNSCALE_TAPS]);
+
+// This function halves src into dst, an RGBA8 image of src->width / 2 x src->height / 2. pattern is only used for raw
+// Bayer sources, filter only for RGB ones. Rows are split in bands over pool (NULL runs on the calling thread). The
+// SIMD kernels cover RGBA8 and raw Bayer sources (Lanczos in SSE4.1), every instruction set matches
+// downscale_half_reference exactly
+void downscale_half(
+    worker_pool_t *pool,
+    const downscale_image_t *src,
+    bayer_pattern_t pattern,
+    const downscale_image_t *dst,
+    downscale_filter_t filter,
+    demosaic_isa_t isa);
+
+// This function is downscale_half pixel by pixel
+void downscale_half_reference(
+    const downscale_image_t *src,
+    bayer_pattern_t pattern,
+    const downscale_image_t *dst,
+    downscale_filter_t filter);
+
+// This function halves src into levels[0], levels[0] into levels[1] and so on, count levels
+void downscale_pyramid(
+    worker_pool_t *pool,
+    const downscale_image_t *src,
+    bayer_pattern_t pattern,
+    const downscale_image_t *levels,
+    int count,
+    downscale_filter_t filter,
+    demosaic_isa_t isa);
+
+#endif //  downscale_h
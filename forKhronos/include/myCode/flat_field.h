@@ -0,0 +1,138 @@
+#ifndef flat_field_h
+#define flat_field_h
+
+#include "myCode/demosaic.h"
+#include "myCode/worker_pool.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Per pixel calibration of raw Bayer frames, before the demosaic:
+//   v = max(raw - dark, 0) * gain          dark and gain maps in 16 bit fixed point
+// and defective pixels (hot in the dark reference, dead or stuck in the flat one) replaced by the mean of their usable
+// same colour neighbours two pixels left, right, up and down. The maps are built from averaged dark frames (lens
+// capped, same ExposureTime and gain) and flat frames (uniform light); the gain brings every pixel to the mean
+// response of its colour, which removes vignetting and pixel response differences.
+
+// fraction bits of the dark map, 8 bit counts
+#define FLAT_FIELD_DARK_BITS 8
+// fraction bits of the gain map, gains up to 16. Gain 0 marks a defective pixel
+#define FLAT_FIELD_GAIN_BITS 12
+
+typedef struct flat_field_t
+{
+    int64_t width, height;     // region the maps were captured at, like acq_camera_t
+    int64_t offsetX, offsetY;
+    int64_t pixelScale;
+    uint16_t *dark;
+    uint16_t *gain;
+    uint32_t *defects; // y * width + x, ascending
+    uint32_t defectCount;
+} flat_field_t;
+
+typedef enum flat_field_reference_t
+{
+    FLAT_FIELD_DARK,
+    FLAT_FIELD_FLAT
+} flat_field_reference_t;
+
+// frames summed for the references, both kept until the region changes so a flat can follow a dark capture
+typedef struct flat_field_capture_t
+{
+    int64_t width, height, offsetX, offsetY, pixelScale;
+    uint32_t *sums[2];
+    int frames[2];
+    flat_field_reference_t reference; // being captured
+    int remaining;                    // frames still to add, 0 when idle
+} flat_field_capture_t;
+
+typedef struct flat_field_config_t
+{
+    double hotCounts;            // dark level above the mean of its colour that makes a pixel hot, 8 bit counts
+    double maxResponseDeviation; // flat response off the mean of its colour by more than this share is defective
+} flat_field_config_t;
+
+// This function starts summing frames frames of reference. A different region than the last capture drops the
+// sums of the other reference too. Returns 0 on success, -1 if out of memory
+int flat_field_capture_start(
+    flat_field_capture_t *capture,
+    flat_field_reference_t reference,
+    int frames,
+    int64_t width,
+    int64_t height,
+    int64_t offsetX,
+    int64_t offsetY,
+    int64_t pixelScale);
+
+// This function adds a raw frame of the capture's region. Returns 1 when it completed the reference, 0 otherwise
+int flat_field_capture_add(
+    flat_field_capture_t *capture,
+    const uint8_t *src,
+    size_t stride);
+
+// This function frees the sums
+void flat_field_capture_free(
+    flat_field_capture_t *capture);
+
+// This function builds maps and defect list from the captured references. Without a dark reference the dark level
+// is 0 and no pixel is hot, without a flat one every gain is 1. Returns 0 on success, -1 if nothing was captured or out
+// of memory
+int flat_field_build(
+    flat_field_t *ff,
+    const flat_field_capture_t *capture,
+    const flat_field_config_t *config);
+
+// This function writes the maps and the defect list, zlib compressed. Returns 0 on success, -1 on failure
+int flat_field_save(
+    const flat_field_t *ff,
+    const char *path);
+
+// This function reads a file of flat_field_save. Returns 0 on success, -1 on failure
+int flat_field_load(
+    flat_field_t *ff,
+    const char *path);
+
+// This function frees the maps and the defect list
+void flat_field_free(
+    flat_field_t *ff);
+
+// This function checks that the maps cover a frame region of the same pixel scale and returns the position of the
+// frame's first pixel in the maps. Returns 0 if the maps apply, -1 if not
+int flat_field_shift(
+    const flat_field_t *ff,
+    int64_t width,
+    int64_t height,
+    int64_t offsetX,
+    int64_t offsetY,
+    int64_t pixelScale,
+    int *shiftX,
+    int *shiftY);
+
+// This function calibrates a width x height raw frame from src into dst, rows split in bands over pool (NULL runs on
+// the calling thread). shiftX and shiftY come from flat_field_shift. dst is only written, it may be write-combined
+// mapped memory. Every instruction set matches flat_field_apply_reference exactly
+void flat_field_apply(
+    worker_pool_t *pool,
+    const flat_field_t *ff,
+    int shiftX,
+    int shiftY,
+    const uint8_t *src,
+    size_t srcStride,
+    uint8_t *dst,
+    size_t dstStride,
+    int width,
+    int height,
+    demosaic_isa_t isa);
+
+// This function is flat_field_apply pixel by pixel
+void flat_field_apply_reference(
+    const flat_field_t *ff,
+    int shiftX,
+    int shiftY,
+    const uint8_t *src,
+    size_t srcStride,
+    uint8_t *dst,
+    size_t dstStride,
+    int width,
+    int height);
+
+#endif //  flat_field_h
@@ -0,0 +1,40 @@
+#ifndef flat_field_gl_h
+#define flat_field_gl_h
+
+#include "myCode/opengl.h"
+#include "myCode/flat_field.h"
+
+// The dark and gain maps of a flat_field_t as GL_R16UI textures on FLAT_FIELD_GL_DARK_UNIT and
+// FLAT_FIELD_GL_GAIN_UNIT. The display shader corrects every raw texel it fetches, gain 0 marks the defects it
+// replaces, so the stage costs texture fetches and no extra pass. Raw Bayer textures only
+#define FLAT_FIELD_GL_DARK_UNIT 2
+#define FLAT_FIELD_GL_GAIN_UNIT 3
+
+typedef struct flat_field_gl_t
+{
+    GLuint dark, gain; // 0 until maps are uploaded
+} flat_field_gl_t;
+
+// This function points the flat field samplers of program at their units and turns the correction off. The program
+// must be in use
+void flat_field_gl_init(
+    GLuint program);
+
+// This function uploads the maps of ff, replacing earlier ones. Render thread
+void flat_field_gl_upload(
+    flat_field_gl_t *maps,
+    const flat_field_t *ff);
+
+// This function binds the maps and turns the correction on for the next draws, or off when maps is NULL or has no
+// textures. shiftX and shiftY from flat_field_shift. The program must be in use
+void flat_field_gl_use(
+    GLuint program,
+    const flat_field_gl_t *maps,
+    int shiftX,
+    int shiftY);
+
+// This function deletes the textures
+void flat_field_gl_destroy(
+    flat_field_gl_t *maps);
+
+#endif //  flat_field_gl_h
@@ -0,0 +1,9 @@
+#ifndef frame_clock_h
+#define frame_clock_h
+
+#include <stdint.h>
+
+// This function returns CLOCK_MONOTONIC in nanoseconds, the clock of every host side frame timestamp
+uint64_t frame_clock_ns();
+
+#endif //  frame_clock_h
@@ -0,0 +1,55 @@
+#ifndef frame_copy_h
+#define frame_copy_h
+
+#include "myCode/worker_pool.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define FRAME_COPY_MAX_THREADS 8
+
+// Copies a frame in cache line aligned stripes, one per thread of a worker_pool, with non-temporal stores so the
+// destination (usually a write combined PBO) never goes through the cache. The calling thread copies stripes itself,
+// the pinned workers the rest.
+typedef struct frame_copy_t
+{
+    int threads; // stripes per copy, the caller included
+    worker_pool_t pool;
+    uint8_t *dst;
+    const uint8_t *src;
+    size_t size;
+    // statistics of frame_copy calls
+    uint64_t copies;
+    uint64_t copyNs;
+    uint64_t bytes;
+} frame_copy_t;
+
+// This function starts the worker pool. threads of 0 measures copy bandwidth for 1..online CPUs threads on
+// calibrationSize bytes and keeps the smallest count within 10% of the best. Returns 0 on success, -1 if a worker
+// could not be started: the copies then run on the threads that did, and frame_copy_destroy is still called once
+int frame_copy_init(
+    frame_copy_t *fc,
+    int threads,
+    size_t calibrationSize);
+
+// This function copies size bytes and returns once every stripe is written and fenced
+void frame_copy(
+    frame_copy_t *fc,
+    void *dst,
+    const void *src,
+    size_t size);
+
+// This function copies with non-temporal stores on the calling thread only (the kernel every stripe uses)
+void frame_copy_stream(
+    void *dst,
+    const void *src,
+    size_t size);
+
+// This function prints the thread count and the average time and bandwidth of frame_copy calls
+void frame_copy_print_stats(
+    frame_copy_t *fc);
+
+// This function stops and joins the workers
+void frame_copy_destroy(
+    frame_copy_t *fc);
+
+#endif //  frame_copy_h
@@ -0,0 +1,63 @@
+#ifndef frame_loss_h
+#define frame_loss_h
+
+#include "KAYA/KYFGLib.h"
+#include "myCode/frame_ring.h"
+#include <stdatomic.h>
+#include <stdint.h>
+
+// Where the frames of one camera went. Every frame the grabber received ends up in exactly one bucket:
+//   rx frames   = delivered + lost in the grabber
+//   delivered   = displayed + overwritten in the handoff + skipped by the renderer (+ the ones still in the ring)
+// delivered/displayed/overwritten/skipped come from the frame ring, the grabber side from RXFrameCounter and
+// from gaps in the delivered sequence.
+typedef struct frame_loss_t
+{
+    // sequence tracking, owned by the callback thread
+    uint32_t bufferCount; // buffers of an auto cycling stream, their IDs repeat in order; 0 when IDs are not sequential
+    uint32_t lastBufferID;
+    uint64_t lastTimestamp;
+    uint64_t periodNs;
+    int haveLast;
+    atomic_uint_fast64_t sequenceGaps; // frames missing between consecutive callbacks
+    // RXFrameCounter samples, owned by the thread calling frame_loss_sample
+    int64_t rxStart;
+    int64_t rxFrames; // received by the grabber since rxStart, -1 while unknown
+    uint64_t delivered; // ring->produced when rxFrames was sampled
+    uint64_t grabberLost;
+    uint64_t reported[4]; // grabber, overwritten, skipped, sequence gaps at the last report
+} frame_loss_t;
+
+// This function resets the counters of a camera about to start. bufferCount is the buffer count of an auto cycling
+// stream (0 otherwise), fps the camera frame rate and rxFrameCounter the grabber's RXFrameCounter before start
+// (negative if not available)
+void frame_loss_init(
+    frame_loss_t *loss,
+    uint32_t bufferCount,
+    double fps,
+    int64_t rxFrameCounter);
+
+// This function checks a delivered frame for a gap in the buffer ID sequence, or in the timestamps when buffer IDs
+// carry no order. Callback thread only, a few compares and one relaxed add
+void frame_loss_frame(
+    frame_loss_t *loss,
+    const frame_desc_t *frame);
+
+// This function updates the grabber side loss from a fresh RXFrameCounter reading. The ring counters are read in the
+// same call so both sides of the balance are taken at about the same time
+void frame_loss_sample(
+    frame_loss_t *loss,
+    frame_ring_t *ring,
+    int64_t rxFrameCounter);
+
+// This function returns 1 if any loss counter moved since the last call
+int frame_loss_changed(
+    frame_loss_t *loss,
+    frame_ring_t *ring);
+
+// This function prints where the frames went
+void frame_loss_print(
+    frame_loss_t *loss,
+    frame_ring_t *ring);
+
+#endif //  frame_loss_h
@@ -0,0 +1,72 @@
+#ifndef frame_ring_h
+#define frame_ring_h
+
+#include "KAYA/KYFGLib.h"
+#include "myCode/frame_clock.h"
+#include <stdatomic.h>
+#include <stdint.h>
+
+// number of descriptors in flight between the grabber callback and the render loop, must be a power of two
+#define FRAME_RING_SIZE 8
+
+typedef struct frame_desc_t
+{
+    STREAM_BUFFER_HANDLE bufferHandle;
+    uint8_t *base;
+    uint32_t bufferID;
+    uint64_t timestamp; // KY_STREAM_BUFFER_INFO_TIMESTAMP, ns
+    uint64_t receivedNs; // frame_clock_ns() when the callback saw the frame
+} frame_desc_t;
+
+// Called with every frame the consumer will never see (retired by the producer or skipped by the consumer),
+// so buffers that must be handed back to the grabber are not lost
+typedef void (*frame_release_fn)(const frame_desc_t *frame, void *context);
+
+// Slots are written by the producer and read by the consumer concurrently when the producer laps,
+// so every field is atomic and a read is only trusted if the tail did not move underneath it.
+typedef struct frame_slot_t
+{
+    atomic_uint_fast64_t bufferHandle;
+    atomic_uintptr_t base;
+    atomic_uint_fast32_t bufferID;
+    atomic_uint_fast64_t timestamp;
+    atomic_uint_fast64_t receivedNs;
+} frame_slot_t;
+
+typedef struct frame_ring_t
+{
+    _Alignas(64) atomic_uint_fast64_t head; // next position the producer writes, owned by the producer
+    _Alignas(64) atomic_uint_fast64_t tail; // oldest unconsumed position, advanced by both sides with CAS
+    _Alignas(64) atomic_uint_fast64_t produced;
+    atomic_uint_fast64_t overwritten; // retired by the producer because the ring was full
+    _Alignas(64) atomic_uint_fast64_t consumed;
+    atomic_uint_fast64_t skipped; // passed over by the consumer in favour of a newer frame
+    frame_slot_t slots[FRAME_RING_SIZE];
+    frame_release_fn release;
+    void *releaseContext;
+} frame_ring_t;
+
+// This function resets ring positions and counters.
+// release may be NULL when dropped frames need no handling (auto-cycling streams)
+void frame_ring_init(
+    frame_ring_t *ring,
+    frame_release_fn release,
+    void *releaseContext);
+
+// This function publishes a frame descriptor. Called only from the grabber callback thread.
+// When the ring is full the oldest unconsumed frame is retired and counted as overwritten.
+void frame_ring_push(
+    frame_ring_t *ring,
+    const frame_desc_t *frame);
+
+// This function takes the newest complete frame and drops every older one.
+// Called only from the render thread. Returns 1 if a frame was taken, 0 if the ring was empty.
+int frame_ring_pop_latest(
+    frame_ring_t *ring,
+    frame_desc_t *frame);
+
+// This function prints produced/consumed/overwritten/skipped counters
+void frame_ring_print_stats(
+    frame_ring_t *ring);
+
+#endif //  frame_ring_h
@@ -0,0 +1,41 @@
+#ifndef frame_stats_h
+#define frame_stats_h
+
+#include "myCode/bayer.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Per channel statistics of one frame, R G B.
+// The histograms come from one 2x2 cell every step cells in both directions, which is plenty for exposure and white
+// balance decisions. Means and clipped counts come from every pixel of the sampled rows, counted with SIMD, so a
+// small specular highlight between grid points still shows up as clipping.
+typedef struct frame_stats_t
+{
+    uint32_t histogram[3][256];
+    uint32_t histogramSamples[3];
+    double mean[3];
+    double clippedFraction[3]; // share of the pixels at or above the clip level
+    uint64_t pixels[3];        // pixels behind mean and clippedFraction
+    uint64_t computeNs;
+} frame_stats_t;
+
+// This function computes stats of a raw Bayer frame (channels 1), an RGB8 (channels 3) or an RGBA8 frame (channels 4).
+// step is the grid spacing in 2x2 cells (1 samples every row pair), clipLevel the lowest value counted as clipped
+void frame_stats_compute(
+    frame_stats_t *stats,
+    const uint8_t *src,
+    size_t stride,
+    int width,
+    int height,
+    int channels,
+    bayer_pattern_t pattern,
+    int step,
+    uint8_t clipLevel);
+
+// This function returns the value below which fraction (0..1) of the histogram samples of channel lie
+int frame_stats_percentile(
+    const frame_stats_t *stats,
+    int channel,
+    double fraction);
+
+#endif //  frame_stats_h
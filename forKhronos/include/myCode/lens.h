@@ -0,0 +1,79 @@
+#ifndef lens_h
+#define lens_h
+
+#include <stdint.h>
+
+// Brown-Conrady lens model, OpenCV's convention and coefficients. A point of the ideal (pinhole) image at pixel (x, y)
+// is seen by the camera at
+//   xn = (x - cx) / fx, yn = (y - cy) / fy, r2 = xn^2 + yn^2
+//   xd = xn (1 + k1 r2 + k2 r2^2 + k3 r2^3) + 2 p1 xn yn + p2 (r2 + 2 xn^2)
+//   yd = yn (1 + k1 r2 + k2 r2^2 + k3 r2^3) + p1 (r2 + 2 yn^2) + 2 p2 xn yn
+//   distorted pixel (fx xd + cx, fy yd + cy)
+// Pixel centres are at integer coordinates
+typedef struct lens_model_t
+{
+    double width, height; // image the calibration was made on, full sensor without binning
+    double fx, fy, cx, cy;
+    double k1, k2, k3; // radial
+    double p1, p2;     // tangential
+} lens_model_t;
+
+// vertices of the warp mesh: x, y, z and the texture coordinate, the layout of main.c's vertices[]
+#define LENS_MESH_VERTEX_FLOATS 5
+
+// a grid of triangles over a screen rectangle whose texture coordinates carry the distortion, so drawing the camera
+// texture on it shows the undistorted image. Between vertices the warp is linear, a fine enough grid hides that
+typedef struct lens_mesh_t
+{
+    float *vertices;
+    uint32_t *indices;
+    int vertexCount, indexCount;
+    double zoom; // ideal focal length over the calibrated one
+} lens_mesh_t;
+
+// This function reads a calibration file of "name value" lines: width, height, fx, fy, cx, cy, k1, k2, k3, p1, p2.
+// Lines starting with # are comments, missing coefficients are 0. Returns 0 on success, -1 if the file cannot be read
+// or has no focal length
+int lens_model_load(
+    lens_model_t *lens,
+    const char *path);
+
+// This function maps a model calibrated on the full sensor to frames read out as a region of interest. offsetX and
+// offsetY are the region's OffsetX and OffsetY, pixelScale the sensor pixels per frame pixel (binning times decimation)
+void lens_model_for_region(
+    const lens_model_t *lens,
+    int64_t offsetX,
+    int64_t offsetY,
+    int64_t pixelScale,
+    lens_model_t *region);
+
+// This function moves an ideal pixel to where the lens images it
+void lens_model_distort(
+    const lens_model_t *lens,
+    double x,
+    double y,
+    double *distortedX,
+    double *distortedY);
+
+// This function builds a columns x rows grid over the screen rectangle left..right, bottom..top that shows a
+// width x height frame of lens undistorted. zoom scales the ideal focal length; 0 picks the widest view whose edges
+// still sample inside the frame, so barrel distortion does not smear the border texels over the screen.
+// Returns 0 on success, -1 if out of memory. Free with lens_mesh_free
+int lens_mesh_build(
+    lens_mesh_t *mesh,
+    const lens_model_t *lens,
+    int width,
+    int height,
+    int columns,
+    int rows,
+    float left,
+    float bottom,
+    float right,
+    float top,
+    double zoom);
+
+// This function frees the vertices and indices of a mesh
+void lens_mesh_free(
+    lens_mesh_t *mesh);
+
+#endif //  lens_h
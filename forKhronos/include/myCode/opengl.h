@@ -12,6 +12,26 @@ typedef struct texture_t
     uint8_t *data;
 } texture_t;
 
+// how a video texture gets its mip levels
+// MIP_NONE      - base level only, sampled with GL_LINEAR
+// MIP_ON_DEMAND - levels are built only while the texture is drawn minified, and only as many as the minification needs
+// MIP_LIMITED   - a fixed number of levels is rebuilt after every upload
+typedef enum mip_policy_t
+{
+    MIP_NONE,
+    MIP_ON_DEMAND,
+    MIP_LIMITED
+} mip_policy_t;
+
+typedef struct video_texture_t
+{
+    GLuint texture;
+    GLsizei width, height;
+    mip_policy_t policy;
+    GLint levels;     // allocated with glTexStorage2D
+    GLint usedLevels; // levels currently built and sampled (GL_TEXTURE_MAX_LEVEL + 1)
+} video_texture_t;
+
 // This function loads glad. Use (GLADloadproc) get_proc_address as its argument.
 // Returns 0 on failure
 GLint load_glad(
@@ -174,6 +194,34 @@ void generate_texture_from_buffer(
     GLenum type,
     const GLvoid *buffer);
 
+// This function gives a texture immutable storage (glTexStorage2D) for a video stream and sets its filtering for the
+// mip policy. levels caps the mip chain of MIP_ON_DEMAND and MIP_LIMITED, 0 allows the full chain.
+// internal_format must be sized (GL_RGB8, GL_R8, ...)
+void create_video_texture(
+    video_texture_t *video,
+    GLuint texture,
+    GLenum internal_format,
+    GLsizei width,
+    GLsizei height,
+    mip_policy_t policy,
+    GLint levels);
+
+// This function gives a video texture new storage of another size, same mip policy. The texture name changes, read
+// video->texture afterwards. The new texture is bound and undefined until the next upload
+void resize_video_texture(
+    video_texture_t *video,
+    GLenum internal_format,
+    GLsizei width,
+    GLsizei height,
+    GLint levels);
+
+// This function builds the mip levels of a video texture after an upload, as its policy asks for.
+// drawn_width/drawn_height is its size on screen in pixels. The texture must be bound
+void update_video_texture_mips(
+    video_texture_t *video,
+    GLfloat drawn_width,
+    GLfloat drawn_height);
+
 GLuint create_shader_from_source(
     GLenum type,
     GLsizei size,
@@ -189,4 +237,24 @@ void update_texture_from_buffer(
     GLenum type,
     const GLvoid *buffer);
 
+// This function allocates immutable storage for a buffer and maps it persistently and coherently.
+// access is GL_MAP_READ_BIT and/or GL_MAP_WRITE_BIT. Returns the mapped pointer or NULL on failure
+GLvoid *create_persistent_mapped_buffer(
+    GLenum target,
+    GLuint buffer,
+    GLsizeiptr size,
+    GLbitfield access);
+
+// This function inserts a fence that signals once all previously issued GL commands have completed
+GLsync insert_fence();
+
+// This function waits up to timeout nanoseconds for a fence. Returns 1 if it has signaled
+GLint fence_signaled(
+    GLsync fence,
+    GLuint64 timeout);
+
+// This function deletes a fence
+void delete_fence(
+    GLsync fence);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,100 @@
+#ifndef pretrigger_h
+#define pretrigger_h
+
+#include "myCode/frame_ring.h"
+#include "myCode/recorder.h"
+#include "myCode/sequence.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Pre-trigger buffer of one camera. The grabber callback copies every frame into the next slot of a ring that holds
+// the last preSeconds, overwriting the oldest; the ring is one arena mapped at init, on huge pages when the system has
+// them reserved (MAP_HUGETLB), else on transparent huge pages (MADV_HUGEPAGE), and touched once so the callback never
+// takes a page fault. A trigger dumps the ring and the next postSeconds: a thread hands the frames in order to a
+// myCode/recorder.h recorder, which writes a sequence like a V recording straight from the arena slots (borrowFrames,
+// slots padded to RECORDER_ALIGNMENT), and each frame's slot is free again once it is on disk. The dump is never
+// compressed and allocates nothing large, the arena is all the memory it uses, printed at init.
+#define PRETRIGGER_HUGE_PAGE (2u << 20)
+
+typedef struct pretrigger_config_t
+{
+    double preSeconds;          // kept before the trigger, at the camera's frame rate
+    double postSeconds;         // written after it; a trigger during a dump extends it
+    int spareFrames;            // slots past preSeconds, how far a dump may fall behind the camera before it drops;
+                                // the frames being written count, so more than recorder.slots
+    int hugePages;              // 0 maps the arena with normal pages
+    recorder_config_t recorder; // of the dump; slots bounds the frames being written, compression is ignored
+} pretrigger_config_t;
+
+typedef struct pretrigger_stats_t
+{
+    uint64_t dumps;   // completed
+    uint64_t frames;  // handed to the recorder
+    uint64_t dropped; // no free slot while dumping
+} pretrigger_stats_t;
+
+typedef struct pretrigger_t
+{
+    atomic_int accepting; // frames are taken
+    atomic_int pushing;   // callbacks inside pretrigger_push
+    pretrigger_config_t config;
+    sequence_header_t format;
+    uint8_t *arena;
+    size_t arenaSize;
+    int hugeTLB; // the arena is on reserved huge pages
+    size_t slotSize;
+    uint64_t slotCount, preFrames, postFrames;
+    frame_desc_t *frames; // of each slot, base pointing into the arena
+    // frame positions: copied by the callback, oldest not on disk yet (while dumping, the oldest slot in use), first
+    // one after the dump
+    _Alignas(64) atomic_uint_fast64_t head;
+    _Alignas(64) atomic_uint_fast64_t next;
+    atomic_uint_fast64_t end;
+    atomic_int dumping;
+    pthread_mutex_t lock; // trigger against the end of a dump, path
+    char path[256];       // of the dump being started
+    recorder_t recorder;
+    uint64_t handed; // next position to hand to the recorder, dump thread
+    pthread_t thread;
+    sem_t work; // one post per trigger, per frame while dumping and at destroy
+    atomic_int quit;
+    atomic_uint_fast64_t dumps, dumped, dropped;
+} pretrigger_t;
+
+// This function maps the arena for config->preSeconds of frames of format and starts the dump thread; nothing large
+// is allocated after it. Returns 0 on success, -1 on failure
+int pretrigger_init(
+    pretrigger_t *pt,
+    const pretrigger_config_t *config,
+    const sequence_header_t *format);
+
+// This function copies a frame into the ring. Grabber callback thread, never waits. Returns 1 if the frame was taken,
+// 0 if the buffer is not set up or a dump holds every slot
+int pretrigger_push(
+    pretrigger_t *pt,
+    const frame_desc_t *frame);
+
+// This function starts dumping the ring and the next postSeconds to path, or extends the running dump by postSeconds
+// from now. Returns at once, the file is written by the dump thread. Not from the callback thread. Returns 0 on
+// success, -1 if the buffer is not set up
+int pretrigger_trigger(
+    pretrigger_t *pt,
+    const char *path);
+
+// This function reads the counters, from any thread
+void pretrigger_get_stats(
+    pretrigger_t *pt,
+    pretrigger_stats_t *stats);
+
+// This function prints the counters and the memory used
+void pretrigger_print_stats(
+    pretrigger_t *pt);
+
+// This function stops taking frames, writes what a running dump has so far and unmaps the arena
+void pretrigger_destroy(
+    pretrigger_t *pt);
+
+#endif //  pretrigger_h
@@ -0,0 +1,85 @@
+#ifndef pyramid_gl_h
+#define pyramid_gl_h
+
+#include "myCode/opengl.h"
+#include "myCode/bayer.h"
+#include "myCode/downscale.h"
+
+// 1/2, 1/4 and 1/8 RGBA8 versions of a camera texture made by the compute shader shaders/downscale.comp, the GPU side
+// of myCode/downscale.h with the same integer arithmetic, so both give identical pixels. A raw Bayer texture is halved
+// by its 2x2 cells, an RGB one and every further level with the pyramid's filter. Levels are only computed down to the
+// deepest one somebody subscribed to. Subscribers that want pixels on the CPU get them through a ring of persistently
+// mapped pack buffers: the copy of frame N is fenced and read frames later, the render thread never waits for it.
+// Needs OpenGL 4.3
+#define PYRAMID_LEVELS 3
+#define PYRAMID_READBACK_SLOTS 3
+// texture unit the source is bound to while the levels are computed
+#define PYRAMID_GL_SOURCE_UNIT 4
+
+typedef struct pyramid_level_t
+{
+    GLuint texture; // 0 until the level is first computed
+    GLsizei width, height;
+    int subscribers; // users of the texture, including readers
+    int readers;     // users of the readback
+    GLuint pbo[PYRAMID_READBACK_SLOTS];
+    uint8_t *mapped[PYRAMID_READBACK_SLOTS];
+    GLsync fence[PYRAMID_READBACK_SLOTS];
+    uint64_t sequence[PYRAMID_READBACK_SLOTS]; // update the slot was copied at
+    int next;                                  // slot the next copy goes to
+    int newest;                                // newest slot whose copy has finished, -1 for none
+} pyramid_level_t;
+
+typedef struct pyramid_gl_t
+{
+    GLuint program;
+    downscale_filter_t filter;
+    GLsizei width, height; // of the source
+    uint64_t updates;
+    pyramid_level_t levels[PYRAMID_LEVELS];
+} pyramid_gl_t;
+
+// This function compiles shaderFile (shaders/downscale.comp) for a pyramid without subscribers.
+// Returns 0 on success, -1 if the shader does not build
+int pyramid_gl_create(
+    pyramid_gl_t *pyramid,
+    const char *shaderFile,
+    downscale_filter_t filter);
+
+// This function adds a user of level (0 is 1/2). readback asks for its pixels on the CPU as well
+void pyramid_gl_subscribe(
+    pyramid_gl_t *pyramid,
+    int level,
+    int readback);
+
+// This function removes a user added by pyramid_gl_subscribe with the same arguments
+void pyramid_gl_unsubscribe(
+    pyramid_gl_t *pyramid,
+    int level,
+    int readback);
+
+// This function computes the subscribed levels from source, a width x height texture holding raw Bayer in pattern
+// (quality other than DEMOSAIC_NONE, GL_R8) or RGB, and starts the readbacks. Levels are reallocated when the size
+// changes. Render thread, after the frame's upload
+void pyramid_gl_update(
+    pyramid_gl_t *pyramid,
+    GLuint source,
+    GLsizei width,
+    GLsizei height,
+    demosaic_quality_t quality,
+    bayer_pattern_t pattern);
+
+// This function points image at the newest finished readback of level, RGBA8 with rows packed, without waiting. The
+// pixels stay valid until the next pyramid_gl_update. sequence, if not NULL, gets the pyramid_gl_update count they are
+// from. Returns 0 on success, -1 if no readback has finished yet or nobody reads the level
+int pyramid_gl_read(
+    pyramid_gl_t *pyramid,
+    int level,
+    downscale_image_t *image,
+    uint64_t *sequence);
+
+// This function deletes the program, the level textures and the readback buffers
+void pyramid_gl_destroy(
+    pyramid_gl_t *pyramid);
+
+#endif //  pyramid_gl_h
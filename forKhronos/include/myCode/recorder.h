@@ -0,0 +1,135 @@
+#ifndef recorder_h
+#define recorder_h
+
+#include "myCode/frame_ring.h"
+#include "myCode/sequence.h"
+#include "myCode/tile_codec.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Raw frame recorder of one camera. The grabber callback copies every frame into the next free staging slot (page
+// aligned) and returns, a frame arriving while all slots wait for the disk is dropped and counted, so neither the
+// callback nor the render loop ever waits for storage. A writer thread writes the slots in order with O_DIRECT into a
+// file preallocated with fallocate: through io_uring when the kernel has it, otherwise with pwrite on a few threads.
+// The file is a myCode/sequence.h sequence: the header page is written at start and again with the index at stop.
+// With a compression level an encoder thread deflates the copied frames in order, the tiles of each frame in parallel
+// on its own worker pool (myCode/tile_codec.h), and the writers take the compressed payloads instead of the slots.
+#define RECORDER_ALIGNMENT SEQUENCE_FRAME_ALIGNMENT
+#define RECORDER_MAX_SLOTS 64
+#define RECORDER_MAX_WRITERS 8
+
+typedef enum recorder_backend_t
+{
+    RECORDER_AUTO,     // io_uring, pwrite threads if it cannot be set up
+    RECORDER_IO_URING,
+    RECORDER_THREADS
+} recorder_backend_t;
+
+typedef struct recorder_config_t
+{
+    int slots;                 // staging buffers, how many frames the disk may fall behind
+    int writers;               // threads of the pwrite backend
+    double preallocateSeconds; // file space reserved at a time, at the camera's frame rate
+    int direct;                // O_DIRECT, bypasses the page cache; 0 for file systems without it
+    recorder_backend_t backend;
+    int compressionLevel;    // 0 writes the frames as they are, 1 (Z_BEST_SPEED) to 9 deflates them
+    int compressionStrategy; // deflateInit2 strategy of the tiles
+    int compressionThreads;  // encoder worker pool, the encoder thread included; 0 for every CPU
+    int tileRows;            // rows per independently decodable tile
+    // 1 writes each frame from frame->base instead of copying it into a slot: base must be RECORDER_ALIGNMENT aligned,
+    // readable up to the frame size rounded up to it, and unchanged until the backlog no longer counts the frame
+    int borrowFrames;
+} recorder_config_t;
+
+typedef struct recorder_stats_t
+{
+    uint64_t frames;      // written
+    uint64_t dropped;     // no free slot when the frame arrived
+    uint64_t bytes;       // written, padding included
+    uint64_t payloadBytes; // frames as stored, compressed or not, without padding
+    uint64_t writeErrors; // failed or short writes, the frame's slot in the file is left as it was
+    uint32_t backlog;     // frames copied and not yet on disk
+    uint32_t maxBacklog;
+    double seconds;       // from recorder_start to now or to recorder_stop
+} recorder_stats_t;
+
+struct recorder_uring_t;
+
+typedef struct recorder_t
+{
+    atomic_int accepting; // frames are taken
+    atomic_int pushing;   // callbacks inside recorder_push
+    int running;          // between recorder_start and recorder_stop, render thread
+    int fd;
+    recorder_backend_t backend;
+    size_t frameSize, slotSize;
+    int slotCount;
+    int borrowing; // slots point at the pushed frames, see borrowFrames
+    uint8_t *slots[RECORDER_MAX_SLOTS];
+    frame_desc_t slotFrames[RECORDER_MAX_SLOTS]; // timestamp and buffer of the frame in each slot
+    // frame positions: copied by the callback, compressed (see encoded), claimed by a writer, on disk in order
+    _Alignas(64) atomic_uint_fast64_t head;
+    _Alignas(64) atomic_uint_fast64_t claimed;
+    _Alignas(64) atomic_uint_fast64_t retired;
+    uint8_t done[RECORDER_MAX_SLOTS]; // slot written, waiting for the ones before it
+    uint64_t allocatedFrames;         // index entries reserved
+    uint64_t allocatedBytes;          // file space reserved
+    uint64_t preallocateFrames;
+    sequence_header_t header;
+    sequence_entry_t *index; // filled by the writers, written after the last frame at stop
+    pthread_mutex_t lock; // done, retired, allocation and index of the pwrite writers
+    // compression, frames up to encoded are ready for the writers
+    int compressing;
+    tile_codec_t codec;
+    worker_pool_t pool;
+    pthread_t encoder;
+    sem_t encode; // one post per frame, one at stop
+    atomic_int encoderQuit;
+    _Alignas(64) atomic_uint_fast64_t encoded;
+    uint8_t *packed[RECORDER_MAX_SLOTS];        // payload of each slot, padded to RECORDER_ALIGNMENT
+    uint64_t packedOffset[RECORDER_MAX_SLOTS]; // in the file
+    uint64_t packedSize[RECORDER_MAX_SLOTS];   // 0 if the frame could not be compressed
+    uint64_t nextOffset;                       // of the next payload, encoder thread
+    struct recorder_uring_t *uring; // io_uring backend, NULL for the pwrite one
+    // pwrite threads, one semaphore post per frame; the io_uring backend has one thread
+    sem_t work;
+    pthread_t threads[RECORDER_MAX_WRITERS];
+    int threadCount;
+    atomic_int quit;
+    atomic_uint_fast64_t dropped, bytes, payloadBytes, writeErrors;
+    atomic_uint maxBacklog;
+    uint64_t startNs, stopNs;
+} recorder_t;
+
+// This function creates path, writes the header of a sequence of format (see sequence_header_init), preallocates the
+// file for format->fps and starts the writers. Returns 0 on success, -1 on failure
+int recorder_start(
+    recorder_t *rec,
+    const recorder_config_t *config,
+    const char *path,
+    const sequence_header_t *format);
+
+// This function copies a frame for writing, or only takes its address when the recorder borrows frames. Grabber
+// callback thread, never waits. Returns 1 if the frame was taken, 0 if the recorder is stopped or has no free slot
+int recorder_push(
+    recorder_t *rec,
+    const frame_desc_t *frame);
+
+// This function stops taking frames, waits until every taken frame is on disk, writes the index, completes the header,
+// trims the preallocation and closes the file
+void recorder_stop(
+    recorder_t *rec);
+
+// This function reads the counters, from any thread
+void recorder_get_stats(
+    recorder_t *rec,
+    recorder_stats_t *stats);
+
+// This function prints the counters and the write throughput
+void recorder_print_stats(
+    recorder_t *rec);
+
+#endif //  recorder_h
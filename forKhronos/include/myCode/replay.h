@@ -0,0 +1,84 @@
+#ifndef replay_h
+#define replay_h
+
+#include "myCode/frame_ring.h"
+#include "myCode/sequence.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+// Playback of a recorded sequence as if it came from a camera. A thread hands every frame to the same delivery
+// function the grabber callback feeds, with base pointing into the read only mapping of the file, so the frames are
+// never copied and never handed back. The next frames are prefetched with madvise(MADV_WILLNEED) ahead of the pacing,
+// the kernel's readahead is doubled with posix_fadvise(POSIX_FADV_SEQUENTIAL). Frames of a compressed sequence are
+// inflated, the tiles in parallel, into REPLAY_DECODED_FRAMES buffers handed out like the zero-copy mode's PBOs: a
+// buffer is decoded into again only once replay_release has given it back, so a full frame ring, the frame the
+// consumer holds and the one being inflated never share one. The replay thread waits while every buffer is held.
+#define REPLAY_DECODED_FRAMES (FRAME_RING_SIZE + 2)
+
+// called once per frame from the replay thread, like the grabber callback
+typedef void (*replay_deliver_fn)(const frame_desc_t *frame, void *context);
+
+typedef struct replay_config_t
+{
+    double speed;        // 1 plays at the recorded timestamps, 2 twice as fast; 0 as fast as the frames are taken
+    int loop;            // start over after the last frame, timestamps keep increasing
+    int readaheadFrames; // frames prefetched ahead of the one delivered
+    int decodeThreads;   // worker pool inflating a compressed sequence, the replay thread included; 0 for every CPU
+} replay_config_t;
+
+typedef struct replay_t
+{
+    sequence_t seq;
+    replay_config_t config;
+    replay_deliver_fn deliver;
+    void *context;
+    pthread_t thread;
+    int running;
+    atomic_int quit;
+    atomic_uint_fast64_t delivered;
+    atomic_uint_fast64_t loops;
+    atomic_uint_fast64_t decodeErrors; // damaged payloads, skipped
+    atomic_uint_fast64_t unwritten;    // entries flagged SEQUENCE_FRAME_WRITE_ERROR, skipped
+    // compressed sequences only
+    int decoding;
+    worker_pool_t pool;
+    uint8_t *decoded[REPLAY_DECODED_FRAMES];
+    atomic_int held[REPLAY_DECODED_FRAMES]; // delivered and not released yet
+    atomic_uint_fast64_t decodeWaits;       // frames that waited for a buffer to be released
+    uint64_t periodNs;   // between frames without timestamps, from the header's frame rate
+    uint64_t durationNs; // first to last timestamp plus one period, added to the timestamps of every loop
+} replay_t;
+
+// This function maps a recorded sequence for playback. Returns 0 on success, -1 on failure
+int replay_open(
+    replay_t *replay,
+    const char *path);
+
+// This function starts delivering frames from the first one. Returns 0 on success, -1 on failure
+int replay_start(
+    replay_t *replay,
+    const replay_config_t *config,
+    replay_deliver_fn deliver,
+    void *context);
+
+// frame_release_fn for the frame ring, and for the consumer once it is done with a frame: the decoded buffer of a
+// compressed sequence may be reused. Frames of the file mapping need nothing, bufferHandle is 0 for them
+void replay_release(
+    const frame_desc_t *frame,
+    void *context);
+
+// This function stops the thread; deliver is not called any more once it returns
+void replay_stop(
+    replay_t *replay);
+
+// This function prints the frames delivered, the loops played, the frames skipped as damaged or never written and
+// how often the decoder waited for a buffer
+void replay_print_stats(
+    replay_t *replay);
+
+// This function unmaps the sequence, the frames delivered from it must not be used any more
+void replay_close(
+    replay_t *replay);
+
+#endif //  replay_h
@@ -0,0 +1,109 @@
+#ifndef sequence_h
+#define sequence_h
+
+#include "myCode/color.h"
+#include "myCode/tile_codec.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Recorded sequence of one camera, written by myCode/recorder.h:
+//   header      one SEQUENCE_HEADER_SIZE page, sequence_header_t at its start
+//   payloads    frame n at header.headerSize + n * header.frameStride, every payload page aligned
+//   index       header.frameCount sequence_entry_t at header.indexOffset, after the last payload
+// Little endian, the host's layout of the structs below. Readers map the whole file and get frame pointers straight
+// into the mapping; frame n is one index lookup away, the payloads are never parsed. A recording that was not stopped
+// has frameCount and indexOffset 0: its frames are found from the file size, without timestamps, and the space
+// preallocated past the last written frame reads as black frames.
+// A compressed sequence (header.compression) stores every frame as a myCode/tile_codec.h payload of its own size,
+// packed back to back on page boundaries: only the index finds them, and sequence_decode restores the frame.
+#define SEQUENCE_MAGIC "FKRAWSEQ"
+#define SEQUENCE_VERSION 1
+#define SEQUENCE_HEADER_SIZE 4096
+#define SEQUENCE_FRAME_ALIGNMENT 4096
+
+// sequence_entry_t.flags
+#define SEQUENCE_FRAME_WRITE_ERROR 1u // the payload never reached the disk, its bytes are undefined
+
+// sequence_header_t.compression
+#define SEQUENCE_COMPRESSION_NONE 0       // payloads are the frames
+#define SEQUENCE_COMPRESSION_TILED_ZLIB 1 // payloads are tile_codec payloads of header.tileRows rows per tile
+
+typedef struct sequence_header_t
+{
+    char magic[8];        // SEQUENCE_MAGIC, not terminated
+    uint32_t version;
+    uint32_t headerSize;  // offset of the first payload
+    char pixelFormat[32]; // GenICam name, "BayerRG8" or "RGB8"
+    uint32_t width, height;
+    uint64_t frameSize;   // bytes of a frame, before compression
+    uint64_t frameStride; // frame plus padding to SEQUENCE_FRAME_ALIGNMENT, the place of uncompressed payloads
+    uint64_t frameCount;
+    uint64_t indexOffset;
+    double fps;           // the camera's setting, the timestamps have the real spacing
+    // colour correction the viewer displayed the frames with, see myCode/color.h
+    float ccm[3][4];
+    float gains[3];
+    float blackLevel;
+    float gamma;
+    uint32_t compression; // SEQUENCE_COMPRESSION_*, 0 in files from before it existed
+    uint32_t tileRows;
+} sequence_header_t;
+
+typedef struct sequence_entry_t
+{
+    uint64_t offset;     // of the payload, from the start of the file
+    uint64_t size;       // payload bytes
+    uint64_t timestamp;  // KY_STREAM_BUFFER_INFO_TIMESTAMP, ns
+    uint64_t receivedNs; // frame_clock_ns() in the grabber callback
+    uint32_t bufferID;   // the grabber's buffer, gaps in the timestamps tell dropped frames
+    uint32_t flags;
+} sequence_entry_t;
+
+typedef struct sequence_t
+{
+    int fd;
+    const uint8_t *map;
+    size_t mapSize;
+    const sequence_header_t *header;
+    const sequence_entry_t *index;
+    uint64_t frameCount;
+    sequence_entry_t *rebuilt; // index made up from the file size when the recording was not stopped
+    tile_codec_t codec;        // decoder of a compressed sequence
+} sequence_t;
+
+// This function fills the description of a sequence; the layout fields are set by the writer
+void sequence_header_init(
+    sequence_header_t *header,
+    const char *pixelFormat,
+    uint32_t width,
+    uint32_t height,
+    uint64_t frameSize,
+    double fps,
+    const color_params_t *color);
+
+// This function maps a sequence read only and checks its header and index. Returns 0 on success, -1 on failure
+int sequence_open(
+    sequence_t *seq,
+    const char *path);
+
+// This function returns the payload of frame n inside the mapping, NULL past the end; entry, if not NULL, receives its
+// index entry
+const uint8_t *sequence_frame(
+    const sequence_t *seq,
+    uint64_t n,
+    const sequence_entry_t **entry);
+
+// This function writes frame n, header.frameSize bytes, to frame: copied from the mapping, or inflated with the tiles
+// spread over pool (NULL decodes on the calling thread). Several threads may decode at once. Returns 0 on success,
+// -1 past the end or for a damaged payload
+int sequence_decode(
+    const sequence_t *seq,
+    uint64_t n,
+    worker_pool_t *pool,
+    uint8_t *frame);
+
+// This function unmaps the sequence
+void sequence_close(
+    sequence_t *seq);
+
+#endif //  sequence_h
@@ -0,0 +1,92 @@
+#ifndef telemetry_h
+#define telemetry_h
+
+#include "myCode/frame_ring.h"
+#include <stdatomic.h>
+#include <stdint.h>
+
+// points in a frame's life, in pipeline order
+typedef enum telemetry_stamp_t
+{
+    STAMP_ACQUIRED,  // KY_STREAM_BUFFER_INFO_TIMESTAMP
+    STAMP_CALLBACK,  // Stream_callback_func saw the frame
+    STAMP_COPIED,    // pixels are in GL visible memory
+    STAMP_UPLOADED,  // texture upload issued
+    STAMP_DRAWN,     // draw call issued
+    STAMP_SWAPPED,   // swap_buffers returned
+    TELEMETRY_STAMPS
+} telemetry_stamp_t;
+
+// one histogram per interval between consecutive stamps, acquisition -> swap and the upload ring stall
+#define TELEMETRY_TOTAL (TELEMETRY_STAMPS - 1)
+#define TELEMETRY_UPLOAD_STALL TELEMETRY_STAMPS
+#define TELEMETRY_HISTOGRAMS (TELEMETRY_STAMPS + 1)
+
+// log-linear buckets: 8 sub-buckets per power of two of nanoseconds, about 12% resolution up to ~2 hours
+#define TELEMETRY_SUB_BUCKET_BITS 3
+#define TELEMETRY_BUCKETS (41 << TELEMETRY_SUB_BUCKET_BITS)
+
+typedef struct telemetry_histogram_t
+{
+    atomic_uint_fast64_t buckets[TELEMETRY_BUCKETS];
+    atomic_uint_fast64_t count;
+    atomic_uint_fast64_t max;
+} telemetry_histogram_t;
+
+typedef struct telemetry_t
+{
+    telemetry_histogram_t histograms[TELEMETRY_HISTOGRAMS];
+    // grabber timestamps come from the grabber clock; when it is not the host clock the acquisition stage is
+    // measured against the fastest transfer seen so far
+    int64_t clockOffsetNs;
+    int clockOffsetValid;
+    // periodic dump, owned by the thread calling telemetry_dump_periodic
+    uint64_t dumpIntervalNs;
+    uint64_t lastDumpNs;
+    uint64_t previous[TELEMETRY_HISTOGRAMS][TELEMETRY_BUCKETS];
+    uint64_t previousCount[TELEMETRY_HISTOGRAMS];
+} telemetry_t;
+
+// per frame stamps, filled in by the render loop
+typedef struct telemetry_frame_t
+{
+    uint64_t stamps[TELEMETRY_STAMPS];
+    uint64_t uploadStallNs; // time spent waiting for a free PBO, only for frames copied through an upload ring
+    int hasUploadStall;
+} telemetry_frame_t;
+
+// This function clears all histograms. dumpIntervalSeconds of 0 disables periodic dumps
+void telemetry_init(
+    telemetry_t *telemetry,
+    double dumpIntervalSeconds);
+
+// This function starts stamps for a frame taken from the frame ring (acquisition and callback stamps)
+void telemetry_frame_begin(
+    telemetry_frame_t *frame,
+    const frame_desc_t *desc);
+
+// This function stamps a stage of the frame with the current host time
+void telemetry_stamp(
+    telemetry_frame_t *frame,
+    telemetry_stamp_t stamp);
+
+// This function records how long the frame waited for a free upload PBO (0 when it did not wait)
+void telemetry_upload_stall(
+    telemetry_frame_t *frame,
+    uint64_t stallNs);
+
+// This function records all intervals of a completed frame. Called from one thread (the render loop);
+// histograms are atomic so dumps may run concurrently from another thread
+void telemetry_record(
+    telemetry_t *telemetry,
+    const telemetry_frame_t *frame);
+
+// This function prints p50/p99/max of the frames recorded since the last periodic dump once the interval has passed
+void telemetry_dump_periodic(
+    telemetry_t *telemetry);
+
+// This function prints p50/p99/max of every frame recorded so far
+void telemetry_dump(
+    telemetry_t *telemetry);
+
+#endif //  telemetry_h
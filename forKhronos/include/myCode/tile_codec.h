@@ -0,0 +1,72 @@
+#ifndef tile_codec_h
+#define tile_codec_h
+
+#include "myCode/worker_pool.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <zlib.h>
+
+// Lossless frame compression of recordings. The frame is cut into tiles of tileRows whole rows, each tile is filtered
+// and deflated on its own, one tile per worker_pool task, so a reader can inflate the tiles of one frame in parallel
+// or only the ones it needs. The filter replaces every byte with its difference from the same colour one step to the
+// left (two pixels in a Bayer row, one pixel in RGB8), which turns the smooth parts of an image into runs of small
+// values that deflate well. On noisy sensor data the filtered bytes hardly repeat: Z_RLE or Z_HUFFMAN_ONLY compress
+// them as well as the default strategy in a fraction of the time. Payload of one frame:
+//   uint32_t sizes[tileCount]   compressed bytes of each tile, host byte order
+//   zlib streams                back to back, tile 0 first
+#define TILE_CODEC_MAX_TILES 512
+
+typedef struct tile_codec_t
+{
+    uint32_t width, height;
+    uint32_t bytesPerPixel; // 1 for Bayer, 3 for RGB8
+    uint32_t tileRows, tileCount;
+    size_t rowSize;
+    int level; // deflate level, 0 for a decoder
+    int strategy;
+    // encoder: one deflate stream, one filtered row and one output area per tile, kept from frame to frame
+    z_stream *streams;
+    uint8_t *rows;
+    uint8_t *tiles;
+    size_t tileBound;
+    uint32_t sizes[TILE_CODEC_MAX_TILES];
+} tile_codec_t;
+
+// This function sets up a codec for frames of width x height pixels. level 0 makes a decoder only, 1 (Z_BEST_SPEED) to
+// 9 an encoder too, with a deflateInit2 strategy. tileRows is rounded up to even, so every tile starts on the same
+// Bayer phase. Returns 0 on success, -1 on failure
+int tile_codec_init(
+    tile_codec_t *codec,
+    uint32_t width,
+    uint32_t height,
+    uint32_t bytesPerPixel,
+    uint32_t tileRows,
+    int level,
+    int strategy);
+
+// This function returns the largest payload tile_codec_encode can produce
+size_t tile_codec_bound(
+    const tile_codec_t *codec);
+
+// This function compresses a frame of height rows of width * bytesPerPixel bytes into payload, which holds
+// tile_codec_bound bytes. Returns the payload size, 0 on failure
+size_t tile_codec_encode(
+    tile_codec_t *codec,
+    worker_pool_t *pool,
+    const uint8_t *frame,
+    uint8_t *payload);
+
+// This function restores a frame from payload, size bytes. Any codec of the same width, height, bytesPerPixel and
+// tileRows decodes, from several threads at once. Returns 0 on success, -1 if the payload is damaged
+int tile_codec_decode(
+    const tile_codec_t *codec,
+    worker_pool_t *pool,
+    const uint8_t *payload,
+    size_t size,
+    uint8_t *frame);
+
+// This function frees the encoder state
+void tile_codec_destroy(
+    tile_codec_t *codec);
+
+#endif //  tile_codec_h
@@ -0,0 +1,59 @@
+#ifndef upload_ring_h
+#define upload_ring_h
+
+#include "myCode/opengl.h"
+#include <stdint.h>
+
+typedef struct upload_ring_slot_t
+{
+    GLuint pbo;
+    GLvoid *mapped;
+    GLsync fence; // texture upload still reading this PBO, NULL once it may be written again
+} upload_ring_slot_t;
+
+// N persistently mapped pixel unpack buffers used round robin. The CPU writes frame N+1 into the next PBO while
+// the upload of frame N is still in flight; a slot is only written again after the fence of its last upload
+// has signaled, and the time spent waiting for it is the stall of that frame.
+typedef struct upload_ring_t
+{
+    upload_ring_slot_t *slots;
+    GLuint count;
+    GLuint next;
+    GLsizeiptr size;
+    uint64_t lastStallNs; // wait of the most recent upload_ring_begin
+    uint64_t stallMaxNs;
+    uint64_t stallTotalNs;
+    uint64_t stalledFrames;
+    uint64_t frames;
+} upload_ring_t;
+
+// This function creates count PBOs of size bytes, mapped for writing. Needs a current GL 4.4+ context.
+// Returns 0 on success, -1 on failure
+int upload_ring_create(
+    upload_ring_t *ring,
+    GLuint count,
+    GLsizeiptr size);
+
+// This function returns the mapped memory of the next PBO once its previous upload has completed.
+// The time spent waiting is stored in lastStallNs. Returns NULL if the fence never signaled
+GLvoid *upload_ring_begin(
+    upload_ring_t *ring);
+
+// This function uploads the PBO returned by upload_ring_begin into the currently bound texture, fences the
+// upload and moves on to the next PBO
+void upload_ring_upload(
+    upload_ring_t *ring,
+    GLsizei width,
+    GLsizei height,
+    GLenum format,
+    GLenum type);
+
+// This function prints how often and how long the CPU waited for a free PBO
+void upload_ring_print_stats(
+    upload_ring_t *ring);
+
+// This function deletes the PBOs and their fences
+void upload_ring_destroy(
+    upload_ring_t *ring);
+
+#endif //  upload_ring_h
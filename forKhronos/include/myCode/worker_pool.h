@@ -0,0 +1,57 @@
+#ifndef worker_pool_h
+#define worker_pool_h
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define WORKER_POOL_MAX_THREADS 16
+
+// Runs the tasks of one job on a fixed set of pinned threads. The caller works on the job too, so a pool of
+// one thread has no workers and runs everything inline.
+typedef void (*worker_pool_fn)(void *context, int task);
+
+struct worker_pool_t;
+
+typedef struct worker_pool_worker_t
+{
+    struct worker_pool_t *pool;
+    pthread_t thread;
+} worker_pool_worker_t;
+
+typedef struct worker_pool_t
+{
+    int threads; // the caller included
+    worker_pool_worker_t workers[WORKER_POOL_MAX_THREADS - 1];
+    int workerCount;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    uint64_t generation; // bumped for every job
+    int busy;            // workers still inside the current job
+    int quit;
+    worker_pool_fn fn;
+    void *context;
+    int tasks;
+    atomic_int nextTask;
+} worker_pool_t;
+
+// This function starts threads - 1 workers, pinned to CPUs firstCpu + 1 ... (firstCpu < 0 leaves them unpinned).
+// threads of 0 uses every online CPU. Returns 0 on success, -1 if some workers could not be started
+int worker_pool_init(
+    worker_pool_t *pool,
+    int threads,
+    int firstCpu);
+
+// This function calls fn(context, task) for task 0 .. tasks - 1 spread over the pool and returns when all are done
+void worker_pool_run(
+    worker_pool_t *pool,
+    worker_pool_fn fn,
+    void *context,
+    int tasks);
+
+// This function stops and joins the workers
+void worker_pool_destroy(
+    worker_pool_t *pool);
+
+#endif //  worker_pool_h
@@ -0,0 +1,56 @@
+#ifndef zero_copy_h
+#define zero_copy_h
+
+#include "KAYA/KYFGLib.h"
+#include "myCode/opengl.h"
+#include "myCode/frame_ring.h"
+
+typedef struct zero_copy_buffer_t
+{
+    GLuint pbo;
+    GLvoid *mapped;
+    STREAM_BUFFER_HANDLE bufferHandle;
+    GLsync fence; // pending texture upload sourced from this buffer, NULL while the grabber owns it
+} zero_copy_buffer_t;
+
+typedef struct zero_copy_t
+{
+    STREAM_HANDLE streamHandle;
+    zero_copy_buffer_t *buffers;
+    GLuint count;
+    GLsizeiptr size;
+} zero_copy_t;
+
+// This function creates a stream on an open camera whose frame buffers are persistently mapped pixel unpack buffers.
+// The buffers are announced to the grabber and queued for acquisition. Needs a current GL 4.4+ context.
+// Returns 0 on success, -1 on failure
+int zero_copy_create(
+    zero_copy_t *zc,
+    CAMHANDLE camHandle,
+    GLuint count);
+
+// This function uploads a frame into the currently bound texture straight from the PBO the grabber wrote it to
+// and fences the upload. The buffer goes back to the grabber from zero_copy_recycle once the fence signals.
+// Returns 0 on success, -1 if the frame does not belong to this stream
+int zero_copy_upload(
+    zero_copy_t *zc,
+    const frame_desc_t *frame,
+    GLsizei width,
+    GLsizei height,
+    GLenum format,
+    GLenum type);
+
+// This function requeues every buffer whose upload has completed. Call once per rendered frame
+void zero_copy_recycle(
+    zero_copy_t *zc);
+
+// frame_release_fn for the frame ring: frames that are never uploaded go straight back to the grabber
+void zero_copy_release(
+    const frame_desc_t *frame,
+    void *context);
+
+// This function deletes the stream and its buffers. Camera must be stopped
+void zero_copy_destroy(
+    zero_copy_t *zc);
+
+#endif //  zero_copy_h
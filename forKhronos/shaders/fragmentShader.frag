@@ -1,12 +1,133 @@
 #version 330 core
 in vec2 TexCoord;
 out vec4 FragColor;
-uniform sampler2D texture;
+uniform sampler2D cameraTexture;
+
+// 0 - texture is RGB already (grabber debayer), 1 - bilinear, 2 - Malvar-He-Cutler
+uniform int demosaicMode;
+// column and row of the red pixel in each 2x2 cell: RG (0,0), GR (1,0), GB (0,1), BG (1,1)
+uniform ivec2 bayerRed;
+
+// colour correction, see myCode/color.h; updated per frame from a uniform buffer. Fused with the demosaic, so
+// every raw texel is fetched once for all of the colour operations
+layout(std140) uniform ColorCorrection
+{
+   vec4 ccm[3];   // rows R, G, B: matrix with gains and black level rescale in xyz, offset in w
+   vec4 tone;     // x black level, y and z scale and offset of the tone curve coordinate
+};
+uniform sampler1D toneCurve;
+
+// flat field, see myCode/flat_field.h: dark level (8 fraction bits) and gain (12 fraction bits) maps of the raw
+// frame, shifted when the frame is a region of the calibrated one. Gain 0 marks a defective pixel
+uniform bool flatField;
+uniform usampler2D flatFieldDark;
+uniform usampler2D flatFieldGain;
+uniform ivec2 flatFieldShift;
+
+float calibrated(ivec2 p, out bool defect)
+{
+   ivec2 m = p + flatFieldShift;
+   uint gain = texelFetch(flatFieldGain, m, 0).r;
+   float dark = float(texelFetch(flatFieldDark, m, 0).r) / (256.0 * 255.0);
+   defect = gain == 0u;
+   return min(max(texelFetch(cameraTexture, p, 0).r - dark, 0.0) * float(gain) / 4096.0, 1.0);
+}
+
+// raw sample with mirrored borders, mirroring keeps the colour of the mirrored pixel
+float raw(ivec2 p)
+{
+   ivec2 size = textureSize(cameraTexture, 0);
+   p = abs(p);
+   p = min(p, 2 * (size - 1) - p);
+   if (!flatField)
+      return texelFetch(cameraTexture, p, 0).r;
+
+   bool defect;
+   float v = calibrated(p, defect);
+   if (defect)
+   {
+      // mean of the usable same colour neighbours
+      const ivec2 neighbours[4] = ivec2[4](ivec2(-2, 0), ivec2(2, 0), ivec2(0, -2), ivec2(0, 2));
+      float sum = 0.0;
+      int count = 0;
+      for (int i = 0; i < 4; i++)
+      {
+         ivec2 q = p + neighbours[i];
+         bool bad;
+         if (any(lessThan(q, ivec2(0))) || any(greaterThanEqual(q, size)))
+            continue;
+         float c = calibrated(q, bad);
+         if (!bad)
+         {
+            sum += c;
+            count++;
+         }
+      }
+      v = count > 0 ? sum / float(count) : texelFetch(cameraTexture, p, 0).r;
+   }
+   return v;
+}
+
+vec3 bilinear(ivec2 p, ivec2 phase)
+{
+   float c = raw(p);
+   float cross = (raw(p + ivec2(-1, 0)) + raw(p + ivec2(1, 0)) + raw(p + ivec2(0, -1)) + raw(p + ivec2(0, 1))) * 0.25;
+   float diagonal = (raw(p + ivec2(-1, -1)) + raw(p + ivec2(1, -1)) + raw(p + ivec2(-1, 1)) + raw(p + ivec2(1, 1))) * 0.25;
+   float horizontal = (raw(p + ivec2(-1, 0)) + raw(p + ivec2(1, 0))) * 0.5;
+   float vertical = (raw(p + ivec2(0, -1)) + raw(p + ivec2(0, 1))) * 0.5;
+
+   if (phase == ivec2(0, 0))
+      return vec3(c, cross, diagonal);
+   if (phase == ivec2(1, 1))
+      return vec3(diagonal, cross, c);
+   if (phase == ivec2(1, 0)) // green on a red row
+      return vec3(horizontal, c, vertical);
+   return vec3(vertical, c, horizontal); // green on a blue row
+}
+
+// Malvar, He, Cutler: "High-quality linear interpolation for demosaicing of Bayer-patterned color images", 2004
+vec3 malvar(ivec2 p, ivec2 phase)
+{
+   float c = raw(p);
+   float n1 = raw(p + ivec2(-1, 0)) + raw(p + ivec2(1, 0));   // horizontal neighbours
+   float m1 = raw(p + ivec2(0, -1)) + raw(p + ivec2(0, 1));   // vertical neighbours
+   float n2 = raw(p + ivec2(-2, 0)) + raw(p + ivec2(2, 0));   // two to the left and right
+   float m2 = raw(p + ivec2(0, -2)) + raw(p + ivec2(0, 2));   // two up and down
+   float d1 = raw(p + ivec2(-1, -1)) + raw(p + ivec2(1, -1)) + raw(p + ivec2(-1, 1)) + raw(p + ivec2(1, 1));
+
+   // green at red or blue
+   float g = (4.0 * c + 2.0 * (n1 + m1) - (n2 + m2)) / 8.0;
+   // the other of red/blue at blue/red
+   float rb = (6.0 * c + 2.0 * d1 - 1.5 * (n2 + m2)) / 8.0;
+   // red/blue at green, from the horizontal or vertical neighbours
+   float h = (5.0 * c + 4.0 * n1 - d1 - n2 + 0.5 * m2) / 8.0;
+   float v = (5.0 * c + 4.0 * m1 - d1 - m2 + 0.5 * n2) / 8.0;
+
+   if (phase == ivec2(0, 0))
+      return vec3(c, g, rb);
+   if (phase == ivec2(1, 1))
+      return vec3(rb, g, c);
+   if (phase == ivec2(1, 0)) // green on a red row
+      return vec3(h, c, v);
+   return vec3(v, c, h); // green on a blue row
+}
+
+vec3 correct(vec3 rgb)
+{
+   vec4 c = vec4(max(rgb - tone.x, 0.0), 1.0);
+   rgb = clamp(vec3(dot(ccm[0], c), dot(ccm[1], c), dot(ccm[2], c)), 0.0, 1.0) * tone.y + tone.z;
+   return vec3(texture(toneCurve, rgb.r).r, texture(toneCurve, rgb.g).r, texture(toneCurve, rgb.b).r);
+}
 
 void main(){
-   float R = texture2D(texture, TexCoord).r;
-   float G = texture2D(texture, TexCoord).g; 
-   float B = texture2D(texture, TexCoord).b;
-   float A = texture2D(texture, TexCoord).a;
-   FragColor = vec4(R, G, B, A);
-}; 
\ No newline at end of file
+   vec3 rgb;
+   if (demosaicMode == 0)
+      rgb = texture(cameraTexture, TexCoord).rgb;
+   else
+   {
+      ivec2 p = ivec2(TexCoord * vec2(textureSize(cameraTexture, 0)));
+      ivec2 phase = (p + bayerRed) & 1;
+      rgb = demosaicMode == 2 ? malvar(p, phase) : bilinear(p, phase);
+   }
+   FragColor = vec4(correct(clamp(rgb, 0.0, 1.0)), 1.0);
+}
@@ -0,0 +1,974 @@
+// Simulated KYFGLib.
+// Builds into bin/sim/libKYFGLib.so and stands in for the KAYA library so the acquisition and upload path
+// can be run and profiled on machines without a grabber. Only the subset of KYFGLib.h used by this project is implemented.
+//
+// Environment:
+//   KYSIM_GRABBERS  number of simulated grabbers (default 1)
+//   KYSIM_CAMERAS   number of cameras per grabber (default 1)
+//   KYSIM_WIDTH     default camera width (default 2048)
+//   KYSIM_HEIGHT    default camera height (default 1536)
+//   KYSIM_FPS       default AcquisitionFrameRate (default 60)
+//
+// Frames are RGB8 when the grabber "PixelFormat" is set to "RGB8" (grabber side debayer), otherwise raw Bayer
+// in the phase selected by the camera "PixelFormat" (BayerRG8 by default).
+
+#include "KAYA/KYFGLib.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#define SIM_MAX_GRABBERS 4
+#define SIM_MAX_PARAMS 64
+#define SIM_MAX_STREAMS (SIM_MAX_GRABBERS * KY_MAX_CAMERAS)
+#define SIM_MAX_BUFFERS 256
+#define SIM_FGHANDLE_BASE 0x100
+#define SIM_CAMHANDLE_BASE 0x1000
+#define SIM_BAR_WIDTH 32
+
+typedef struct sim_param_t
+{
+    char name[64];
+    int64_t intValue;
+    double floatValue;
+    char enumName[32];
+} sim_param_t;
+
+typedef struct sim_node_t
+{
+    pthread_mutex_t lock;
+    sim_param_t params[SIM_MAX_PARAMS];
+    int count;
+} sim_node_t;
+
+typedef struct sim_stream_t sim_stream_t;
+
+typedef struct sim_camera_t
+{
+    int grabber;
+    int opened;
+    sim_node_t node;
+    sim_stream_t *stream;
+    pthread_t thread;
+    atomic_int running;
+    atomic_uint_fast64_t frameCounter;
+} sim_camera_t;
+
+typedef struct sim_grabber_t
+{
+    int opened;
+    sim_node_t node;
+    sim_camera_t cameras[KY_MAX_CAMERAS];
+} sim_grabber_t;
+
+struct sim_stream_t
+{
+    int used;
+    int queued; // created with KYFG_StreamCreate, buffers are announced and queued by the user
+    sim_camera_t *camera;
+    size_t frameSize;
+    uint32_t bufferCount;
+    uint8_t *buffers[SIM_MAX_BUFFERS];
+    void *privates[SIM_MAX_BUFFERS];
+    int owned[SIM_MAX_BUFFERS]; // allocated by the library and freed with the stream
+    KY_ACQ_QUEUE_TYPE queue[SIM_MAX_BUFFERS];
+    uint32_t input[SIM_MAX_BUFFERS]; // FIFO of buffers waiting to be filled
+    uint32_t inputHead, inputCount;
+    pthread_mutex_t queueLock;
+    uint64_t timestamps[SIM_MAX_BUFFERS];
+    double instantFps[SIM_MAX_BUFFERS];
+    uint8_t *pattern;
+    int64_t width, height, bytesPerPixel;
+    int64_t lastFrameIndex;
+    StreamBufferCallback callback;
+    void *userContext;
+};
+
+static sim_grabber_t grabbers[SIM_MAX_GRABBERS];
+static sim_stream_t streams[SIM_MAX_STREAMS];
+static int grabberCount = -1;
+static int camerasPerGrabber = 1;
+static pthread_mutex_t simLock = PTHREAD_MUTEX_INITIALIZER;
+
+static int env_int(const char *name, int fallback)
+{
+    const char *value = getenv(name);
+    return value ? atoi(value) : fallback;
+}
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static sim_param_t *node_find(sim_node_t *node, const char *name, int create)
+{
+    for (int i = 0; i < node->count; i++)
+        if (!strcmp(node->params[i].name, name))
+            return &node->params[i];
+    if (!create || node->count == SIM_MAX_PARAMS)
+        return NULL;
+    sim_param_t *param = &node->params[node->count++];
+    memset(param, 0, sizeof(*param));
+    snprintf(param->name, sizeof(param->name), "%s", name);
+    return param;
+}
+
+static void node_set_int(sim_node_t *node, const char *name, int64_t value)
+{
+    pthread_mutex_lock(&node->lock);
+    sim_param_t *param = node_find(node, name, 1);
+    if (param)
+    {
+        param->intValue = value;
+        param->floatValue = (double)value;
+    }
+    pthread_mutex_unlock(&node->lock);
+}
+
+static void node_set_float(sim_node_t *node, const char *name, double value)
+{
+    pthread_mutex_lock(&node->lock);
+    sim_param_t *param = node_find(node, name, 1);
+    if (param)
+    {
+        param->floatValue = value;
+        param->intValue = (int64_t)value;
+    }
+    pthread_mutex_unlock(&node->lock);
+}
+
+static void node_set_enum_name(sim_node_t *node, const char *name, const char *valueName)
+{
+    pthread_mutex_lock(&node->lock);
+    sim_param_t *param = node_find(node, name, 1);
+    if (param)
+        snprintf(param->enumName, sizeof(param->enumName), "%s", valueName);
+    pthread_mutex_unlock(&node->lock);
+}
+
+static int64_t node_get_int(sim_node_t *node, const char *name, int64_t fallback)
+{
+    pthread_mutex_lock(&node->lock);
+    sim_param_t *param = node_find(node, name, 0);
+    int64_t value = param ? param->intValue : fallback;
+    pthread_mutex_unlock(&node->lock);
+    return value;
+}
+
+static double node_get_float(sim_node_t *node, const char *name, double fallback)
+{
+    pthread_mutex_lock(&node->lock);
+    sim_param_t *param = node_find(node, name, 0);
+    double value = param ? param->floatValue : fallback;
+    pthread_mutex_unlock(&node->lock);
+    return value;
+}
+
+static void node_get_enum_name(sim_node_t *node, const char *name, const char *fallback, char *out, size_t size)
+{
+    pthread_mutex_lock(&node->lock);
+    sim_param_t *param = node_find(node, name, 0);
+    snprintf(out, size, "%s", (param && param->enumName[0]) ? param->enumName : fallback);
+    pthread_mutex_unlock(&node->lock);
+}
+
+static void sim_setup()
+{
+    pthread_mutex_lock(&simLock);
+    if (grabberCount < 0)
+    {
+        grabberCount = env_int("KYSIM_GRABBERS", 1);
+        if (grabberCount > SIM_MAX_GRABBERS)
+            grabberCount = SIM_MAX_GRABBERS;
+        camerasPerGrabber = env_int("KYSIM_CAMERAS", 1);
+        if (camerasPerGrabber > KY_MAX_CAMERAS)
+            camerasPerGrabber = KY_MAX_CAMERAS;
+        for (int g = 0; g < SIM_MAX_GRABBERS; g++)
+        {
+            pthread_mutex_init(&grabbers[g].node.lock, NULL);
+            for (int c = 0; c < KY_MAX_CAMERAS; c++)
+            {
+                sim_camera_t *camera = &grabbers[g].cameras[c];
+                camera->grabber = g;
+                pthread_mutex_init(&camera->node.lock, NULL);
+                node_set_int(&camera->node, "Width", env_int("KYSIM_WIDTH", 2048));
+                node_set_int(&camera->node, "Height", env_int("KYSIM_HEIGHT", 1536));
+                node_set_float(&camera->node, "AcquisitionFrameRate", env_int("KYSIM_FPS", 60));
+                node_set_enum_name(&camera->node, "PixelFormat", "BayerRG8");
+            }
+        }
+    }
+    pthread_mutex_unlock(&simLock);
+}
+
+static sim_grabber_t *grabber_from_handle(FGHANDLE handle)
+{
+    int index = (int)handle - SIM_FGHANDLE_BASE;
+    if (index < 0 || index >= grabberCount || !grabbers[index].opened)
+        return NULL;
+    return &grabbers[index];
+}
+
+static sim_camera_t *camera_from_handle(CAMHANDLE camHandle)
+{
+    int index = (int)camHandle - SIM_CAMHANDLE_BASE;
+    int g = index / KY_MAX_CAMERAS, c = index % KY_MAX_CAMERAS;
+    if (index < 0 || g >= grabberCount || c >= camerasPerGrabber)
+        return NULL;
+    return &grabbers[g].cameras[c];
+}
+
+static sim_stream_t *stream_from_handle(STREAM_HANDLE streamHandle)
+{
+    if (streamHandle >= SIM_MAX_STREAMS || !streams[streamHandle].used)
+        return NULL;
+    return &streams[streamHandle];
+}
+
+// stream buffer handle: stream index in the high word, 1-based buffer index in the low word so it is never 0
+static STREAM_BUFFER_HANDLE make_buffer_handle(STREAM_HANDLE streamHandle, uint32_t buffer)
+{
+    return ((STREAM_BUFFER_HANDLE)streamHandle << 32) | (buffer + 1);
+}
+
+static sim_stream_t *stream_from_buffer(STREAM_BUFFER_HANDLE bufferHandle, uint32_t *buffer)
+{
+    sim_stream_t *stream = stream_from_handle((STREAM_HANDLE)(bufferHandle >> 32));
+    uint32_t index = (uint32_t)(bufferHandle & 0xFFFFFFFF) - 1;
+    if (!stream || index >= stream->bufferCount)
+        return NULL;
+    *buffer = index;
+    return stream;
+}
+
+// Horizontal colour ramp blended with a vertical luminance ramp, mosaiced to the requested Bayer phase
+static void build_pattern(sim_stream_t *stream, const char *bayerFormat)
+{
+    int64_t w = stream->width, h = stream->height;
+    // offsets of the red sample inside the 2x2 cell: RG -> (0,0), GR -> (1,0), GB -> (0,1), BG -> (1,1)
+    int redX = 0, redY = 0;
+    if (!strcasecmp(bayerFormat, "BayerGR8"))
+        redX = 1;
+    else if (!strcasecmp(bayerFormat, "BayerGB8"))
+        redY = 1;
+    else if (!strcasecmp(bayerFormat, "BayerBG8"))
+        redX = 1, redY = 1;
+
+    for (int64_t y = 0; y < h; y++)
+    {
+        uint8_t *row = stream->pattern + y * w * stream->bytesPerPixel;
+        for (int64_t x = 0; x < w; x++)
+        {
+            uint8_t r = (uint8_t)(255 * x / w);
+            uint8_t g = (uint8_t)(255 * y / h);
+            uint8_t b = (uint8_t)(255 - r);
+            if (stream->bytesPerPixel == 3)
+            {
+                row[3 * x + 0] = r;
+                row[3 * x + 1] = g;
+                row[3 * x + 2] = b;
+            }
+            else
+            {
+                int isRedRow = ((y & 1) == redY), isRedCol = ((x & 1) == redX);
+                row[x] = isRedRow ? (isRedCol ? r : g) : (isRedCol ? g : b);
+            }
+        }
+    }
+}
+
+static void render_frame(sim_stream_t *stream, uint8_t *dst, uint64_t frameIndex)
+{
+    memcpy(dst, stream->pattern, stream->frameSize);
+    // moving white bar so tearing and dropped frames are visible on screen
+    int64_t rowBytes = stream->width * stream->bytesPerPixel;
+    int64_t barX = (int64_t)(frameIndex * 8 % stream->width) * stream->bytesPerPixel;
+    int64_t barBytes = SIM_BAR_WIDTH * stream->bytesPerPixel;
+    if (barX + barBytes > rowBytes)
+        barBytes = rowBytes - barX;
+    for (int64_t y = 0; y < stream->height; y++)
+        memset(dst + y * rowBytes + barX, 0xFF, barBytes);
+}
+
+// next buffer to fill, -1 when a queued stream has nothing in its input queue and the frame is lost
+static int next_buffer(sim_stream_t *stream, uint64_t frameIndex)
+{
+    if (!stream->queued)
+        return (int)(frameIndex % stream->bufferCount);
+    int buffer = -1;
+    pthread_mutex_lock(&stream->queueLock);
+    if (stream->inputCount)
+    {
+        buffer = stream->input[stream->inputHead];
+        stream->inputHead = (stream->inputHead + 1) % SIM_MAX_BUFFERS;
+        stream->inputCount--;
+        stream->queue[buffer] = KY_ACQ_QUEUE_OUTPUT;
+    }
+    pthread_mutex_unlock(&stream->queueLock);
+    return buffer;
+}
+
+static void *camera_thread(void *arg)
+{
+    sim_camera_t *camera = (sim_camera_t *)arg;
+    sim_stream_t *stream = camera->stream;
+    STREAM_HANDLE streamHandle = (STREAM_HANDLE)(stream - streams);
+    uint64_t previous = 0;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    while (atomic_load(&camera->running))
+    {
+        double fps = node_get_float(&camera->node, "AcquisitionFrameRate", 60.0);
+        uint64_t period = fps > 0 ? (uint64_t)(1e9 / fps) : 16666666;
+        deadline.tv_nsec += period;
+        while (deadline.tv_nsec >= 1000000000)
+        {
+            deadline.tv_nsec -= 1000000000;
+            deadline.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+        if (!atomic_load(&camera->running))
+            break;
+
+        uint64_t frameIndex = atomic_fetch_add(&camera->frameCounter, 1);
+        int buffer = next_buffer(stream, frameIndex);
+        if (buffer < 0)
+            continue;
+        render_frame(stream, stream->buffers[buffer], frameIndex);
+
+        uint64_t timestamp = now_ns();
+        stream->timestamps[buffer] = timestamp;
+        stream->instantFps[buffer] = previous ? 1e9 / (double)(timestamp - previous) : 0.0;
+        stream->lastFrameIndex = buffer;
+        previous = timestamp;
+
+        // don't try to catch up after a stall, a real sensor would not burst either
+        uint64_t deadlineNs = (uint64_t)deadline.tv_sec * 1000000000ull + deadline.tv_nsec;
+        if (timestamp > deadlineNs + period)
+        {
+            deadline.tv_sec = timestamp / 1000000000ull;
+            deadline.tv_nsec = timestamp % 1000000000ull;
+        }
+
+        if (stream->callback)
+            stream->callback(make_buffer_handle(streamHandle, buffer), stream->userContext);
+    }
+    if (stream->callback)
+        stream->callback(0, stream->userContext); // acquisition stopped
+    return NULL;
+}
+
+/***************************** library ******************************/
+
+FGSTATUS KYFGLib_Initialize(KYFGLib_InitParameters *pKYFGLib_InitParameters)
+{
+    (void)pKYFGLib_InitParameters;
+    sim_setup();
+    return FGSTATUS_OK;
+}
+
+FGSTATUS KY_DeviceScan(int *pDetectedDevices)
+{
+    sim_setup();
+    *pDetectedDevices = grabberCount;
+    return FGSTATUS_OK;
+}
+
+FGSTATUS KY_DeviceInfo(int index, KY_DEVICE_INFO *pInfo)
+{
+    sim_setup();
+    if (index < 0 || index >= grabberCount || !pInfo)
+        return FGSTATUS_HW_NOT_FOUND;
+    uint32_t version = pInfo->version;
+    memset(pInfo, 0, sizeof(*pInfo));
+    pInfo->version = version > KY_MAX_DEVICE_INFO_VERSION ? KY_MAX_DEVICE_INFO_VERSION : version;
+    snprintf(pInfo->szDeviceDisplayName, sizeof(pInfo->szDeviceDisplayName), "Simulated grabber %d", index);
+    pInfo->nSlot = index;
+    pInfo->isVirtual = KYTRUE;
+    pInfo->m_Flags = KY_DEVICE_STREAM_GRABBER;
+    pInfo->m_Protocol = KY_DEVICE_PROTOCOL_CoaXPress;
+    pInfo->DeviceGeneration = 2;
+    return FGSTATUS_OK;
+}
+
+const char *KY_DeviceDisplayName(int index)
+{
+    (void)index;
+    return "Simulated grabber";
+}
+
+FGHANDLE KYFG_Open(int index)
+{
+    sim_setup();
+    if (index < 0 || index >= grabberCount)
+        return INVALID_FGHANDLE;
+    grabbers[index].opened = 1;
+    return SIM_FGHANDLE_BASE + index;
+}
+
+FGHANDLE KYFG_OpenEx(int index, const char *projectFile)
+{
+    (void)projectFile;
+    return KYFG_Open(index);
+}
+
+FGSTATUS KYFG_Close(FGHANDLE handle)
+{
+    sim_grabber_t *grabber = grabber_from_handle(handle);
+    if (!grabber)
+        return FGSTATUS_UNKNOWN_HANDLE;
+    for (int c = 0; c < camerasPerGrabber; c++)
+        if (atomic_load(&grabber->cameras[c].running))
+            KYFG_CameraStop(SIM_CAMHANDLE_BASE + (grabber - grabbers) * KY_MAX_CAMERAS + c);
+    grabber->opened = 0;
+    return FGSTATUS_OK;
+}
+
+FGSTATUS KYFG_UpdateCameraList(FGHANDLE handle, CAMHANDLE *pCamHandleArray, int *pArraySize)
+{
+    sim_grabber_t *grabber = grabber_from_handle(handle);
+    if (!grabber)
+        return FGSTATUS_UNKNOWN_HANDLE;
+    int count = camerasPerGrabber < *pArraySize ? camerasPerGrabber : *pArraySize;
+    for (int c = 0; c < count; c++)
+        pCamHandleArray[c] = SIM_CAMHANDLE_BASE + (grabber - grabbers) * KY_MAX_CAMERAS + c;
+    *pArraySize = count;
+    return FGSTATUS_OK;
+}
+
+FGSTATUS KYFG_CameraOpen2(CAMHANDLE camHandle, const char *xml_file_path)
+{
+    (void)xml_file_path;
+    sim_camera_t *camera = camera_from_handle(camHandle);
+    if (!camera)
+        return FGSTATUS_CAMERA_NOT_CONNECTED;
+    camera->opened = 1;
+    return FGSTATUS_OK;
+}
+
+FGSTATUS KYFG_CameraClose(CAMHANDLE camHandle)
+{
+    sim_camera_t *camera = camera_from_handle(camHandle);
+    if (!camera)
+        return FGSTATUS_CAMERA_NOT_CONNECTED;
+    camera->opened = 0;
+    return FGSTATUS_OK;
+}
+
+/***************************** streams ******************************/
+
+static sim_stream_t *stream_setup(sim_camera_t *camera, int queued, STREAM_HANDLE *pStreamHandle)
+{
+    pthread_mutex_lock(&simLock);
+    STREAM_HANDLE handle = 0;
+    while (handle < SIM_MAX_STREAMS && streams[handle].used)
+        handle++;
+    if (handle == SIM_MAX_STREAMS)
+    {
+        pthread_mutex_unlock(&simLock);
+        return NULL;
+    }
+    sim_stream_t *stream = &streams[handle];
+    memset(stream, 0, sizeof(*stream));
+    stream->used = 1;
+    pthread_mutex_unlock(&simLock);
+
+    char grabberFormat[32], cameraFormat[32];
+    node_get_enum_name(&grabbers[camera->grabber].node, "PixelFormat", "", grabberFormat, sizeof(grabberFormat));
+    node_get_enum_name(&camera->node, "PixelFormat", "BayerRG8", cameraFormat, sizeof(cameraFormat));
+
+    stream->camera = camera;
+    stream->lastFrameIndex = -1;
+    stream->width = node_get_int(&camera->node, "Width", 2048);
+    stream->height = node_get_int(&camera->node, "Height", 1536);
+    stream->bytesPerPixel = strcasecmp(grabberFormat, "RGB8") ? 1 : 3;
+    stream->frameSize = (size_t)(stream->width * stream->height * stream->bytesPerPixel);
+    stream->queued = queued;
+    pthread_mutex_init(&stream->queueLock, NULL);
+    stream->pattern = aligned_alloc(4096, (stream->frameSize + 4095) & ~(size_t)4095);
+    build_pattern(stream, cameraFormat);
+
+    node_set_int(&grabbers[camera->grabber].node, "Width", stream->width);
+    node_set_int(&grabbers[camera->grabber].node, "Height", stream->height);
+    camera->stream = stream;
+    *pStreamHandle = handle;
+    return stream;
+}
+
+FGSTATUS KYFG_StreamCreateAndAlloc(CAMHANDLE camHandle, STREAM_HANDLE *pStreamHandle, uint32_t frames, int streamIndex)
+{
+    (void)streamIndex;
+    sim_camera_t *camera = camera_from_handle(camHandle);
+    if (!camera || !camera->opened)
+        return FGSTATUS_CAMERA_NOT_OPENED;
+    if (frames == 0 || frames > SIM_MAX_BUFFERS)
+        return FGSTATUS_INVALID_VALUE;
+
+    sim_stream_t *stream = stream_setup(camera, 0, pStreamHandle);
+    if (!stream)
+        return FGSTATUS_MEMORY_ERROR;
+    stream->bufferCount = frames;
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        stream->buffers[i] = aligned_alloc(4096, (stream->frameSize + 4095) & ~(size_t)4095);
+        stream->owned[i] = 1;
+        stream->queue[i] = KY_ACQ_QUEUE_AUTO;
+    }
+    return FGSTATUS_OK;
+}
+
+FGSTATUS KYFG_StreamCreate(CAMHANDLE camHandle, STREAM_HANDLE *pStreamHandle, int streamIndex)
+{
+    (void)streamIndex;
+    sim_camera_t *camera = camera_from_handle(camHandle);
+    if (!camera || !camera->opened)
+        return FGSTATUS_CAMERA_NOT_OPENED;
+    return stream_setup(camera, 1, pStreamHandle) ? FGSTATUS_OK : FGSTATUS_MEMORY_ERROR;
+}
+
+FGSTATUS KYFG_StreamDelete(STREAM_HANDLE streamHandle)
+{
+    sim_stream_t *stream = stream_from_handle(streamHandle);
+    if (!stream)
+        return FGSTATUS_STREAM_NOT_CREATED;
+    if (atomic_load(&stream->camera->running))
+        return FGSTATUS_STREAM_IS_LOCKED;
+    for (uint32_t i = 0; i < stream->bufferCount; i++)
+        if (stream->owned[i])
+            free(stream->buffers[i]);
+    free(stream->pattern);
+    pthread_mutex_destroy(&stream->queueLock);
+    stream->camera->stream = NULL;
+    stream->used = 0;
+    return FGSTATUS_OK;
+}
+
+static FGSTATUS stream_announce(STREAM_HANDLE streamHandle, void *pBuffer, size_t nBufferSize, int owned, void *pPrivate, STREAM_BUFFER_HANDLE *pBufferHandle)
+{
+    sim_stream_t *stream = stream_from_handle(streamHandle);
+    if (!stream)
+        return FGSTATUS_STREAM_NOT_CREATED;
+    if (!stream->queued)
+        return FGSTATUS_QUEUED_BUFFERS_NOT_SUPPORTED;
+    if (nBufferSize < stream->frameSize)
+        return FGSTATUS_BUFFER_TOO_SMALL;
+    pthread_mutex_lock(&stream->queueLock);
+    if (stream->bufferCount == SIM_MAX_BUFFERS)
+    {
+        pthread_mutex_unlock(&stream->queueLock);
+        return FGSTATUS_MEMORY_ERROR;
+    }
+    uint32_t buffer = stream->bufferCount++;
+    stream->buffers[buffer] = pBuffer;
+    stream->privates[buffer] = pPrivate;
+    stream->owned[buffer] = owned;
+    stream->queue[buffer] = KY_ACQ_QUEUE_UNQUEUED;
+    pthread_mutex_unlock(&stream->queueLock);
+    *pBufferHandle = make_buffer_handle(streamHandle, buffer);
+    return FGSTATUS_OK;
+}
+
+FGSTATUS KYFG_BufferAnnounce(STREAM_HANDLE streamHandle, void *pBuffer, size_t nBufferSize, void *pPrivate, STREAM_BUFFER_HANDLE *pBufferHandle)
+{
+    if (!pBuffer)
+        return FGSTATUS_INVALID_VALUE;
+    return stream_announce(streamHandle, pBuffer, nBufferSize, 0, pPrivate, pBufferHandle);
+}
+
+FGSTATUS KYFG_BufferAllocAndAnnounce(STREAM_HANDLE streamHandle, size_t nBufferSize, void *pPrivate, STREAM_BUFFER_HANDLE *pBufferHandle)
+{
+    void *buffer = aligned_alloc(4096, (nBufferSize + 4095) & ~(size_t)4095);
+    if (!buffer)
+        return FGSTATUS_MEMORY_ERROR;
+    FGSTATUS status = stream_announce(streamHandle, buffer, nBufferSize, 1, pPrivate, pBufferHandle);
+    if (status != FGSTATUS_OK)
+        free(buffer);
+    return status;
+}
+
+// caller holds queueLock
+static FGSTATUS move_to_queue(sim_stream_t *stream, uint32_t buffer, KY_ACQ_QUEUE_TYPE dstQueue)
+{
+    if (dstQueue == KY_ACQ_QUEUE_AUTO)
+        return FGSTATUS_DESTINATION_QUEUE_NOT_SUPPORTED;
+    if (stream->queue[buffer] == dstQueue)
+        return dstQueue == KY_ACQ_QUEUE_INPUT ? FGSTATUS_BUFFER_ALREADY_IN_INPUT_QUEUE : FGSTATUS_OK;
+    if (stream->queue[buffer] == KY_ACQ_QUEUE_INPUT)
+    {
+        // drop it from the FIFO, keeping the order of the rest
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < stream->inputCount; i++)
+        {
+            uint32_t entry = stream->input[(stream->inputHead + i) % SIM_MAX_BUFFERS];
+            if (entry != buffer)
+                stream->input[(stream->inputHead + kept++) % SIM_MAX_BUFFERS] = entry;
+        }
+        stream->inputCount = kept;
+    }
+    if (dstQueue == KY_ACQ_QUEUE_INPUT)
+        stream->input[(stream->inputHead + stream->inputCount++) % SIM_MAX_BUFFERS] = buffer;
+    stream->queue[buffer] = dstQueue;
+    return FGSTATUS_OK;
+}
+
+FGSTATUS KYFG_BufferToQueue(STREAM_BUFFER_HANDLE streamBufferHandle, KY_ACQ_QUEUE_TYPE dstQueue)
+{
+    uint32_t buffer;
+    sim_stream_t *stream = stream_from_buffer(streamBufferHandle, &buffer);
+    if (!stream)
+        return FGSTATUS_UNKNOWN_HANDLE;
+    if (!stream->queued)
+        return FGSTATUS_QUEUED_BUFFERS_NOT_SUPPORTED;
+    pthread_mutex_lock(&stream->queueLock);
+    FGSTATUS status = move_to_queue(stream, buffer, dstQueue);
+    pthread_mutex_unlock(&stream->queueLock);
+    return status;
+}
+
+FGSTATUS KYFG_BufferQueueAll(STREAM_HANDLE streamHandle, KY_ACQ_QUEUE_TYPE srcQueue, KY_ACQ_QUEUE_TYPE dstQueue)
+{
+    sim_stream_t *stream = stream_from_handle(streamHandle);
+    if (!stream)
+        return FGSTATUS_STREAM_NOT_CREATED;
+    if (!stream->queued)
+        return FGSTATUS_QUEUED_BUFFERS_NOT_SUPPORTED;
+    FGSTATUS status = FGSTATUS_OK;
+    pthread_mutex_lock(&stream->queueLock);
+    for (uint32_t i = 0; i < stream->bufferCount && status == FGSTATUS_OK; i++)
+        if (stream->queue[i] == srcQueue)
+            status = move_to_queue(stream, i, dstQueue);
+    pthread_mutex_unlock(&stream->queueLock);
+    return status;
+}
+
+FGSTATUS KYFG_StreamGetInfo(STREAM_HANDLE streamHandle, KY_STREAM_INFO_CMD cmdStreamInfo, void *pInfoBuffer, size_t *pInfoSize, KY_DATA_TYPE *pInfoType)
+{
+    sim_stream_t *stream = stream_from_handle(streamHandle);
+    if (!stream)
+        return FGSTATUS_STREAM_NOT_CREATED;
+
+    size_t value = 0;
+    switch (cmdStreamInfo)
+    {
+    case KY_STREAM_INFO_PAYLOAD_SIZE:
+        value = stream->frameSize;
+        break;
+    case KY_STREAM_INFO_BUF_ALIGNMENT:
+        value = 4096;
+        break;
+    case KY_STREAM_INFO_PAYLOAD_SIZE_INCREMENT_FACTOR:
+        value = 1;
+        break;
+    case KY_STREAM_INFO_BUF_COUNT:
+        value = stream->bufferCount;
+        break;
+    case KY_STREAM_INFO_INSTANTFPS:
+        if (pInfoBuffer)
+            *(double *)pInfoBuffer = stream->lastFrameIndex >= 0 ? stream->instantFps[stream->lastFrameIndex] : 0.0;
+        if (pInfoSize)
+            *pInfoSize = sizeof(double);
+        if (pInfoType)
+            *pInfoType = KY_DATATYPE_FLOAT64;
+        return FGSTATUS_OK;
+    default:
+        return FGSTATUS_INVALID_STREAM_INFO_CMD;
+    }
+    if (pInfoBuffer)
+        *(size_t *)pInfoBuffer = value;
+    if (pInfoSize)
+        *pInfoSize = sizeof(size_t);
+    if (pInfoType)
+        *pInfoType = KY_DATATYPE_SIZET;
+    return FGSTATUS_OK;
+}
+
+FGSTATUS KYFG_StreamBufferCallbackRegister(STREAM_HANDLE streamHandle, StreamBufferCallback userFunc, void *userContext)
+{
+    sim_stream_t *stream = stream_from_handle(streamHandle);
+    if (!stream)
+        return FGSTATUS_STREAM_NOT_CREATED;
+    stream->callback = userFunc;
+    stream->userContext = userContext;
+    return FGSTATUS_OK;
+}
+
+FGSTATUS KYFG_StreamBufferCallbackUnregister(STREAM_HANDLE streamHandle, StreamBufferCallback userFunc)
+{
+    sim_stream_t *stream = stream_from_handle(streamHandle);
+    if (!stream)
+        return FGSTATUS_STREAM_NOT_CREATED;
+    if (stream->callback == userFunc)
+        stream->callback = NULL;
+    return FGSTATUS_OK;
+}
+
+FGSTATUS KYFG_BufferGetInfo(STREAM_BUFFER_HANDLE streamBufferHandle, KY_STREAM_BUFFER_INFO_CMD cmdStreamBufferInfo, void *pInfoBuffer, size_t *pInfoSize, KY_DATA_TYPE *pInfoType)
+{
+    uint32_t buffer;
+    sim_stream_t *stream = stream_from_buffer(streamBufferHandle, &buffer);
+    if (!stream)
+        return FGSTATUS_UNKNOWN_HANDLE;
+
+    size_t size;
+    KY_DATA_TYPE type;
+    switch (cmdStreamBufferInfo)
+    {
+    case KY_STREAM_BUFFER_INFO_BASE:
+        size = sizeof(void *), type = KY_DATATYPE_PTR;
+        if (pInfoBuffer)
+            *(void **)pInfoBuffer = stream->buffers[buffer];
+        break;
+    case KY_STREAM_BUFFER_INFO_SIZE:
+        size = sizeof(size_t), type = KY_DATATYPE_SIZET;
+        if (pInfoBuffer)
+            *(size_t *)pInfoBuffer = stream->frameSize;
+        break;
+    case KY_STREAM_BUFFER_INFO_USER_PTR:
+        size = sizeof(void *), type = KY_DATATYPE_PTR;
+        if (pInfoBuffer)
+            *(void **)pInfoBuffer = stream->privates[buffer];
+        break;
+    case KY_STREAM_BUFFER_INFO_TIMESTAMP:
+        size = sizeof(uint64_t), type = KY_DATATYPE_UINT64;
+        if (pInfoBuffer)
+            *(uint64_t *)pInfoBuffer = stream->timestamps[buffer];
+        break;
+    case KY_STREAM_BUFFER_INFO_INSTANTFPS:
+        size = sizeof(double), type = KY_DATATYPE_FLOAT64;
+        if (pInfoBuffer)
+            *(double *)pInfoBuffer = stream->instantFps[buffer];
+        break;
+    case KY_STREAM_BUFFER_INFO_ID:
+        size = sizeof(uint32_t), type = KY_DATATYPE_UINT32;
+        if (pInfoBuffer)
+            *(uint32_t *)pInfoBuffer = buffer;
+        break;
+    default:
+        return FGSTATUS_INVALID_STREAM_BUFFER_INFO_CMD;
+    }
+    if (pInfoSize)
+        *pInfoSize = size;
+    if (pInfoType)
+        *pInfoType = type;
+    return FGSTATUS_OK;
+}
+
+void *KYFG_StreamGetPtr(STREAM_HANDLE streamHandle, uint32_t frame)
+{
+    sim_stream_t *stream = stream_from_handle(streamHandle);
+    if (!stream || frame >= stream->bufferCount)
+        return NULL;
+    return stream->buffers[frame];
+}
+
+int64_t KYFG_StreamGetSize(STREAM_HANDLE streamHandle)
+{
+    sim_stream_t *stream = stream_from_handle(streamHandle);
+    return stream ? (int64_t)stream->frameSize : 0;
+}
+
+int KYFG_StreamGetFrameIndex(STREAM_HANDLE streamHandle)
+{
+    sim_stream_t *stream = stream_from_handle(streamHandle);
+    return stream ? (int)stream->lastFrameIndex : -1;
+}
+
+FGSTATUS KYFG_CameraStart(CAMHANDLE camHandle, STREAM_HANDLE streamHandle, uint32_t frames)
+{
+    (void)frames;
+    sim_camera_t *camera = camera_from_handle(camHandle);
+    sim_stream_t *stream = stream_from_handle(streamHandle);
+    if (!camera || !camera->opened)
+        return FGSTATUS_CAMERA_NOT_OPENED;
+    if (!stream || stream->camera != camera)
+        return FGSTATUS_STREAM_NOT_CREATED;
+    if (atomic_exchange(&camera->running, 1))
+        return FGSTATUS_STREAM_CANNOT_LOCK;
+    camera->stream = stream;
+    if (pthread_create(&camera->thread, NULL, camera_thread, camera))
+    {
+        atomic_store(&camera->running, 0);
+        return FGSTATUS_COULD_NOT_START;
+    }
+    return FGSTATUS_OK;
+}
+
+FGSTATUS KYFG_CameraStop(CAMHANDLE camHandle)
+{
+    sim_camera_t *camera = camera_from_handle(camHandle);
+    if (!camera)
+        return FGSTATUS_CAMERA_NOT_CONNECTED;
+    if (!atomic_exchange(&camera->running, 0))
+        return FGSTATUS_OK;
+    pthread_join(camera->thread, NULL);
+    return FGSTATUS_OK;
+}
+
+/***************************** parameters ******************************/
+
+static sim_node_t *grabber_node(FGHANDLE handle)
+{
+    sim_grabber_t *grabber = grabber_from_handle(handle);
+    return grabber ? &grabber->node : NULL;
+}
+
+static sim_node_t *camera_node(CAMHANDLE camHandle)
+{
+    sim_camera_t *camera = camera_from_handle(camHandle);
+    return camera ? &camera->node : NULL;
+}
+
+// frame counters are live values rather than stored parameters
+static int64_t counter_value(FGHANDLE grabberHandle, CAMHANDLE camHandle, const char *paramName, int *found)
+{
+    *found = 0;
+    if (strcmp(paramName, "RXFrameCounter"))
+        return 0;
+    *found = 1;
+    if (camHandle != INVALID_CAMHANDLE)
+    {
+        sim_camera_t *camera = camera_from_handle(camHandle);
+        return camera ? (int64_t)atomic_load(&camera->frameCounter) : 0;
+    }
+    sim_grabber_t *grabber = grabber_from_handle(grabberHandle);
+    if (!grabber)
+        return 0;
+    // grabber counter follows the selected camera
+    int64_t selected = node_get_int(&grabber->node, "CameraSelector", 0);
+    if (selected < 0 || selected >= camerasPerGrabber)
+        return 0;
+    return (int64_t)atomic_load(&grabber->cameras[selected].frameCounter);
+}
+
+FGSTATUS KYFG_SetGrabberValueInt(FGHANDLE handle, const char *paramName, int64_t value)
+{
+    sim_node_t *node = grabber_node(handle);
+    if (!node)
+        return FGSTATUS_UNKNOWN_HANDLE;
+    node_set_int(node, paramName, value);
+    return FGSTATUS_OK;
+}
+
+FGSTATUS KYFG_SetGrabberValueFloat(FGHANDLE handle, const char *paramName, double value)
+{
+    sim_node_t *node = grabber_node(handle);
+    if (!node)
+        return FGSTATUS_UNKNOWN_HANDLE;
+    node_set_float(node, paramName, value);
+    return FGSTATUS_OK;
+}
+
+FGSTATUS KYFG_SetGrabberValueBool(FGHANDLE handle, const char *paramName, KYBOOL value)
+{
+    return KYFG_SetGrabberValueInt(handle, paramName, value);
+}
+
+FGSTATUS KYFG_SetGrabberValueEnum(FGHANDLE handle, const char *paramName, int64_t value)
+{
+    return KYFG_SetGrabberValueInt(handle, paramName, value);
+}
+
+FGSTATUS KYFG_SetGrabberValueEnum_ByValueName(FGHANDLE handle, const char *paramName, const char *paramValueName)
+{
+    sim_node_t *node = grabber_node(handle);
+    if (!node)
+        return FGSTATUS_UNKNOWN_HANDLE;
+    node_set_enum_name(node, paramName, paramValueName);
+    return FGSTATUS_OK;
+}
+
+int64_t KYFG_GetGrabberValueInt(FGHANDLE handle, const char *paramName)
+{
+    int found;
+    int64_t counter = counter_value(handle, INVALID_CAMHANDLE, paramName, &found);
+    if (found)
+        return counter;
+    sim_node_t *node = grabber_node(handle);
+    return node ? node_get_int(node, paramName, 0) : INVALID_INT_PARAMETER_VALUE;
+}
+
+int64_t KYFG_GetGrabberValueEnum(FGHANDLE handle, const char *paramName)
+{
+    return KYFG_GetGrabberValueInt(handle, paramName);
+}
+
+double KYFG_GetGrabberValueFloat(FGHANDLE handle, const char *paramName)
+{
+    sim_node_t *node = grabber_node(handle);
+    return node ? node_get_float(node, paramName, 0.0) : INVALID_FLOAT_PARAMETER_VALUE;
+}
+
+KYBOOL KYFG_GetGrabberValueBool(FGHANDLE handle, const char *paramName)
+{
+    return KYFG_GetGrabberValueInt(handle, paramName) != 0;
+}
+
+FGSTATUS KYFG_SetCameraValueInt(CAMHANDLE camHandle, const char *paramName, int64_t value)
+{
+    sim_node_t *node = camera_node(camHandle);
+    if (!node)
+        return FGSTATUS_CAMERA_NOT_CONNECTED;
+    node_set_int(node, paramName, value);
+    return FGSTATUS_OK;
+}
+
+FGSTATUS KYFG_SetCameraValueFloat(CAMHANDLE camHandle, const char *paramName, double value)
+{
+    sim_node_t *node = camera_node(camHandle);
+    if (!node)
+        return FGSTATUS_CAMERA_NOT_CONNECTED;
+    node_set_float(node, paramName, value);
+    return FGSTATUS_OK;
+}
+
+FGSTATUS KYFG_SetCameraValueBool(CAMHANDLE camHandle, const char *paramName, KYBOOL value)
+{
+    return KYFG_SetCameraValueInt(camHandle, paramName, value);
+}
+
+FGSTATUS KYFG_SetCameraValueEnum(CAMHANDLE camHandle, const char *paramName, int64_t value)
+{
+    return KYFG_SetCameraValueInt(camHandle, paramName, value);
+}
+
+FGSTATUS KYFG_SetCameraValueEnum_ByValueName(CAMHANDLE camHandle, const char *paramName, const char *paramValueName)
+{
+    sim_node_t *node = camera_node(camHandle);
+    if (!node)
+        return FGSTATUS_CAMERA_NOT_CONNECTED;
+    node_set_enum_name(node, paramName, paramValueName);
+    return FGSTATUS_OK;
+}
+
+int64_t KYFG_GetCameraValueInt(CAMHANDLE camHandle, const char *paramName)
+{
+    int found;
+    int64_t counter = counter_value(INVALID_FGHANDLE, camHandle, paramName, &found);
+    if (found)
+        return counter;
+    sim_node_t *node = camera_node(camHandle);
+    return node ? node_get_int(node, paramName, 0) : INVALID_INT_PARAMETER_VALUE;
+}
+
+int64_t KYFG_GetCameraValueEnum(CAMHANDLE camHandle, const char *paramName)
+{
+    return KYFG_GetCameraValueInt(camHandle, paramName);
+}
+
+double KYFG_GetCameraValueFloat(CAMHANDLE camHandle, const char *paramName)
+{
+    sim_node_t *node = camera_node(camHandle);
+    return node ? node_get_float(node, paramName, 0.0) : INVALID_FLOAT_PARAMETER_VALUE;
+}
+
+KYBOOL KYFG_GetCameraValueBool(CAMHANDLE camHandle, const char *paramName)
+{
+    return KYFG_GetCameraValueInt(camHandle, paramName) != 0;
+}
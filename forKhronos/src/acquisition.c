@@ -0,0 +1,500 @@
+#include "myCode/acquisition.h"
+#include "myCode/grabber.h"
+#include "myCode/camera.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// discovery state of one grabber, filled in by its own thread
+typedef struct grabber_job_t
+{
+    acq_engine_t *engine;
+    acq_setup_fn setup;
+    int grabberIndex;
+    pthread_t thread;
+    int threadStarted;
+    CAMHANDLE camHandles[KY_MAX_CAMERAS];
+    int cameraOpen[KY_MAX_CAMERAS];
+    int detectedCameras;
+} grabber_job_t;
+
+// every frame of a camera goes through here, from its grabber callback or its replay thread
+static void deliver_frame(const frame_desc_t *frame, void *context)
+{
+    acq_camera_t *camera = (acq_camera_t *)context;
+    frame_loss_frame(&camera->loss, frame);
+    // every frame, before the render loop can skip or release it
+    recorder_push(&camera->recorder, frame);
+    pretrigger_push(&camera->pretrigger, frame);
+    // descriptor is fully written before it becomes visible to the render loop
+    frame_ring_push(&camera->ring, frame);
+}
+
+static void stream_callback(STREAM_BUFFER_HANDLE streamBufferHandle, void *userContext)
+{
+    if (!streamBufferHandle)
+    {
+        // this callback indicates that acquisition has stopped
+        return;
+    }
+    frame_desc_t frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.bufferHandle = streamBufferHandle;
+    frame.receivedNs = frame_clock_ns();
+    KYFG_BufferGetInfo(streamBufferHandle, KY_STREAM_BUFFER_INFO_BASE, &frame.base, NULL, NULL);
+    KYFG_BufferGetInfo(streamBufferHandle, KY_STREAM_BUFFER_INFO_ID, &frame.bufferID, NULL, NULL);
+    KYFG_BufferGetInfo(streamBufferHandle, KY_STREAM_BUFFER_INFO_TIMESTAMP, &frame.timestamp, NULL, NULL);
+    deliver_frame(&frame, userContext);
+}
+
+static void *grabber_open_thread(void *arg)
+{
+    grabber_job_t *job = (grabber_job_t *)arg;
+    FGHANDLE handle;
+    int ret;
+
+    if (connect_to_grabber(job->engine->grabbers, job->grabberIndex))
+        return NULL;
+    handle = job->engine->grabbers[job->grabberIndex];
+
+    job->detectedCameras = KY_MAX_CAMERAS;
+    ret = camera_update_list(handle, job->camHandles, &job->detectedCameras);
+    if (FGSTATUS_OK != ret)
+    {
+        printf("Grabber #%d camera_update_list - %x\n", job->grabberIndex, ret);
+        job->detectedCameras = 0;
+        return NULL;
+    }
+    printf("Grabber #%d: found %d cameras.\n", job->grabberIndex, job->detectedCameras);
+
+    // cameras of one grabber share its CameraSelector, so they are set up one after another
+    for (int c = 0; c < job->detectedCameras; c++)
+    {
+        if (FGSTATUS_OK != camera_open(job->camHandles[c]))
+        {
+            printf("Grabber #%d camera #%d isn't connected\n", job->grabberIndex, c);
+            continue;
+        }
+        job->cameraOpen[c] = 1;
+        if (job->setup)
+            job->setup(handle, job->camHandles[c], job->grabberIndex, c);
+    }
+    return NULL;
+}
+
+int acq_engine_open(acq_engine_t *engine, acq_setup_fn setup)
+{
+    grabber_job_t jobs[ACQ_MAX_GRABBERS];
+    int devices = 0;
+
+    for (int g = 0; g < ACQ_MAX_GRABBERS; g++)
+        engine->grabbers[g] = INVALID_FGHANDLE;
+    engine->cameras = NULL;
+    engine->cameraCount = 0;
+
+    KY_DeviceScan(&devices);
+    if (devices > ACQ_MAX_GRABBERS)
+    {
+        printf("%d devices found, using the first %d\n", devices, ACQ_MAX_GRABBERS);
+        devices = ACQ_MAX_GRABBERS;
+    }
+
+    memset(jobs, 0, sizeof(jobs));
+    for (int g = 0; g < devices; g++)
+    {
+        jobs[g].engine = engine;
+        jobs[g].setup = setup;
+        jobs[g].grabberIndex = g;
+        if (pthread_create(&jobs[g].thread, NULL, grabber_open_thread, &jobs[g]) == 0)
+            jobs[g].threadStarted = 1;
+        else
+            grabber_open_thread(&jobs[g]);
+    }
+
+    int opened = 0;
+    for (int g = 0; g < devices; g++)
+    {
+        if (jobs[g].threadStarted)
+            pthread_join(jobs[g].thread, NULL);
+        for (int c = 0; c < jobs[g].detectedCameras; c++)
+            opened += jobs[g].cameraOpen[c];
+    }
+
+    engine->cameras = calloc(opened ? opened : 1, sizeof(acq_camera_t));
+    for (int g = 0; g < devices; g++)
+    {
+        for (int c = 0; c < jobs[g].detectedCameras; c++)
+        {
+            if (!jobs[g].cameraOpen[c])
+                continue;
+            acq_camera_t *camera = &engine->cameras[engine->cameraCount++];
+            camera->grabberIndex = g;
+            camera->cameraIndex = c;
+            camera->grabberHandle = engine->grabbers[g];
+            camera->camHandle = jobs[g].camHandles[c];
+            camera->streamHandle = INVALID_STREAMHANDLE;
+        }
+    }
+    printf("%d cameras open on %d devices\n", engine->cameraCount, devices);
+    return engine->cameraCount;
+}
+
+int acq_engine_open_replay(acq_engine_t *engine, const char *const *paths, int count, const char *pixelFormat)
+{
+    for (int g = 0; g < ACQ_MAX_GRABBERS; g++)
+        engine->grabbers[g] = INVALID_FGHANDLE;
+    engine->cameras = calloc(count > 0 ? count : 1, sizeof(acq_camera_t));
+    engine->cameraCount = 0;
+    for (int i = 0; i < count; i++)
+    {
+        acq_camera_t *camera = &engine->cameras[engine->cameraCount];
+        if (replay_open(&camera->replay, paths[i]))
+            continue;
+        const sequence_header_t *h = camera->replay.seq.header;
+        if (strcmp(h->pixelFormat, pixelFormat))
+        {
+            printf("Replay: %s is %s, the viewer shows %s.\n", paths[i], h->pixelFormat, pixelFormat);
+            replay_close(&camera->replay);
+            continue;
+        }
+        camera->grabberIndex = -1;
+        camera->cameraIndex = engine->cameraCount++;
+        camera->streamHandle = INVALID_STREAMHANDLE;
+        camera->width = camera->sensorWidth = h->width;
+        camera->height = camera->sensorHeight = h->height;
+        camera->pixelScale = 1;
+        camera->fps = camera->defaultFrameRate = h->fps;
+    }
+    printf("%d cameras replayed from %d recordings\n", engine->cameraCount, count);
+    return engine->cameraCount;
+}
+
+// RXFrameCounter is a grabber value of the camera picked by CameraSelector. Only called from the thread driving
+// the engine, so the selector cannot change between the two calls
+static int64_t read_rx_frame_counter(acq_camera_t *camera)
+{
+    if (FGSTATUS_OK != set_grabber_value_int(camera->grabberHandle, "CameraSelector", camera->cameraIndex))
+        return -1;
+    return get_grabber_value_int(camera->grabberHandle, "RXFrameCounter");
+}
+
+static int64_t clamp64(int64_t v, int64_t lo, int64_t hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// binning and decimation first, they change the valid sizes; offsets go to 0 before the size grows, so every
+// intermediate region fits the sensor
+static void camera_write_geometry(acq_camera_t *camera, const acq_geometry_t *geometry)
+{
+    CAMHANDLE camHandle = camera->camHandle;
+    int ret;
+
+    if (!camera->sensorWidth)
+    {
+        camera->sensorWidth = get_camera_value_int(camHandle, "WidthMax");
+        camera->sensorHeight = get_camera_value_int(camHandle, "HeightMax");
+        if (camera->sensorWidth <= 0 || camera->sensorHeight <= 0)
+        {
+            camera->sensorWidth = get_camera_value_int(camHandle, "Width");
+            camera->sensorHeight = get_camera_value_int(camHandle, "Height");
+        }
+        camera->defaultFrameRate = get_camera_value_float(camHandle, "AcquisitionFrameRate");
+    }
+    int64_t binning = geometry->binning > 0 ? geometry->binning : 1;
+    int64_t decimation = geometry->decimation > 0 ? geometry->decimation : 1;
+    ret = set_camera_value_int(camHandle, "BinningHorizontal", binning);
+    ret |= set_camera_value_int(camHandle, "BinningVertical", binning);
+    if (ret != FGSTATUS_OK && binning != 1)
+        printf("SET 'Binning' %ld - %x\n", (long)binning, ret);
+    ret = set_camera_value_int(camHandle, "DecimationHorizontal", decimation);
+    ret |= set_camera_value_int(camHandle, "DecimationVertical", decimation);
+    if (ret != FGSTATUS_OK && decimation != 1)
+        printf("SET 'Decimation' %ld - %x\n", (long)decimation, ret);
+
+    int64_t fullWidth = camera->sensorWidth / (binning * decimation);
+    int64_t fullHeight = camera->sensorHeight / (binning * decimation);
+    int64_t width = geometry->width > 0 ? clamp64(geometry->width, 2, fullWidth) : fullWidth;
+    int64_t height = geometry->height > 0 ? clamp64(geometry->height, 2, fullHeight) : fullHeight;
+    set_camera_value_int(camHandle, "OffsetX", 0);
+    set_camera_value_int(camHandle, "OffsetY", 0);
+    ret = set_camera_value_int(camHandle, "Width", width);
+    printf("SET 'Width' %ld - %x\n", (long)width, ret);
+    ret = set_camera_value_int(camHandle, "Height", height);
+    printf("SET 'Height' %ld - %x\n", (long)height, ret);
+    // the camera may round the size to its increments
+    width = get_camera_value_int(camHandle, "Width");
+    height = get_camera_value_int(camHandle, "Height");
+
+    int64_t offsetX = geometry->offsetX < 0 ? (fullWidth - width) / 2 : geometry->offsetX;
+    int64_t offsetY = geometry->offsetY < 0 ? (fullHeight - height) / 2 : geometry->offsetY;
+    offsetX = clamp64(offsetX, 0, fullWidth - width) & ~(int64_t)1;
+    offsetY = clamp64(offsetY, 0, fullHeight - height) & ~(int64_t)1;
+    ret = set_camera_value_int(camHandle, "OffsetX", offsetX);
+    ret |= set_camera_value_int(camHandle, "OffsetY", offsetY);
+    if (ret != FGSTATUS_OK && (offsetX || offsetY))
+        printf("SET 'Offset' %ld, %ld - %x\n", (long)offsetX, (long)offsetY, ret);
+
+    // a smaller region reads out faster, the rate is set after the size so the camera accepts it
+    double frameRate = geometry->frameRate > 0 ? geometry->frameRate : camera->defaultFrameRate;
+    if (frameRate > 0)
+    {
+        ret = set_camera_value_float(camHandle, "AcquisitionFrameRate", frameRate);
+        printf("SET 'AcquisitionFrameRate' %.1f - %x\n", frameRate, ret);
+    }
+
+    // the grabber's image size is per camera, under CameraSelector
+    set_grabber_value_int(camera->grabberHandle, "CameraSelector", camera->cameraIndex);
+    set_grabber_value_int(camera->grabberHandle, "Width", width);
+    set_grabber_value_int(camera->grabberHandle, "Height", height);
+    camera->width = width;
+    camera->height = height;
+    camera->offsetX = offsetX;
+    camera->offsetY = offsetY;
+    camera->pixelScale = binning * decimation;
+    printf("Grabber #%d camera #%d: %ldx%ld at %ld,%ld, binning %ld, decimation %ld\n", camera->grabberIndex,
+           camera->cameraIndex, (long)width, (long)height, (long)offsetX, (long)offsetY, (long)binning, (long)decimation);
+}
+
+static int camera_create_stream(acq_camera_t *camera, const acq_config_t *config)
+{
+    camera->mode = config->mode;
+    camera->fps = get_camera_value_float(camera->camHandle, "AcquisitionFrameRate");
+    if (config->mode == ACQ_MODE_ZERO_COPY)
+    {
+        // frames land directly in GL visible memory, buffers are handed back once their upload has completed
+        if (zero_copy_create(&camera->zeroCopy, camera->camHandle, config->zeroCopyBuffers))
+        {
+            printf("Failed to create zero-copy stream.\n");
+            return -1;
+        }
+        camera->streamHandle = camera->zeroCopy.streamHandle;
+        frame_ring_init(&camera->ring, zero_copy_release, &camera->zeroCopy);
+    }
+    else if (config->mode == ACQ_MODE_QUEUED)
+    {
+        uint32_t count = config->queuedBuffers;
+        if (count == 0)
+        {
+            // what the render loop really held a frame for, once a stream has run; the configured guess before
+            uint64_t latencyNs = camera->measuredHoldNs ? camera->measuredHoldNs
+                                                         : (uint64_t)(config->expectedConsumerLatencyMs * 1e6);
+            count = buffer_queue_count_for_latency(camera->fps, latencyNs);
+            printf("Queue sized for the %s consumer latency, %.2f ms\n", camera->measuredHoldNs ? "measured" : "expected",
+                   latencyNs / 1e6);
+            if (config->maxQueuedBuffers && count > config->maxQueuedBuffers)
+            {
+                printf("Queue capped at %u of %u buffers\n", config->maxQueuedBuffers, count);
+                count = config->maxQueuedBuffers;
+            }
+        }
+        if (buffer_queue_create(&camera->queue, camera->camHandle, count))
+        {
+            printf("Failed to create queued stream.\n");
+            return -1;
+        }
+        camera->streamHandle = camera->queue.streamHandle;
+        frame_ring_init(&camera->ring, buffer_queue_requeue, &camera->queue);
+    }
+    else
+    {
+        frame_ring_init(&camera->ring, NULL, NULL);
+        // let KYFGLib allocate acquisition buffers
+        if (FGSTATUS_OK != KYFG_StreamCreateAndAlloc(camera->camHandle, &camera->streamHandle, config->autoCycleBuffers, 0))
+        {
+            printf("Failed to allocate buffer.\n");
+            camera->streamHandle = INVALID_STREAMHANDLE;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// frames point into the file mapping, or into decoded buffers of a compressed sequence that go back to the replay
+// like zero-copy PBOs, through the ring and acq_camera_release
+static int replay_start_stream(acq_camera_t *camera, const acq_config_t *config)
+{
+    camera->mode = ACQ_MODE_AUTO_CYCLE;
+    frame_ring_init(&camera->ring, replay_release, &camera->replay);
+    frame_loss_init(&camera->loss, 0, camera->fps, -1);
+    camera->started = replay_start(&camera->replay, &config->replay, deliver_frame, camera) == 0;
+    printf("Replay camera #%d: %s\n", camera->cameraIndex, camera->started ? "started" : "failed to start");
+    return camera->started ? 0 : -1;
+}
+
+static int camera_start_stream(acq_camera_t *camera, const acq_config_t *config, const acq_geometry_t *geometry)
+{
+    int ret;
+
+    if (acq_camera_is_replay(camera))
+        return replay_start_stream(camera, config);
+
+    printf("Grabber #%d camera #%d:\n", camera->grabberIndex, camera->cameraIndex);
+    camera_write_geometry(camera, geometry);
+    if (camera_create_stream(camera, config))
+        return -1;
+
+    frame_loss_init(&camera->loss, config->mode == ACQ_MODE_AUTO_CYCLE ? config->autoCycleBuffers : 0, camera->fps,
+                    read_rx_frame_counter(camera));
+    ret = KYFG_StreamBufferCallbackRegister(camera->streamHandle, stream_callback, camera);
+    printf("KYFG_StreamBufferCallbackRegister - %x\n", ret);
+
+    ret = camera_start(camera->camHandle, camera->streamHandle, 0);
+    printf("KYFG_CameraStart - %x\n", ret);
+    camera->started = FGSTATUS_OK == ret;
+    return camera->started ? 0 : -1;
+}
+
+// after camera_stop every callback has run
+static void camera_delete_stream(acq_camera_t *camera)
+{
+    if (camera->mode == ACQ_MODE_ZERO_COPY)
+        zero_copy_destroy(&camera->zeroCopy);
+    else if (camera->mode == ACQ_MODE_QUEUED)
+    {
+        buffer_queue_print_stats(&camera->queue, camera->fps);
+        if (camera->queue.releases)
+            camera->measuredHoldNs = buffer_queue_hold_percentile(&camera->queue, 0.99);
+        buffer_queue_destroy(&camera->queue);
+    }
+    else
+        KYFG_StreamDelete(camera->streamHandle);
+    camera->streamHandle = INVALID_STREAMHANDLE;
+    camera->started = 0;
+}
+
+int acq_engine_start(acq_engine_t *engine, const acq_config_t *config)
+{
+    int started = 0;
+
+    engine->config = *config;
+    engine->lossSampleNs = (uint64_t)(config->lossSampleSeconds * 1e9);
+    engine->lastLossSampleNs = frame_clock_ns();
+    for (int i = 0; i < engine->cameraCount; i++)
+        started += camera_start_stream(&engine->cameras[i], config, &config->geometry) == 0;
+    return started;
+}
+
+int acq_camera_set_geometry(acq_engine_t *engine, acq_camera_t *camera, const acq_geometry_t *geometry)
+{
+    if (acq_camera_is_replay(camera))
+    {
+        printf("Replay camera #%d keeps the recorded %ldx%ld.\n", camera->cameraIndex, (long)camera->width,
+               (long)camera->height);
+        return camera->started ? 0 : -1;
+    }
+    if (camera->streamHandle != INVALID_STREAMHANDLE)
+    {
+        if (camera->started)
+        {
+            int ret = camera_stop(camera->camHandle);
+            printf("\nGrabber #%d camera #%d KYFG_CameraStop - %x\n", camera->grabberIndex, camera->cameraIndex, ret);
+            frame_loss_sample(&camera->loss, &camera->ring, read_rx_frame_counter(camera));
+            frame_loss_print(&camera->loss, &camera->ring);
+        }
+        camera_delete_stream(camera);
+    }
+    engine->config.geometry = *geometry;
+    return camera_start_stream(camera, &engine->config, geometry);
+}
+
+int acq_camera_pop_latest(acq_camera_t *camera, frame_desc_t *frame)
+{
+    if (!camera->started)
+        return 0;
+    return frame_ring_pop_latest(&camera->ring, frame);
+}
+
+void acq_camera_release(acq_camera_t *camera, const frame_desc_t *frame)
+{
+    if (acq_camera_is_replay(camera))
+        replay_release(frame, &camera->replay);
+    else if (camera->mode == ACQ_MODE_QUEUED)
+        buffer_queue_release(&camera->queue, frame);
+}
+
+void acq_engine_recycle(acq_engine_t *engine)
+{
+    for (int i = 0; i < engine->cameraCount; i++)
+        if (engine->cameras[i].started && engine->cameras[i].mode == ACQ_MODE_ZERO_COPY)
+            zero_copy_recycle(&engine->cameras[i].zeroCopy);
+}
+
+void acq_engine_poll(acq_engine_t *engine)
+{
+    uint64_t now = frame_clock_ns();
+    if (!engine->lossSampleNs || now - engine->lastLossSampleNs < engine->lossSampleNs)
+        return;
+    engine->lastLossSampleNs = now;
+    for (int i = 0; i < engine->cameraCount; i++)
+    {
+        acq_camera_t *camera = &engine->cameras[i];
+        if (!camera->started || acq_camera_is_replay(camera))
+            continue;
+        frame_loss_sample(&camera->loss, &camera->ring, read_rx_frame_counter(camera));
+        if (frame_loss_changed(&camera->loss, &camera->ring))
+        {
+            printf("\nGrabber #%d camera #%d is losing frames:\n", camera->grabberIndex, camera->cameraIndex);
+            frame_loss_print(&camera->loss, &camera->ring);
+        }
+    }
+}
+
+void acq_engine_stop(acq_engine_t *engine)
+{
+    int ret;
+
+    // stop everything first so no callback is still pushing while the streams go away
+    for (int i = 0; i < engine->cameraCount; i++)
+    {
+        acq_camera_t *camera = &engine->cameras[i];
+        if (!camera->started)
+            continue;
+        if (acq_camera_is_replay(camera))
+        {
+            replay_stop(&camera->replay);
+            printf("\nReplay camera #%d:\n", camera->cameraIndex);
+            replay_print_stats(&camera->replay);
+            frame_loss_print(&camera->loss, &camera->ring);
+            camera->started = 0;
+            continue;
+        }
+        ret = camera_stop(camera->camHandle);
+        printf("\nGrabber #%d camera #%d KYFG_CameraStop - %x\n", camera->grabberIndex, camera->cameraIndex, ret);
+        // every callback has run now, so the balance is exact
+        frame_loss_sample(&camera->loss, &camera->ring, read_rx_frame_counter(camera));
+    }
+    for (int i = 0; i < engine->cameraCount; i++)
+    {
+        acq_camera_t *camera = &engine->cameras[i];
+        if (camera->streamHandle == INVALID_STREAMHANDLE)
+            continue;
+        if (camera->started)
+        {
+            printf("\nGrabber #%d camera #%d:\n", camera->grabberIndex, camera->cameraIndex);
+            frame_loss_print(&camera->loss, &camera->ring);
+        }
+        camera_delete_stream(camera);
+    }
+}
+
+void acq_engine_close(acq_engine_t *engine)
+{
+    for (int g = 0; g < ACQ_MAX_GRABBERS; g++)
+    {
+        if (INVALID_FGHANDLE == engine->grabbers[g])
+            continue;
+        if (FGSTATUS_OK != KYFG_Close(engine->grabbers[g])) // Close the selected device and unregisters all associated routines
+            printf("wasn't able to close grabber #%d\n", g);
+        else
+            printf("Grabber #%d Closed!\n", g);
+        engine->grabbers[g] = INVALID_FGHANDLE;
+    }
+    for (int i = 0; i < engine->cameraCount; i++)
+        if (acq_camera_is_replay(&engine->cameras[i]))
+            replay_close(&engine->cameras[i].replay);
+    free(engine->cameras);
+    engine->cameras = NULL;
+    engine->cameraCount = 0;
+}
@@ -0,0 +1,49 @@
+#include "myCode/auto_exposure.h"
+#include <math.h>
+
+static double clamp(double v, double lo, double hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+void auto_exposure_init(auto_exposure_t *ae, const auto_exposure_config_t *config, double exposureUs, double gain)
+{
+    ae->config = *config;
+    ae->exposureUs = clamp(exposureUs, config->minExposureUs, config->maxExposureUs);
+    ae->gain = clamp(gain, config->minGain, config->maxGain);
+    ae->lastUpdateNs = 0;
+    ae->updates = 0;
+}
+
+int auto_exposure_due(const auto_exposure_t *ae, uint64_t nowNs)
+{
+    return nowNs - ae->lastUpdateNs >= (uint64_t)(1e9 / ae->config.updatesPerSecond);
+}
+
+int auto_exposure_update(auto_exposure_t *ae, const frame_stats_t *stats, uint64_t nowNs)
+{
+    const auto_exposure_config_t *config = &ae->config;
+    if (!auto_exposure_due(ae, nowNs))
+        return 0;
+    ae->lastUpdateNs = nowNs;
+
+    double clipped = fmax(stats->clippedFraction[0], fmax(stats->clippedFraction[1], stats->clippedFraction[2]));
+    double signal = fmax(stats->mean[1] - config->blackLevel, 1.0);
+    double ratio = (config->targetMean - config->blackLevel) / signal;
+    if (clipped > config->maxClippedFraction)
+        ratio = fmin(ratio, 1.0 / config->maxStep); // highlights win over the mean
+    else if (fabs(ratio - 1.0) <= config->tolerance)
+        return 0;
+    ratio = clamp(ratio, 1.0 / config->maxStep, config->maxStep);
+
+    double total = clamp(ae->exposureUs * ae->gain * ratio, config->minExposureUs * config->minGain,
+                         config->maxExposureUs * config->maxGain);
+    double exposureUs = clamp(total / config->minGain, config->minExposureUs, config->maxExposureUs);
+    double gain = clamp(total / exposureUs, config->minGain, config->maxGain);
+    if (fabs(exposureUs - ae->exposureUs) < 1.0 && fabs(gain - ae->gain) < 0.01)
+        return 0; // at a limit
+    ae->exposureUs = exposureUs;
+    ae->gain = gain;
+    ae->updates++;
+    return 1;
+}
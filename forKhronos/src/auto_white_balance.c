@@ -0,0 +1,169 @@
+#include "myCode/auto_white_balance.h"
+#include "myCode/frame_clock.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// channel means of the samples the method trusts, above the black level and relative to green; returns 0 if too
+// few samples are left
+static int estimate(const awb_t *awb, double means[3])
+{
+    const awb_config_t *config = &awb->config;
+    uint32_t brightness[3 * 256] = {0};
+    double gray[3] = {0, 0, 0}, white[3] = {0, 0, 0};
+    int grayCount = 0, whiteCount = 0;
+
+    // gray world, and a histogram of r + g + b for the white patch threshold
+    for (int i = 0; i < awb->sampleCount; i++)
+    {
+        const uint8_t *s = awb->samples + i * 3;
+        if (s[0] >= config->clipLevel || s[1] >= config->clipLevel || s[2] >= config->clipLevel)
+            continue;
+        for (int c = 0; c < 3; c++)
+            gray[c] += s[c];
+        grayCount++;
+        brightness[s[0] + s[1] + s[2]]++;
+    }
+    if (grayCount < 16)
+        return 0;
+
+    uint32_t wanted = (uint32_t)(grayCount * config->whitePatchFraction) + 1, seen = 0;
+    int threshold = 3 * 255;
+    while (threshold > 0 && seen + brightness[threshold] < wanted)
+        seen += brightness[threshold--];
+    for (int i = 0; i < awb->sampleCount; i++)
+    {
+        const uint8_t *s = awb->samples + i * 3;
+        if (s[0] >= config->clipLevel || s[1] >= config->clipLevel || s[2] >= config->clipLevel || s[0] + s[1] + s[2] < threshold)
+            continue;
+        for (int c = 0; c < 3; c++)
+            white[c] += s[c];
+        whiteCount++;
+    }
+
+    double grayMean[3], whiteMean[3];
+    for (int c = 0; c < 3; c++)
+    {
+        grayMean[c] = fmax(gray[c] / grayCount - config->blackLevel, 1.0);
+        whiteMean[c] = fmax(white[c] / whiteCount - config->blackLevel, 1.0);
+    }
+    // relative to green
+    for (int c = 0; c < 3; c++)
+    {
+        double g = grayMean[c] / grayMean[1], w = whiteMean[c] / whiteMean[1];
+        means[c] = config->method == AWB_GRAY_WORLD ? g : (config->method == AWB_WHITE_PATCH ? w : 0.5 * (g + w));
+    }
+    return 1;
+}
+
+static void update_gains(awb_t *awb)
+{
+    const awb_config_t *config = &awb->config;
+    double means[3];
+    if (!estimate(awb, means))
+        return;
+
+    // first order filter in the log domain, so raising and lowering a gain take equally long; the first estimate is
+    // taken as is
+    double dt = awb->lastEstimateNs ? (awb->sampledNs - awb->lastEstimateNs) / 1e9 : 1e9;
+    double alpha = 1.0 - exp(-dt / config->smoothingSeconds);
+    awb->lastEstimateNs = awb->sampledNs;
+    for (int c = 0; c < 3; c += 2)
+    {
+        double target = means[1] / means[c];
+        target = target < config->minGain ? config->minGain : (target > config->maxGain ? config->maxGain : target);
+        awb->gains[c] = (float)(awb->gains[c] * pow(target / awb->gains[c], alpha));
+    }
+    awb->gains[1] = 1.0f;
+    color_gl_set_gains(awb->color, awb->gains);
+    awb->estimates++;
+}
+
+static void *awb_thread(void *arg)
+{
+    awb_t *awb = (awb_t *)arg;
+    for (;;)
+    {
+        sem_wait(&awb->wake);
+        if (atomic_load(&awb->quit))
+            break;
+        update_gains(awb);
+        atomic_store_explicit(&awb->busy, 0, memory_order_release);
+    }
+    return NULL;
+}
+
+int awb_start(awb_t *awb, const awb_config_t *config, color_gl_t *color, const float gains[3], int maxWidth, int maxHeight)
+{
+    awb->config = *config;
+    if (awb->config.decimation < 1)
+        awb->config.decimation = 1;
+    awb->color = color;
+    awb->capacity = (maxWidth / 2 / awb->config.decimation + 1) * (maxHeight / 2 / awb->config.decimation + 1);
+    awb->samples = malloc((size_t)awb->capacity * 3);
+    awb->sampleCount = 0;
+    awb->lastSubmitNs = 0;
+    awb->lastEstimateNs = 0;
+    awb->estimates = 0;
+    for (int c = 0; c < 3; c++)
+        awb->gains[c] = gains[c] > 0.0f ? gains[c] / gains[1] : 1.0f;
+    atomic_init(&awb->quit, 0);
+    atomic_init(&awb->busy, 0);
+    sem_init(&awb->wake, 0, 0);
+    awb->started = awb->samples && pthread_create(&awb->thread, NULL, awb_thread, awb) == 0;
+    if (!awb->started)
+    {
+        printf("Failed to start the white balance thread.\n");
+        return -1;
+    }
+    return 0;
+}
+
+int awb_submit(awb_t *awb, const uint8_t *src, size_t stride, int width, int height, int channels,
+               bayer_pattern_t pattern, uint64_t nowNs)
+{
+    if (!awb->started || nowNs - awb->lastSubmitNs < (uint64_t)(1e9 / awb->config.updatesPerSecond) ||
+        atomic_load_explicit(&awb->busy, memory_order_acquire))
+        return 0;
+    awb->lastSubmitNs = nowNs;
+
+    int step = 2 * awb->config.decimation, count = 0;
+    int redX = bayer_red_x(pattern), redY = bayer_red_y(pattern);
+    for (int y = 0; y + 1 < height && count < awb->capacity; y += step)
+    {
+        const uint8_t *rows[2] = {src + y * stride, src + (y + 1) * stride};
+        for (int x = 0; x + 1 < width && count < awb->capacity; x += step)
+        {
+            uint8_t *sample = awb->samples + count++ * 3;
+            if (channels > 1)
+            {
+                for (int c = 0; c < 3; c++)
+                    sample[c] = rows[0][x * channels + c];
+                continue;
+            }
+            // one 2x2 cell: red, the mean of both greens, blue
+            sample[0] = rows[redY][x + redX];
+            sample[1] = (uint8_t)((rows[redY][x + 1 - redX] + rows[1 - redY][x + redX] + 1) >> 1);
+            sample[2] = rows[1 - redY][x + 1 - redX];
+        }
+    }
+    awb->sampleCount = count;
+    awb->sampledNs = nowNs;
+    atomic_store_explicit(&awb->busy, 1, memory_order_release);
+    sem_post(&awb->wake);
+    return 1;
+}
+
+void awb_stop(awb_t *awb)
+{
+    if (awb->started)
+    {
+        atomic_store(&awb->quit, 1);
+        sem_post(&awb->wake);
+        pthread_join(awb->thread, NULL);
+        sem_destroy(&awb->wake);
+        awb->started = 0;
+    }
+    free(awb->samples);
+    awb->samples = NULL;
+}
@@ -0,0 +1,115 @@
+#include "myCode/buffer_queue.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BUFFER_QUEUE_MIN_COUNT 3
+
+uint32_t buffer_queue_count_for_latency(double fps, uint64_t consumerLatencyNs)
+{
+    uint32_t count = (uint32_t)ceil(fps * (double)consumerLatencyNs / 1e9) + 2;
+    return count < BUFFER_QUEUE_MIN_COUNT ? BUFFER_QUEUE_MIN_COUNT : count;
+}
+
+uint64_t buffer_queue_hold_percentile(const buffer_queue_t *queue, double fraction)
+{
+    uint64_t rank = (uint64_t)ceil(fraction * (double)queue->releases), seen = 0;
+    if (!queue->releases)
+        return 0;
+    for (int i = 0; i < BUFFER_QUEUE_HOLD_BUCKETS - 1; i++)
+    {
+        seen += queue->holdBuckets[i];
+        if (seen >= rank)
+            return (uint64_t)(i + 1) * 1000000ull;
+    }
+    // past the histogram, the longest hold is the closest bound
+    return queue->holdMaxNs;
+}
+
+int buffer_queue_create(buffer_queue_t *queue, CAMHANDLE camHandle, uint32_t count)
+{
+    int ret;
+
+    queue->buffers = NULL;
+    queue->count = 0;
+    queue->size = 0;
+    queue->holdMaxNs = 0;
+    queue->holdAvgNs = 0.0;
+    queue->releases = 0;
+    memset(queue->holdBuckets, 0, sizeof(queue->holdBuckets));
+    atomic_init(&queue->requeueFailures, 0);
+    queue->streamHandle = INVALID_STREAMHANDLE;
+    if (FGSTATUS_OK != (ret = KYFG_StreamCreate(camHandle, &queue->streamHandle, 0)))
+    {
+        printf("KYFG_StreamCreate - %x\n", ret);
+        return -1;
+    }
+    ret = KYFG_StreamGetInfo(queue->streamHandle, KY_STREAM_INFO_PAYLOAD_SIZE, &queue->size, NULL, NULL);
+    if (FGSTATUS_OK != ret || queue->size == 0)
+    {
+        printf("KYFG_StreamGetInfo(KY_STREAM_INFO_PAYLOAD_SIZE) - %x, %lu bytes\n", ret, (unsigned long)queue->size);
+        buffer_queue_destroy(queue);
+        return -1;
+    }
+
+    queue->buffers = calloc(count, sizeof(STREAM_BUFFER_HANDLE));
+    for (uint32_t i = 0; i < count; i++)
+    {
+        ret = KYFG_BufferAllocAndAnnounce(queue->streamHandle, queue->size, NULL, &queue->buffers[i]);
+        if (FGSTATUS_OK != ret)
+        {
+            printf("KYFG_BufferAllocAndAnnounce - %x\n", ret);
+            buffer_queue_destroy(queue);
+            return -1;
+        }
+        queue->count++;
+    }
+
+    ret = KYFG_BufferQueueAll(queue->streamHandle, KY_ACQ_QUEUE_UNQUEUED, KY_ACQ_QUEUE_INPUT);
+    printf("KYFG_BufferQueueAll - %x\n", ret);
+    printf("Queued stream: %u buffers of %lu bytes (%.1f MB)\n", queue->count, (unsigned long)queue->size,
+           queue->count * (double)queue->size / (1024.0 * 1024.0));
+    return FGSTATUS_OK == ret ? 0 : -1;
+}
+
+void buffer_queue_release(buffer_queue_t *queue, const frame_desc_t *frame)
+{
+    uint64_t held = frame_clock_ns() - frame->receivedNs;
+    if (held > queue->holdMaxNs)
+        queue->holdMaxNs = held;
+    // slow moving average, the max covers the spikes
+    queue->holdAvgNs = queue->releases ? queue->holdAvgNs + ((double)held - queue->holdAvgNs) / 64.0 : (double)held;
+    uint64_t bucket = held / 1000000ull;
+    queue->holdBuckets[bucket < BUFFER_QUEUE_HOLD_BUCKETS ? bucket : BUFFER_QUEUE_HOLD_BUCKETS - 1]++;
+    queue->releases++;
+    buffer_queue_requeue(frame, queue);
+}
+
+void buffer_queue_requeue(const frame_desc_t *frame, void *context)
+{
+    buffer_queue_t *queue = (buffer_queue_t *)context;
+    if (FGSTATUS_OK != KYFG_BufferToQueue(frame->bufferHandle, KY_ACQ_QUEUE_INPUT))
+        atomic_fetch_add_explicit(&queue->requeueFailures, 1, memory_order_relaxed);
+}
+
+void buffer_queue_print_stats(buffer_queue_t *queue, double fps)
+{
+    uint64_t holdP99Ns = buffer_queue_hold_percentile(queue, 0.99);
+    printf("Consumer hold time: avg %.2f ms, p99 %.0f ms, max %.2f ms over %lu frames, requeue failures: %lu\n",
+           queue->holdAvgNs / 1e6, holdP99Ns / 1e6, queue->holdMaxNs / 1e6, (unsigned long)queue->releases,
+           (unsigned long)atomic_load(&queue->requeueFailures));
+    printf("Buffers in use: %u, recommended at %.1f fps: %u\n", queue->count, fps,
+           buffer_queue_count_for_latency(fps, holdP99Ns));
+}
+
+void buffer_queue_destroy(buffer_queue_t *queue)
+{
+    // KYFGLib frees buffers it allocated together with the stream
+    if (queue->streamHandle != INVALID_STREAMHANDLE)
+        KYFG_StreamDelete(queue->streamHandle);
+    free(queue->buffers);
+    queue->buffers = NULL;
+    queue->count = 0;
+    queue->streamHandle = INVALID_STREAMHANDLE;
+}
@@ -0,0 +1,116 @@
+#include "myCode/color_gl.h"
+#include <stdint.h>
+#include <stdio.h>
+
+static void pack_block(const color_params_t *params, color_gl_block_t *block)
+{
+    float black = params->blackLevel / 255.0f;
+    if (black > 0.99f)
+        black = 0.99f;
+    // (c - black) / (1 - black) * gain, per input channel
+    for (int r = 0; r < 3; r++)
+    {
+        for (int c = 0; c < 3; c++)
+            block->ccm[r][c] = params->ccm[r][c] * params->gains[c] / (1.0f - black);
+        block->ccm[r][3] = params->ccm[r][3];
+    }
+    // texel centres, so 0 and 1 hit the first and the last entry
+    block->tone[0] = black;
+    block->tone[1] = (COLOR_LUT_SIZE - 1) / (float)COLOR_LUT_SIZE;
+    block->tone[2] = 0.5f / COLOR_LUT_SIZE;
+    block->tone[3] = 0.0f;
+}
+
+static void upload_lut(color_gl_t *color, const color_params_t *params)
+{
+    static uint16_t curve[COLOR_LUT_SIZE];
+    for (int i = 0; i < COLOR_LUT_SIZE; i++)
+        curve[i] = (uint16_t)(color_curve(params, i / (float)(COLOR_LUT_SIZE - 1)) * 65535.0f + 0.5f);
+    glActiveTexture(GL_TEXTURE0 + COLOR_GL_LUT_UNIT);
+    glBindTexture(GL_TEXTURE_1D, color->lut);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_R16, COLOR_LUT_SIZE, 0, GL_RED, GL_UNSIGNED_SHORT, curve);
+    glActiveTexture(GL_TEXTURE0);
+    color->lutGamma = params->gamma;
+}
+
+int color_gl_create(color_gl_t *color, GLuint program, GLuint binding, const color_params_t *params)
+{
+    GLuint index = glGetUniformBlockIndex(program, "ColorCorrection");
+    if (index == GL_INVALID_INDEX)
+    {
+        printf("Program %u has no ColorCorrection uniform block.\n", program);
+        return -1;
+    }
+    color_gl_block_t block;
+    pack_block(params, &block);
+    color->binding = binding;
+    color->pending = *params;
+    atomic_init(&color->dirty, 0);
+    pthread_mutex_init(&color->lock, NULL);
+    generate_buffers(1, &color->ubo);
+    bind_buffer_set_data(GL_UNIFORM_BUFFER, color->ubo, sizeof(block), &block, GL_DYNAMIC_DRAW);
+    glUniformBlockBinding(program, index, binding);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, color->ubo);
+
+    glGenTextures(1, &color->lut);
+    glActiveTexture(GL_TEXTURE0 + COLOR_GL_LUT_UNIT);
+    glBindTexture(GL_TEXTURE_1D, color->lut);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAX_LEVEL, 0);
+    upload_lut(color, params);
+    glUniform1i(get_uniform_location(program, "toneCurve"), COLOR_GL_LUT_UNIT);
+    return 0;
+}
+
+void color_gl_set(color_gl_t *color, const color_params_t *params)
+{
+    pthread_mutex_lock(&color->lock);
+    color->pending = *params;
+    pthread_mutex_unlock(&color->lock);
+    atomic_store_explicit(&color->dirty, 1, memory_order_release);
+}
+
+void color_gl_set_gains(color_gl_t *color, const float gains[3])
+{
+    pthread_mutex_lock(&color->lock);
+    for (int c = 0; c < 3; c++)
+        color->pending.gains[c] = gains[c];
+    pthread_mutex_unlock(&color->lock);
+    atomic_store_explicit(&color->dirty, 1, memory_order_release);
+}
+
+void color_gl_get(color_gl_t *color, color_params_t *params)
+{
+    pthread_mutex_lock(&color->lock);
+    *params = color->pending;
+    pthread_mutex_unlock(&color->lock);
+}
+
+void color_gl_apply(color_gl_t *color)
+{
+    if (!atomic_load_explicit(&color->dirty, memory_order_acquire) || pthread_mutex_trylock(&color->lock))
+        return;
+    atomic_store_explicit(&color->dirty, 0, memory_order_relaxed);
+    color_params_t params = color->pending;
+    pthread_mutex_unlock(&color->lock);
+    color_gl_block_t block;
+    pack_block(&params, &block);
+    bind_buffer(GL_UNIFORM_BUFFER, color->ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+    bind_buffer(GL_UNIFORM_BUFFER, 0);
+    if (params.gamma != color->lutGamma)
+        upload_lut(color, &params);
+}
+
+void color_gl_destroy(color_gl_t *color)
+{
+    if (color->ubo)
+        delete_buffers(1, &color->ubo);
+    if (color->lut)
+        glDeleteTextures(1, &color->lut);
+    color->ubo = 0;
+    color->lut = 0;
+    pthread_mutex_destroy(&color->lock);
+}
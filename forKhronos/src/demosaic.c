@@ -0,0 +1,446 @@
+#include "myCode/demosaic.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DEMOSAIC_X86 1
+#endif
+
+// mirrored border, keeps the colour of the mirrored pixel (same as the fragment shader)
+static inline int mirror(int v, int n)
+{
+    v = v < 0 ? -v : v;
+    return v > n - 1 ? 2 * (n - 1) - v : v;
+}
+
+// source row pointers of one output row
+typedef struct demosaic_rows_t
+{
+    const uint8_t *up, *cur, *down;
+    int rowBlue; // the row holds blue and green instead of red and green
+} demosaic_rows_t;
+
+static demosaic_rows_t rows_for(const demosaic_frame_t *frame, int y)
+{
+    demosaic_rows_t rows;
+    rows.up = frame->src + mirror(y - 1, frame->height) * frame->srcStride;
+    rows.cur = frame->src + y * frame->srcStride;
+    rows.down = frame->src + mirror(y + 1, frame->height) * frame->srcStride;
+    rows.rowBlue = (y + bayer_red_y(frame->pattern)) & 1;
+    return rows;
+}
+
+static inline void put_pixel(uint8_t *out, int channels, int r, int g, int b)
+{
+    out[0] = (uint8_t)r;
+    out[1] = (uint8_t)g;
+    out[2] = (uint8_t)b;
+    if (channels == 4)
+        out[3] = 255;
+}
+
+// lookup table index of output channel o, r g b with the black level already subtracted
+static inline int color_index(const demosaic_color_t *color, int o, int r, int g, int b)
+{
+    int v = (color->coef[o][0] * r + color->coef[o][1] * g + color->coef[o][2] * b + color->offset[o]) >> DEMOSAIC_COEF_BITS;
+    return v < 0 ? 0 : (v > COLOR_LUT_SIZE - 1 ? COLOR_LUT_SIZE - 1 : v);
+}
+
+static inline void put_pixel_color(uint8_t *out, int channels, int r, int g, int b, const demosaic_color_t *color)
+{
+    if (!color)
+    {
+        put_pixel(out, channels, r, g, b);
+        return;
+    }
+    r = r > color->black ? r - color->black : 0;
+    g = g > color->black ? g - color->black : 0;
+    b = b > color->black ? b - color->black : 0;
+    put_pixel(out, channels, color->lut[color_index(color, 0, r, g, b)], color->lut[color_index(color, 1, r, g, b)],
+              color->lut[color_index(color, 2, r, g, b)]);
+}
+
+// the row kernels are always inlined into a plain and a fused caller, so neither pays for the other's branch
+#define DEMOSAIC_INLINE static inline __attribute__((always_inline))
+
+DEMOSAIC_INLINE void row_scalar(const demosaic_frame_t *frame, const demosaic_color_t *color, const demosaic_rows_t *rows, int x0, int x1, uint8_t *dst)
+{
+    int width = frame->width, redX = bayer_red_x(frame->pattern);
+    for (int x = x0; x < x1; x++)
+    {
+        int xl = mirror(x - 1, width), xr = mirror(x + 1, width);
+        int c = rows->cur[x];
+        int h2 = (rows->cur[xl] + rows->cur[xr] + 1) >> 1;
+        int v2 = (rows->up[x] + rows->down[x] + 1) >> 1;
+        int own, other, g;
+        // red on a red row, blue on a blue row
+        if (((x + redX + rows->rowBlue) & 1) == 0)
+        {
+            own = c;
+            g = (rows->cur[xl] + rows->cur[xr] + rows->up[x] + rows->down[x] + 2) >> 2;
+            other = (rows->up[xl] + rows->up[xr] + rows->down[xl] + rows->down[xr] + 2) >> 2;
+        }
+        else
+        {
+            own = h2;
+            g = c;
+            other = v2;
+        }
+        if (rows->rowBlue)
+            put_pixel_color(dst + x * frame->channels, frame->channels, other, g, own, color);
+        else
+            put_pixel_color(dst + x * frame->channels, frame->channels, own, g, other, color);
+    }
+}
+
+#ifdef DEMOSAIC_X86
+// byte shuffles interleaving 16 R, G and B values into 48 bytes of RGB8
+static const int8_t rgbShuffle[3][3][16] = {
+    {{0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5},
+     {-1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1},
+     {-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1}},
+    {{-1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1},
+     {5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10},
+     {-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1}},
+    {{-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1},
+     {-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1},
+     {10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15}}};
+
+__attribute__((target("sse4.1"))) static inline void store_sse41(uint8_t *out, int channels, __m128i r, __m128i g, __m128i b)
+{
+    if (channels == 4)
+    {
+        __m128i a = _mm_set1_epi8(-1);
+        __m128i rgLo = _mm_unpacklo_epi8(r, g), rgHi = _mm_unpackhi_epi8(r, g);
+        __m128i baLo = _mm_unpacklo_epi8(b, a), baHi = _mm_unpackhi_epi8(b, a);
+        _mm_storeu_si128((__m128i *)out, _mm_unpacklo_epi16(rgLo, baLo));
+        _mm_storeu_si128((__m128i *)(out + 16), _mm_unpackhi_epi16(rgLo, baLo));
+        _mm_storeu_si128((__m128i *)(out + 32), _mm_unpacklo_epi16(rgHi, baHi));
+        _mm_storeu_si128((__m128i *)(out + 48), _mm_unpackhi_epi16(rgHi, baHi));
+        return;
+    }
+    for (int k = 0; k < 3; k++)
+    {
+        __m128i v = _mm_or_si128(_mm_shuffle_epi8(r, _mm_loadu_si128((const __m128i *)rgbShuffle[k][0])),
+                                 _mm_or_si128(_mm_shuffle_epi8(g, _mm_loadu_si128((const __m128i *)rgbShuffle[k][1])),
+                                              _mm_shuffle_epi8(b, _mm_loadu_si128((const __m128i *)rgbShuffle[k][2]))));
+        _mm_storeu_si128((__m128i *)(out + 16 * k), v);
+    }
+}
+
+// (a + b + c + d + 2) >> 2 exactly, in 16 bit lanes
+__attribute__((target("sse4.1"))) static inline __m128i avg4_sse41(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+    __m128i zero = _mm_setzero_si128(), two = _mm_set1_epi16(2);
+    __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)),
+                               _mm_add_epi16(_mm_unpacklo_epi8(c, zero), _mm_unpacklo_epi8(d, zero)));
+    __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)),
+                               _mm_add_epi16(_mm_unpackhi_epi8(c, zero), _mm_unpackhi_epi8(d, zero)));
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+    return _mm_packus_epi16(lo, hi);
+}
+
+// lookup table indices of output channel o for 8 pixels, r g b in 16 bit lanes
+__attribute__((target("sse4.1"))) static inline void color_index_sse41(const demosaic_color_t *color, int o, __m128i r, __m128i g, __m128i b, uint16_t *index)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i rg = _mm_set1_epi32((int)(((uint32_t)(uint16_t)color->coef[o][1] << 16) | (uint16_t)color->coef[o][0]));
+    __m128i b0 = _mm_set1_epi32((uint16_t)color->coef[o][2]);
+    __m128i offset = _mm_set1_epi32(color->offset[o]);
+    __m128i lo = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(r, g), rg), _mm_madd_epi16(_mm_unpacklo_epi16(b, zero), b0)), offset);
+    __m128i hi = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(r, g), rg), _mm_madd_epi16(_mm_unpackhi_epi16(b, zero), b0)), offset);
+    __m128i v = _mm_packs_epi32(_mm_srai_epi32(lo, DEMOSAIC_COEF_BITS), _mm_srai_epi32(hi, DEMOSAIC_COEF_BITS));
+    v = _mm_min_epi16(_mm_max_epi16(v, zero), _mm_set1_epi16(COLOR_LUT_SIZE - 1));
+    _mm_storeu_si128((__m128i *)index, v);
+}
+
+// black level, gains and matrix in registers, then the tone curve lookups, for 16 demosaiced pixels
+__attribute__((target("sse4.1"))) static inline void store_color_sse41(uint8_t *out, int channels, __m128i r, __m128i g, __m128i b,
+                                                                      const demosaic_color_t *color)
+{
+    uint16_t index[3][16];
+    __m128i zero = _mm_setzero_si128(), black = _mm_set1_epi8((char)color->black);
+    r = _mm_subs_epu8(r, black);
+    g = _mm_subs_epu8(g, black);
+    b = _mm_subs_epu8(b, black);
+    for (int o = 0; o < 3; o++)
+    {
+        color_index_sse41(color, o, _mm_unpacklo_epi8(r, zero), _mm_unpacklo_epi8(g, zero), _mm_unpacklo_epi8(b, zero), index[o]);
+        color_index_sse41(color, o, _mm_unpackhi_epi8(r, zero), _mm_unpackhi_epi8(g, zero), _mm_unpackhi_epi8(b, zero), index[o] + 8);
+    }
+    for (int i = 0; i < 16; i++)
+        put_pixel(out + i * channels, channels, color->lut[index[0][i]], color->lut[index[1][i]], color->lut[index[2][i]]);
+}
+
+__attribute__((target("sse4.1"))) static inline void store_any_sse41(uint8_t *out, int channels, __m128i r, __m128i g, __m128i b,
+                                                                    const demosaic_color_t *color)
+{
+    if (color)
+        store_color_sse41(out, channels, r, g, b, color);
+    else
+        store_sse41(out, channels, r, g, b);
+}
+
+// returns the first column it did not process
+__attribute__((target("sse4.1"))) DEMOSAIC_INLINE int row_sse41(const demosaic_frame_t *frame, const demosaic_color_t *color, const demosaic_rows_t *rows, int x0, int x1, uint8_t *dst)
+{
+    // lanes holding red on a red row / blue on a blue row, for chunks starting on an even or an odd column
+    __m128i evenLanes = _mm_set1_epi16(0x00FF), oddLanes = _mm_set1_epi16((short)0xFF00);
+    int parity = bayer_red_x(frame->pattern) + rows->rowBlue;
+    const uint8_t *up = rows->up, *cur = rows->cur, *down = rows->down;
+    int x = x0;
+    for (; x + 16 <= x1; x += 16)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i *)(cur + x));
+        __m128i l = _mm_loadu_si128((const __m128i *)(cur + x - 1));
+        __m128i r = _mm_loadu_si128((const __m128i *)(cur + x + 1));
+        __m128i u = _mm_loadu_si128((const __m128i *)(up + x));
+        __m128i d = _mm_loadu_si128((const __m128i *)(down + x));
+        __m128i diagonal = avg4_sse41(_mm_loadu_si128((const __m128i *)(up + x - 1)), _mm_loadu_si128((const __m128i *)(up + x + 1)),
+                                      _mm_loadu_si128((const __m128i *)(down + x - 1)), _mm_loadu_si128((const __m128i *)(down + x + 1)));
+        __m128i cross = avg4_sse41(l, r, u, d);
+        __m128i mask = ((x + parity) & 1) ? oddLanes : evenLanes;
+        __m128i own = _mm_blendv_epi8(_mm_avg_epu8(l, r), c, mask);
+        __m128i other = _mm_blendv_epi8(_mm_avg_epu8(u, d), diagonal, mask);
+        __m128i g = _mm_blendv_epi8(c, cross, mask);
+        if (rows->rowBlue)
+            store_any_sse41(dst + x * frame->channels, frame->channels, other, g, own, color);
+        else
+            store_any_sse41(dst + x * frame->channels, frame->channels, own, g, other, color);
+    }
+    return x;
+}
+
+__attribute__((target("avx2"))) static inline __m256i avg4_avx2(__m256i a, __m256i b, __m256i c, __m256i d)
+{
+    // unpack and pack both work within 128 bit lanes, so the byte order comes back unchanged
+    __m256i zero = _mm256_setzero_si256(), two = _mm256_set1_epi16(2);
+    __m256i lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero)),
+                                  _mm256_add_epi16(_mm256_unpacklo_epi8(c, zero), _mm256_unpacklo_epi8(d, zero)));
+    __m256i hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero)),
+                                  _mm256_add_epi16(_mm256_unpackhi_epi8(c, zero), _mm256_unpackhi_epi8(d, zero)));
+    lo = _mm256_srli_epi16(_mm256_add_epi16(lo, two), 2);
+    hi = _mm256_srli_epi16(_mm256_add_epi16(hi, two), 2);
+    return _mm256_packus_epi16(lo, hi);
+}
+
+__attribute__((target("avx2"))) DEMOSAIC_INLINE int row_avx2(const demosaic_frame_t *frame, const demosaic_color_t *color, const demosaic_rows_t *rows, int x0, int x1, uint8_t *dst)
+{
+    __m256i evenLanes = _mm256_set1_epi16(0x00FF), oddLanes = _mm256_set1_epi16((short)0xFF00);
+    int parity = bayer_red_x(frame->pattern) + rows->rowBlue;
+    const uint8_t *up = rows->up, *cur = rows->cur, *down = rows->down;
+    int x = x0;
+    for (; x + 32 <= x1; x += 32)
+    {
+        __m256i c = _mm256_loadu_si256((const __m256i *)(cur + x));
+        __m256i l = _mm256_loadu_si256((const __m256i *)(cur + x - 1));
+        __m256i r = _mm256_loadu_si256((const __m256i *)(cur + x + 1));
+        __m256i u = _mm256_loadu_si256((const __m256i *)(up + x));
+        __m256i d = _mm256_loadu_si256((const __m256i *)(down + x));
+        __m256i diagonal = avg4_avx2(_mm256_loadu_si256((const __m256i *)(up + x - 1)), _mm256_loadu_si256((const __m256i *)(up + x + 1)),
+                                     _mm256_loadu_si256((const __m256i *)(down + x - 1)), _mm256_loadu_si256((const __m256i *)(down + x + 1)));
+        __m256i cross = avg4_avx2(l, r, u, d);
+        __m256i mask = ((x + parity) & 1) ? oddLanes : evenLanes;
+        __m256i own = _mm256_blendv_epi8(_mm256_avg_epu8(l, r), c, mask);
+        __m256i other = _mm256_blendv_epi8(_mm256_avg_epu8(u, d), diagonal, mask);
+        __m256i g = _mm256_blendv_epi8(c, cross, mask);
+        __m256i red = rows->rowBlue ? other : own, blue = rows->rowBlue ? own : other;
+        uint8_t *out = dst + x * frame->channels;
+        store_any_sse41(out, frame->channels, _mm256_castsi256_si128(red), _mm256_castsi256_si128(g), _mm256_castsi256_si128(blue), color);
+        store_any_sse41(out + 16 * frame->channels, frame->channels, _mm256_extracti128_si256(red, 1),
+                        _mm256_extracti128_si256(g, 1), _mm256_extracti128_si256(blue, 1), color);
+    }
+    return x;
+}
+#endif
+
+demosaic_isa_t demosaic_best_isa()
+{
+#ifdef DEMOSAIC_X86
+    if (__builtin_cpu_supports("avx2"))
+        return DEMOSAIC_ISA_AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return DEMOSAIC_ISA_SSE41;
+#endif
+    return DEMOSAIC_ISA_SCALAR;
+}
+
+const char *demosaic_isa_name(demosaic_isa_t isa)
+{
+    static const char *names[] = {"auto", "scalar", "sse4.1", "avx2"};
+    return names[isa];
+}
+
+// one row per instruction set, with and without the colour stage
+static void row_scalar_plain(const demosaic_frame_t *frame, const demosaic_rows_t *rows, int x0, int x1, uint8_t *dst)
+{
+    row_scalar(frame, NULL, rows, x0, x1, dst);
+}
+
+static void row_scalar_color(const demosaic_frame_t *frame, const demosaic_color_t *color, const demosaic_rows_t *rows, int x0, int x1, uint8_t *dst)
+{
+    row_scalar(frame, color, rows, x0, x1, dst);
+}
+
+#ifdef DEMOSAIC_X86
+__attribute__((target("sse4.1"))) static int row_sse41_plain(const demosaic_frame_t *frame, const demosaic_rows_t *rows, int x0, int x1, uint8_t *dst)
+{
+    return row_sse41(frame, NULL, rows, x0, x1, dst);
+}
+
+__attribute__((target("sse4.1"))) static int row_sse41_color(const demosaic_frame_t *frame, const demosaic_color_t *color, const demosaic_rows_t *rows, int x0, int x1, uint8_t *dst)
+{
+    return row_sse41(frame, color, rows, x0, x1, dst);
+}
+
+__attribute__((target("avx2"))) static int row_avx2_plain(const demosaic_frame_t *frame, const demosaic_rows_t *rows, int x0, int x1, uint8_t *dst)
+{
+    return row_avx2(frame, NULL, rows, x0, x1, dst);
+}
+
+__attribute__((target("avx2"))) static int row_avx2_color(const demosaic_frame_t *frame, const demosaic_color_t *color, const demosaic_rows_t *rows, int x0, int x1, uint8_t *dst)
+{
+    return row_avx2(frame, color, rows, x0, x1, dst);
+}
+#endif
+
+static void demosaic_rows(const demosaic_frame_t *frame, const demosaic_color_t *color, demosaic_isa_t isa, int rowBegin, int rowEnd)
+{
+    if (isa == DEMOSAIC_ISA_AUTO)
+        isa = demosaic_best_isa();
+    for (int y = rowBegin; y < rowEnd; y++)
+    {
+        demosaic_rows_t rows = rows_for(frame, y);
+        uint8_t *dst = frame->dst + y * frame->dstStride;
+        // the vector loop needs both horizontal neighbours inside the row, the first and last columns are mirrored
+        int x = 1, simdEnd = frame->width - 1;
+#ifdef DEMOSAIC_X86
+        if (isa == DEMOSAIC_ISA_AVX2)
+            x = color ? row_avx2_color(frame, color, &rows, x, simdEnd, dst) : row_avx2_plain(frame, &rows, x, simdEnd, dst);
+        if (isa >= DEMOSAIC_ISA_SSE41)
+            x = color ? row_sse41_color(frame, color, &rows, x, simdEnd, dst) : row_sse41_plain(frame, &rows, x, simdEnd, dst);
+#endif
+        if (color)
+        {
+            row_scalar_color(frame, color, &rows, 0, 1, dst);
+            row_scalar_color(frame, color, &rows, x, frame->width, dst);
+        }
+        else
+        {
+            row_scalar_plain(frame, &rows, 0, 1, dst);
+            row_scalar_plain(frame, &rows, x, frame->width, dst);
+        }
+    }
+}
+
+void demosaic_bilinear_rows(const demosaic_frame_t *frame, demosaic_isa_t isa, int rowBegin, int rowEnd)
+{
+    demosaic_rows(frame, NULL, isa, rowBegin, rowEnd);
+}
+
+typedef struct demosaic_job_t
+{
+    const demosaic_frame_t *frame;
+    const demosaic_color_t *color;
+    demosaic_isa_t isa;
+} demosaic_job_t;
+
+static void demosaic_task(void *context, int task)
+{
+    demosaic_job_t *job = (demosaic_job_t *)context;
+    int begin = task * DEMOSAIC_ROWS_PER_TASK;
+    int end = begin + DEMOSAIC_ROWS_PER_TASK;
+    demosaic_rows(job->frame, job->color, job->isa, begin, end < job->frame->height ? end : job->frame->height);
+}
+
+static void demosaic_run(worker_pool_t *pool, const demosaic_frame_t *frame, const demosaic_color_t *color, demosaic_isa_t isa)
+{
+    demosaic_job_t job = {frame, color, isa == DEMOSAIC_ISA_AUTO ? demosaic_best_isa() : isa};
+    int tasks = (frame->height + DEMOSAIC_ROWS_PER_TASK - 1) / DEMOSAIC_ROWS_PER_TASK;
+    if (pool)
+        worker_pool_run(pool, demosaic_task, &job, tasks);
+    else
+        demosaic_rows(frame, color, job.isa, 0, frame->height);
+}
+
+void demosaic_bilinear(worker_pool_t *pool, const demosaic_frame_t *frame, demosaic_isa_t isa)
+{
+    demosaic_run(pool, frame, NULL, isa);
+}
+
+void demosaic_fused(worker_pool_t *pool, const demosaic_frame_t *frame, const demosaic_color_t *color, demosaic_isa_t isa)
+{
+    demosaic_run(pool, frame, color, isa);
+}
+
+static int16_t coefficient(double value)
+{
+    long q = lround(value * (1 << DEMOSAIC_COEF_BITS));
+    return (int16_t)(q < INT16_MIN ? INT16_MIN : (q > INT16_MAX ? INT16_MAX : q));
+}
+
+void demosaic_color_prepare(demosaic_color_t *color, const color_params_t *params)
+{
+    long black = lroundf(params->blackLevel);
+    color->black = (uint8_t)(black < 0 ? 0 : (black > 254 ? 254 : black));
+    // 8 bit counts above black to lookup table entries
+    double scale = 255.0 / (255 - color->black) * (COLOR_LUT_SIZE - 1) / 255.0;
+    for (int o = 0; o < 3; o++)
+    {
+        for (int c = 0; c < 3; c++)
+            color->coef[o][c] = coefficient(params->ccm[o][c] * params->gains[c] * scale);
+        color->offset[o] = (int32_t)lround(params->ccm[o][3] * (COLOR_LUT_SIZE - 1) * (1 << DEMOSAIC_COEF_BITS)) +
+                           (1 << (DEMOSAIC_COEF_BITS - 1));
+    }
+    for (int i = 0; i < COLOR_LUT_SIZE; i++)
+        color->lut[i] = (uint8_t)lroundf(color_curve(params, i / (float)(COLOR_LUT_SIZE - 1)) * 255.0f);
+}
+
+void demosaic_fused_reference(const demosaic_frame_t *frame, const demosaic_color_t *color)
+{
+    size_t rgbStride = (size_t)frame->width * 3;
+    uint8_t *rgb = malloc(rgbStride * frame->height);
+    demosaic_frame_t plain = *frame;
+    plain.dst = rgb;
+    plain.dstStride = rgbStride;
+    plain.channels = 3;
+    demosaic_bilinear_reference(&plain);
+    for (int y = 0; y < frame->height; y++)
+        for (int x = 0; x < frame->width; x++)
+        {
+            const uint8_t *in = rgb + y * rgbStride + x * 3;
+            put_pixel_color(frame->dst + y * frame->dstStride + x * frame->channels, frame->channels, in[0], in[1], in[2], color);
+        }
+    free(rgb);
+}
+
+void demosaic_bilinear_reference(const demosaic_frame_t *frame)
+{
+    int width = frame->width, height = frame->height;
+    int redX = bayer_red_x(frame->pattern), redY = bayer_red_y(frame->pattern);
+#define RAW(x, y) frame->src[mirror(y, height) * frame->srcStride + mirror(x, width)]
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int c = RAW(x, y);
+            int cross = (RAW(x - 1, y) + RAW(x + 1, y) + RAW(x, y - 1) + RAW(x, y + 1) + 2) >> 2;
+            int diagonal = (RAW(x - 1, y - 1) + RAW(x + 1, y - 1) + RAW(x - 1, y + 1) + RAW(x + 1, y + 1) + 2) >> 2;
+            int horizontal = (RAW(x - 1, y) + RAW(x + 1, y) + 1) >> 1;
+            int vertical = (RAW(x, y - 1) + RAW(x, y + 1) + 1) >> 1;
+            int px = (x + redX) & 1, py = (y + redY) & 1;
+            uint8_t *out = frame->dst + y * frame->dstStride + x * frame->channels;
+            if (!px && !py)
+                put_pixel(out, frame->channels, c, cross, diagonal);
+            else if (px && py)
+                put_pixel(out, frame->channels, diagonal, cross, c);
+            else if (px) // green on a red row
+                put_pixel(out, frame->channels, horizontal, c, vertical);
+            else
+                put_pixel(out, frame->channels, vertical, c, horizontal);
+        }
+    }
+#undef RAW
+}
@@ -0,0 +1,8 @@
+#include "myCode/demosaic_gl.h"
+
+void demosaic_gl_set(GLuint program, demosaic_quality_t quality, bayer_pattern_t pattern)
+{
+	glUniform1i(get_uniform_location(program, "cameraTexture"), 0);
+	glUniform1i(get_uniform_location(program, "demosaicMode"), (GLint)quality);
+	glUniform2i(get_uniform_location(program, "bayerRed"), bayer_red_x(pattern), bayer_red_y(pattern));
+}
@@ -0,0 +1,418 @@
+#include "myCode/downscale.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DOWNSCALE_X86 1
+#endif
+
+#define LANCZOS_SHIFT (DOWNSCALE_H_BITS + DOWNSCALE_V_BITS)
+
+static inline int mirror(int v, int n)
+{
+    v = v < 0 ? -v : v;
+    return v > n - 1 ? 2 * (n - 1) - v : v;
+}
+
+static double sinc(double x)
+{
+    return x == 0 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+}
+
+void downscale_lanczos_weights(int bits, int weights[DOWNSCALE_TAPS])
+{
+    // input pixel 2x - 3 + k is k - 3.5 pixels from the centre of output pixel x, the kernel is stretched by 2
+    double raw[DOWNSCALE_TAPS], sum = 0;
+    for (int k = 0; k < DOWNSCALE_TAPS; k++)
+    {
+        double t = (k - 3.5) / 2;
+        raw[k] = sinc(t) * sinc(t / 2);
+        sum += raw[k];
+    }
+    int total = 0;
+    for (int k = 0; k < DOWNSCALE_TAPS; k++)
+        total += weights[k] = (int)lround(raw[k] / sum * (1 << bits));
+    // the rounding error goes to the two centre taps
+    int error = (1 << bits) - total;
+    weights[3] += error / 2;
+    weights[4] += error - error / 2;
+}
+
+typedef struct downscale_job_t
+{
+    const downscale_image_t *src, *dst;
+    bayer_pattern_t pattern;
+    downscale_filter_t filter;
+    demosaic_isa_t isa;
+    int h[DOWNSCALE_TAPS], v[DOWNSCALE_TAPS];
+} downscale_job_t;
+
+static inline void put_rgba(uint8_t *out, int r, int g, int b)
+{
+    out[0] = (uint8_t)r;
+    out[1] = (uint8_t)g;
+    out[2] = (uint8_t)b;
+    out[3] = 255;
+}
+
+// raw Bayer: one output pixel per 2x2 cell
+static void bayer_row_scalar(const downscale_job_t *job, const uint8_t *rows[2], int x, uint8_t *out)
+{
+    int redX = bayer_red_x(job->pattern), redY = bayer_red_y(job->pattern);
+    for (; x < job->dst->width; x++)
+    {
+        const uint8_t *red = rows[redY] + 2 * x, *blue = rows[1 - redY] + 2 * x;
+        put_rgba(out + x * 4, red[redX], (red[1 - redX] + blue[redX] + 1) >> 1, blue[1 - redX]);
+    }
+}
+
+static void box_row_scalar(const downscale_job_t *job, const uint8_t *rows[2], int x, uint8_t *out)
+{
+    int channels = job->src->channels;
+    for (; x < job->dst->width; x++)
+    {
+        const uint8_t *a = rows[0] + 2 * x * channels, *b = rows[1] + 2 * x * channels;
+        int rgb[3];
+        for (int c = 0; c < 3; c++)
+            rgb[c] = (a[c] + a[c + channels] + b[c] + b[c + channels] + 2) >> 2;
+        put_rgba(out + x * 4, rgb[0], rgb[1], rgb[2]);
+    }
+}
+
+// horizontal Lanczos pass into 4 int16 per output pixel, DOWNSCALE_H_BITS fraction bits
+static void lanczos_h_scalar(const downscale_job_t *job, const uint8_t *row, int x, int x1, int16_t *out)
+{
+    int channels = job->src->channels, width = job->src->width;
+    for (; x < x1; x++)
+    {
+        const uint8_t *taps[DOWNSCALE_TAPS];
+        for (int k = 0; k < DOWNSCALE_TAPS; k++)
+            taps[k] = row + mirror(2 * x - 3 + k, width) * channels;
+        for (int c = 0; c < 3; c++)
+        {
+            int sum = 0;
+            for (int k = 0; k < DOWNSCALE_TAPS; k++)
+                sum += job->h[k] * taps[k][c];
+            out[x * 4 + c] = (int16_t)sum;
+        }
+        out[x * 4 + 3] = 0; // alpha, set to 255 by the vertical pass
+    }
+}
+
+static inline int lanczos_v(const downscale_job_t *job, const int16_t *const rows[DOWNSCALE_TAPS], int i)
+{
+    int sum = 1 << (LANCZOS_SHIFT - 1);
+    for (int k = 0; k < DOWNSCALE_TAPS; k++)
+        sum += job->v[k] * rows[k][i];
+    sum >>= LANCZOS_SHIFT;
+    return sum < 0 ? 0 : (sum > 255 ? 255 : sum);
+}
+
+static void lanczos_v_scalar(const downscale_job_t *job, const int16_t *const rows[DOWNSCALE_TAPS], int i, uint8_t *out)
+{
+    for (; i < job->dst->width * 4; i++)
+        out[i] = (i & 3) == 3 ? 255 : (uint8_t)lanczos_v(job, rows, i);
+}
+
+#ifdef DOWNSCALE_X86
+// 8 cells of each row: even and odd bytes split with pshufb, then interleaved into RGBA
+__attribute__((target("sse4.1"))) static int bayer_row_sse41(const downscale_job_t *job, const uint8_t *rows[2], uint8_t *out)
+{
+    int redX = bayer_red_x(job->pattern), redY = bayer_red_y(job->pattern);
+    __m128i split = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+    __m128i alpha = _mm_set1_epi8((char)0xFF);
+    int x = 0;
+    for (; x + 8 <= job->dst->width; x += 8)
+    {
+        // low 8 bytes the even columns, high 8 the odd ones
+        __m128i red = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(rows[redY] + 2 * x)), split);
+        __m128i blue = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(rows[1 - redY] + 2 * x)), split);
+        __m128i r = redX ? _mm_srli_si128(red, 8) : red, g1 = redX ? red : _mm_srli_si128(red, 8);
+        __m128i b = redX ? blue : _mm_srli_si128(blue, 8), g2 = redX ? _mm_srli_si128(blue, 8) : blue;
+        __m128i rg = _mm_unpacklo_epi8(r, _mm_avg_epu8(g1, g2)), ba = _mm_unpacklo_epi8(b, alpha);
+        _mm_storeu_si128((__m128i *)(out + x * 4), _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128((__m128i *)(out + x * 4 + 16), _mm_unpackhi_epi16(rg, ba));
+    }
+    return x;
+}
+
+__attribute__((target("avx2"))) static int bayer_row_avx2(const downscale_job_t *job, const uint8_t *rows[2], uint8_t *out)
+{
+    int redX = bayer_red_x(job->pattern), redY = bayer_red_y(job->pattern);
+    __m256i split = _mm256_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15,
+                                     0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+    __m256i alpha = _mm256_set1_epi8((char)0xFF);
+    int x = 0;
+    for (; x + 16 <= job->dst->width; x += 16)
+    {
+        // per 128 bit lane like bayer_row_sse41, lane 0 makes pixels x .. x + 7, lane 1 x + 8 .. x + 15
+        __m256i red = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(rows[redY] + 2 * x)), split);
+        __m256i blue = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(rows[1 - redY] + 2 * x)), split);
+        __m256i r = redX ? _mm256_srli_si256(red, 8) : red, g1 = redX ? red : _mm256_srli_si256(red, 8);
+        __m256i b = redX ? blue : _mm256_srli_si256(blue, 8), g2 = redX ? _mm256_srli_si256(blue, 8) : blue;
+        __m256i rg = _mm256_unpacklo_epi8(r, _mm256_avg_epu8(g1, g2)), ba = _mm256_unpacklo_epi8(b, alpha);
+        __m256i lo = _mm256_unpacklo_epi16(rg, ba), hi = _mm256_unpackhi_epi16(rg, ba);
+        _mm256_storeu_si256((__m256i *)(out + x * 4), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *)(out + x * 4 + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    return x;
+}
+
+// RGBA8: rows added in 16 bits, then neighbouring pixels; the exact (a + b + c + d + 2) >> 2 of the reference, alpha
+// forced to 255 afterwards
+__attribute__((target("sse4.1"))) static __m128i box_pairs_sse41(__m128i a, __m128i b)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i left = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));  // pixels 0, 1
+    __m128i right = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)); // pixels 2, 3
+    __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(left, right), _mm_unpackhi_epi64(left, right));
+    return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+}
+
+__attribute__((target("sse4.1"))) static int box_row_sse41(const downscale_job_t *job, const uint8_t *rows[2], uint8_t *out)
+{
+    __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+    int x = 0;
+    for (; x + 4 <= job->dst->width; x += 4)
+    {
+        const uint8_t *a = rows[0] + x * 8, *b = rows[1] + x * 8;
+        __m128i first = box_pairs_sse41(_mm_loadu_si128((const __m128i *)a), _mm_loadu_si128((const __m128i *)b));
+        __m128i second = box_pairs_sse41(_mm_loadu_si128((const __m128i *)(a + 16)), _mm_loadu_si128((const __m128i *)(b + 16)));
+        _mm_storeu_si128((__m128i *)(out + x * 4), _mm_or_si128(_mm_packus_epi16(first, second), alpha));
+    }
+    return x;
+}
+
+__attribute__((target("avx2"))) static __m256i box_pairs_avx2(__m256i a, __m256i b)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i left = _mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+    __m256i right = _mm256_add_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero));
+    __m256i sum = _mm256_add_epi16(_mm256_unpacklo_epi64(left, right), _mm256_unpackhi_epi64(left, right));
+    return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(2)), 2);
+}
+
+__attribute__((target("avx2"))) static int box_row_avx2(const downscale_job_t *job, const uint8_t *rows[2], uint8_t *out)
+{
+    __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+    int x = 0;
+    for (; x + 8 <= job->dst->width; x += 8)
+    {
+        const uint8_t *a = rows[0] + x * 8, *b = rows[1] + x * 8;
+        // lanes hold pixels 0 1 | 2 3 and 4 5 | 6 7, the pack interleaves them by 64 bits
+        __m256i first = box_pairs_avx2(_mm256_loadu_si256((const __m256i *)a), _mm256_loadu_si256((const __m256i *)b));
+        __m256i second = box_pairs_avx2(_mm256_loadu_si256((const __m256i *)(a + 32)), _mm256_loadu_si256((const __m256i *)(b + 32)));
+        _mm256_storeu_si256((__m256i *)(out + x * 4), _mm256_or_si256(_mm256_permute4x64_epi64(_mm256_packus_epi16(first, second), 0xD8), alpha));
+    }
+    return x;
+}
+
+// RGBA8, one output pixel: 8 input pixels widened in pairs, each pair times its two weights
+__attribute__((target("sse4.1"))) static inline __m128i lanczos_h_pixel_sse41(const uint8_t *p, const __m128i w[4])
+{
+    __m128i a = _mm_loadu_si128((const __m128i *)p), b = _mm_loadu_si128((const __m128i *)(p + 16));
+    __m128i t = _mm_mullo_epi16(_mm_cvtepu8_epi16(a), w[0]);
+    t = _mm_add_epi16(t, _mm_mullo_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(a, 8)), w[1]));
+    t = _mm_add_epi16(t, _mm_mullo_epi16(_mm_cvtepu8_epi16(b), w[2]));
+    t = _mm_add_epi16(t, _mm_mullo_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(b, 8)), w[3]));
+    return _mm_add_epi16(t, _mm_srli_si128(t, 8));
+}
+
+// the output pixels whose 8 taps are all inside the row
+__attribute__((target("sse4.1"))) static void lanczos_h_sse41(const downscale_job_t *job, const uint8_t *row, int16_t *out,
+                                                             int *x0, int *x1)
+{
+    __m128i w[4];
+    for (int p = 0; p < 4; p++)
+        w[p] = _mm_setr_epi16(job->h[2 * p], job->h[2 * p], job->h[2 * p], job->h[2 * p], job->h[2 * p + 1],
+                              job->h[2 * p + 1], job->h[2 * p + 1], job->h[2 * p + 1]);
+    int x = 2, last = (job->src->width - 5) / 2; // 2x - 3 >= 0 and 2x + 4 < width
+    for (; x + 1 <= last; x += 2)
+    {
+        __m128i first = lanczos_h_pixel_sse41(row + (2 * x - 3) * 4, w);
+        __m128i second = lanczos_h_pixel_sse41(row + (2 * x - 1) * 4, w);
+        _mm_storeu_si128((__m128i *)(out + x * 4), _mm_unpacklo_epi64(first, second));
+    }
+    *x0 = 2;
+    *x1 = x;
+}
+
+__attribute__((target("sse4.1"))) static int lanczos_v_sse41(const downscale_job_t *job, const int16_t *const rows[DOWNSCALE_TAPS], uint8_t *out)
+{
+    __m128i w[4], round = _mm_set1_epi32(1 << (LANCZOS_SHIFT - 1)), alpha = _mm_set1_epi32((int)0xFF000000);
+    for (int p = 0; p < 4; p++)
+        w[p] = _mm_set1_epi32((int)(((uint32_t)job->v[2 * p + 1] << 16) | (uint16_t)job->v[2 * p]));
+    int i = 0, n = job->dst->width * 4;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i lo = round, hi = round;
+        for (int p = 0; p < 4; p++)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i *)(rows[2 * p] + i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(rows[2 * p + 1] + i));
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w[p]));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w[p]));
+        }
+        __m128i v = _mm_packs_epi32(_mm_srai_epi32(lo, LANCZOS_SHIFT), _mm_srai_epi32(hi, LANCZOS_SHIFT));
+        _mm_storel_epi64((__m128i *)(out + i), _mm_or_si128(_mm_packus_epi16(v, v), alpha));
+    }
+    return i;
+}
+#endif
+
+static demosaic_isa_t simd_isa(const downscale_job_t *job)
+{
+    // the vector kernels read RGBA8 or raw Bayer
+    return job->src->channels == 3 ? DEMOSAIC_ISA_SCALAR : job->isa;
+}
+
+static void two_row_band(const downscale_job_t *job, int rowBegin, int rowEnd)
+{
+    demosaic_isa_t isa = simd_isa(job);
+    for (int y = rowBegin; y < rowEnd; y++)
+    {
+        const uint8_t *rows[2] = {job->src->data + 2 * y * job->src->stride, job->src->data + (2 * y + 1) * job->src->stride};
+        uint8_t *out = job->dst->data + y * job->dst->stride;
+        int x = 0;
+        if (job->src->channels == 1)
+        {
+#ifdef DOWNSCALE_X86
+            if (isa == DEMOSAIC_ISA_AVX2)
+                x = bayer_row_avx2(job, rows, out);
+            else if (isa == DEMOSAIC_ISA_SSE41)
+                x = bayer_row_sse41(job, rows, out);
+#endif
+            bayer_row_scalar(job, rows, x, out);
+            continue;
+        }
+#ifdef DOWNSCALE_X86
+        if (isa == DEMOSAIC_ISA_AVX2)
+            x = box_row_avx2(job, rows, out);
+        else if (isa == DEMOSAIC_ISA_SSE41)
+            x = box_row_sse41(job, rows, out);
+#endif
+        box_row_scalar(job, rows, x, out);
+    }
+}
+
+static void lanczos_row_h(const downscale_job_t *job, const uint8_t *row, int16_t *out)
+{
+    int x0 = 0, x1 = 0;
+#ifdef DOWNSCALE_X86
+    if (simd_isa(job) >= DEMOSAIC_ISA_SSE41)
+        lanczos_h_sse41(job, row, out, &x0, &x1);
+#endif
+    if (x0 >= x1)
+        x0 = x1 = job->dst->width;
+    lanczos_h_scalar(job, row, 0, x0, out);
+    lanczos_h_scalar(job, row, x1, job->dst->width, out);
+}
+
+// output rows rowBegin .. rowEnd - 1 read input rows 2 rowBegin - 3 .. 2 rowEnd + 2, filtered horizontally first
+static void lanczos_band(const downscale_job_t *job, int rowBegin, int rowEnd)
+{
+    int rows = 2 * (rowEnd - rowBegin) + DOWNSCALE_TAPS - 2, lanes = job->dst->width * 4;
+    int16_t *tmp = malloc((size_t)rows * lanes * sizeof(int16_t));
+    if (!tmp)
+        return;
+    for (int t = 0; t < rows; t++)
+        lanczos_row_h(job, job->src->data + mirror(2 * rowBegin - 3 + t, job->src->height) * job->src->stride, tmp + t * lanes);
+    for (int y = rowBegin; y < rowEnd; y++)
+    {
+        const int16_t *taps[DOWNSCALE_TAPS];
+        for (int k = 0; k < DOWNSCALE_TAPS; k++)
+            taps[k] = tmp + (2 * (y - rowBegin) + k) * lanes;
+        uint8_t *out = job->dst->data + y * job->dst->stride;
+        int i = 0;
+#ifdef DOWNSCALE_X86
+        if (simd_isa(job) >= DEMOSAIC_ISA_SSE41)
+            i = lanczos_v_sse41(job, taps, out);
+#endif
+        lanczos_v_scalar(job, taps, i, out);
+    }
+    free(tmp);
+}
+
+static void downscale_rows(const downscale_job_t *job, int rowBegin, int rowEnd)
+{
+    if (job->src->channels != 1 && job->filter == DOWNSCALE_LANCZOS)
+        lanczos_band(job, rowBegin, rowEnd);
+    else
+        two_row_band(job, rowBegin, rowEnd);
+}
+
+static void downscale_task(void *context, int task)
+{
+    const downscale_job_t *job = context;
+    int begin = task * DEMOSAIC_ROWS_PER_TASK, end = begin + DEMOSAIC_ROWS_PER_TASK;
+    downscale_rows(job, begin, end < job->dst->height ? end : job->dst->height);
+}
+
+static void job_init(downscale_job_t *job, const downscale_image_t *src, bayer_pattern_t pattern,
+                     const downscale_image_t *dst, downscale_filter_t filter, demosaic_isa_t isa)
+{
+    job->src = src;
+    job->dst = dst;
+    job->pattern = pattern;
+    job->filter = filter;
+    job->isa = isa == DEMOSAIC_ISA_AUTO ? demosaic_best_isa() : isa;
+    downscale_lanczos_weights(DOWNSCALE_H_BITS, job->h);
+    downscale_lanczos_weights(DOWNSCALE_V_BITS, job->v);
+}
+
+void downscale_half(worker_pool_t *pool, const downscale_image_t *src, bayer_pattern_t pattern,
+                    const downscale_image_t *dst, downscale_filter_t filter, demosaic_isa_t isa)
+{
+    downscale_job_t job;
+    job_init(&job, src, pattern, dst, filter, isa);
+    int tasks = (dst->height + DEMOSAIC_ROWS_PER_TASK - 1) / DEMOSAIC_ROWS_PER_TASK;
+    if (pool)
+        worker_pool_run(pool, downscale_task, &job, tasks);
+    else
+        downscale_rows(&job, 0, dst->height);
+}
+
+void downscale_half_reference(const downscale_image_t *src, bayer_pattern_t pattern, const downscale_image_t *dst,
+                              downscale_filter_t filter)
+{
+    downscale_job_t job;
+    job_init(&job, src, pattern, dst, filter, DEMOSAIC_ISA_SCALAR);
+    for (int y = 0; y < dst->height; y++)
+    {
+        const uint8_t *rows[2] = {src->data + 2 * y * src->stride, src->data + (2 * y + 1) * src->stride};
+        uint8_t *out = dst->data + y * dst->stride;
+        if (src->channels == 1)
+            bayer_row_scalar(&job, rows, 0, out);
+        else if (filter == DOWNSCALE_BOX)
+            box_row_scalar(&job, rows, 0, out);
+        else
+        {
+            // both passes for every output value, no intermediate rows
+            for (int x = 0; x < dst->width; x++)
+                for (int c = 0; c < 3; c++)
+                {
+                    int sum = 1 << (LANCZOS_SHIFT - 1);
+                    for (int j = 0; j < DOWNSCALE_TAPS; j++)
+                    {
+                        const uint8_t *row = src->data + mirror(2 * y - 3 + j, src->height) * src->stride;
+                        int h = 0;
+                        for (int k = 0; k < DOWNSCALE_TAPS; k++)
+                            h += job.h[k] * row[mirror(2 * x - 3 + k, src->width) * src->channels + c];
+                        sum += job.v[j] * (int16_t)h;
+                    }
+                    sum >>= LANCZOS_SHIFT;
+                    out[x * 4 + c] = (uint8_t)(sum < 0 ? 0 : (sum > 255 ? 255 : sum));
+                }
+            for (int x = 0; x < dst->width; x++)
+                out[x * 4 + 3] = 255;
+        }
+    }
+}
+
+void downscale_pyramid(worker_pool_t *pool, const downscale_image_t *src, bayer_pattern_t pattern,
+                       const downscale_image_t *levels, int count, downscale_filter_t filter, demosaic_isa_t isa)
+{
+    for (int i = 0; i < count; i++)
+        downscale_half(pool, i ? &levels[i - 1] : src, pattern, &levels[i], filter, isa);
+}
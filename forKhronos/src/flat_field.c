@@ -0,0 +1,463 @@
+#include "myCode/flat_field.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FLAT_FIELD_X86 1
+#endif
+
+// (raw << 8) - dark has FLAT_FIELD_DARK_BITS fraction bits, the high half of its product with the gain keeps
+// FLAT_FIELD_SHIFT of them
+#define FLAT_FIELD_SHIFT (FLAT_FIELD_DARK_BITS + FLAT_FIELD_GAIN_BITS - 16)
+#define FLAT_FIELD_ROUND (1 << (FLAT_FIELD_SHIFT - 1))
+
+// file layout: this header, then the zlib compressed dark map, gain map and defect list, host byte order
+#define FLAT_FIELD_MAGIC "FKFLAT\0"
+#define FLAT_FIELD_VERSION 1
+
+typedef struct flat_field_header_t
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t defectCount;
+    int64_t width, height, offsetX, offsetY, pixelScale;
+    uint32_t darkBits, gainBits;
+    uint64_t payloadBytes, compressedBytes;
+} flat_field_header_t;
+
+static inline int calibrate(int raw, uint16_t dark, uint16_t gain)
+{
+    int v = (raw << 8) - dark;
+    v = v < 0 ? 0 : v;
+    v = (int)(((uint32_t)v * gain) >> 16);
+    v = (v + FLAT_FIELD_ROUND) >> FLAT_FIELD_SHIFT;
+    return v > 255 ? 255 : v;
+}
+
+int flat_field_capture_start(flat_field_capture_t *capture, flat_field_reference_t reference, int frames, int64_t width,
+                             int64_t height, int64_t offsetX, int64_t offsetY, int64_t pixelScale)
+{
+    if (capture->width != width || capture->height != height || capture->offsetX != offsetX ||
+        capture->offsetY != offsetY || capture->pixelScale != pixelScale)
+    {
+        flat_field_capture_free(capture);
+        capture->width = width;
+        capture->height = height;
+        capture->offsetX = offsetX;
+        capture->offsetY = offsetY;
+        capture->pixelScale = pixelScale;
+    }
+    size_t pixels = (size_t)width * height;
+    if (!capture->sums[reference])
+        capture->sums[reference] = malloc(pixels * sizeof(uint32_t));
+    if (!capture->sums[reference])
+        return -1;
+    memset(capture->sums[reference], 0, pixels * sizeof(uint32_t));
+    capture->frames[reference] = 0;
+    capture->reference = reference;
+    capture->remaining = frames;
+    return 0;
+}
+
+int flat_field_capture_add(flat_field_capture_t *capture, const uint8_t *src, size_t stride)
+{
+    if (capture->remaining <= 0)
+        return 0;
+    uint32_t *sum = capture->sums[capture->reference];
+    for (int64_t y = 0; y < capture->height; y++, sum += capture->width)
+    {
+        const uint8_t *row = src + y * stride;
+        for (int64_t x = 0; x < capture->width; x++) // vectorized by the compiler
+            sum[x] += row[x];
+    }
+    capture->frames[capture->reference]++;
+    return --capture->remaining == 0;
+}
+
+void flat_field_capture_free(flat_field_capture_t *capture)
+{
+    free(capture->sums[0]);
+    free(capture->sums[1]);
+    memset(capture, 0, sizeof(*capture));
+}
+
+// mean per Bayer phase of the pixels not yet marked defective (gain 0)
+static void phase_means(const flat_field_t *ff, const double *values, double means[4])
+{
+    double sums[4] = {0};
+    uint64_t counts[4] = {0};
+    for (int64_t y = 0; y < ff->height; y++)
+        for (int64_t x = 0; x < ff->width; x++)
+        {
+            size_t i = y * ff->width + x;
+            int phase = (int)((y & 1) * 2 + (x & 1));
+            if (ff->gain[i])
+            {
+                sums[phase] += values[i];
+                counts[phase]++;
+            }
+        }
+    for (int phase = 0; phase < 4; phase++)
+        means[phase] = counts[phase] ? sums[phase] / counts[phase] : 0;
+}
+
+int flat_field_build(flat_field_t *ff, const flat_field_capture_t *capture, const flat_field_config_t *config)
+{
+    int darkFrames = capture->sums[FLAT_FIELD_DARK] ? capture->frames[FLAT_FIELD_DARK] : 0;
+    int flatFrames = capture->sums[FLAT_FIELD_FLAT] ? capture->frames[FLAT_FIELD_FLAT] : 0;
+    size_t pixels = (size_t)capture->width * capture->height;
+    memset(ff, 0, sizeof(*ff));
+    if (!darkFrames && !flatFrames)
+        return -1;
+    ff->width = capture->width;
+    ff->height = capture->height;
+    ff->offsetX = capture->offsetX;
+    ff->offsetY = capture->offsetY;
+    ff->pixelScale = capture->pixelScale;
+    ff->dark = malloc(pixels * sizeof(uint16_t));
+    ff->gain = malloc(pixels * sizeof(uint16_t));
+    double *dark = malloc(pixels * sizeof(double));
+    double *response = malloc(pixels * sizeof(double));
+    if (!ff->dark || !ff->gain || !dark || !response)
+    {
+        free(dark);
+        free(response);
+        flat_field_free(ff);
+        return -1;
+    }
+
+    double means[4];
+    for (size_t i = 0; i < pixels; i++)
+    {
+        dark[i] = darkFrames ? (double)capture->sums[FLAT_FIELD_DARK][i] / darkFrames : 0;
+        double v = dark[i] * (1 << FLAT_FIELD_DARK_BITS) + 0.5;
+        ff->dark[i] = (uint16_t)(v > 65535 ? 65535 : v);
+        ff->gain[i] = 1 << FLAT_FIELD_GAIN_BITS;
+    }
+    // hot pixels from the dark reference
+    phase_means(ff, dark, means);
+    for (int64_t y = 0; y < ff->height && darkFrames; y++)
+        for (int64_t x = 0; x < ff->width; x++)
+        {
+            size_t i = y * ff->width + x;
+            if (dark[i] > means[(y & 1) * 2 + (x & 1)] + config->hotCounts)
+                ff->gain[i] = 0;
+        }
+
+    if (flatFrames)
+    {
+        for (size_t i = 0; i < pixels; i++)
+            response[i] = (double)capture->sums[FLAT_FIELD_FLAT][i] / flatFrames - dark[i];
+        // dead and stuck pixels against the mean, then the mean again without them
+        phase_means(ff, response, means);
+        for (int64_t y = 0; y < ff->height; y++)
+            for (int64_t x = 0; x < ff->width; x++)
+            {
+                size_t i = y * ff->width + x;
+                double mean = means[(y & 1) * 2 + (x & 1)];
+                if (response[i] <= 0 || mean <= 0 || fabs(response[i] - mean) > mean * config->maxResponseDeviation)
+                    ff->gain[i] = 0;
+            }
+        phase_means(ff, response, means);
+        for (int64_t y = 0; y < ff->height; y++)
+            for (int64_t x = 0; x < ff->width; x++)
+            {
+                size_t i = y * ff->width + x;
+                if (!ff->gain[i])
+                    continue;
+                double v = means[(y & 1) * 2 + (x & 1)] / response[i] * (1 << FLAT_FIELD_GAIN_BITS) + 0.5;
+                ff->gain[i] = (uint16_t)(v < 1 ? 1 : (v > 65535 ? 65535 : v));
+            }
+    }
+    free(dark);
+    free(response);
+
+    for (size_t i = 0; i < pixels; i++)
+        ff->defectCount += !ff->gain[i];
+    ff->defects = malloc((ff->defectCount ? ff->defectCount : 1) * sizeof(uint32_t));
+    if (!ff->defects)
+    {
+        flat_field_free(ff);
+        return -1;
+    }
+    for (size_t i = 0, d = 0; i < pixels; i++)
+        if (!ff->gain[i])
+            ff->defects[d++] = (uint32_t)i;
+    printf("Flat field %ldx%ld from %d dark and %d flat frames, %u defective pixels\n", (long)ff->width,
+           (long)ff->height, darkFrames, flatFrames, ff->defectCount);
+    return 0;
+}
+
+int flat_field_save(const flat_field_t *ff, const char *path)
+{
+    size_t pixels = (size_t)ff->width * ff->height;
+    size_t mapBytes = pixels * sizeof(uint16_t), defectBytes = ff->defectCount * sizeof(uint32_t);
+    flat_field_header_t header = {FLAT_FIELD_MAGIC, FLAT_FIELD_VERSION, ff->defectCount, ff->width, ff->height,
+                                  ff->offsetX, ff->offsetY, ff->pixelScale, FLAT_FIELD_DARK_BITS, FLAT_FIELD_GAIN_BITS,
+                                  2 * mapBytes + defectBytes, 0};
+    uint8_t *payload = malloc(header.payloadBytes);
+    uLongf compressedBytes = compressBound(header.payloadBytes);
+    uint8_t *compressed = malloc(compressedBytes);
+    int ret = -1;
+    if (payload && compressed)
+    {
+        memcpy(payload, ff->dark, mapBytes);
+        memcpy(payload + mapBytes, ff->gain, mapBytes);
+        memcpy(payload + 2 * mapBytes, ff->defects, defectBytes);
+        if (compress2(compressed, &compressedBytes, payload, header.payloadBytes, Z_BEST_SPEED) == Z_OK)
+        {
+            header.compressedBytes = compressedBytes;
+            FILE *file = fopen(path, "wb");
+            if (file)
+            {
+                if (fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(compressed, compressedBytes, 1, file) == 1)
+                    ret = 0;
+                if (fclose(file))
+                    ret = -1;
+            }
+        }
+    }
+    free(payload);
+    free(compressed);
+    if (ret)
+        printf("Failed to write flat field %s\n", path);
+    else
+        printf("Flat field saved to %s, %lu bytes\n", path, (unsigned long)(sizeof(header) + compressedBytes));
+    return ret;
+}
+
+int flat_field_load(flat_field_t *ff, const char *path)
+{
+    flat_field_header_t header;
+    memset(ff, 0, sizeof(*ff));
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return -1;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, FLAT_FIELD_MAGIC, sizeof(header.magic)) ||
+        header.version != FLAT_FIELD_VERSION || header.darkBits != FLAT_FIELD_DARK_BITS ||
+        header.gainBits != FLAT_FIELD_GAIN_BITS || header.width <= 0 || header.height <= 0 ||
+        header.payloadBytes != (uint64_t)header.width * header.height * 4 + header.defectCount * 4ull)
+    {
+        printf("%s is not a flat field file of this version\n", path);
+        fclose(file);
+        return -1;
+    }
+    size_t pixels = (size_t)header.width * header.height, mapBytes = pixels * sizeof(uint16_t);
+    uint8_t *compressed = malloc(header.compressedBytes);
+    ff->dark = malloc(mapBytes);
+    ff->gain = malloc(mapBytes);
+    ff->defects = malloc((header.defectCount ? header.defectCount : 1) * sizeof(uint32_t));
+    uint8_t *payload = malloc(header.payloadBytes);
+    uLongf payloadBytes = header.payloadBytes;
+    int ok = compressed && ff->dark && ff->gain && ff->defects && payload &&
+             fread(compressed, header.compressedBytes, 1, file) == 1 &&
+             uncompress(payload, &payloadBytes, compressed, header.compressedBytes) == Z_OK &&
+             payloadBytes == header.payloadBytes;
+    fclose(file);
+    if (ok)
+    {
+        memcpy(ff->dark, payload, mapBytes);
+        memcpy(ff->gain, payload + mapBytes, mapBytes);
+        memcpy(ff->defects, payload + 2 * mapBytes, header.defectCount * sizeof(uint32_t));
+        ff->width = header.width;
+        ff->height = header.height;
+        ff->offsetX = header.offsetX;
+        ff->offsetY = header.offsetY;
+        ff->pixelScale = header.pixelScale;
+        ff->defectCount = header.defectCount;
+        // the GPU path only sees the gain map
+        for (uint32_t i = 0; i < ff->defectCount && ok; i++)
+        {
+            ok = ff->defects[i] < pixels && (!i || ff->defects[i] > ff->defects[i - 1]);
+            if (ok)
+                ff->gain[ff->defects[i]] = 0;
+        }
+    }
+    free(compressed);
+    free(payload);
+    if (!ok)
+    {
+        printf("%s is damaged\n", path);
+        flat_field_free(ff);
+        return -1;
+    }
+    return 0;
+}
+
+void flat_field_free(flat_field_t *ff)
+{
+    free(ff->dark);
+    free(ff->gain);
+    free(ff->defects);
+    memset(ff, 0, sizeof(*ff));
+}
+
+int flat_field_shift(const flat_field_t *ff, int64_t width, int64_t height, int64_t offsetX, int64_t offsetY,
+                     int64_t pixelScale, int *shiftX, int *shiftY)
+{
+    int64_t x = offsetX - ff->offsetX, y = offsetY - ff->offsetY;
+    // an odd shift would pair pixels of different colours
+    if (!ff->gain || pixelScale != ff->pixelScale || x < 0 || y < 0 || (x | y) & 1 || x + width > ff->width ||
+        y + height > ff->height)
+        return -1;
+    *shiftX = (int)x;
+    *shiftY = (int)y;
+    return 0;
+}
+
+typedef struct flat_field_job_t
+{
+    const flat_field_t *ff;
+    int shiftX, shiftY;
+    const uint8_t *src;
+    size_t srcStride;
+    uint8_t *dst;
+    size_t dstStride;
+    int width, height;
+    demosaic_isa_t isa;
+} flat_field_job_t;
+
+static int row_scalar(const uint8_t *src, const uint16_t *dark, const uint16_t *gain, int x, int width, uint8_t *dst)
+{
+    for (; x < width; x++)
+        dst[x] = (uint8_t)calibrate(src[x], dark[x], gain[x]);
+    return x;
+}
+
+#ifdef FLAT_FIELD_X86
+// the byte unpack puts the raw value in the high byte, which is raw << 8 for free
+__attribute__((target("sse4.1"))) static int row_sse41(const uint8_t *src, const uint16_t *dark, const uint16_t *gain,
+                                                       int width, uint8_t *dst)
+{
+    __m128i zero = _mm_setzero_si128(), round = _mm_set1_epi16(FLAT_FIELD_ROUND);
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i raw = _mm_loadu_si128((const __m128i *)(src + x));
+        __m128i lo = _mm_subs_epu16(_mm_unpacklo_epi8(zero, raw), _mm_loadu_si128((const __m128i *)(dark + x)));
+        __m128i hi = _mm_subs_epu16(_mm_unpackhi_epi8(zero, raw), _mm_loadu_si128((const __m128i *)(dark + x + 8)));
+        lo = _mm_mulhi_epu16(lo, _mm_loadu_si128((const __m128i *)(gain + x)));
+        hi = _mm_mulhi_epu16(hi, _mm_loadu_si128((const __m128i *)(gain + x + 8)));
+        lo = _mm_srli_epi16(_mm_adds_epu16(lo, round), FLAT_FIELD_SHIFT);
+        hi = _mm_srli_epi16(_mm_adds_epu16(hi, round), FLAT_FIELD_SHIFT);
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_packus_epi16(lo, hi));
+    }
+    return x;
+}
+
+// the unpacks work within 128 bit lanes, the maps are loaded in the same lane order so the pack comes out in order
+__attribute__((target("avx2"))) static int row_avx2(const uint8_t *src, const uint16_t *dark, const uint16_t *gain,
+                                                    int width, uint8_t *dst)
+{
+    __m256i zero = _mm256_setzero_si256(), round = _mm256_set1_epi16(FLAT_FIELD_ROUND);
+    int x = 0;
+    for (; x + 32 <= width; x += 32)
+    {
+        __m256i raw = _mm256_loadu_si256((const __m256i *)(src + x));
+        __m256i dark0 = _mm256_loadu_si256((const __m256i *)(dark + x));
+        __m256i dark1 = _mm256_loadu_si256((const __m256i *)(dark + x + 16));
+        __m256i gain0 = _mm256_loadu_si256((const __m256i *)(gain + x));
+        __m256i gain1 = _mm256_loadu_si256((const __m256i *)(gain + x + 16));
+        __m256i lo = _mm256_subs_epu16(_mm256_unpacklo_epi8(zero, raw), _mm256_permute2x128_si256(dark0, dark1, 0x20));
+        __m256i hi = _mm256_subs_epu16(_mm256_unpackhi_epi8(zero, raw), _mm256_permute2x128_si256(dark0, dark1, 0x31));
+        lo = _mm256_mulhi_epu16(lo, _mm256_permute2x128_si256(gain0, gain1, 0x20));
+        hi = _mm256_mulhi_epu16(hi, _mm256_permute2x128_si256(gain0, gain1, 0x31));
+        lo = _mm256_srli_epi16(_mm256_adds_epu16(lo, round), FLAT_FIELD_SHIFT);
+        hi = _mm256_srli_epi16(_mm256_adds_epu16(hi, round), FLAT_FIELD_SHIFT);
+        _mm256_storeu_si256((__m256i *)(dst + x), _mm256_packus_epi16(lo, hi));
+    }
+    return x;
+}
+#endif
+
+// mean of the calibrated same colour neighbours that are not defective themselves; read from src, never from dst
+static int replacement(const flat_field_job_t *job, int x, int y)
+{
+    static const int offsets[4][2] = {{-2, 0}, {2, 0}, {0, -2}, {0, 2}};
+    const flat_field_t *ff = job->ff;
+    int sum = 0, count = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        int nx = x + offsets[i][0], ny = y + offsets[i][1];
+        if (nx < 0 || ny < 0 || nx >= job->width || ny >= job->height)
+            continue;
+        size_t m = (size_t)(ny + job->shiftY) * ff->width + nx + job->shiftX;
+        if (!ff->gain[m])
+            continue;
+        sum += calibrate(job->src[ny * job->srcStride + nx], ff->dark[m], ff->gain[m]);
+        count++;
+    }
+    return count ? (sum + count / 2) / count : job->src[y * job->srcStride + x];
+}
+
+static void apply_rows(const flat_field_job_t *job, int rowBegin, int rowEnd)
+{
+    const flat_field_t *ff = job->ff;
+    for (int y = rowBegin; y < rowEnd; y++)
+    {
+        size_t m = (size_t)(y + job->shiftY) * ff->width + job->shiftX;
+        const uint8_t *src = job->src + y * job->srcStride;
+        uint8_t *dst = job->dst + y * job->dstStride;
+        int x = 0;
+#ifdef FLAT_FIELD_X86
+        if (job->isa == DEMOSAIC_ISA_AVX2)
+            x = row_avx2(src, ff->dark + m, ff->gain + m, job->width, dst);
+        else if (job->isa == DEMOSAIC_ISA_SSE41)
+            x = row_sse41(src, ff->dark + m, ff->gain + m, job->width, dst);
+#endif
+        row_scalar(src, ff->dark + m, ff->gain + m, x, job->width, dst);
+    }
+
+    // defects of these rows, the list is in map order
+    uint32_t first = (uint32_t)((rowBegin + job->shiftY) * ff->width), end = (uint32_t)((rowEnd + job->shiftY) * ff->width);
+    uint32_t low = 0, high = ff->defectCount;
+    while (low < high)
+    {
+        uint32_t middle = (low + high) / 2;
+        if (ff->defects[middle] < first)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    for (uint32_t i = low; i < ff->defectCount && ff->defects[i] < end; i++)
+    {
+        int x = (int)(ff->defects[i] % ff->width) - job->shiftX, y = (int)(ff->defects[i] / ff->width) - job->shiftY;
+        if (x >= 0 && x < job->width)
+            job->dst[y * job->dstStride + x] = (uint8_t)replacement(job, x, y);
+    }
+}
+
+static void apply_task(void *context, int task)
+{
+    const flat_field_job_t *job = context;
+    int begin = task * DEMOSAIC_ROWS_PER_TASK, end = begin + DEMOSAIC_ROWS_PER_TASK;
+    apply_rows(job, begin, end < job->height ? end : job->height);
+}
+
+void flat_field_apply(worker_pool_t *pool, const flat_field_t *ff, int shiftX, int shiftY, const uint8_t *src,
+                      size_t srcStride, uint8_t *dst, size_t dstStride, int width, int height, demosaic_isa_t isa)
+{
+    flat_field_job_t job = {ff, shiftX, shiftY, src, srcStride, dst, dstStride, width, height,
+                            isa == DEMOSAIC_ISA_AUTO ? demosaic_best_isa() : isa};
+    int tasks = (height + DEMOSAIC_ROWS_PER_TASK - 1) / DEMOSAIC_ROWS_PER_TASK;
+    if (pool && tasks > 1)
+        worker_pool_run(pool, apply_task, &job, tasks);
+    else
+        apply_rows(&job, 0, height);
+}
+
+void flat_field_apply_reference(const flat_field_t *ff, int shiftX, int shiftY, const uint8_t *src, size_t srcStride,
+                                uint8_t *dst, size_t dstStride, int width, int height)
+{
+    flat_field_job_t job = {ff, shiftX, shiftY, src, srcStride, dst, dstStride, width, height, DEMOSAIC_ISA_SCALAR};
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+        {
+            size_t m = (size_t)(y + shiftY) * ff->width + x + shiftX;
+            dst[y * dstStride + x] = ff->gain[m] ? (uint8_t)calibrate(src[y * srcStride + x], ff->dark[m], ff->gain[m])
+                                                 : (uint8_t)replacement(&job, x, y);
+        }
+}
@@ -0,0 +1,53 @@
+#include "myCode/flat_field_gl.h"
+
+static void upload_map(GLuint *texture, GLenum unit, const flat_field_t *ff, const uint16_t *map)
+{
+    // integer textures are never filtered, the shader fetches texels
+    if (*texture)
+        glDeleteTextures(1, texture);
+    glGenTextures(1, texture);
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, *texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R16UI, (GLsizei)ff->width, (GLsizei)ff->height);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, (GLsizei)ff->width, (GLsizei)ff->height, GL_RED_INTEGER, GL_UNSIGNED_SHORT, map);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void flat_field_gl_init(GLuint program)
+{
+    glUniform1i(get_uniform_location(program, "flatFieldDark"), FLAT_FIELD_GL_DARK_UNIT);
+    glUniform1i(get_uniform_location(program, "flatFieldGain"), FLAT_FIELD_GL_GAIN_UNIT);
+    glUniform1i(get_uniform_location(program, "flatField"), 0);
+}
+
+void flat_field_gl_upload(flat_field_gl_t *maps, const flat_field_t *ff)
+{
+    upload_map(&maps->dark, FLAT_FIELD_GL_DARK_UNIT, ff, ff->dark);
+    upload_map(&maps->gain, FLAT_FIELD_GL_GAIN_UNIT, ff, ff->gain);
+}
+
+void flat_field_gl_use(GLuint program, const flat_field_gl_t *maps, int shiftX, int shiftY)
+{
+    int enabled = maps && maps->dark && maps->gain;
+    glUniform1i(get_uniform_location(program, "flatField"), enabled);
+    if (!enabled)
+        return;
+    glUniform2i(get_uniform_location(program, "flatFieldShift"), shiftX, shiftY);
+    glActiveTexture(GL_TEXTURE0 + FLAT_FIELD_GL_DARK_UNIT);
+    glBindTexture(GL_TEXTURE_2D, maps->dark);
+    glActiveTexture(GL_TEXTURE0 + FLAT_FIELD_GL_GAIN_UNIT);
+    glBindTexture(GL_TEXTURE_2D, maps->gain);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void flat_field_gl_destroy(flat_field_gl_t *maps)
+{
+    if (maps->dark)
+        glDeleteTextures(1, &maps->dark);
+    if (maps->gain)
+        glDeleteTextures(1, &maps->gain);
+    maps->dark = maps->gain = 0;
+}
@@ -0,0 +1,9 @@
+#include "myCode/frame_clock.h"
+#include <time.h>
+
+uint64_t frame_clock_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
@@ -0,0 +1,200 @@
+#include "myCode/frame_copy.h"
+#include "myCode/frame_clock.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FRAME_COPY_X86 1
+#endif
+
+#define FRAME_COPY_LINE 64
+#define FRAME_COPY_CALIBRATION_RUNS 3
+#define FRAME_COPY_GOOD_ENOUGH 0.9
+
+#ifdef FRAME_COPY_X86
+// head until dst is 16 byte aligned and the tail are plain copies, everything between goes around the cache
+static void stream_copy_sse2(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    size_t head = (16 - ((uintptr_t)dst & 15)) & 15;
+    if (head > size)
+        head = size;
+    memcpy(dst, src, head);
+    dst += head, src += head, size -= head;
+
+    for (; size >= 64; dst += 64, src += 64, size -= 64)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)src);
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *)(src + 32));
+        __m128i d = _mm_loadu_si128((const __m128i *)(src + 48));
+        _mm_stream_si128((__m128i *)dst, a);
+        _mm_stream_si128((__m128i *)(dst + 16), b);
+        _mm_stream_si128((__m128i *)(dst + 32), c);
+        _mm_stream_si128((__m128i *)(dst + 48), d);
+    }
+    memcpy(dst, src, size);
+    _mm_sfence();
+}
+
+__attribute__((target("avx2"))) static void stream_copy_avx2(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    size_t head = (32 - ((uintptr_t)dst & 31)) & 31;
+    if (head > size)
+        head = size;
+    memcpy(dst, src, head);
+    dst += head, src += head, size -= head;
+
+    for (; size >= 128; dst += 128, src += 128, size -= 128)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)src);
+        __m256i b = _mm256_loadu_si256((const __m256i *)(src + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i *)(src + 64));
+        __m256i d = _mm256_loadu_si256((const __m256i *)(src + 96));
+        _mm256_stream_si256((__m256i *)dst, a);
+        _mm256_stream_si256((__m256i *)(dst + 32), b);
+        _mm256_stream_si256((__m256i *)(dst + 64), c);
+        _mm256_stream_si256((__m256i *)(dst + 96), d);
+    }
+    memcpy(dst, src, size);
+    _mm_sfence();
+}
+#endif
+
+void frame_copy_stream(void *dst, const void *src, size_t size)
+{
+#ifdef FRAME_COPY_X86
+    static int avx2 = -1;
+    if (avx2 < 0)
+        avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    if (avx2)
+        stream_copy_avx2(dst, src, size);
+    else
+        stream_copy_sse2(dst, src, size);
+#else
+    memcpy(dst, src, size);
+#endif
+}
+
+// stripe boundaries fall on destination cache lines, so no two threads ever write the same line
+static void copy_stripe(frame_copy_t *fc, int stripe)
+{
+    uintptr_t base = (uintptr_t)fc->dst;
+    size_t chunk = fc->size / fc->threads;
+    size_t begin = 0, end = fc->size;
+    if (stripe > 0)
+        begin = ((base + stripe * chunk + FRAME_COPY_LINE - 1) & ~(uintptr_t)(FRAME_COPY_LINE - 1)) - base;
+    if (stripe < fc->threads - 1)
+        end = ((base + (stripe + 1) * chunk + FRAME_COPY_LINE - 1) & ~(uintptr_t)(FRAME_COPY_LINE - 1)) - base;
+    if (begin > fc->size)
+        begin = fc->size;
+    if (end > fc->size)
+        end = fc->size;
+    if (end > begin)
+        frame_copy_stream(fc->dst + begin, fc->src + begin, end - begin);
+}
+
+static void copy_task(void *context, int stripe)
+{
+    copy_stripe((frame_copy_t *)context, stripe);
+}
+
+// workers pinned to the CPUs after the caller's first one, as many stripes as threads
+static int start_workers(frame_copy_t *fc, int threads)
+{
+    fc->copies = 0;
+    fc->copyNs = 0;
+    fc->bytes = 0;
+    int ret = worker_pool_init(&fc->pool, threads, 0);
+    fc->threads = fc->pool.threads;
+    return ret;
+}
+
+static double measure_bandwidth(frame_copy_t *fc, uint8_t *dst, const uint8_t *src, size_t size)
+{
+    uint64_t best = UINT64_MAX;
+    for (int run = 0; run < FRAME_COPY_CALIBRATION_RUNS; run++)
+    {
+        uint64_t start = frame_clock_ns();
+        frame_copy(fc, dst, src, size);
+        uint64_t elapsed = frame_clock_ns() - start;
+        if (elapsed < best)
+            best = elapsed;
+    }
+    return size / (double)best; // GB/s
+}
+
+int frame_copy_init(frame_copy_t *fc, int threads, size_t calibrationSize)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int maxThreads = cpus < 1 ? 1 : (cpus > FRAME_COPY_MAX_THREADS ? FRAME_COPY_MAX_THREADS : (int)cpus);
+
+    if (threads > 0)
+        return start_workers(fc, threads > FRAME_COPY_MAX_THREADS ? FRAME_COPY_MAX_THREADS : threads);
+
+    uint8_t *src = aligned_alloc(4096, (calibrationSize + 4095) & ~(size_t)4095);
+    uint8_t *dst = aligned_alloc(4096, (calibrationSize + 4095) & ~(size_t)4095);
+    if (!src || !dst)
+    {
+        free(src);
+        free(dst);
+        return start_workers(fc, 1);
+    }
+    memset(src, 0x5A, calibrationSize);
+    memset(dst, 0, calibrationSize);
+
+    double bandwidth[FRAME_COPY_MAX_THREADS + 1] = {0};
+    double best = 0.0;
+    for (int t = 1; t <= maxThreads; t++)
+    {
+        int failed = start_workers(fc, t);
+        if (!failed)
+            bandwidth[t] = measure_bandwidth(fc, dst, src, calibrationSize);
+        frame_copy_destroy(fc);
+        if (failed)
+            break;
+        if (bandwidth[t] > best)
+            best = bandwidth[t];
+    }
+    free(src);
+    free(dst);
+
+    // more threads than the memory bus can feed only add wakeup latency
+    int chosen = 1;
+    while (chosen < maxThreads && bandwidth[chosen] < FRAME_COPY_GOOD_ENOUGH * best)
+        chosen++;
+    printf("frame_copy: %.2f GB/s with %d threads (best %.2f GB/s of 1..%d)\n", bandwidth[chosen], chosen, best, maxThreads);
+    return start_workers(fc, chosen);
+}
+
+void frame_copy(frame_copy_t *fc, void *dst, const void *src, size_t size)
+{
+    uint64_t start = frame_clock_ns();
+    if (fc->threads <= 1)
+    {
+        frame_copy_stream(dst, src, size);
+    }
+    else
+    {
+        fc->dst = dst;
+        fc->src = src;
+        fc->size = size;
+        // the caller copies stripes too, so it is never idle while the workers run
+        worker_pool_run(&fc->pool, copy_task, fc, fc->threads);
+    }
+    fc->copyNs += frame_clock_ns() - start;
+    fc->copies++;
+    fc->bytes += size;
+}
+
+void frame_copy_print_stats(frame_copy_t *fc)
+{
+    printf("Frame copy: %d threads, %lu copies, avg %.3f ms, %.2f GB/s\n", fc->threads, (unsigned long)fc->copies,
+           fc->copies ? fc->copyNs / 1e6 / fc->copies : 0.0, fc->copyNs ? fc->bytes / (double)fc->copyNs : 0.0);
+}
+
+void frame_copy_destroy(frame_copy_t *fc)
+{
+    worker_pool_destroy(&fc->pool);
+}
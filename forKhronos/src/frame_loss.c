@@ -0,0 +1,93 @@
+#include "myCode/frame_loss.h"
+#include <stdio.h>
+
+void frame_loss_init(frame_loss_t *loss, uint32_t bufferCount, double fps, int64_t rxFrameCounter)
+{
+    loss->bufferCount = bufferCount;
+    loss->lastBufferID = 0;
+    loss->lastTimestamp = 0;
+    loss->periodNs = fps > 0 ? (uint64_t)(1e9 / fps) : 0;
+    loss->haveLast = 0;
+    atomic_init(&loss->sequenceGaps, 0);
+    loss->rxStart = rxFrameCounter;
+    loss->rxFrames = -1;
+    loss->delivered = 0;
+    loss->grabberLost = 0;
+    for (int i = 0; i < 4; i++)
+        loss->reported[i] = 0;
+}
+
+void frame_loss_frame(frame_loss_t *loss, const frame_desc_t *frame)
+{
+    uint64_t missing = 0;
+
+    if (loss->haveLast)
+    {
+        if (loss->bufferCount)
+        {
+            // auto cycling streams fill their buffers round robin, a skipped ID is a frame that never arrived
+            // (a whole lap of bufferCount frames cannot be told apart from none)
+            missing = (frame->bufferID + loss->bufferCount - loss->lastBufferID - 1) % loss->bufferCount;
+        }
+        else if (loss->periodNs && frame->timestamp > loss->lastTimestamp)
+        {
+            // more than one and a half frame periods between frames
+            uint64_t delta = frame->timestamp - loss->lastTimestamp;
+            if (2 * delta > 3 * loss->periodNs)
+                missing = (delta + loss->periodNs / 2) / loss->periodNs - 1;
+        }
+        if (missing)
+            atomic_fetch_add_explicit(&loss->sequenceGaps, missing, memory_order_relaxed);
+    }
+    loss->lastBufferID = frame->bufferID;
+    loss->lastTimestamp = frame->timestamp;
+    loss->haveLast = 1;
+}
+
+void frame_loss_sample(frame_loss_t *loss, frame_ring_t *ring, int64_t rxFrameCounter)
+{
+    if (loss->rxStart < 0 || rxFrameCounter < loss->rxStart)
+        return;
+    loss->delivered = atomic_load_explicit(&ring->produced, memory_order_relaxed);
+    loss->rxFrames = rxFrameCounter - loss->rxStart;
+    // a frame counted by the grabber whose callback has not run yet is not lost, it shows up in the next sample
+    if ((uint64_t)loss->rxFrames > loss->delivered + loss->grabberLost)
+        loss->grabberLost = loss->rxFrames - loss->delivered;
+}
+
+static void current(frame_loss_t *loss, frame_ring_t *ring, uint64_t counters[4])
+{
+    counters[0] = loss->grabberLost;
+    counters[1] = atomic_load_explicit(&ring->overwritten, memory_order_relaxed);
+    counters[2] = atomic_load_explicit(&ring->skipped, memory_order_relaxed);
+    counters[3] = atomic_load_explicit(&loss->sequenceGaps, memory_order_relaxed);
+}
+
+int frame_loss_changed(frame_loss_t *loss, frame_ring_t *ring)
+{
+    uint64_t counters[4];
+    int changed = 0;
+    current(loss, ring, counters);
+    for (int i = 0; i < 4; i++)
+    {
+        changed |= counters[i] != loss->reported[i];
+        loss->reported[i] = counters[i];
+    }
+    return changed;
+}
+
+void frame_loss_print(frame_loss_t *loss, frame_ring_t *ring)
+{
+    uint64_t counters[4];
+    current(loss, ring, counters);
+    uint64_t displayed = atomic_load_explicit(&ring->consumed, memory_order_relaxed);
+
+    if (loss->rxFrames >= 0)
+        printf("Frames received by grabber: %ld, delivered: %lu, displayed: %lu\n", (long)loss->rxFrames,
+               (unsigned long)loss->delivered, (unsigned long)displayed);
+    else
+        printf("Frames delivered: %lu, displayed: %lu (RXFrameCounter not available)\n",
+               (unsigned long)atomic_load_explicit(&ring->produced, memory_order_relaxed), (unsigned long)displayed);
+    printf("Lost in grabber: %lu, overwritten in handoff: %lu, skipped by renderer: %lu, sequence gaps: %lu\n",
+           (unsigned long)counters[0], (unsigned long)counters[1], (unsigned long)counters[2], (unsigned long)counters[3]);
+}
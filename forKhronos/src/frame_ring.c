@@ -0,0 +1,111 @@
+#include "myCode/frame_ring.h"
+#include <stdio.h>
+
+#define FRAME_RING_MASK (FRAME_RING_SIZE - 1)
+
+static void slot_load(frame_slot_t *slot, frame_desc_t *frame)
+{
+    frame->bufferHandle = atomic_load_explicit(&slot->bufferHandle, memory_order_relaxed);
+    frame->base = (uint8_t *)atomic_load_explicit(&slot->base, memory_order_relaxed);
+    frame->bufferID = atomic_load_explicit(&slot->bufferID, memory_order_relaxed);
+    frame->timestamp = atomic_load_explicit(&slot->timestamp, memory_order_relaxed);
+    frame->receivedNs = atomic_load_explicit(&slot->receivedNs, memory_order_relaxed);
+}
+
+void frame_ring_init(frame_ring_t *ring, frame_release_fn release, void *releaseContext)
+{
+    ring->release = release;
+    ring->releaseContext = releaseContext;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->produced, 0);
+    atomic_init(&ring->overwritten, 0);
+    atomic_init(&ring->consumed, 0);
+    atomic_init(&ring->skipped, 0);
+    for (int i = 0; i < FRAME_RING_SIZE; i++)
+    {
+        atomic_init(&ring->slots[i].bufferHandle, 0);
+        atomic_init(&ring->slots[i].base, 0);
+        atomic_init(&ring->slots[i].bufferID, 0);
+        atomic_init(&ring->slots[i].timestamp, 0);
+        atomic_init(&ring->slots[i].receivedNs, 0);
+    }
+}
+
+void frame_ring_push(frame_ring_t *ring, const frame_desc_t *frame)
+{
+    uint_fast64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint_fast64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    // ring full: retire the oldest frame so the slot at head is free to reuse
+    while (head - tail >= FRAME_RING_SIZE)
+    {
+        if (atomic_compare_exchange_weak_explicit(&ring->tail, &tail, tail + 1, memory_order_acq_rel, memory_order_acquire))
+        {
+            atomic_fetch_add_explicit(&ring->overwritten, 1, memory_order_relaxed);
+            if (ring->release)
+            {
+                // only the producer writes slots, so the retired one still holds what we put there
+                frame_desc_t retired;
+                slot_load(&ring->slots[tail & FRAME_RING_MASK], &retired);
+                ring->release(&retired, ring->releaseContext);
+            }
+            break;
+        }
+    }
+
+    frame_slot_t *slot = &ring->slots[head & FRAME_RING_MASK];
+    atomic_store_explicit(&slot->bufferHandle, frame->bufferHandle, memory_order_relaxed);
+    atomic_store_explicit(&slot->base, (uintptr_t)frame->base, memory_order_relaxed);
+    atomic_store_explicit(&slot->bufferID, frame->bufferID, memory_order_relaxed);
+    atomic_store_explicit(&slot->timestamp, frame->timestamp, memory_order_relaxed);
+    atomic_store_explicit(&slot->receivedNs, frame->receivedNs, memory_order_relaxed);
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    atomic_fetch_add_explicit(&ring->produced, 1, memory_order_relaxed);
+}
+
+int frame_ring_pop_latest(frame_ring_t *ring, frame_desc_t *frame)
+{
+    uint_fast64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    for (;;)
+    {
+        uint_fast64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (head == tail)
+            return 0;
+        // the producer lapped us between the two loads, the slots past the old tail are no longer ours to read
+        if (head - tail > FRAME_RING_SIZE)
+        {
+            tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+            continue;
+        }
+
+        slot_load(&ring->slots[(head - 1) & FRAME_RING_MASK], frame);
+
+        // skipped slots may be reused by the producer as soon as the tail moves, read them first
+        frame_desc_t skipped[FRAME_RING_SIZE];
+        uint_fast64_t skippedCount = ring->release ? head - 1 - tail : 0;
+        for (uint_fast64_t i = 0; i < skippedCount; i++)
+            slot_load(&ring->slots[(tail + i) & FRAME_RING_MASK], &skipped[i]);
+
+        // the slots can only have been rewritten if the producer moved the tail past them,
+        // in which case the exchange fails and we retry with the new tail
+        if (atomic_compare_exchange_weak_explicit(&ring->tail, &tail, head, memory_order_acq_rel, memory_order_acquire))
+        {
+            atomic_fetch_add_explicit(&ring->consumed, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&ring->skipped, head - tail - 1, memory_order_relaxed);
+            for (uint_fast64_t i = 0; i < skippedCount; i++)
+                ring->release(&skipped[i], ring->releaseContext);
+            return 1;
+        }
+    }
+}
+
+void frame_ring_print_stats(frame_ring_t *ring)
+{
+    printf("Frames produced: %lu, consumed: %lu, overwritten: %lu, skipped: %lu\n",
+           (unsigned long)atomic_load(&ring->produced),
+           (unsigned long)atomic_load(&ring->consumed),
+           (unsigned long)atomic_load(&ring->overwritten),
+           (unsigned long)atomic_load(&ring->skipped));
+}
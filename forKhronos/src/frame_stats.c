@@ -0,0 +1,174 @@
+#include "myCode/frame_stats.h"
+#include "myCode/frame_clock.h"
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FRAME_STATS_X86 1
+#endif
+
+// sums and clipped counts of the even and the odd columns of one row
+typedef struct row_sums_t
+{
+    uint64_t sum[2];
+    uint64_t clipped[2];
+} row_sums_t;
+
+static int row_scalar(const uint8_t *row, int x0, int width, uint8_t clipLevel, row_sums_t *sums)
+{
+    for (int x = x0; x < width; x++)
+    {
+        sums->sum[x & 1] += row[x];
+        sums->clipped[x & 1] += row[x] >= clipLevel;
+    }
+    return width;
+}
+
+#ifdef FRAME_STATS_X86
+// returns the first column it did not process, always even
+__attribute__((target("sse4.1"))) static int row_sse41(const uint8_t *row, int width, uint8_t clipLevel, row_sums_t *sums)
+{
+    __m128i evenBytes = _mm_set1_epi16(0x00FF), clip = _mm_set1_epi8((char)clipLevel), zero = _mm_setzero_si128();
+    __m128i even = zero, odd = zero;
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(row + x));
+        // psadbw adds 8 bytes at once, the other column's bytes are zeroed first
+        even = _mm_add_epi64(even, _mm_sad_epu8(_mm_and_si128(v, evenBytes), zero));
+        odd = _mm_add_epi64(odd, _mm_sad_epu8(_mm_srli_epi16(v, 8), zero));
+        unsigned clipped = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, clip), v));
+        sums->clipped[0] += __builtin_popcount(clipped & 0x5555u);
+        sums->clipped[1] += __builtin_popcount(clipped & 0xAAAAu);
+    }
+    sums->sum[0] += (uint64_t)_mm_cvtsi128_si64(even) + (uint64_t)_mm_extract_epi64(even, 1);
+    sums->sum[1] += (uint64_t)_mm_cvtsi128_si64(odd) + (uint64_t)_mm_extract_epi64(odd, 1);
+    return x;
+}
+
+__attribute__((target("avx2"))) static int row_avx2(const uint8_t *row, int width, uint8_t clipLevel, row_sums_t *sums)
+{
+    __m256i evenBytes = _mm256_set1_epi16(0x00FF), clip = _mm256_set1_epi8((char)clipLevel), zero = _mm256_setzero_si256();
+    __m256i even = zero, odd = zero;
+    int x = 0;
+    for (; x + 32 <= width; x += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(row + x));
+        even = _mm256_add_epi64(even, _mm256_sad_epu8(_mm256_and_si256(v, evenBytes), zero));
+        odd = _mm256_add_epi64(odd, _mm256_sad_epu8(_mm256_srli_epi16(v, 8), zero));
+        uint32_t clipped = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(v, clip), v));
+        sums->clipped[0] += __builtin_popcount(clipped & 0x55555555u);
+        sums->clipped[1] += __builtin_popcount(clipped & 0xAAAAAAAAu);
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, even);
+    sums->sum[0] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_storeu_si256((__m256i *)lanes, odd);
+    sums->sum[1] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    return x;
+}
+#endif
+
+static void row_sums(const uint8_t *row, int width, uint8_t clipLevel, row_sums_t *sums)
+{
+    int x = 0;
+#ifdef FRAME_STATS_X86
+    if (__builtin_cpu_supports("avx2"))
+        x = row_avx2(row, width, clipLevel, sums);
+    else if (__builtin_cpu_supports("sse4.1"))
+        x = row_sse41(row, width, clipLevel, sums);
+#endif
+    row_scalar(row, x, width, clipLevel, sums);
+}
+
+static void stats_bayer(frame_stats_t *stats, const uint8_t *src, size_t stride, int width, int height,
+                        bayer_pattern_t pattern, int step, uint8_t clipLevel, uint64_t sum[3], uint64_t clipped[3])
+{
+    int redX = bayer_red_x(pattern), redY = bayer_red_y(pattern);
+    for (int y = 0; y + 1 < height; y += 2 * step)
+    {
+        const uint8_t *rows[2] = {src + y * stride, src + (y + 1) * stride};
+        for (int r = 0; r < 2; r++)
+        {
+            // a red row holds red and green, a blue row green and blue; columns alternate starting at redX
+            int blueRow = ((y + r + redY) & 1) != 0;
+            int colorAtRedX = blueRow ? 1 : 0, colorBesideRedX = blueRow ? 2 : 1;
+            row_sums_t sums = {{0, 0}, {0, 0}};
+            row_sums(rows[r], width, clipLevel, &sums);
+            for (int parity = 0; parity < 2; parity++)
+            {
+                int color = parity == redX ? colorAtRedX : colorBesideRedX;
+                sum[color] += sums.sum[parity];
+                clipped[color] += sums.clipped[parity];
+                stats->pixels[color] += (width - parity + 1) / 2;
+            }
+        }
+        for (int x = 0; x + 1 < width; x += 2 * step)
+        {
+            for (int r = 0; r < 2; r++)
+            {
+                for (int c = 0; c < 2; c++)
+                {
+                    int blue = ((y + r + redY) & 1) != 0, atRedX = ((x + c + redX) & 1) == 0;
+                    int color = atRedX ? (blue ? 1 : 0) : (blue ? 2 : 1);
+                    stats->histogram[color][rows[r][x + c]]++;
+                }
+            }
+        }
+    }
+}
+
+static void stats_rgb(frame_stats_t *stats, const uint8_t *src, size_t stride, int width, int height, int channels,
+                      int step, uint8_t clipLevel, uint64_t sum[3], uint64_t clipped[3])
+{
+    for (int y = 0; y < height; y += 2 * step)
+    {
+        const uint8_t *row = src + y * stride;
+        for (int x = 0; x < width; x++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                sum[c] += row[x * channels + c];
+                clipped[c] += row[x * channels + c] >= clipLevel;
+            }
+            if (x % (2 * step) == 0)
+                for (int c = 0; c < 3; c++)
+                    stats->histogram[c][row[x * channels + c]]++;
+        }
+        for (int c = 0; c < 3; c++)
+            stats->pixels[c] += width;
+    }
+}
+
+void frame_stats_compute(frame_stats_t *stats, const uint8_t *src, size_t stride, int width, int height, int channels,
+                         bayer_pattern_t pattern, int step, uint8_t clipLevel)
+{
+    uint64_t start = frame_clock_ns();
+    uint64_t sum[3] = {0, 0, 0}, clipped[3] = {0, 0, 0};
+    memset(stats, 0, sizeof(*stats));
+    if (step < 1)
+        step = 1;
+    if (channels == 1)
+        stats_bayer(stats, src, stride, width, height, pattern, step, clipLevel, sum, clipped);
+    else
+        stats_rgb(stats, src, stride, width, height, channels, step, clipLevel, sum, clipped);
+    for (int c = 0; c < 3; c++)
+    {
+        for (int i = 0; i < 256; i++)
+            stats->histogramSamples[c] += stats->histogram[c][i];
+        stats->mean[c] = stats->pixels[c] ? sum[c] / (double)stats->pixels[c] : 0.0;
+        stats->clippedFraction[c] = stats->pixels[c] ? clipped[c] / (double)stats->pixels[c] : 0.0;
+    }
+    stats->computeNs = frame_clock_ns() - start;
+}
+
+int frame_stats_percentile(const frame_stats_t *stats, int channel, double fraction)
+{
+    uint64_t wanted = (uint64_t)(fraction * stats->histogramSamples[channel]), seen = 0;
+    for (int i = 0; i < 256; i++)
+    {
+        seen += stats->histogram[channel][i];
+        if (seen > wanted)
+            return i;
+    }
+    return 255;
+}
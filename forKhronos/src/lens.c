@@ -0,0 +1,187 @@
+#include "myCode/lens.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// zoom search range and steps, far more than double precision needs
+#define ZOOM_MIN 0.25
+#define ZOOM_MAX 8.0
+#define ZOOM_STEPS 60
+
+int lens_model_load(lens_model_t *lens, const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        printf("Cannot open lens calibration %s\n", path);
+        return -1;
+    }
+    struct
+    {
+        const char *name;
+        double *value;
+    } fields[] = {{"width", &lens->width}, {"height", &lens->height}, {"fx", &lens->fx}, {"fy", &lens->fy},
+                  {"cx", &lens->cx}, {"cy", &lens->cy}, {"k1", &lens->k1}, {"k2", &lens->k2},
+                  {"k3", &lens->k3}, {"p1", &lens->p1}, {"p2", &lens->p2}};
+    memset(lens, 0, sizeof(*lens));
+
+    char line[256], name[32];
+    double value;
+    while (fgets(line, sizeof(line), file))
+    {
+        if (line[0] == '#' || sscanf(line, "%31s %lf", name, &value) != 2)
+            continue;
+        size_t i = 0;
+        while (i < sizeof(fields) / sizeof(fields[0]) && strcmp(fields[i].name, name))
+            i++;
+        if (i < sizeof(fields) / sizeof(fields[0]))
+            *fields[i].value = value;
+        else
+            printf("%s: unknown lens parameter '%s'\n", path, name);
+    }
+    fclose(file);
+    if (lens->fx <= 0 || lens->fy <= 0)
+    {
+        printf("%s: fx and fy must be positive\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+void lens_model_for_region(const lens_model_t *lens, int64_t offsetX, int64_t offsetY, int64_t pixelScale,
+                           lens_model_t *region)
+{
+    double scale = pixelScale > 0 ? (double)pixelScale : 1.0;
+    *region = *lens;
+    // a binned pixel is centred on the middle of the sensor pixels it sums
+    region->width = lens->width / scale;
+    region->height = lens->height / scale;
+    region->fx = lens->fx / scale;
+    region->fy = lens->fy / scale;
+    region->cx = (lens->cx - (scale - 1) / 2) / scale - offsetX;
+    region->cy = (lens->cy - (scale - 1) / 2) / scale - offsetY;
+}
+
+static void distort_normalized(const lens_model_t *lens, double xn, double yn, double *xd, double *yd)
+{
+    double r2 = xn * xn + yn * yn;
+    double radial = 1 + r2 * (lens->k1 + r2 * (lens->k2 + r2 * lens->k3));
+    *xd = xn * radial + 2 * lens->p1 * xn * yn + lens->p2 * (r2 + 2 * xn * xn);
+    *yd = yn * radial + lens->p1 * (r2 + 2 * yn * yn) + 2 * lens->p2 * xn * yn;
+}
+
+void lens_model_distort(const lens_model_t *lens, double x, double y, double *distortedX, double *distortedY)
+{
+    double xd, yd;
+    distort_normalized(lens, (x - lens->cx) / lens->fx, (y - lens->cy) / lens->fy, &xd, &yd);
+    *distortedX = lens->fx * xd + lens->cx;
+    *distortedY = lens->fy * yd + lens->cy;
+}
+
+// ideal pixel of grid vertex (column, row), row 0 at the top of the image
+static void grid_point(const lens_model_t *lens, int width, int height, int columns, int rows, double zoom, int column,
+                       int row, double *x, double *y)
+{
+    double idealX = (double)column * width / columns - 0.5, idealY = (double)row * height / rows - 0.5;
+    double xd, yd;
+    distort_normalized(lens, (idealX - lens->cx) / (lens->fx * zoom), (idealY - lens->cy) / (lens->fy * zoom), &xd, &yd);
+    *x = lens->fx * xd + lens->cx;
+    *y = lens->fy * yd + lens->cy;
+}
+
+// the border vertices are the outermost samples, the inside follows for any sane lens
+static int border_fits(const lens_model_t *lens, int width, int height, int columns, int rows, double zoom)
+{
+    for (int row = 0; row <= rows; row++)
+    {
+        int step = row == 0 || row == rows ? 1 : columns;
+        for (int column = 0; column <= columns; column += step)
+        {
+            double x, y;
+            grid_point(lens, width, height, columns, rows, zoom, column, row, &x, &y);
+            // a texel edge is half a pixel beyond its centre
+            if (x < -0.5 - 1e-6 || y < -0.5 - 1e-6 || x > width - 0.5 + 1e-6 || y > height - 0.5 + 1e-6)
+                return 0;
+        }
+    }
+    return 1;
+}
+
+static double fit_zoom(const lens_model_t *lens, int width, int height, int columns, int rows)
+{
+    double low = ZOOM_MIN, high = ZOOM_MAX;
+    if (border_fits(lens, width, height, columns, rows, low))
+        return low;
+    for (int i = 0; i < ZOOM_STEPS; i++)
+    {
+        double middle = (low + high) / 2;
+        if (border_fits(lens, width, height, columns, rows, middle))
+            high = middle;
+        else
+            low = middle;
+    }
+    return high;
+}
+
+static float clamp01(double v)
+{
+    return v < 0 ? 0.0f : (v > 1 ? 1.0f : (float)v);
+}
+
+int lens_mesh_build(lens_mesh_t *mesh, const lens_model_t *lens, int width, int height, int columns, int rows,
+                    float left, float bottom, float right, float top, double zoom)
+{
+    memset(mesh, 0, sizeof(*mesh));
+    mesh->vertexCount = (columns + 1) * (rows + 1);
+    mesh->indexCount = columns * rows * 6;
+    mesh->vertices = malloc(sizeof(float) * LENS_MESH_VERTEX_FLOATS * mesh->vertexCount);
+    mesh->indices = malloc(sizeof(uint32_t) * mesh->indexCount);
+    if (!mesh->vertices || !mesh->indices)
+    {
+        lens_mesh_free(mesh);
+        return -1;
+    }
+    mesh->zoom = zoom > 0 ? zoom : fit_zoom(lens, width, height, columns, rows);
+
+    float *vertex = mesh->vertices;
+    for (int row = 0; row <= rows; row++)
+    {
+        for (int column = 0; column <= columns; column++)
+        {
+            double x, y;
+            grid_point(lens, width, height, columns, rows, mesh->zoom, column, row, &x, &y);
+            *vertex++ = left + (right - left) * column / columns;
+            *vertex++ = top - (top - bottom) * row / rows;
+            *vertex++ = 0.0f;
+            // the vertex shader flips v, image row 0 is at the top of the screen
+            *vertex++ = clamp01((x + 0.5) / width);
+            *vertex++ = 1.0f - clamp01((y + 0.5) / height);
+        }
+    }
+
+    // two triangles per cell, wound like the quad
+    uint32_t *index = mesh->indices;
+    for (int row = 0; row < rows; row++)
+    {
+        for (int column = 0; column < columns; column++)
+        {
+            uint32_t topLeft = row * (columns + 1) + column, bottomLeft = topLeft + columns + 1;
+            *index++ = topLeft + 1;
+            *index++ = bottomLeft + 1;
+            *index++ = topLeft;
+            *index++ = bottomLeft + 1;
+            *index++ = bottomLeft;
+            *index++ = topLeft;
+        }
+    }
+    return 0;
+}
+
+void lens_mesh_free(lens_mesh_t *mesh)
+{
+    free(mesh->vertices);
+    free(mesh->indices);
+    mesh->vertices = NULL;
+    mesh->indices = NULL;
+    mesh->vertexCount = mesh->indexCount = 0;
+}
@@ -19,18 +19,77 @@
 #include "myCode/window.h"
 #include "myCode/grabber.h"
 #include "myCode/camera.h"
+#include "myCode/acquisition.h"
+#include "myCode/upload_ring.h"
+#include "myCode/frame_copy.h"
+#include "myCode/demosaic_gl.h"
+#include "myCode/color_gl.h"
+#include "myCode/telemetry.h"
+#include "myCode/auto_exposure.h"
+#include "myCode/auto_white_balance.h"
+#include "myCode/lens.h"
+#include "myCode/flat_field_gl.h"
+#include "myCode/pyramid_gl.h"
+#include "myCode/recorder.h"
+#include "myCode/pretrigger.h"
+#include <signal.h>
+#include <sys/stat.h>
+#include <time.h>
 
 // screen resolution
 const GLuint SCR_WIDTH = 1920;
 const GLuint SCR_HEIGHT = 1080;
 
-const GLuint texWidth = 2048;
-const GLuint texHeight = 1536;
+// sensor region of interest and binning, the first preset is applied at start and R steps through them while running.
+// Streams, textures and upload rings are recreated at the new size; a centre crop at a higher frame rate is often worth
+// more than the full sensor. Offsets of -1 centre the region, sizes of 0 take the whole (binned) sensor
+const acq_geometry_t geometryPresets[] = {
+    {.width = 2048, .height = 1536, .offsetX = -1, .offsetY = -1, .binning = 1, .decimation = 1, .frameRate = 0.0},
+    {.width = 1024, .height = 768, .offsetX = -1, .offsetY = -1, .binning = 1, .decimation = 1, .frameRate = 120.0},
+    {.width = 0, .height = 0, .offsetX = -1, .offsetY = -1, .binning = 2, .decimation = 1, .frameRate = 0.0}};
+const int geometryPresetCount = sizeof(geometryPresets) / sizeof(geometryPresets[0]);
+int geometryPreset = 0;
+int requestedGeometryPreset = 0; // set by processInput, applied at the top of the render loop
+
+// DEMOSAIC_NONE lets the grabber debayer to RGB8, anything else keeps the sensor's Bayer data all the way to the
+// GPU (a third of the bytes over PCIe, through the copy and the upload) and demosaics in the fragment shader
+const demosaic_quality_t gpuDemosaic = DEMOSAIC_MALVAR;
+const bayer_pattern_t sensorPattern = BAYER_RG;
+
+// camera textures are drawn close to 1:1, mips are only built while a tile shows them minified
+const mip_policy_t videoMipPolicy = MIP_ON_DEMAND;
+const GLint videoMipLevels = 0; // cap on the mip chain, 0 for the full chain
 /**********************************************/
 
-int FLAG = 0;
-
-uint8_t *pFrameMemory = NULL;
+// acquisition mode, see myCode/acquisition.h
+const int acquisitionMode = ACQ_MODE_ZERO_COPY;
+const GLuint zeroCopyBuffers = 8;
+const GLuint uploadRingBuffers = 3; // PBOs per camera for the copying modes, frame N+1 is written while N uploads
+const int frameCopyThreads = 0;     // striped non-temporal copy into the upload ring, 0 picks from measured bandwidth
+frame_copy_t frameCopy;
+const uint32_t autoCycleBuffers = 60;
+const uint32_t queuedBuffers = 0; // 0 sizes the queue from the consumer latency and the camera frame rate
+const uint32_t maxQueuedBuffers = 16; // a slow consumer never makes the queue hold more frames than this
+const double expectedConsumerLatencyMs = 25.0; // first start only, a geometry change resizes from the measured hold time
+const double frameLossSampleSeconds = 1.0; // how often RXFrameCounter is compared with delivered frames
+
+// every camera on every grabber, each with its own stream and frame ring
+acq_engine_t engine;
+
+// recordings played instead of the grabbers when replayFileCount > 0, one camera each, see myCode/replay.h. The whole
+// display and processing pipeline runs on them as on live frames, so it can be benchmarked on any machine; they must
+// have the pixel format of gpuDemosaic and sensorPattern
+const char *const replayFiles[] = {"./recordings/camera0.seq"};
+const int replayFileCount = 0;
+const replay_config_t replayConfig = {
+    .speed = 1.0, // at the recorded timestamps, 0 as fast as the render loop takes the frames
+    .loop = 1,
+    .readaheadFrames = 8,
+    .decodeThreads = 0}; // compressed recordings are inflated on every CPU
+
+// per-stage latency histograms, printed every telemetryDumpSeconds and on exit
+const double telemetryDumpSeconds = 10.0;
+telemetry_t telemetry;
 
 // void* mappedBuffer;
 
@@ -38,22 +97,139 @@ const float exposureTime = 9700.0;
 const float analogBlackLevel = 20.0;
 const float analogGainLevel = 1.50;
 
-// CCM
-const float RR = 1.0;
-const float RG = 0.0;
-const float RB = 0.0;
-const float R00 = 0.0;
-const float GR = 0.0;
-const float GG = 1.0;
-const float GB = 0.0;
-const float G00 = 0.0;
-const float BR = 0.0;
-const float BG = 0.0;
-const float BB = 2.0;
-const float B00 = 0;
-
-static void Stream_callback_func(STREAM_BUFFER_HANDLE streamBufferHandle, void *userContext);
+// software auto exposure: statistics of the frame in grabber memory drive ExposureTime and AnalogGainLevel, starting
+// from the values above. Zero copy frames land in write-only mapped GL memory, there the statistics come from the
+// readback of image pyramid level statsPyramidLevel
+const int autoExposure = 1;
+const int statsGridStep = 8;          // histogram grid, in 2x2 cells
+const uint8_t statsClipLevel = 250;
+const auto_exposure_config_t autoExposureConfig = {
+    .targetMean = 110.0,
+    .blackLevel = 20.0, // analogBlackLevel
+    .tolerance = 0.08,
+    .maxClippedFraction = 0.01,
+    .minExposureUs = 20.0,
+    .maxExposureUs = 16000.0, // stays inside the frame period at 60 fps
+    .minGain = 1.0,
+    .maxGain = 8.0,
+    .maxStep = 2.0,
+    .updatesPerSecond = 4.0};
+auto_exposure_t *autoExposures;
+frame_stats_t frameStats;
+
+// software white balance of awbCamera in a background thread, its gains replace displayColor.gains. All tiles share
+// the display colour correction. Zero copy frames are sampled from the pyramid readback like autoExposure
+const int autoWhiteBalance = 1;
+const int awbCamera = 0;
+const awb_config_t awbConfig = {
+    .method = AWB_COMBINED,
+    .decimation = 8,
+    .blackLevel = 20.0, // analogBlackLevel
+    .clipLevel = 250,
+    .whitePatchFraction = 0.02,
+    .smoothingSeconds = 2.0,
+    .minGain = 0.25,
+    .maxGain = 4.0,
+    .updatesPerSecond = 5.0};
+awb_t awb;
+
+// image pyramid: 1/2, 1/4 and 1/8 RGBA8 versions of every camera texture made by a compute shader, see
+// myCode/pyramid_gl.h. A level is only computed while something subscribes to it, so it costs nothing in the copying
+// modes; in zero copy mode auto exposure and white balance read statsPyramidLevel back asynchronously. Raw, not
+// flat field corrected
+const downscale_filter_t pyramidFilter = DOWNSCALE_BOX;
+const int statsPyramidLevel = 2; // 1/8, each pixel a 16x16 region of the frame
+pyramid_gl_t *pyramids;
+
+// colour correction, rows R, G, B; columns R, G, B and offset
+const color_params_t displayColor = {
+    .ccm = {{1.0f, 0.0f, 0.0f, 0.0f},
+            {0.0f, 1.0f, 0.0f, 0.0f},
+            {0.0f, 0.0f, 1.0f, 0.0f}},
+    .gains = {1.0f, 1.0f, 2.0f}, // white balance before the matrix, where autoWhiteBalance starts from
+    .blackLevel = 0.0f, // 8 bit counts subtracted before the matrix
+    .gamma = 1.0f};
+// 0 - applied by the display shader from a uniform block, can change every frame (color_gl_set from any thread)
+// 1 - written once into the grabber's ColorTransformation registers, so CPU consumers of the stream get corrected
+//     pixels too; the grabber applies them to its RGB8 output only (gpuDemosaic == DEMOSAIC_NONE)
+const int grabberColorCorrection = 0;
+color_gl_t color;
+
+// lens undistortion: tiles are drawn on a warp mesh whose texture coordinates carry the Brown-Conrady distortion of
+// the calibration, so it costs nothing per pixel over the plain quad. The calibration is of the full sensor, the mesh
+// is rebuilt for camera 0's region and binning whenever they change, every tile uses it. NULL or a missing file draws
+// the plain quad
+const char *lensCalibrationFile = "./data/lens_calibration.txt";
+const int lensMeshColumns = 64;
+const int lensMeshRows = 48;
+const double lensZoom = 0.0; // 0 fits the widest view that does not smear the frame's border pixels
+lens_model_t lens;
+int lensCalibrated;
+GLsizei quadIndexCount = 6; // indices drawn per tile, the quad's or the mesh's
+
+// flat field: dark level, gain and defective pixel correction of the raw frames, see myCode/flat_field.h. D captures
+// the dark reference (lens capped), F the flat one (even light, nothing clipped), each from flatFieldFrames frames of
+// every camera at the current ExposureTime and region; the maps are rebuilt and saved to flatFieldFile after each and
+// loaded from it at start. Capturing needs a copying acquisition mode. C toggles the correction. Raw Bayer only
+const char *flatFieldFile = "./data/flat_field_cam%d.bin";
+const int flatFieldFrames = 32;
+const flat_field_config_t flatFieldConfig = {.hotCounts = 24.0, .maxResponseDeviation = 0.5};
+// 0 - corrected by the display shader as it fetches raw texels
+// 1 - corrected on flatFieldThreads CPUs while the frame is copied into the upload ring (copying modes only, zero copy
+//     frames stay with the shader)
+const int flatFieldOnCpu = 0;
+const int flatFieldThreads = 2;
+int flatFieldEnabled = 1;
+int flatFieldRequest = -1; // reference to capture, set by processInput
+flat_field_t *flatFields;
+flat_field_gl_t *flatFieldMaps;
+flat_field_capture_t *flatFieldCaptures;
+worker_pool_t flatFieldPool;
+
+// raw recording: V starts and stops writing every frame of every camera to recordingFile (camera index, start time),
+// see myCode/recorder.h. The files are myCode/sequence.h sequences, with the pixel format and displayColor in the
+// header and an index of the frames' timestamps at the end. The grabber callback copies each frame into a staging
+// slot, a frame finding every slot still waiting for the disk is dropped and counted. Needs a copying acquisition
+// mode, zero copy frames are write-only mapped
+const char *recordingDirectory = "./recordings";
+const char *recordingFile = "./recordings/camera%d_%ld.seq";
+const recorder_config_t recorderConfig = {
+    .slots = 24, // 0.4 s at 60 fps, 226 MB per camera of RGB8 frames
+    .writers = 3,
+    .preallocateSeconds = 10.0,
+    .direct = 1,
+    .backend = RECORDER_AUTO,
+    // 0 records uncompressed. 1 (Z_BEST_SPEED) writes lossless tiles, about half the disk bandwidth on sensor data,
+    // at ~60 MB/s per thread, so a 60 fps RGB8 camera needs about 10 compression threads
+    .compressionLevel = 0,
+    .compressionStrategy = Z_RLE, // as small as the default strategy on filtered noisy data, faster
+    .compressionThreads = 8,
+    .tileRows = 64};
+int recording = 0;
+int recordingRequest = 0; // set by processInput
+
+// pre-trigger buffer: the last preSeconds of every camera stay in memory, T or SIGUSR1 (kill -USR1 <pid>) writes them
+// and the next postSeconds to pretriggerFile (camera index, trigger time), see myCode/pretrigger.h. The arenas are
+// mapped once the cameras run and again after a geometry change, their size is printed. Copying acquisition modes only
+const char *pretriggerFile = "./recordings/camera%d_%ld_event.seq";
+const pretrigger_config_t pretriggerConfig = {
+    .preSeconds = 0.0, // 0 leaves it off; 5 s at 60 fps are 944 MB per camera of 2048x1536 Bayer frames
+    .postSeconds = 5.0,
+    .spareFrames = 30, // 0.5 s at 60 fps for the disk to catch up with the ring and the camera, 24 of them in flight
+    .hugePages = 1,
+    .recorder = {.slots = 24, .writers = 3, .preallocateSeconds = 10.0, .direct = 1, .backend = RECORDER_AUTO}};
+volatile sig_atomic_t pretriggerRequest = 0; // set by processInput and SIGUSR1
+
 static void processInput(GLFWwindow *window);
+static void set_recording(int on);
+static void recording_format(const acq_camera_t *camera, sequence_header_t *format);
+static void set_pretrigger(int on);
+static void dump_pretrigger(void);
+static void request_pretrigger(int signal);
+static void finish_flat_field(int cameraIndex);
+static void upload_lens_mesh(GLuint VAO, GLuint VBO, GLuint EBO, const acq_camera_t *camera);
+static void run_auto_exposure(int cameraIndex, acq_camera_t *camera, const downscale_image_t *image, int gridStep);
+static GLsizeiptr camera_frame_size(const acq_camera_t *camera);
 static int KY_init();
 static void first_cam_setup(FGHANDLE handle, CAMHANDLE camHandle, int grabberIndex, int cameraIndex);
 
@@ -86,15 +262,18 @@ int main()
         return -1;
     }
 
-    GLuint *tex = create_textures(3);
-    bind_texture(tex[0]);
-
     GLuint shaders[2];
 
     shaders[0] = load_shader_from_file("./shaders/vertexShader.vert", GL_VERTEX_SHADER);
     shaders[1] = load_shader_from_file("./shaders/fragmentShader.frag", GL_FRAGMENT_SHADER);
     GLuint shaderProgram = create_program(shaders, 2);
     use_program(shaderProgram);
+    demosaic_gl_set(shaderProgram, gpuDemosaic, sensorPattern);
+    color_params_t shaderColor = displayColor;
+    if (grabberColorCorrection)
+        color_params_identity(&shaderColor);
+    color_gl_create(&color, shaderProgram, 0, &shaderColor);
+    flat_field_gl_init(shaderProgram);
 
     GLuint posLoc = get_attrib_location(shaderProgram, "aPos");
     GLuint texLoc = get_attrib_location(shaderProgram, "aTexCoord");
@@ -109,105 +288,322 @@ int main()
     enable_vertex_attrib_array(posLoc, 3, GL_FLOAT, 5 * sizeof(float), (float *)0);
     enable_vertex_attrib_array(texLoc, 2, GL_FLOAT, 5 * sizeof(float), (void *)(3 * sizeof(float)));
 
-    GLuint *streamBuffers = calloc(10, sizeof(GLuint));
-    GLsizeiptr mappedBufferSize = texWidth * texHeight * 3;
-    glGenBuffers(10, streamBuffers);
-    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, streamBuffers[0]);
-    glBufferData(GL_PIXEL_UNPACK_BUFFER, mappedBufferSize, NULL, GL_DYNAMIC_DRAW);
-
-    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, streamBuffers[1]);
-    glBufferData(GL_PIXEL_UNPACK_BUFFER, mappedBufferSize, NULL, GL_DYNAMIC_DRAW);
-
-    
     /************************************/
-    int ret;
-    int grabberIndex = 0;
-    int cameraIndex = 0;
-    FGHANDLE handle[MAXBOARDS] = {INVALID_FGHANDLE};
-    STREAM_HANDLE streamHandle = INVALID_STREAMHANDLE;
-    CAMHANDLE camHandleArray[MAXBOARDS][KY_MAX_CAMERAS];
-    int detectedCameras[MAXBOARDS];
-
-    KY_init();
-    grabber_get_info();
-
-    printf("Selected grabber #%d\n", grabberIndex);
-    connect_to_grabber(&handle[0], grabberIndex);
-
-    int detectionCount = sizeof(camHandleArray) / sizeof(camHandleArray[0]);
-
-    ret = camera_update_list(handle[grabberIndex], camHandleArray[grabberIndex], &detectionCount);
-    printf(" camera_update_list - %x\n", ret);
-
-    detectedCameras[grabberIndex] = detectionCount;
-
-    printf("Found %d cameras.\n", detectedCameras[grabberIndex]);
-
-    if (FGSTATUS_OK == camera_open(camHandleArray[grabberIndex][cameraIndex]))
+    if (replayFileCount > 0)
     {
-        first_cam_setup(handle[grabberIndex], camHandleArray[grabberIndex][cameraIndex], grabberIndex, cameraIndex);
+        if (acq_engine_open_replay(&engine, replayFiles, replayFileCount,
+                                   gpuDemosaic == DEMOSAIC_NONE ? "RGB8" : bayer_pixel_format(sensorPattern)) == 0)
+        {
+            printf("No recording to replay\n");
+            goto exit;
+        }
     }
     else
     {
-        printf("Camera isn't connected\n");
-        goto exit;
-    }
-
-    // let KYFGLib allocate acquisition buffers
-    if (FGSTATUS_OK != KYFG_StreamCreateAndAlloc(camHandleArray[grabberIndex][cameraIndex], &streamHandle, 60, 0))
-    {
-        printf("Failed to allocate buffer.\n");
+        KY_init();
+        grabber_get_info();
+        if (acq_engine_open(&engine, first_cam_setup) == 0)
+        {
+            printf("Camera isn't connected\n");
+            goto exit;
+        }
     }
-    ret = KYFG_StreamBufferCallbackRegister(streamHandle, Stream_callback_func, NULL);
-    printf("KYFG_StreamBufferCallbackRegister - %x\n", ret);
 
-    ret = camera_start(camHandleArray[grabberIndex][cameraIndex], streamHandle, 0);
-    printf("KYFG_CameraStart - %x\n", ret);
-    printf("\nRecording...\n");
+    acq_config_t acqConfig = {
+        .mode = acquisitionMode,
+        .zeroCopyBuffers = zeroCopyBuffers,
+        .autoCycleBuffers = autoCycleBuffers,
+        .queuedBuffers = queuedBuffers,
+        .maxQueuedBuffers = maxQueuedBuffers,
+        .expectedConsumerLatencyMs = expectedConsumerLatencyMs,
+        .lossSampleSeconds = frameLossSampleSeconds,
+        .geometry = geometryPresets[0],
+        .replay = replayConfig,
+    };
+    int startedCameras = acq_engine_start(&engine, &acqConfig);
+    set_pretrigger(1);
+    signal(SIGUSR1, request_pretrigger);
+    lensCalibrated = lensCalibrationFile && lens_model_load(&lens, lensCalibrationFile) == 0;
+    upload_lens_mesh(VAOs[0], VBOs[0], EBOs[0], &engine.cameras[0]);
+    printf("\nRecording from %d cameras...\n", startedCameras);
     printf("\nOpenGL...\n");
 
 
     /****************opengl***********************/
 
-    generate_texture_from_buffer(GL_TEXTURE_2D, GL_RGB, texWidth, texHeight, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    // one texture per camera, plus an upload ring when frames are copied; cameras are tiled over the window
+    int cameraCount = engine.cameraCount;
+    GLuint *tex = create_textures(cameraCount);
+    video_texture_t *videoTextures = calloc(cameraCount, sizeof(video_texture_t));
+    // raw Bayer frames are one byte per pixel, uploaded as a single channel texture
+    GLint texInternalFormat = gpuDemosaic == DEMOSAIC_NONE ? GL_RGB8 : GL_R8;
+    GLenum texFormat = gpuDemosaic == DEMOSAIC_NONE ? GL_RGB : GL_RED;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    upload_ring_t *uploadRings = calloc(cameraCount, sizeof(upload_ring_t));
+    frame_copy_init(&frameCopy, acquisitionMode == ACQ_MODE_ZERO_COPY ? 1 : frameCopyThreads,
+                    cameraCount ? camera_frame_size(&engine.cameras[0]) : 0);
+    for (int i = 0; i < cameraCount; i++)
+    {
+        acq_camera_t *camera = &engine.cameras[i];
+        // a mosaic cannot be filtered into mips, the shader reads single texels of level 0
+        create_video_texture(&videoTextures[i], tex[i], texInternalFormat, camera->width, camera->height,
+                             gpuDemosaic == DEMOSAIC_NONE ? videoMipPolicy : MIP_NONE, videoMipLevels);
+        if (camera->mode != ACQ_MODE_ZERO_COPY && upload_ring_create(&uploadRings[i], uploadRingBuffers, camera_frame_size(camera)))
+            printf("Failed to create upload ring for camera %d.\n", i);
+    }
+    int tileColumns = 1;
+    while (tileColumns * tileColumns < cameraCount)
+        tileColumns++;
+    int tileRows = (cameraCount + tileColumns - 1) / tileColumns;
+    GLsizei tileWidth = SCR_WIDTH / tileColumns;
+    GLsizei tileHeight = SCR_HEIGHT / tileRows;
+    // the quad covers vertices[0] x vertices[1] of its tile
+    GLfloat drawnWidth = tileWidth * vertices[0];
+    GLfloat drawnHeight = tileHeight * vertices[1];
+
+    flatFields = calloc(cameraCount, sizeof(flat_field_t));
+    flatFieldMaps = calloc(cameraCount, sizeof(flat_field_gl_t));
+    flatFieldCaptures = calloc(cameraCount, sizeof(flat_field_capture_t));
+    for (int i = 0; i < cameraCount && gpuDemosaic != DEMOSAIC_NONE; i++)
+    {
+        char path[256];
+        snprintf(path, sizeof(path), flatFieldFile, i);
+        if (flat_field_load(&flatFields[i], path) == 0)
+        {
+            flat_field_gl_upload(&flatFieldMaps[i], &flatFields[i]);
+            printf("Camera %d: flat field from %s, %u defective pixels\n", i, path, flatFields[i].defectCount);
+        }
+    }
+    if (flatFieldOnCpu)
+        worker_pool_init(&flatFieldPool, flatFieldThreads, -1);
+
+    autoExposures = calloc(cameraCount, sizeof(auto_exposure_t));
+    for (int i = 0; i < cameraCount; i++)
+        auto_exposure_init(&autoExposures[i], &autoExposureConfig, exposureTime, analogGainLevel);
+    int runWhiteBalance = autoWhiteBalance && !grabberColorCorrection && awbCamera < cameraCount;
+    awb_config_t whiteBalanceConfig = awbConfig;
+    pyramids = calloc(cameraCount, sizeof(pyramid_gl_t));
+    for (int i = 0; i < cameraCount; i++)
+        if (pyramid_gl_create(&pyramids[i], "./shaders/downscale.comp", pyramidFilter))
+            printf("Failed to build the pyramid shader for camera %d.\n", i);
+    if (acquisitionMode == ACQ_MODE_ZERO_COPY)
+    {
+        for (int i = 0; i < cameraCount; i++)
+            if (autoExposure || (runWhiteBalance && i == awbCamera))
+                pyramid_gl_subscribe(&pyramids[i], statsPyramidLevel, 1);
+        // a level pixel is 2 << statsPyramidLevel frame pixels wide, about as many samples as from the frame
+        whiteBalanceConfig.decimation = awbConfig.decimation >> (statsPyramidLevel + 1);
+        if (whiteBalanceConfig.decimation < 1)
+            whiteBalanceConfig.decimation = 1;
+    }
+    if (runWhiteBalance)
+        awb_start(&awb, &whiteBalanceConfig, &color, displayColor.gains, engine.cameras[awbCamera].sensorWidth,
+                  engine.cameras[awbCamera].sensorHeight);
 
-    GLuint PBOindex = 0;
-    GLuint numOfBuffers = 2;
+    frame_desc_t frame;
+    telemetry_frame_t *frameStamps = calloc(cameraCount, sizeof(telemetry_frame_t));
+    int *frameDrawn = calloc(cameraCount, sizeof(int));
+    telemetry_init(&telemetry, telemetryDumpSeconds);
 
     while (!glfwWindowShouldClose(window))
     { // render loop
         processInput(window);
+        if (requestedGeometryPreset != geometryPreset)
+        {
+            // no frame is held here, the previous iteration released and recycled them all
+            geometryPreset = requestedGeometryPreset;
+            printf("\nGeometry preset %d...\n", geometryPreset);
+            set_recording(0); // the files hold frames of one size
+            set_pretrigger(0);
+            for (int i = 0; i < cameraCount; i++)
+            {
+                acq_camera_t *camera = &engine.cameras[i];
+                flatFieldCaptures[i].remaining = 0; // the frames would not match the sums any more
+                if (acq_camera_set_geometry(&engine, camera, &geometryPresets[geometryPreset]))
+                    printf("Camera %d did not restart.\n", i);
+                resize_video_texture(&videoTextures[i], texInternalFormat, camera->width, camera->height, videoMipLevels);
+                tex[i] = videoTextures[i].texture;
+                if (!uploadRings[i].slots)
+                    continue;
+                upload_ring_destroy(&uploadRings[i]);
+                if (upload_ring_create(&uploadRings[i], uploadRingBuffers, camera_frame_size(camera)))
+                    printf("Failed to create upload ring for camera %d.\n", i);
+            }
+            upload_lens_mesh(VAOs[0], VBOs[0], EBOs[0], &engine.cameras[0]);
+            set_pretrigger(1);
+        }
+        if (recordingRequest)
+        {
+            set_recording(!recording);
+            recordingRequest = 0;
+        }
+        if (pretriggerRequest)
+        {
+            pretriggerRequest = 0;
+            dump_pretrigger();
+        }
+        if (flatFieldRequest >= 0)
+        {
+            if (gpuDemosaic == DEMOSAIC_NONE || acquisitionMode == ACQ_MODE_ZERO_COPY)
+                printf("Flat field references need raw frames and a copying acquisition mode.\n");
+            for (int i = 0; i < cameraCount && gpuDemosaic != DEMOSAIC_NONE && acquisitionMode != ACQ_MODE_ZERO_COPY; i++)
+            {
+                acq_camera_t *camera = &engine.cameras[i];
+                if (flat_field_capture_start(&flatFieldCaptures[i], flatFieldRequest, flatFieldFrames, camera->width,
+                                             camera->height, camera->offsetX, camera->offsetY, camera->pixelScale))
+                    printf("Camera %d: out of memory for the flat field capture.\n", i);
+            }
+            printf("\nCapturing %s reference from %d frames...\n", flatFieldRequest == FLAT_FIELD_DARK ? "dark" : "flat",
+                   flatFieldFrames);
+            flatFieldRequest = -1;
+        }
+        color_gl_apply(&color);
+        set_viewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
         clear_color_buffer(0.2f, 0.2f, 0.2f, 1.0f);
         clear_buffer(GL_COLOR_BUFFER_BIT); // | GL_DEPTH_BUFFER_BIT);
-        if (FLAG == 1)
+        for (int i = 0; i < cameraCount; i++)
         {
-            bind_texture(tex[0]);
-            PBOindex = PBOindex % numOfBuffers;
-            void *mappedBuffer = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
-            memcpy(mappedBuffer, pFrameMemory, texWidth * texHeight * 3);
-            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, streamBuffers[PBOindex]);
-            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
-            update_texture_from_buffer(GL_TEXTURE_2D, 0, 0, texWidth, texHeight, GL_RGB, GL_UNSIGNED_BYTE, (void *)0);
-            bind_vertex_object_and_draw_it(VAOs[0], GL_TRIANGLES, 6);
-
-            FLAG = 0;
+            acq_camera_t *camera = &engine.cameras[i];
+            // camera 0 in the top left tile
+            set_viewport((i % tileColumns) * tileWidth, (tileRows - 1 - i / tileColumns) * tileHeight, tileWidth, tileHeight);
+            bind_texture(tex[i]);
+            frameDrawn[i] = acq_camera_pop_latest(camera, &frame);
+            int shiftX = 0, shiftY = 0;
+            int calibrate = flatFieldEnabled && gpuDemosaic != DEMOSAIC_NONE &&
+                            flat_field_shift(&flatFields[i], camera->width, camera->height, camera->offsetX,
+                                             camera->offsetY, camera->pixelScale, &shiftX, &shiftY) == 0;
+            int cpuCalibrate = calibrate && flatFieldOnCpu && uploadRings[i].slots;
+            if (frameDrawn[i])
+            {
+                telemetry_frame_begin(&frameStamps[i], &frame);
+                if (flatFieldCaptures[i].remaining && flat_field_capture_add(&flatFieldCaptures[i], frame.base, camera->width))
+                    finish_flat_field(i);
+                int channels = gpuDemosaic == DEMOSAIC_NONE ? 3 : 1;
+                downscale_image_t image = {frame.base, (size_t)camera->width * channels, camera->width, camera->height, channels};
+                // exposure holds still while flat field references are captured
+                if (autoExposure && camera->mode != ACQ_MODE_ZERO_COPY && !flatFieldCaptures[i].remaining &&
+                    !acq_camera_is_replay(camera))
+                    run_auto_exposure(i, camera, &image, statsGridStep);
+                // a decimated copy a few times per second, skipped while the last is in work
+                if (i == awbCamera && camera->mode != ACQ_MODE_ZERO_COPY)
+                    awb_submit(&awb, image.data, image.stride, image.width, image.height, channels, sensorPattern,
+                               frame_clock_ns());
+                if (camera->mode == ACQ_MODE_ZERO_COPY)
+                {
+                    telemetry_stamp(&frameStamps[i], STAMP_COPIED); // already in GL memory
+                    zero_copy_upload(&camera->zeroCopy, &frame, camera->width, camera->height, texFormat, GL_UNSIGNED_BYTE);
+                }
+                else if (uploadRings[i].slots)
+                {
+                    // waits only if the upload from uploadRingBuffers frames ago is still reading this PBO
+                    void *mappedBuffer = upload_ring_begin(&uploadRings[i]);
+                    telemetry_upload_stall(&frameStamps[i], uploadRings[i].lastStallNs);
+                    if (mappedBuffer && cpuCalibrate) // read once, written once, never read back from the mapping
+                        flat_field_apply(&flatFieldPool, &flatFields[i], shiftX, shiftY, frame.base, camera->width,
+                                         mappedBuffer, camera->width, camera->width, camera->height, DEMOSAIC_ISA_AUTO);
+                    else if (mappedBuffer)
+                        frame_copy(&frameCopy, mappedBuffer, frame.base, camera_frame_size(camera));
+                    telemetry_stamp(&frameStamps[i], STAMP_COPIED);
+                    acq_camera_release(camera, &frame);
+                    if (mappedBuffer)
+                        upload_ring_upload(&uploadRings[i], camera->width, camera->height, texFormat, GL_UNSIGNED_BYTE);
+                }
+                else
+                    acq_camera_release(camera, &frame);
+                update_video_texture_mips(&videoTextures[i], drawnWidth, drawnHeight);
+                telemetry_stamp(&frameStamps[i], STAMP_UPLOADED);
+                // the levels of this frame, and the stats of one finished a few frames ago
+                pyramid_gl_update(&pyramids[i], tex[i], camera->width, camera->height, gpuDemosaic, sensorPattern);
+                use_program(shaderProgram);
+                bind_texture(tex[i]);
+                downscale_image_t level;
+                if (camera->mode == ACQ_MODE_ZERO_COPY && pyramid_gl_read(&pyramids[i], statsPyramidLevel, &level, NULL) == 0)
+                {
+                    int gridStep = statsGridStep >> statsPyramidLevel;
+                    if (autoExposure && !flatFieldCaptures[i].remaining)
+                        run_auto_exposure(i, camera, &level, gridStep > 0 ? gridStep : 1);
+                    if (i == awbCamera)
+                        awb_submit(&awb, level.data, level.stride, level.width, level.height, level.channels, sensorPattern,
+                                   frame_clock_ns());
+                }
+            }
+            // cameras without a new frame keep showing their last one
+            flat_field_gl_use(shaderProgram, calibrate && !cpuCalibrate ? &flatFieldMaps[i] : NULL, shiftX, shiftY);
+            bind_vertex_object_and_draw_it(VAOs[0], GL_TRIANGLES, quadIndexCount);
+            if (frameDrawn[i])
+                telemetry_stamp(&frameStamps[i], STAMP_DRAWN);
         }
+        acq_engine_recycle(&engine);
         swap_buffers(window);
+        for (int i = 0; i < cameraCount; i++)
+        {
+            if (!frameDrawn[i])
+                continue;
+            telemetry_stamp(&frameStamps[i], STAMP_SWAPPED);
+            telemetry_record(&telemetry, &frameStamps[i]);
+        }
+        telemetry_dump_periodic(&telemetry);
+        static uint64_t lastRecorderPrintNs = 0;
+        if (recording && frame_clock_ns() - lastRecorderPrintNs > (uint64_t)(telemetryDumpSeconds * 1e9))
+        {
+            lastRecorderPrintNs = frame_clock_ns();
+            for (int i = 0; i < cameraCount; i++)
+            {
+                printf("Camera %d: ", i);
+                recorder_print_stats(&engine.cameras[i].recorder);
+            }
+        }
+        acq_engine_poll(&engine);
         pool_events();
 
         // printf("%f, %f, %f, %f\n",cam.resultQuat[0], cam.resultQuat[1], cam.resultQuat[2], cam.resultQuat[3]);
     }
     printf("\nExiting...\n");
-    ret = camera_stop(camHandleArray[grabberIndex][cameraIndex]);
-    printf("\nKYFG_CameraStop - %x\n", ret);
+    set_recording(0);
+    set_pretrigger(0);
+    awb_stop(&awb);
+    acq_engine_stop(&engine);
+    telemetry_dump(&telemetry);
+
+    for (int i = 0; i < cameraCount; i++)
+    {
+        if (!uploadRings[i].slots)
+            continue;
+        printf("Camera %d: ", i);
+        upload_ring_print_stats(&uploadRings[i]);
+        upload_ring_destroy(&uploadRings[i]);
+    }
+    if (frameCopy.copies)
+        frame_copy_print_stats(&frameCopy);
+    frame_copy_destroy(&frameCopy);
+    for (int i = 0; i < cameraCount; i++)
+    {
+        flat_field_gl_destroy(&flatFieldMaps[i]);
+        flat_field_free(&flatFields[i]);
+        flat_field_capture_free(&flatFieldCaptures[i]);
+    }
+    if (flatFieldOnCpu)
+        worker_pool_destroy(&flatFieldPool);
+    free(flatFields);
+    free(flatFieldMaps);
+    free(flatFieldCaptures);
+    for (int i = 0; i < cameraCount; i++)
+        pyramid_gl_destroy(&pyramids[i]);
+    free(pyramids);
+    delete_textures(cameraCount, tex);
+    free(videoTextures);
+    free(uploadRings);
+    free(frameStamps);
+    free(frameDrawn);
+    free(autoExposures);
 exit:
-    close_grabbers(&handle[0]);
+    acq_engine_close(&engine);
 
     // deallocating stuff
     delete_VAOs(3, VAOs);
-    delete_textures(1, tex);
     delete_buffers(3, VBOs);
     delete_buffers(3, EBOs);
+    color_gl_destroy(&color);
     delete_program(shaderProgram);
     terminate(); // glfw: terminate, clearing all previously allocated GLFW resources.
     /*********************************************/
@@ -215,18 +611,165 @@ exit:
     return 0;
 }
 
-static void Stream_callback_func(STREAM_BUFFER_HANDLE streamBufferHandle, void *userContext)
+// stats are only computed when the controller may act on them, a few times per second
+static void run_auto_exposure(int cameraIndex, acq_camera_t *camera, const downscale_image_t *image, int gridStep)
+{
+    auto_exposure_t *ae = &autoExposures[cameraIndex];
+    uint64_t now = frame_clock_ns();
+    if (!auto_exposure_due(ae, now))
+        return;
+    frame_stats_compute(&frameStats, image->data, image->stride, image->width, image->height, image->channels, sensorPattern,
+                        gridStep, statsClipLevel);
+    if (!auto_exposure_update(ae, &frameStats, now))
+        return;
+    // a few register writes over the camera link, at most updatesPerSecond times
+    int ret = set_camera_value_float(camera->camHandle, "ExposureTime", ae->exposureUs);
+    ret |= set_camera_value_float(camera->camHandle, "AnalogGainLevel", ae->gain);
+    if (ret != FGSTATUS_OK)
+        printf("Camera %d: auto exposure write failed - %x\n", cameraIndex, ret);
+}
+
+// every camera starts or stops together, stopping waits until their last frames are on disk
+static void set_recording(int on)
+{
+    if (on == recording)
+        return;
+    if (on && acquisitionMode == ACQ_MODE_ZERO_COPY)
+    {
+        printf("Recording needs a copying acquisition mode.\n");
+        return;
+    }
+    if (on)
+        mkdir(recordingDirectory, 0755);
+    long startTime = (long)time(NULL);
+    for (int i = 0; i < engine.cameraCount; i++)
+    {
+        acq_camera_t *camera = &engine.cameras[i];
+        if (!on)
+        {
+            if (!camera->recorder.running)
+                continue;
+            recorder_stop(&camera->recorder);
+            printf("Camera %d: ", i);
+            recorder_print_stats(&camera->recorder);
+            continue;
+        }
+        char path[256];
+        sequence_header_t format;
+        snprintf(path, sizeof(path), recordingFile, i, startTime);
+        recording_format(camera, &format);
+        if (recorder_start(&camera->recorder, &recorderConfig, path, &format) == 0)
+            printf("Camera %d: recording to %s\n", i, path);
+    }
+    recording = on;
+}
+
+// what the frames of a camera are, for the recordings and the pre-trigger dumps
+static void recording_format(const acq_camera_t *camera, sequence_header_t *format)
+{
+    // with grabberColorCorrection the grabber has applied the matrix to the pixels already
+    sequence_header_init(format, gpuDemosaic == DEMOSAIC_NONE ? "RGB8" : bayer_pixel_format(sensorPattern),
+                         (uint32_t)camera->width, (uint32_t)camera->height, (uint64_t)camera_frame_size(camera),
+                         camera->fps, grabberColorCorrection ? NULL : &displayColor);
+}
+
+// maps the pre-trigger arena of every camera for its current frame size, or finishes their dumps and unmaps them
+static void set_pretrigger(int on)
+{
+    if (pretriggerConfig.preSeconds <= 0 || acquisitionMode == ACQ_MODE_ZERO_COPY)
+        return;
+    for (int i = 0; i < engine.cameraCount; i++)
+    {
+        acq_camera_t *camera = &engine.cameras[i];
+        if (!on)
+        {
+            if (!camera->pretrigger.arena)
+                continue;
+            pretrigger_destroy(&camera->pretrigger);
+            printf("Camera %d: ", i);
+            pretrigger_print_stats(&camera->pretrigger);
+            continue;
+        }
+        sequence_header_t format;
+        recording_format(camera, &format);
+        printf("Camera %d: ", i);
+        if (pretrigger_init(&camera->pretrigger, &pretriggerConfig, &format))
+            printf("Camera %d: no pre-trigger buffer.\n", i);
+    }
+}
+
+// every camera dumps, each to its own file, the writing happens on their dump threads
+static void dump_pretrigger(void)
+{
+    if (pretriggerConfig.preSeconds <= 0 || acquisitionMode == ACQ_MODE_ZERO_COPY)
+    {
+        printf("The pre-trigger buffer is off, it needs preSeconds and a copying acquisition mode.\n");
+        return;
+    }
+    mkdir(recordingDirectory, 0755);
+    long triggerTime = (long)time(NULL);
+    for (int i = 0; i < engine.cameraCount; i++)
+    {
+        char path[256];
+        snprintf(path, sizeof(path), pretriggerFile, i, triggerTime);
+        if (pretrigger_trigger(&engine.cameras[i].pretrigger, path) == 0)
+            printf("Camera %d: pre-trigger dump to %s\n", i, path);
+    }
+}
+
+// only sets the flag, the render loop does the rest
+static void request_pretrigger(int signal)
 {
+    (void)signal;
+    pretriggerRequest = 1;
+}
 
-    if (!streamBufferHandle)
+// maps from the references captured so far, saved and shown from the next frame on
+static void finish_flat_field(int cameraIndex)
+{
+    flat_field_t ff;
+    char path[256];
+    if (flat_field_build(&ff, &flatFieldCaptures[cameraIndex], &flatFieldConfig))
     {
-        // this callback indicates that acquisition has stopped
+        printf("Camera %d: flat field build failed.\n", cameraIndex);
         return;
     }
-    // as a minimum, application may want to get pointer to current frame memory and/or its numerical ID
-    KYFG_BufferGetInfo(streamBufferHandle, KY_STREAM_BUFFER_INFO_BASE, &pFrameMemory, NULL, NULL);
+    snprintf(path, sizeof(path), flatFieldFile, cameraIndex);
+    flat_field_save(&ff, path);
+    flat_field_free(&flatFields[cameraIndex]);
+    flatFields[cameraIndex] = ff;
+    flat_field_gl_upload(&flatFieldMaps[cameraIndex], &flatFields[cameraIndex]);
+}
+
+// built once per geometry, a few thousand vertices
+static void upload_lens_mesh(GLuint VAO, GLuint VBO, GLuint EBO, const acq_camera_t *camera)
+{
+    if (!lensCalibrated || !camera->width)
+        return;
+    lens_model_t region;
+    lens_mesh_t mesh;
+    lens_model_for_region(&lens, camera->offsetX, camera->offsetY, camera->pixelScale, &region);
+    // same screen rectangle as the quad
+    if (lens_mesh_build(&mesh, &region, camera->width, camera->height, lensMeshColumns, lensMeshRows,
+                        -vertices[0], -vertices[1], vertices[0], vertices[1], lensZoom))
+    {
+        printf("Failed to build the lens mesh.\n");
+        return;
+    }
+    bind_VAOs(VAO);
+    bind_buffer_set_data(GL_ARRAY_BUFFER, VBO, sizeof(float) * LENS_MESH_VERTEX_FLOATS * mesh.vertexCount, mesh.vertices,
+                         GL_STATIC_DRAW);
+    bind_buffer_set_data(GL_ELEMENT_ARRAY_BUFFER, EBO, sizeof(uint32_t) * mesh.indexCount, mesh.indices, GL_STATIC_DRAW);
+    quadIndexCount = mesh.indexCount;
+    printf("Lens mesh %dx%d for %ldx%ld frames, zoom %.3f\n", lensMeshColumns, lensMeshRows, (long)camera->width,
+           (long)camera->height, mesh.zoom);
+    lens_mesh_free(&mesh);
+}
 
-    FLAG = 1;
+// grabber RGB8 or raw Bayer, rows packed
+static GLsizeiptr camera_frame_size(const acq_camera_t *camera)
+{
+    return (GLsizeiptr)camera->width * camera->height * (gpuDemosaic == DEMOSAIC_NONE ? 3 : 1);
 }
 
 static int KY_init()
@@ -247,15 +790,11 @@ static int KY_init()
 static void first_cam_setup(FGHANDLE handle, CAMHANDLE camHandle, int grabberIndex, int cameraIndex)
 {
     int ret;
-    printf("\nCamera Setup starts here!\n");
-
-    ret = set_camera_value_int(camHandle, "Width", texWidth); // sets camera width
-    printf("SET 'Width' - %x\n", ret);
+    printf("\nCamera Setup starts here! (grabber #%d, camera #%d)\n", grabberIndex, cameraIndex);
 
-    ret = set_camera_value_int(camHandle, "Height", texHeight); // sets camera height
-    printf("SET 'Height' - %x\n", ret);
+    // Width, Height, offsets and binning come from geometryPresets when the stream starts
 
-    ret = set_camera_value_enum_by_value_name(camHandle, "PixelFormat", "BayerRG8"); // sets format
+    ret = set_camera_value_enum_by_value_name(camHandle, "PixelFormat", bayer_pixel_format(sensorPattern)); // sets format
     printf("SET 'PixelFormat' - %x\n", ret);
 
     ret = set_camera_value_float(camHandle, "ExposureTime", exposureTime);
@@ -287,54 +826,42 @@ static void first_cam_setup(FGHANDLE handle, CAMHANDLE camHandle, int grabberInd
 
     printf("\nGrabber Setup starts here!\n");
 
-    ret = get_grabber_value_int(handle, "CameraSelector"); // sets selector
-    if (ret != 0)
+    ret = get_grabber_value_int(handle, "CameraSelector"); // sets selector, grabber values below apply to this camera only
+    if (ret != cameraIndex)
     {
-        ret = set_grabber_value_int(handle, "CameraSelector", 0);
+        ret = set_grabber_value_int(handle, "CameraSelector", cameraIndex);
         printf("SET 'CameraSelector' - %x\n", ret);
     }
 
-    ret = set_grabber_value_enum_by_value_name(handle, "PixelFormat", "RGB8"); // sets RGB8
-    printf("SET 'PixelFormat' - %x\n", ret);
-
-    ret = set_grabber_value_enum(handle, "DebayerMode", 0);
-    printf("SET 'DebayerMode' - %x\n", ret);
-
-    ret = set_grabber_value_float(handle, "ColorTransformationRR", RR);
-    printf("SET 'ColorTransformationRR' - %x\n", ret);
-
-    ret = set_grabber_value_float(handle, "ColorTransformationGG", GG);
-    printf("SET 'ColorTransformationGG' - %x\n", ret);
-
-    ret = set_grabber_value_float(handle, "ColorTransformationBB", BB);
-    printf("SET 'ColorTransformationBB' - %x\n", ret);
-
-    ret = set_grabber_value_float(handle, "ColorTransformationRG", RG);
-    printf("SET 'ColorTransformationRG' - %x\n", ret);
-
-    ret = set_grabber_value_float(handle, "ColorTransformationRB", RB);
-    printf("SET 'ColorTransformationRB' - %x\n", ret);
-
-    ret = set_grabber_value_float(handle, "ColorTransformationGR", GR);
-    printf("SET 'ColorTransformationGR' - %x\n", ret);
-
-    ret = set_grabber_value_float(handle, "ColorTransformationGB", GB);
-    printf("SET 'ColorTransformationGB' - %x\n", ret);
-
-    ret = set_grabber_value_float(handle, "ColorTransformationBR", BR);
-    printf("SET 'ColorTransformationBR' - %x\n", ret);
-
-    ret = set_grabber_value_float(handle, "ColorTransformationBG", BG);
-    printf("SET 'ColorTransformationBG' - %x\n", ret);
-
-    ret = set_grabber_value_float(handle, "ColorTransformationR0", R00);
-    printf("SET 'ColorTransformationR0' - %x\n", ret);
+    if (gpuDemosaic == DEMOSAIC_NONE)
+    {
+        ret = set_grabber_value_enum_by_value_name(handle, "PixelFormat", "RGB8"); // sets RGB8
+        printf("SET 'PixelFormat' - %x\n", ret);
 
-    ret = set_grabber_value_float(handle, "ColorTransformationB0", B00);
-    printf("SET 'ColorTransformationB0' - %x\n", ret);
+        ret = set_grabber_value_enum(handle, "DebayerMode", 0);
+        printf("SET 'DebayerMode' - %x\n", ret);
+    }
+    else
+    {
+        ret = set_grabber_value_enum_by_value_name(handle, "PixelFormat", bayer_pixel_format(sensorPattern)); // raw pass through
+        printf("SET 'PixelFormat' - %x\n", ret);
+    }
 
-    ret = set_grabber_value_float(handle, "ColorTransformationG0", G00);
-    printf("SET 'ColorTransformationG0' - %x\n", ret);
+    // identity unless the grabber corrects the colour, so the shader's matrix is not applied on top of an old one
+    color_params_t grabberColor = displayColor;
+    if (!grabberColorCorrection)
+        color_params_identity(&grabberColor);
+    static const char *channels = "RGB";
+    for (int r = 0; r < 3; r++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "ColorTransformation%c%c", channels[r], c < 3 ? channels[c] : '0');
+            ret = set_grabber_value_float(handle, name, grabberColor.ccm[r][c]);
+            printf("SET '%s' - %x\n", name, ret);
+        }
+    }
 
     printf("\nGET GREBBER VALUES!\n");
     width = 0, height = 0, totalFrames = 0;
@@ -357,4 +884,47 @@ static void processInput(GLFWwindow *window){ // keeps all the input code
     if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {// closes window on ESC
         glfwSetWindowShouldClose(window, GL_TRUE);
     }
+    static int gammaKeyDown = 0;
+    int gammaKey = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+    if (gammaKey && !gammaKeyDown && !grabberColorCorrection) { // G toggles the display gamma between linear and 2.2
+        color_params_t params;
+        color_gl_get(&color, &params);
+        params.gamma = params.gamma == 1.0f ? 2.2f : 1.0f;
+        color_gl_set(&color, &params);
+    }
+    gammaKeyDown = gammaKey;
+    static int geometryKeyDown = 0;
+    int geometryKey = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+    if (geometryKey && !geometryKeyDown) { // R steps through the region of interest and binning presets
+        requestedGeometryPreset = (geometryPreset + 1) % geometryPresetCount;
+    }
+    geometryKeyDown = geometryKey;
+    static int darkKeyDown = 0, flatKeyDown = 0, calibrationKeyDown = 0;
+    int darkKey = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
+    int flatKey = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+    int calibrationKey = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+    if (darkKey && !darkKeyDown) { // D captures the dark reference, F the flat one
+        flatFieldRequest = FLAT_FIELD_DARK;
+    }
+    if (flatKey && !flatKeyDown) {
+        flatFieldRequest = FLAT_FIELD_FLAT;
+    }
+    if (calibrationKey && !calibrationKeyDown) { // C toggles the flat field correction
+        flatFieldEnabled = !flatFieldEnabled;
+    }
+    darkKeyDown = darkKey;
+    flatKeyDown = flatKey;
+    calibrationKeyDown = calibrationKey;
+    static int recordKeyDown = 0;
+    int recordKey = glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS;
+    if (recordKey && !recordKeyDown) { // V starts and stops recording
+        recordingRequest = 1;
+    }
+    recordKeyDown = recordKey;
+    static int triggerKeyDown = 0;
+    int triggerKey = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+    if (triggerKey && !triggerKeyDown) { // T dumps the pre-trigger buffers
+        pretriggerRequest = 1;
+    }
+    triggerKeyDown = triggerKey;
 }
\ No newline at end of file
@@ -248,11 +248,107 @@ void set_viewport(GLint x, GLint y, GLsizei witdh, GLsizei height)
 void generate_texture_from_buffer(GLenum target, GLint internal_format, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid *buffer)
 {
 	glTexImage2D(target, 0, internal_format, width, height, 0, format, type, buffer);
-	glGenerateMipmap(target);
 }
 
 void update_texture_from_buffer(GLenum target, GLuint xoffset, GLuint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid *buffer)
 {
 	glTexSubImage2D(target, 0, xoffset, yoffset, width, height, format, type, buffer);
-	glGenerateMipmap(target);
-}
\ No newline at end of file
+}
+
+static GLint full_mip_chain(GLsizei width, GLsizei height)
+{
+	GLint levels = 1;
+	GLsizei size = width > height ? width : height;
+	while (size >>= 1)
+		levels++;
+	return levels;
+}
+
+static void set_used_mip_levels(video_texture_t *video, GLint levels)
+{
+	if (levels == video->usedLevels)
+		return;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	video->usedLevels = levels;
+}
+
+void create_video_texture(video_texture_t *video, GLuint texture, GLenum internal_format, GLsizei width, GLsizei height, mip_policy_t policy, GLint levels)
+{
+	GLint fullChain = full_mip_chain(width, height);
+	video->texture = texture;
+	video->width = width;
+	video->height = height;
+	video->policy = policy;
+	video->levels = policy == MIP_NONE ? 1 : (levels > 0 && levels < fullChain ? levels : fullChain);
+	video->usedLevels = 0;
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexStorage2D(GL_TEXTURE_2D, video->levels, internal_format, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	// on demand textures start without mips, the first minified draw turns them on
+	set_used_mip_levels(video, policy == MIP_LIMITED ? video->levels : 1);
+}
+
+void resize_video_texture(video_texture_t *video, GLenum internal_format, GLsizei width, GLsizei height, GLint levels)
+{
+	// immutable storage cannot be respecified, the texture gets a new name
+	GLuint texture;
+	glDeleteTextures(1, &video->texture);
+	glGenTextures(1, &texture);
+	create_video_texture(video, texture, internal_format, width, height, video->policy, levels);
+}
+
+void update_video_texture_mips(video_texture_t *video, GLfloat drawn_width, GLfloat drawn_height)
+{
+	GLint levels = video->usedLevels;
+	if (video->policy == MIP_NONE)
+		return;
+	if (video->policy == MIP_ON_DEMAND)
+	{
+		// one more level for every halving of the texture on screen, none at all for 1:1 or magnified
+		GLfloat scaleX = drawn_width > 0 ? video->width / drawn_width : 1.0f;
+		GLfloat scaleY = drawn_height > 0 ? video->height / drawn_height : 1.0f;
+		GLfloat minification = scaleX > scaleY ? scaleX : scaleY;
+		levels = 1;
+		while (minification > 1.0f && levels < video->levels)
+		{
+			levels++;
+			minification /= 2.0f;
+		}
+		set_used_mip_levels(video, levels);
+	}
+	// glGenerateMipmap only fills base + 1 .. GL_TEXTURE_MAX_LEVEL
+	if (levels > 1)
+		glGenerateMipmap(GL_TEXTURE_2D);
+}
+
+GLvoid *create_persistent_mapped_buffer(GLenum target, GLuint buffer, GLsizeiptr size, GLbitfield access)
+{
+	GLbitfield flags = access | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glBindBuffer(target, buffer);
+	glBufferStorage(target, size, NULL, flags);
+	GLvoid *mapped = glMapBufferRange(target, 0, size, flags);
+	glBindBuffer(target, 0);
+	if (!mapped)
+		fprintf(stderr, "In file: %s, line: %d Failed to map buffer %u persistently\n", __FILE__, __LINE__, buffer);
+	return mapped;
+}
+
+GLsync insert_fence()
+{
+	return glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLint fence_signaled(GLsync fence, GLuint64 timeout)
+{
+	GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+	return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+}
+
+void delete_fence(GLsync fence)
+{
+	glDeleteSync(fence);
+}
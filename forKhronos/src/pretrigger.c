@@ -0,0 +1,268 @@
+#define _GNU_SOURCE
+#include "myCode/pretrigger.h"
+#include <errno.h>
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static size_t round_up(size_t v, size_t alignment)
+{
+    return (v + alignment - 1) / alignment * alignment;
+}
+
+// reserved huge pages are taken at mmap, so a pool too small fails here and not at the first touch
+static uint8_t *map_arena(size_t size, int hugePages, int *hugeTLB)
+{
+    void *arena = MAP_FAILED;
+    *hugeTLB = 0;
+    if (hugePages)
+    {
+        arena = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+        *hugeTLB = arena != MAP_FAILED;
+    }
+    if (arena == MAP_FAILED)
+    {
+        arena = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (arena == MAP_FAILED)
+            return NULL;
+        if (hugePages && madvise(arena, size, MADV_HUGEPAGE))
+            printf("Pre-trigger: no transparent huge pages - %s\n", strerror(errno));
+        // every page faulted in now, never in the callback
+        memset(arena, 0, size);
+    }
+    return (uint8_t *)arena;
+}
+
+// under lock, so a trigger either extends the dump or starts the next one
+static int dump_finished(pretrigger_t *pt, uint64_t next)
+{
+    int finished = 0;
+    pthread_mutex_lock(&pt->lock);
+    if (next >= atomic_load(&pt->end) || atomic_load(&pt->quit))
+    {
+        atomic_store(&pt->dumping, 0);
+        finished = 1;
+    }
+    pthread_mutex_unlock(&pt->lock);
+    return finished;
+}
+
+// the recorder writes from the arena: a slot is free for the callback once its frame has left the recorder's backlog.
+// Returns the frames still being written
+static uint32_t free_written(pretrigger_t *pt)
+{
+    recorder_stats_t stats;
+    recorder_get_stats(&pt->recorder, &stats);
+    atomic_store_explicit(&pt->next, pt->handed - stats.backlog, memory_order_release);
+    return stats.backlog;
+}
+
+// every frame copied so far, up to the end of the dump, never more than the recorder's slots in flight
+static void hand_frames(pretrigger_t *pt)
+{
+    uint64_t head = atomic_load_explicit(&pt->head, memory_order_acquire);
+    for (; pt->handed < head && pt->handed < atomic_load(&pt->end); pt->handed++)
+    {
+        while (free_written(pt) >= (uint32_t)pt->recorder.slotCount)
+            usleep(1000);
+        recorder_push(&pt->recorder, &pt->frames[pt->handed % pt->slotCount]);
+        atomic_fetch_add_explicit(&pt->dumped, 1, memory_order_relaxed);
+    }
+    free_written(pt);
+}
+
+static void *dump_thread(void *arg)
+{
+    pretrigger_t *pt = (pretrigger_t *)arg;
+    for (;;)
+    {
+        while (sem_wait(&pt->work) && errno == EINTR)
+            ;
+        if (!atomic_load(&pt->dumping))
+        {
+            if (atomic_load(&pt->quit))
+                return NULL;
+            continue;
+        }
+        if (!pt->recorder.running)
+        {
+            char path[sizeof(pt->path)];
+            pthread_mutex_lock(&pt->lock);
+            memcpy(path, pt->path, sizeof(path));
+            pthread_mutex_unlock(&pt->lock);
+            if (recorder_start(&pt->recorder, &pt->config.recorder, path, &pt->format))
+            {
+                printf("Pre-trigger: the dump to %s could not be started.\n", path);
+                atomic_store(&pt->next, atomic_load(&pt->end));
+                dump_finished(pt, atomic_load(&pt->end));
+                continue;
+            }
+            pt->handed = atomic_load(&pt->next);
+            printf("Pre-trigger: dumping to %s\n", path);
+        }
+
+        hand_frames(pt);
+        if (pt->handed < atomic_load(&pt->end) && !atomic_load(&pt->quit))
+            continue;
+        // the callback overwrites any slot once the dump is over, so it only ends with every frame on disk
+        while (free_written(pt))
+            usleep(1000);
+        if (!dump_finished(pt, pt->handed))
+            continue;
+        recorder_stop(&pt->recorder);
+        printf("Pre-trigger: ");
+        recorder_print_stats(&pt->recorder);
+        atomic_fetch_add(&pt->dumps, 1);
+        if (atomic_load(&pt->quit))
+            return NULL;
+    }
+}
+
+int pretrigger_init(pretrigger_t *pt, const pretrigger_config_t *config, const sequence_header_t *format)
+{
+    // no memset: a callback may be checking accepting
+    double fps = format->fps > 0 ? format->fps : 60.0;
+    pt->config = *config;
+    pt->config.recorder.compressionLevel = 0;
+    pt->config.recorder.borrowFrames = 1;
+    pt->format = *format;
+    pt->preFrames = (uint64_t)ceil(config->preSeconds * fps);
+    pt->postFrames = (uint64_t)ceil(config->postSeconds * fps);
+    pt->slotCount = pt->preFrames + (uint64_t)(config->spareFrames < 2 ? 2 : config->spareFrames);
+    // what the recorder writes of each frame, from an aligned address
+    pt->slotSize = round_up(format->frameSize, RECORDER_ALIGNMENT);
+    pt->arenaSize = round_up(pt->slotCount * pt->slotSize, PRETRIGGER_HUGE_PAGE);
+    pt->arena = map_arena(pt->arenaSize, config->hugePages, &pt->hugeTLB);
+    pt->frames = calloc(pt->slotCount, sizeof(frame_desc_t));
+    if (!pt->arena || !pt->frames)
+    {
+        printf("Pre-trigger: cannot map %.0f MB for %lu frames - %s\n", pt->arenaSize / 1e6,
+               (unsigned long)pt->slotCount, strerror(errno));
+        if (pt->arena)
+            munmap(pt->arena, pt->arenaSize);
+        free(pt->frames);
+        pt->arena = NULL;
+        pt->frames = NULL;
+        return -1;
+    }
+    for (uint64_t i = 0; i < pt->slotCount; i++)
+        pt->frames[i].base = pt->arena + i * pt->slotSize;
+    atomic_store(&pt->head, 0);
+    atomic_store(&pt->next, 0);
+    atomic_store(&pt->end, 0);
+    atomic_store(&pt->dumping, 0);
+    atomic_store(&pt->quit, 0);
+    atomic_store(&pt->dumps, 0);
+    atomic_store(&pt->dumped, 0);
+    atomic_store(&pt->dropped, 0);
+    pthread_mutex_init(&pt->lock, NULL);
+    sem_init(&pt->work, 0, 0);
+    int ret = pthread_create(&pt->thread, NULL, dump_thread, pt);
+    if (ret)
+    {
+        printf("Pre-trigger: cannot start the dump thread - %s\n", strerror(ret));
+        sem_destroy(&pt->work);
+        pthread_mutex_destroy(&pt->lock);
+        munmap(pt->arena, pt->arenaSize);
+        free(pt->frames);
+        pt->arena = NULL;
+        pt->frames = NULL;
+        return -1;
+    }
+    atomic_store(&pt->accepting, 1);
+    pretrigger_print_stats(pt);
+    return 0;
+}
+
+int pretrigger_push(pretrigger_t *pt, const frame_desc_t *frame)
+{
+    int taken = 0;
+    atomic_fetch_add(&pt->pushing, 1);
+    if (atomic_load(&pt->accepting))
+    {
+        // the callback is the only writer of head; without a dump every slot may be overwritten
+        uint64_t head = atomic_load_explicit(&pt->head, memory_order_relaxed);
+        int dumping = atomic_load(&pt->dumping);
+        if (dumping && head - atomic_load_explicit(&pt->next, memory_order_acquire) >= pt->slotCount)
+            atomic_fetch_add_explicit(&pt->dropped, 1, memory_order_relaxed);
+        else
+        {
+            frame_desc_t *slot = &pt->frames[head % pt->slotCount];
+            uint8_t *base = slot->base;
+            memcpy(base, frame->base, pt->format.frameSize);
+            *slot = *frame;
+            slot->base = base;
+            slot->bufferHandle = 0; // the grabber's buffer is not held
+            atomic_store_explicit(&pt->head, head + 1, memory_order_release);
+            if (dumping)
+                sem_post(&pt->work);
+            taken = 1;
+        }
+    }
+    atomic_fetch_sub(&pt->pushing, 1);
+    return taken;
+}
+
+int pretrigger_trigger(pretrigger_t *pt, const char *path)
+{
+    if (!atomic_load(&pt->accepting))
+        return -1;
+    pthread_mutex_lock(&pt->lock);
+    uint64_t head = atomic_load(&pt->head);
+    if (atomic_load(&pt->dumping))
+        atomic_store(&pt->end, head + pt->postFrames);
+    else
+    {
+        // a callback copying frame head now fills the slot of head - slotCount, older than anything kept; the ring
+        // is protected before the next frame arrives
+        atomic_store(&pt->next, head > pt->preFrames ? head - pt->preFrames : 0);
+        atomic_store(&pt->end, head + pt->postFrames);
+        snprintf(pt->path, sizeof(pt->path), "%s", path);
+        atomic_store(&pt->dumping, 1);
+    }
+    pthread_mutex_unlock(&pt->lock);
+    sem_post(&pt->work);
+    return 0;
+}
+
+void pretrigger_get_stats(pretrigger_t *pt, pretrigger_stats_t *stats)
+{
+    stats->dumps = atomic_load(&pt->dumps);
+    stats->frames = atomic_load(&pt->dumped);
+    stats->dropped = atomic_load(&pt->dropped);
+}
+
+void pretrigger_print_stats(pretrigger_t *pt)
+{
+    pretrigger_stats_t stats;
+    pretrigger_get_stats(pt, &stats);
+    printf("Pre-trigger: %.1f s (%lu frames) in %.0f MB of %s, written from there; %lu dumps, %lu frames dumped, %lu "
+           "dropped\n",
+           pt->config.preSeconds, (unsigned long)pt->preFrames, pt->arenaSize / 1e6,
+           pt->hugeTLB ? "huge pages" : (pt->config.hugePages ? "transparent huge pages" : "normal pages"),
+           (unsigned long)stats.dumps, (unsigned long)stats.frames, (unsigned long)stats.dropped);
+}
+
+void pretrigger_destroy(pretrigger_t *pt)
+{
+    if (!pt->arena)
+        return;
+    atomic_store(&pt->accepting, 0);
+    // a callback that saw accepting set finishes its copy first
+    while (atomic_load(&pt->pushing))
+        sched_yield();
+    // a running dump ends with the frames it has
+    atomic_store(&pt->quit, 1);
+    sem_post(&pt->work);
+    pthread_join(pt->thread, NULL);
+    sem_destroy(&pt->work);
+    pthread_mutex_destroy(&pt->lock);
+    munmap(pt->arena, pt->arenaSize);
+    free(pt->frames);
+    pt->arena = NULL;
+    pt->frames = NULL;
+}
@@ -0,0 +1,209 @@
+#include "myCode/pyramid_gl.h"
+#include <string.h>
+
+#define PYRAMID_GROUP_SIZE 16
+
+int pyramid_gl_create(pyramid_gl_t *pyramid, const char *shaderFile, downscale_filter_t filter)
+{
+    memset(pyramid, 0, sizeof(*pyramid));
+    pyramid->filter = filter;
+    for (int i = 0; i < PYRAMID_LEVELS; i++)
+        pyramid->levels[i].newest = -1;
+    GLuint shader = load_shader_from_file(shaderFile, GL_COMPUTE_SHADER);
+    if (!shader)
+        return -1;
+    pyramid->program = create_program(&shader, 1);
+    GLint linked = 0;
+    glGetProgramiv(pyramid->program, GL_LINK_STATUS, &linked);
+    if (!linked)
+    {
+        delete_program(pyramid->program);
+        pyramid->program = 0;
+        return -1;
+    }
+
+    int h[DOWNSCALE_TAPS], v[DOWNSCALE_TAPS];
+    downscale_lanczos_weights(DOWNSCALE_H_BITS, h);
+    downscale_lanczos_weights(DOWNSCALE_V_BITS, v);
+    use_program(pyramid->program);
+    glUniform1iv(get_uniform_location(pyramid->program, "hTaps"), DOWNSCALE_TAPS, h);
+    glUniform1iv(get_uniform_location(pyramid->program, "vTaps"), DOWNSCALE_TAPS, v);
+    glUniform1i(get_uniform_location(pyramid->program, "source"), PYRAMID_GL_SOURCE_UNIT);
+    glUniform1i(get_uniform_location(pyramid->program, "level"), 0);
+    return 0;
+}
+
+void pyramid_gl_subscribe(pyramid_gl_t *pyramid, int level, int readback)
+{
+    pyramid->levels[level].subscribers++;
+    pyramid->levels[level].readers += readback != 0;
+}
+
+void pyramid_gl_unsubscribe(pyramid_gl_t *pyramid, int level, int readback)
+{
+    pyramid->levels[level].subscribers--;
+    pyramid->levels[level].readers -= readback != 0;
+}
+
+static void free_readback(pyramid_level_t *level)
+{
+    for (int s = 0; s < PYRAMID_READBACK_SLOTS; s++)
+    {
+        if (level->fence[s])
+            delete_fence(level->fence[s]);
+        level->fence[s] = 0;
+        level->mapped[s] = NULL;
+    }
+    if (level->pbo[0])
+        delete_buffers(PYRAMID_READBACK_SLOTS, level->pbo);
+    memset(level->pbo, 0, sizeof(level->pbo));
+    level->newest = -1;
+}
+
+static void free_level(pyramid_level_t *level)
+{
+    free_readback(level);
+    if (level->texture)
+        glDeleteTextures(1, &level->texture);
+    level->texture = 0;
+}
+
+// immutable storage, a new size gets new textures and buffers
+static void allocate_level(pyramid_level_t *level, GLsizei width, GLsizei height)
+{
+    free_level(level);
+    level->width = width;
+    level->height = height;
+    glGenTextures(1, &level->texture);
+    glBindTexture(GL_TEXTURE_2D, level->texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+static int allocate_readback(pyramid_level_t *level)
+{
+    GLsizeiptr size = (GLsizeiptr)level->width * level->height * 4;
+    generate_buffers(PYRAMID_READBACK_SLOTS, level->pbo);
+    for (int s = 0; s < PYRAMID_READBACK_SLOTS; s++)
+    {
+        level->mapped[s] = create_persistent_mapped_buffer(GL_PIXEL_PACK_BUFFER, level->pbo[s], size, GL_MAP_READ_BIT);
+        if (!level->mapped[s])
+        {
+            free_readback(level);
+            return -1;
+        }
+    }
+    level->next = 0;
+    return 0;
+}
+
+// a copy into the next slot, the oldest one; its reader was told the pixels last only until this update
+static void start_readback(pyramid_gl_t *pyramid, pyramid_level_t *level)
+{
+    if (!level->pbo[0] && allocate_readback(level))
+        return;
+    int s = level->next;
+    if (level->fence[s])
+        delete_fence(level->fence[s]);
+    if (level->newest == s)
+        level->newest = -1;
+    glBindTexture(GL_TEXTURE_2D, level->texture);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, level->pbo[s]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, (void *)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    // the coherent mapping sees the copy once the fence has signaled
+    glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+    level->fence[s] = insert_fence();
+    level->sequence[s] = pyramid->updates;
+    level->next = (s + 1) % PYRAMID_READBACK_SLOTS;
+}
+
+void pyramid_gl_update(pyramid_gl_t *pyramid, GLuint source, GLsizei width, GLsizei height, demosaic_quality_t quality,
+                       bayer_pattern_t pattern)
+{
+    int deepest = -1;
+    for (int i = 0; i < PYRAMID_LEVELS; i++)
+        if (pyramid->levels[i].subscribers > 0)
+            deepest = i;
+    // levels nobody reads any more give their buffers back
+    for (int i = 0; i < PYRAMID_LEVELS; i++)
+        if (pyramid->levels[i].readers <= 0 && pyramid->levels[i].pbo[0])
+            free_readback(&pyramid->levels[i]);
+    if (deepest < 0 || !pyramid->program)
+        return;
+    pyramid->updates++;
+    if (width != pyramid->width || height != pyramid->height)
+    {
+        for (int i = 0; i < PYRAMID_LEVELS; i++)
+            free_level(&pyramid->levels[i]);
+        pyramid->width = width;
+        pyramid->height = height;
+    }
+
+    use_program(pyramid->program);
+    glUniform2i(get_uniform_location(pyramid->program, "bayerRed"), bayer_red_x(pattern), bayer_red_y(pattern));
+    GLuint input = source;
+    for (int i = 0; i <= deepest; i++)
+    {
+        pyramid_level_t *level = &pyramid->levels[i];
+        if (!level->texture)
+            allocate_level(level, width >> (i + 1), height >> (i + 1));
+        GLint mode = i == 0 && quality != DEMOSAIC_NONE ? 0 : (pyramid->filter == DOWNSCALE_BOX ? 1 : 2);
+        glUniform1i(get_uniform_location(pyramid->program, "mode"), mode);
+        glActiveTexture(GL_TEXTURE0 + PYRAMID_GL_SOURCE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, input);
+        glBindImageTexture(0, level->texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+        glDispatchCompute((level->width + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+                          (level->height + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+        // the next level samples this one, readbacks and draws read it as a texture
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+        input = level->texture;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    for (int i = 0; i <= deepest; i++)
+        if (pyramid->levels[i].readers > 0)
+            start_readback(pyramid, &pyramid->levels[i]);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+int pyramid_gl_read(pyramid_gl_t *pyramid, int level, downscale_image_t *image, uint64_t *sequence)
+{
+    pyramid_level_t *l = &pyramid->levels[level];
+    if (!l->pbo[0])
+        return -1;
+    // oldest slot first, so the newest finished one is picked last
+    for (int k = 0; k < PYRAMID_READBACK_SLOTS; k++)
+    {
+        int s = (l->next + k) % PYRAMID_READBACK_SLOTS;
+        if (l->fence[s] && fence_signaled(l->fence[s], 0))
+        {
+            delete_fence(l->fence[s]);
+            l->fence[s] = 0;
+            l->newest = s;
+        }
+    }
+    if (l->newest < 0)
+        return -1;
+    image->data = l->mapped[l->newest];
+    image->stride = (size_t)l->width * 4;
+    image->width = l->width;
+    image->height = l->height;
+    image->channels = 4;
+    if (sequence)
+        *sequence = l->sequence[l->newest];
+    return 0;
+}
+
+void pyramid_gl_destroy(pyramid_gl_t *pyramid)
+{
+    for (int i = 0; i < PYRAMID_LEVELS; i++)
+        free_level(&pyramid->levels[i]);
+    if (pyramid->program)
+        delete_program(pyramid->program);
+    pyramid->program = 0;
+}
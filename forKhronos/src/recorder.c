@@ -0,0 +1,667 @@
+#define _GNU_SOURCE
+#include "myCode/recorder.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// user_data of the eventfd read, writes carry their frame position
+#define EVENT_TAG UINT64_MAX
+
+// io_uring without liburing: the three rings mapped from the ring fd, indices shared with the kernel
+typedef struct recorder_uring_t
+{
+    int ringFd, eventFd;
+    void *sqRing, *cqRing;
+    struct io_uring_sqe *sqes;
+    size_t sqRingSize, cqRingSize, sqesSize;
+    unsigned *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_cqe *cqes;
+    uint64_t eventValue; // the eventfd read lands here
+} recorder_uring_t;
+
+static size_t round_up(size_t v, size_t alignment)
+{
+    return (v + alignment - 1) / alignment * alignment;
+}
+
+static off_t frame_offset(const recorder_t *rec, uint64_t frame)
+{
+    return (off_t)(rec->header.headerSize + frame * rec->slotSize);
+}
+
+// where the writers find a frame and put it: the slot itself at its fixed place, or its compressed payload where the
+// encoder placed it. length is padded to RECORDER_ALIGNMENT, size is not; length 0 if there is nothing to write
+static void frame_extent(const recorder_t *rec, uint64_t frame, const uint8_t **data, uint64_t *offset, size_t *length,
+                         size_t *size)
+{
+    int s = (int)(frame % rec->slotCount);
+    if (rec->compressing)
+    {
+        *data = rec->packed[s];
+        *offset = rec->packedOffset[s];
+        *size = rec->packedSize[s];
+        *length = round_up(*size, RECORDER_ALIGNMENT);
+        return;
+    }
+    *data = rec->slots[s];
+    *offset = (uint64_t)frame_offset(rec, frame);
+    *size = rec->frameSize;
+    *length = rec->slotSize;
+}
+
+// frames the writers may take
+static uint64_t ready_frames(recorder_t *rec)
+{
+    return atomic_load_explicit(rec->compressing ? &rec->encoded : &rec->head, memory_order_acquire);
+}
+
+// index entries up to and including frame and file space up to end, preallocateFrames at a time so the file system
+// never allocates during a write
+static void reserve(recorder_t *rec, uint64_t frame, uint64_t end)
+{
+    if (frame >= rec->allocatedFrames)
+    {
+        uint64_t frames = (frame / rec->preallocateFrames + 1) * rec->preallocateFrames;
+        sequence_entry_t *index = realloc(rec->index, frames * sizeof(sequence_entry_t));
+        if (!index)
+        {
+            printf("Recorder: out of memory for the index of %lu frames.\n", (unsigned long)frames);
+            return;
+        }
+        // for frames whose entry a failed growth kept from being filled: raw payloads are where they belong, compressed
+        // ones cannot be found
+        for (uint64_t i = rec->allocatedFrames; i < frames; i++)
+            index[i] = rec->compressing ? (sequence_entry_t){0, 0, 0, 0, 0, SEQUENCE_FRAME_WRITE_ERROR}
+                                        : (sequence_entry_t){(uint64_t)frame_offset(rec, i), rec->frameSize, 0, 0, 0, 0};
+        rec->index = index;
+        rec->allocatedFrames = frames;
+    }
+    if (end > rec->allocatedBytes)
+    {
+        uint64_t chunk = rec->preallocateFrames * rec->slotSize;
+        uint64_t bytes = rec->header.headerSize + ((end - rec->header.headerSize) / chunk + 1) * chunk;
+        if (fallocate(rec->fd, 0, 0, (off_t)bytes) && errno != EOPNOTSUPP)
+            printf("Recorder: fallocate failed - %s\n", strerror(errno));
+        rec->allocatedBytes = bytes;
+    }
+}
+
+// a slot is only handed back once every frame before it is written, so the callback fills slots in order
+static void slot_written(recorder_t *rec, uint64_t frame, int64_t result)
+{
+    const uint8_t *data;
+    uint64_t offset;
+    size_t length, size;
+    frame_extent(rec, frame, &data, &offset, &length, &size);
+    int written = length && result == (int64_t)length;
+    if (written)
+    {
+        atomic_fetch_add_explicit(&rec->bytes, length, memory_order_relaxed);
+        atomic_fetch_add_explicit(&rec->payloadBytes, size, memory_order_relaxed);
+    }
+    else
+        atomic_fetch_add_explicit(&rec->writeErrors, 1, memory_order_relaxed);
+    if (frame < rec->allocatedFrames)
+    {
+        // the slot is not refilled before it retires below
+        const frame_desc_t *f = &rec->slotFrames[frame % rec->slotCount];
+        rec->index[frame] = (sequence_entry_t){offset, size, f->timestamp, f->receivedNs, f->bufferID,
+                                               written ? 0 : SEQUENCE_FRAME_WRITE_ERROR};
+    }
+    rec->done[frame % rec->slotCount] = 1;
+    uint64_t retired = atomic_load_explicit(&rec->retired, memory_order_relaxed);
+    while (rec->done[retired % rec->slotCount] && retired < atomic_load_explicit(&rec->claimed, memory_order_relaxed))
+        rec->done[retired++ % rec->slotCount] = 0;
+    atomic_store_explicit(&rec->retired, retired, memory_order_release);
+}
+
+static int64_t write_all(int fd, const uint8_t *src, size_t size, off_t offset)
+{
+    size_t written = 0;
+    while (written < size)
+    {
+        ssize_t ret = pwrite(fd, src + written, size - written, offset + (off_t)written);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return -1;
+        written += (size_t)ret;
+    }
+    return (int64_t)written;
+}
+
+static void *write_thread(void *arg)
+{
+    recorder_t *rec = (recorder_t *)arg;
+    for (;;)
+    {
+        while (sem_wait(&rec->work) && errno == EINTR)
+            ;
+        // one post per frame and one per thread at quit, so a thread that finds nothing to claim may leave
+        uint64_t frame = atomic_load(&rec->claimed);
+        do
+        {
+            if (frame >= ready_frames(rec))
+                return NULL;
+        } while (!atomic_compare_exchange_weak(&rec->claimed, &frame, frame + 1));
+        const uint8_t *data;
+        uint64_t offset;
+        size_t length, size;
+        frame_extent(rec, frame, &data, &offset, &length, &size);
+        pthread_mutex_lock(&rec->lock);
+        reserve(rec, frame, offset + length);
+        pthread_mutex_unlock(&rec->lock);
+        int64_t result = length ? write_all(rec->fd, data, length, (off_t)offset) : -1;
+        pthread_mutex_lock(&rec->lock);
+        slot_written(rec, frame, result);
+        pthread_mutex_unlock(&rec->lock);
+    }
+}
+
+static struct io_uring_sqe *uring_next_sqe(recorder_uring_t *u)
+{
+    unsigned tail = *u->sqTail, index = tail & *u->sqMask;
+    struct io_uring_sqe *sqe = &u->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sqArray[index] = index;
+    // the kernel reads the entry once it sees the new tail
+    __atomic_store_n(u->sqTail, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+static void uring_arm_event(recorder_uring_t *u)
+{
+    struct io_uring_sqe *sqe = uring_next_sqe(u);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = u->eventFd;
+    sqe->addr = (uintptr_t)&u->eventValue;
+    sqe->len = sizeof(u->eventValue);
+    sqe->user_data = EVENT_TAG;
+}
+
+// writes are queued as soon as a frame is ready (copied by the callback, or compressed), the thread sleeps in
+// io_uring_enter until a write completes or the eventfd says there are new frames
+static void *uring_thread(void *arg)
+{
+    recorder_t *rec = (recorder_t *)arg;
+    recorder_uring_t *u = rec->uring;
+    unsigned pending = 1, inflight = 0; // prepared and not yet submitted, submitted writes
+    uring_arm_event(u);
+    for (;;)
+    {
+        uint64_t ready = ready_frames(rec);
+        uint64_t frame = atomic_load_explicit(&rec->claimed, memory_order_relaxed);
+        for (; frame < ready; frame++)
+        {
+            const uint8_t *data;
+            uint64_t offset;
+            size_t length, size;
+            frame_extent(rec, frame, &data, &offset, &length, &size);
+            atomic_store_explicit(&rec->claimed, frame + 1, memory_order_relaxed);
+            if (!length)
+            {
+                // a frame the encoder failed on, nothing to write
+                slot_written(rec, frame, -1);
+                continue;
+            }
+            reserve(rec, frame, offset + length);
+            struct io_uring_sqe *sqe = uring_next_sqe(u);
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->fd = rec->fd;
+            sqe->addr = (uintptr_t)data;
+            sqe->len = (uint32_t)length;
+            sqe->off = offset;
+            sqe->user_data = frame;
+            pending++;
+            inflight++;
+        }
+        if (atomic_load(&rec->quit) && !inflight && frame == ready_frames(rec))
+            return NULL;
+
+        int ret = (int)syscall(__NR_io_uring_enter, u->ringFd, pending, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+            printf("Recorder: io_uring_enter failed - %s\n", strerror(errno));
+            return NULL;
+        }
+        pending -= ret > 0 ? (unsigned)ret : 0;
+
+        unsigned cqHead = *u->cqHead, cqTail = __atomic_load_n(u->cqTail, __ATOMIC_ACQUIRE);
+        for (; cqHead != cqTail; cqHead++)
+        {
+            struct io_uring_cqe *cqe = &u->cqes[cqHead & *u->cqMask];
+            if (cqe->user_data == EVENT_TAG)
+            {
+                uring_arm_event(u);
+                pending++;
+                continue;
+            }
+            slot_written(rec, cqe->user_data, cqe->res);
+            inflight--;
+        }
+        __atomic_store_n(u->cqHead, cqHead, __ATOMIC_RELEASE);
+    }
+}
+
+static void wake_writers(recorder_t *rec)
+{
+    if (rec->uring)
+    {
+        uint64_t one = 1;
+        if (write(rec->uring->eventFd, &one, sizeof(one)) < 0)
+            atomic_fetch_add_explicit(&rec->writeErrors, 1, memory_order_relaxed);
+    }
+    else
+        sem_post(&rec->work);
+}
+
+// compresses the copied frames in order and places them back to back in the file; the tiles of a frame run on the pool
+static void *encode_thread(void *arg)
+{
+    recorder_t *rec = (recorder_t *)arg;
+    for (;;)
+    {
+        while (sem_wait(&rec->encode) && errno == EINTR)
+            ;
+        uint64_t frame = atomic_load_explicit(&rec->encoded, memory_order_relaxed);
+        if (frame >= atomic_load_explicit(&rec->head, memory_order_acquire))
+        {
+            if (atomic_load(&rec->encoderQuit))
+                return NULL;
+            continue;
+        }
+        int s = (int)(frame % rec->slotCount);
+        size_t size = tile_codec_encode(&rec->codec, &rec->pool, rec->slots[s], rec->packed[s]);
+        size_t length = round_up(size, RECORDER_ALIGNMENT);
+        // O_DIRECT writes whole blocks, the padding is zero in the file
+        memset(rec->packed[s] + size, 0, length - size);
+        rec->packedOffset[s] = rec->nextOffset;
+        rec->packedSize[s] = size;
+        rec->nextOffset += length;
+        atomic_store_explicit(&rec->encoded, frame + 1, memory_order_release);
+        wake_writers(rec);
+    }
+}
+
+static void stop_encoder(recorder_t *rec)
+{
+    if (!rec->compressing)
+        return;
+    atomic_store(&rec->encoderQuit, 1);
+    sem_post(&rec->encode);
+    pthread_join(rec->encoder, NULL);
+}
+
+static void uring_destroy(recorder_t *rec)
+{
+    recorder_uring_t *u = rec->uring;
+    if (!u)
+        return;
+    if (u->sqes)
+        munmap(u->sqes, u->sqesSize);
+    if (u->cqRing)
+        munmap(u->cqRing, u->cqRingSize);
+    if (u->sqRing)
+        munmap(u->sqRing, u->sqRingSize);
+    if (u->ringFd >= 0)
+        close(u->ringFd);
+    if (u->eventFd >= 0)
+        close(u->eventFd);
+    free(u);
+    rec->uring = NULL;
+}
+
+static int uring_create(recorder_t *rec)
+{
+    struct io_uring_params params;
+    recorder_uring_t *u = calloc(1, sizeof(recorder_uring_t));
+    if (!u)
+        return -1;
+    rec->uring = u;
+    memset(&params, 0, sizeof(params));
+    // every slot in flight plus the eventfd read
+    u->ringFd = (int)syscall(__NR_io_uring_setup, rec->slotCount + 1, &params);
+    u->eventFd = eventfd(0, EFD_CLOEXEC);
+    if (u->ringFd < 0 || u->eventFd < 0)
+    {
+        uring_destroy(rec);
+        return -1;
+    }
+    u->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    u->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    u->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqRing = mmap(NULL, u->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ringFd, IORING_OFF_SQ_RING);
+    u->cqRing = mmap(NULL, u->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ringFd, IORING_OFF_CQ_RING);
+    u->sqes = mmap(NULL, u->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ringFd, IORING_OFF_SQES);
+    if (u->sqRing == MAP_FAILED || u->cqRing == MAP_FAILED || u->sqes == MAP_FAILED)
+    {
+        u->sqRing = u->sqRing == MAP_FAILED ? NULL : u->sqRing;
+        u->cqRing = u->cqRing == MAP_FAILED ? NULL : u->cqRing;
+        u->sqes = u->sqes == MAP_FAILED ? NULL : u->sqes;
+        uring_destroy(rec);
+        return -1;
+    }
+    u->sqTail = (unsigned *)((uint8_t *)u->sqRing + params.sq_off.tail);
+    u->sqMask = (unsigned *)((uint8_t *)u->sqRing + params.sq_off.ring_mask);
+    u->sqArray = (unsigned *)((uint8_t *)u->sqRing + params.sq_off.array);
+    u->cqHead = (unsigned *)((uint8_t *)u->cqRing + params.cq_off.head);
+    u->cqTail = (unsigned *)((uint8_t *)u->cqRing + params.cq_off.tail);
+    u->cqMask = (unsigned *)((uint8_t *)u->cqRing + params.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)((uint8_t *)u->cqRing + params.cq_off.cqes);
+    return 0;
+}
+
+static void free_slots(recorder_t *rec)
+{
+    for (int i = 0; i < RECORDER_MAX_SLOTS; i++)
+    {
+        if (!rec->borrowing)
+            free(rec->slots[i]);
+        free(rec->packed[i]);
+        rec->slots[i] = rec->packed[i] = NULL;
+    }
+    free(rec->index);
+    rec->index = NULL;
+}
+
+static void free_compression(recorder_t *rec)
+{
+    if (!rec->compressing)
+        return;
+    worker_pool_destroy(&rec->pool);
+    tile_codec_destroy(&rec->codec);
+    sem_destroy(&rec->encode);
+    rec->compressing = 0;
+}
+
+// codec, payload buffers and pool of the encoder; the frames are placed one after the other from the header on
+static int setup_compression(recorder_t *rec, const recorder_config_t *config)
+{
+    uint64_t pixels = (uint64_t)rec->header.width * rec->header.height;
+    uint32_t bytesPerPixel = pixels ? (uint32_t)(rec->frameSize / pixels) : 0;
+    if (!bytesPerPixel || pixels * bytesPerPixel != rec->frameSize ||
+        tile_codec_init(&rec->codec, rec->header.width, rec->header.height, bytesPerPixel, (uint32_t)config->tileRows,
+                        config->compressionLevel, config->compressionStrategy))
+    {
+        printf("Recorder: cannot compress %ux%u frames of %zu bytes.\n", rec->header.width, rec->header.height,
+               rec->frameSize);
+        return -1;
+    }
+    size_t packedSize = round_up(tile_codec_bound(&rec->codec), RECORDER_ALIGNMENT);
+    for (int i = 0; i < rec->slotCount; i++)
+    {
+        rec->packed[i] = aligned_alloc(RECORDER_ALIGNMENT, packedSize);
+        if (!rec->packed[i])
+        {
+            printf("Recorder: out of memory for %d payloads of %zu bytes.\n", rec->slotCount, packedSize);
+            tile_codec_destroy(&rec->codec);
+            return -1;
+        }
+        memset(rec->packed[i], 0, packedSize);
+    }
+    if (worker_pool_init(&rec->pool, config->compressionThreads, -1))
+        printf("Recorder: the encoder runs on %d threads.\n", rec->pool.threads);
+    sem_init(&rec->encode, 0, 0);
+    rec->compressing = 1;
+    rec->header.compression = SEQUENCE_COMPRESSION_TILED_ZLIB;
+    rec->header.tileRows = rec->codec.tileRows;
+    rec->nextOffset = rec->header.headerSize;
+    return 0;
+}
+
+// size bytes at offset through an aligned bounce buffer, O_DIRECT takes whole blocks only
+static int write_aligned(recorder_t *rec, const void *data, size_t size, off_t offset)
+{
+    size_t padded = round_up(size ? size : 1, RECORDER_ALIGNMENT);
+    uint8_t *page = aligned_alloc(RECORDER_ALIGNMENT, padded);
+    if (!page)
+        return -1;
+    memset(page + size, 0, padded - size);
+    memcpy(page, data, size);
+    int64_t result = write_all(rec->fd, page, padded, offset);
+    free(page);
+    return result == (int64_t)padded ? 0 : -1;
+}
+
+int recorder_start(recorder_t *rec, const recorder_config_t *config, const char *path, const sequence_header_t *format)
+{
+    if (rec->running)
+        return -1;
+    rec->frameSize = format->frameSize;
+    rec->slotSize = round_up(format->frameSize, RECORDER_ALIGNMENT);
+    // frameCount and indexOffset stay 0 until recorder_stop, a reader of an unfinished file knows it
+    rec->header = *format;
+    rec->header.headerSize = SEQUENCE_HEADER_SIZE;
+    rec->header.frameStride = rec->slotSize;
+    rec->header.frameCount = 0;
+    rec->header.indexOffset = 0;
+    rec->header.compression = SEQUENCE_COMPRESSION_NONE;
+    rec->header.tileRows = 0;
+    rec->slotCount = config->slots < 2 ? 2 : (config->slots > RECORDER_MAX_SLOTS ? RECORDER_MAX_SLOTS : config->slots);
+    atomic_store(&rec->head, 0);
+    atomic_store(&rec->claimed, 0);
+    atomic_store(&rec->retired, 0);
+    atomic_store(&rec->dropped, 0);
+    atomic_store(&rec->bytes, 0);
+    atomic_store(&rec->payloadBytes, 0);
+    atomic_store(&rec->writeErrors, 0);
+    atomic_store(&rec->maxBacklog, 0);
+    atomic_store(&rec->quit, 0);
+    atomic_store(&rec->encoded, 0);
+    atomic_store(&rec->encoderQuit, 0);
+    rec->compressing = 0;
+    rec->borrowing = config->borrowFrames;
+    memset(rec->done, 0, sizeof(rec->done));
+    for (int i = 0; i < rec->slotCount && !rec->borrowing; i++)
+    {
+        // touched once here, so the callback never takes a page fault; the padding stays zero
+        rec->slots[i] = aligned_alloc(RECORDER_ALIGNMENT, rec->slotSize);
+        if (!rec->slots[i])
+        {
+            printf("Recorder: out of memory for %d slots of %zu bytes.\n", rec->slotCount, rec->slotSize);
+            free_slots(rec);
+            return -1;
+        }
+        memset(rec->slots[i], 0, rec->slotSize);
+    }
+    if (config->compressionLevel > 0 && setup_compression(rec, config))
+    {
+        free_slots(rec);
+        return -1;
+    }
+
+    rec->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | (config->direct ? O_DIRECT : 0), 0644);
+    if (rec->fd < 0 && config->direct && errno == EINVAL)
+    {
+        printf("Recorder: %s does not take O_DIRECT, writing through the page cache.\n", path);
+        rec->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    }
+    if (rec->fd < 0)
+    {
+        printf("Recorder: cannot create %s - %s\n", path, strerror(errno));
+        free_compression(rec);
+        free_slots(rec);
+        return -1;
+    }
+    if (write_aligned(rec, &rec->header, sizeof(rec->header), 0))
+    {
+        printf("Recorder: cannot write the header of %s - %s\n", path, strerror(errno));
+        close(rec->fd);
+        free_compression(rec);
+        free_slots(rec);
+        return -1;
+    }
+    rec->preallocateFrames = (uint64_t)(format->fps * config->preallocateSeconds);
+    rec->preallocateFrames = rec->preallocateFrames ? rec->preallocateFrames : 1;
+    rec->allocatedFrames = 0;
+    rec->allocatedBytes = 0;
+    reserve(rec, 0, (uint64_t)frame_offset(rec, 1));
+
+    pthread_mutex_init(&rec->lock, NULL);
+    sem_init(&rec->work, 0, 0);
+    // it only wakes the writers once frames arrive, after they are all started
+    if (rec->compressing && pthread_create(&rec->encoder, NULL, encode_thread, rec))
+    {
+        printf("Recorder: the encoder could not be started, recording uncompressed frames.\n");
+        // the header page on disk says compressed until stop rewrites it
+        free_compression(rec);
+        rec->header.compression = SEQUENCE_COMPRESSION_NONE;
+        rec->header.tileRows = 0;
+    }
+    rec->threadCount = 0;
+    rec->backend = config->backend;
+    if (rec->backend != RECORDER_THREADS && uring_create(rec) == 0)
+    {
+        rec->backend = RECORDER_IO_URING;
+        if (pthread_create(&rec->threads[0], NULL, uring_thread, rec) == 0)
+            rec->threadCount = 1;
+    }
+    else if (rec->backend != RECORDER_IO_URING)
+    {
+        int writers = config->writers < 1 ? 1 : (config->writers > RECORDER_MAX_WRITERS ? RECORDER_MAX_WRITERS : config->writers);
+        rec->backend = RECORDER_THREADS;
+        while (rec->threadCount < writers && pthread_create(&rec->threads[rec->threadCount], NULL, write_thread, rec) == 0)
+            rec->threadCount++;
+    }
+    if (!rec->threadCount)
+    {
+        printf("Recorder: no writer could be started.\n");
+        stop_encoder(rec);
+        uring_destroy(rec);
+        sem_destroy(&rec->work);
+        pthread_mutex_destroy(&rec->lock);
+        close(rec->fd);
+        free_compression(rec);
+        free_slots(rec);
+        return -1;
+    }
+    rec->startNs = frame_clock_ns();
+    rec->stopNs = 0;
+    rec->running = 1;
+    atomic_store(&rec->accepting, 1);
+    return 0;
+}
+
+int recorder_push(recorder_t *rec, const frame_desc_t *frame)
+{
+    int taken = 0;
+    atomic_fetch_add(&rec->pushing, 1);
+    if (atomic_load(&rec->accepting))
+    {
+        // the callback is the only writer of head
+        uint64_t head = atomic_load_explicit(&rec->head, memory_order_relaxed);
+        uint64_t backlog = head - atomic_load_explicit(&rec->retired, memory_order_acquire);
+        if (backlog < (uint64_t)rec->slotCount)
+        {
+            if (rec->borrowing)
+                rec->slots[head % rec->slotCount] = frame->base;
+            else
+                memcpy(rec->slots[head % rec->slotCount], frame->base, rec->frameSize);
+            rec->slotFrames[head % rec->slotCount] = *frame;
+            atomic_store_explicit(&rec->head, head + 1, memory_order_release);
+            if (backlog + 1 > atomic_load_explicit(&rec->maxBacklog, memory_order_relaxed))
+                atomic_store_explicit(&rec->maxBacklog, (unsigned)(backlog + 1), memory_order_relaxed);
+            if (rec->compressing)
+                sem_post(&rec->encode);
+            else
+                wake_writers(rec);
+            taken = 1;
+        }
+        else
+            atomic_fetch_add_explicit(&rec->dropped, 1, memory_order_relaxed);
+    }
+    atomic_fetch_sub(&rec->pushing, 1);
+    return taken;
+}
+
+void recorder_stop(recorder_t *rec)
+{
+    if (!rec->running)
+        return;
+    atomic_store(&rec->accepting, 0);
+    // a callback that saw accepting set finishes its copy first
+    while (atomic_load(&rec->pushing))
+        sched_yield();
+    // every copied frame is compressed before the writers are told to finish
+    stop_encoder(rec);
+    atomic_store(&rec->quit, 1);
+    if (rec->uring)
+    {
+        uint64_t one = 1;
+        if (write(rec->uring->eventFd, &one, sizeof(one)) < 0)
+            printf("Recorder: cannot wake the writer - %s\n", strerror(errno));
+    }
+    else
+        for (int i = 0; i < rec->threadCount; i++)
+            sem_post(&rec->work);
+    for (int i = 0; i < rec->threadCount; i++)
+        pthread_join(rec->threads[i], NULL);
+    rec->threadCount = 0;
+    rec->stopNs = frame_clock_ns();
+
+    // the index right after the last frame, then the header that points to it; the file ends with the index
+    uint64_t frames = atomic_load(&rec->head);
+    off_t end = rec->compressing ? (off_t)rec->nextOffset : frame_offset(rec, frames);
+    if (frames <= rec->allocatedFrames)
+    {
+        size_t indexSize = frames * sizeof(sequence_entry_t);
+        rec->header.frameCount = frames;
+        rec->header.indexOffset = (uint64_t)end;
+        if (write_aligned(rec, rec->index, indexSize, end) || write_aligned(rec, &rec->header, sizeof(rec->header), 0))
+        {
+            printf("Recorder: cannot write the index - %s\n", strerror(errno));
+            rec->header.frameCount = rec->header.indexOffset = 0;
+        }
+        else
+            end += (off_t)indexSize;
+    }
+    else
+        printf("Recorder: the index is incomplete, the file is left without one.\n");
+    if (ftruncate(rec->fd, end))
+        printf("Recorder: cannot trim the preallocation - %s\n", strerror(errno));
+    close(rec->fd);
+    uring_destroy(rec);
+    sem_destroy(&rec->work);
+    pthread_mutex_destroy(&rec->lock);
+    free_compression(rec);
+    free_slots(rec);
+    rec->running = 0;
+}
+
+void recorder_get_stats(recorder_t *rec, recorder_stats_t *stats)
+{
+    uint64_t retired = atomic_load(&rec->retired);
+    stats->writeErrors = atomic_load(&rec->writeErrors);
+    stats->frames = retired > stats->writeErrors ? retired - stats->writeErrors : 0;
+    stats->dropped = atomic_load(&rec->dropped);
+    stats->bytes = atomic_load(&rec->bytes);
+    stats->payloadBytes = atomic_load(&rec->payloadBytes);
+    stats->backlog = (uint32_t)(atomic_load(&rec->head) - retired);
+    stats->maxBacklog = atomic_load(&rec->maxBacklog);
+    stats->seconds = rec->startNs ? ((rec->stopNs ? rec->stopNs : frame_clock_ns()) - rec->startNs) / 1e9 : 0.0;
+}
+
+void recorder_print_stats(recorder_t *rec)
+{
+    recorder_stats_t stats;
+    recorder_get_stats(rec, &stats);
+    printf("Recorder (%s): %lu frames, %lu dropped, %lu write errors, %.1f MB/s over %.1f s, backlog %u (max %u of %d "
+           "slots)\n",
+           rec->backend == RECORDER_IO_URING ? "io_uring" : "pwrite threads", (unsigned long)stats.frames,
+           (unsigned long)stats.dropped, (unsigned long)stats.writeErrors,
+           stats.seconds > 0 ? stats.bytes / stats.seconds / 1e6 : 0.0, stats.seconds, stats.backlog, stats.maxBacklog,
+           rec->slotCount);
+    if (rec->header.compression == SEQUENCE_COMPRESSION_TILED_ZLIB && stats.frames)
+        printf("Recorder: compressed to %.1f%% of %lu raw bytes in tiles of %u rows\n",
+               100.0 * stats.payloadBytes / ((double)stats.frames * rec->frameSize),
+               (unsigned long)(stats.frames * rec->frameSize), rec->header.tileRows);
+}
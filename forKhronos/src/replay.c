@@ -0,0 +1,235 @@
+#include "myCode/replay.h"
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+// longest single sleep, so replay_stop never waits out a long gap in the timestamps
+#define REPLAY_MAX_SLEEP_NS 50000000ull
+// poll interval while every decoded buffer is held
+#define REPLAY_BUFFER_WAIT_US 500
+
+int replay_open(replay_t *replay, const char *path)
+{
+    memset(replay, 0, sizeof(*replay));
+    if (sequence_open(&replay->seq, path))
+        return -1;
+    const sequence_header_t *h = replay->seq.header;
+    uint64_t written = 0;
+    for (uint64_t n = 0; n < replay->seq.frameCount; n++)
+        written += !(replay->seq.index[n].flags & SEQUENCE_FRAME_WRITE_ERROR);
+    if (!written)
+    {
+        printf("Replay: %s has no frames.\n", path);
+        sequence_close(&replay->seq);
+        return -1;
+    }
+    replay->periodNs = h->fps > 0 ? (uint64_t)(1e9 / h->fps) : 16666667ull;
+    const sequence_entry_t *first = &replay->seq.index[0], *last = &replay->seq.index[replay->seq.frameCount - 1];
+    replay->durationNs = (last->timestamp > first->timestamp ? last->timestamp - first->timestamp : 0) + replay->periodNs;
+    if (posix_fadvise(replay->seq.fd, 0, 0, POSIX_FADV_SEQUENTIAL))
+        printf("Replay: posix_fadvise failed, default readahead.\n");
+    printf("Replay: %s, %ux%u %s%s, %lu frames, %.1f s\n", path, h->width, h->height, h->pixelFormat,
+           h->compression == SEQUENCE_COMPRESSION_TILED_ZLIB ? " compressed" : "", (unsigned long)replay->seq.frameCount,
+           replay->durationNs / 1e9);
+    return 0;
+}
+
+// pages of frame n are read in the background, the mapping starts on a page so the range is rounded down to one
+static void prefetch(replay_t *replay, uint64_t n)
+{
+    const sequence_entry_t *entry;
+    const uint8_t *frame = sequence_frame(&replay->seq, n % replay->seq.frameCount, &entry);
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)frame & ~(page - 1);
+    madvise((void *)start, (uintptr_t)frame + entry->size - start, MADV_WILLNEED);
+}
+
+// from the start of playback, in recorded time; recordings without timestamps play at the header's frame rate
+static uint64_t recorded_time(const replay_t *replay, uint64_t n, uint64_t loop)
+{
+    const sequence_entry_t *first = &replay->seq.index[0], *entry = &replay->seq.index[n];
+    uint64_t t = first->timestamp && entry->timestamp >= first->timestamp ? entry->timestamp - first->timestamp
+                                                                         : n * replay->periodNs;
+    return t + loop * replay->durationNs;
+}
+
+static void wait_until(replay_t *replay, uint64_t due)
+{
+    for (uint64_t now = frame_clock_ns(); now < due && !atomic_load(&replay->quit); now = frame_clock_ns())
+    {
+        uint64_t ns = due - now < REPLAY_MAX_SLEEP_NS ? due - now : REPLAY_MAX_SLEEP_NS;
+        nanosleep(&(struct timespec){(time_t)(ns / 1000000000), (long)(ns % 1000000000)}, NULL);
+    }
+}
+
+// a decoded buffer nobody holds, oldest first; -1 once the replay is stopped
+static int take_buffer(replay_t *replay, uint64_t delivered)
+{
+    for (int waited = 0; !atomic_load(&replay->quit); waited = 1)
+    {
+        for (int i = 0; i < REPLAY_DECODED_FRAMES; i++)
+        {
+            int index = (int)((delivered + (uint64_t)i) % REPLAY_DECODED_FRAMES);
+            if (!atomic_load_explicit(&replay->held[index], memory_order_acquire))
+            {
+                atomic_store_explicit(&replay->held[index], 1, memory_order_relaxed);
+                if (waited)
+                    atomic_fetch_add_explicit(&replay->decodeWaits, 1, memory_order_relaxed);
+                return index;
+            }
+        }
+        usleep(REPLAY_BUFFER_WAIT_US);
+    }
+    return -1;
+}
+
+static void *replay_thread(void *arg)
+{
+    replay_t *replay = (replay_t *)arg;
+    uint64_t count = replay->seq.frameCount, ahead = (uint64_t)replay->config.readaheadFrames;
+    uint64_t startNs = frame_clock_ns(), delivered = 0;
+    for (uint64_t n = 0; n <= ahead && n < count; n++)
+        prefetch(replay, n);
+    for (uint64_t loop = 0;; loop++)
+    {
+        for (uint64_t n = 0; n < count; n++)
+        {
+            if (atomic_load(&replay->quit))
+                return NULL;
+            if (ahead && (replay->config.loop || n + ahead < count))
+                prefetch(replay, n + ahead);
+            uint64_t t = recorded_time(replay, n, loop);
+            const sequence_entry_t *entry;
+            uint8_t *base = (uint8_t *)sequence_frame(&replay->seq, n, &entry);
+            if (entry->flags & SEQUENCE_FRAME_WRITE_ERROR)
+            {
+                // its bytes are whatever the file held, not a frame
+                atomic_fetch_add_explicit(&replay->unwritten, 1, memory_order_relaxed);
+                continue;
+            }
+            int buffer = -1;
+            if (replay->decoding)
+            {
+                // inflated before the frame is due, the wait below absorbs the decoding time
+                if ((buffer = take_buffer(replay, delivered)) < 0)
+                    return NULL;
+                base = replay->decoded[buffer];
+                if (sequence_decode(&replay->seq, n, &replay->pool, base))
+                {
+                    atomic_store_explicit(&replay->held[buffer], 0, memory_order_release);
+                    atomic_fetch_add_explicit(&replay->decodeErrors, 1, memory_order_relaxed);
+                    continue;
+                }
+            }
+            if (replay->config.speed > 0)
+                wait_until(replay, startNs + (uint64_t)(t / replay->config.speed));
+            else
+                sched_yield(); // the consumer gets the CPU between frames even on one core
+
+            frame_desc_t frame;
+            memset(&frame, 0, sizeof(frame));
+            frame.base = base;
+            frame.bufferHandle = (STREAM_BUFFER_HANDLE)(buffer + 1);
+            frame.bufferID = entry->bufferID;
+            frame.timestamp = replay->seq.index[0].timestamp + t;
+            frame.receivedNs = frame_clock_ns();
+            replay->deliver(&frame, replay->context);
+            atomic_fetch_add_explicit(&replay->delivered, 1, memory_order_relaxed);
+            delivered++;
+        }
+        if (!replay->config.loop)
+            return NULL;
+        atomic_fetch_add_explicit(&replay->loops, 1, memory_order_relaxed);
+    }
+}
+
+void replay_release(const frame_desc_t *frame, void *context)
+{
+    replay_t *replay = (replay_t *)context;
+    if (frame->bufferHandle > 0 && frame->bufferHandle <= REPLAY_DECODED_FRAMES)
+        atomic_store_explicit(&replay->held[frame->bufferHandle - 1], 0, memory_order_release);
+}
+
+static void free_decoder(replay_t *replay)
+{
+    if (replay->decoding)
+        worker_pool_destroy(&replay->pool);
+    for (int i = 0; i < REPLAY_DECODED_FRAMES; i++)
+    {
+        free(replay->decoded[i]);
+        replay->decoded[i] = NULL;
+    }
+    replay->decoding = 0;
+}
+
+int replay_start(replay_t *replay, const replay_config_t *config, replay_deliver_fn deliver, void *context)
+{
+    if (replay->running || !replay->seq.map)
+        return -1;
+    replay->config = *config;
+    if (replay->config.readaheadFrames < 0)
+        replay->config.readaheadFrames = 0;
+    replay->deliver = deliver;
+    replay->context = context;
+    atomic_store(&replay->quit, 0);
+    atomic_store(&replay->delivered, 0);
+    atomic_store(&replay->loops, 0);
+    atomic_store(&replay->decodeErrors, 0);
+    atomic_store(&replay->unwritten, 0);
+    atomic_store(&replay->decodeWaits, 0);
+    for (int i = 0; i < REPLAY_DECODED_FRAMES; i++)
+        atomic_store(&replay->held[i], 0);
+    if (replay->seq.header->compression != SEQUENCE_COMPRESSION_NONE)
+    {
+        for (int i = 0; i < REPLAY_DECODED_FRAMES; i++)
+            if (!(replay->decoded[i] = malloc(replay->seq.header->frameSize)))
+            {
+                printf("Replay: out of memory for %d decoded frames.\n", REPLAY_DECODED_FRAMES);
+                free_decoder(replay);
+                return -1;
+            }
+        if (worker_pool_init(&replay->pool, replay->config.decodeThreads, -1))
+            printf("Replay: the decoder runs on %d threads.\n", replay->pool.threads);
+        replay->decoding = 1;
+    }
+    int ret = pthread_create(&replay->thread, NULL, replay_thread, replay);
+    if (ret)
+    {
+        printf("Replay: cannot start the thread - %s\n", strerror(ret));
+        free_decoder(replay);
+        return -1;
+    }
+    replay->running = 1;
+    return 0;
+}
+
+void replay_stop(replay_t *replay)
+{
+    if (!replay->running)
+        return;
+    atomic_store(&replay->quit, 1);
+    pthread_join(replay->thread, NULL);
+    free_decoder(replay);
+    replay->running = 0;
+}
+
+void replay_print_stats(replay_t *replay)
+{
+    printf("Replay: %lu frames delivered, %lu loops of %lu frames, %lu damaged, %lu never written (skipped), "
+           "%lu waits for a decoded buffer\n",
+           (unsigned long)atomic_load(&replay->delivered), (unsigned long)atomic_load(&replay->loops),
+           (unsigned long)replay->seq.frameCount, (unsigned long)atomic_load(&replay->decodeErrors),
+           (unsigned long)atomic_load(&replay->unwritten), (unsigned long)atomic_load(&replay->decodeWaits));
+}
+
+void replay_close(replay_t *replay)
+{
+    replay_stop(replay);
+    if (replay->seq.map)
+        sequence_close(&replay->seq);
+}
@@ -0,0 +1,169 @@
+#include "myCode/sequence.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+void sequence_header_init(sequence_header_t *header, const char *pixelFormat, uint32_t width, uint32_t height,
+                          uint64_t frameSize, double fps, const color_params_t *color)
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, SEQUENCE_MAGIC, sizeof(header->magic));
+    header->version = SEQUENCE_VERSION;
+    header->headerSize = SEQUENCE_HEADER_SIZE;
+    snprintf(header->pixelFormat, sizeof(header->pixelFormat), "%s", pixelFormat);
+    header->width = width;
+    header->height = height;
+    header->frameSize = frameSize;
+    header->frameStride = (frameSize + SEQUENCE_FRAME_ALIGNMENT - 1) / SEQUENCE_FRAME_ALIGNMENT * SEQUENCE_FRAME_ALIGNMENT;
+    header->fps = fps;
+    color_params_t identity;
+    color_params_identity(&identity);
+    color = color ? color : &identity;
+    memcpy(header->ccm, color->ccm, sizeof(header->ccm));
+    memcpy(header->gains, color->gains, sizeof(header->gains));
+    header->blackLevel = color->blackLevel;
+    header->gamma = color->gamma;
+}
+
+// the frames of an unfinished recording: every whole stride after the header, as the recorder placed them
+static int rebuild_index(sequence_t *seq)
+{
+    const sequence_header_t *h = seq->header;
+    seq->frameCount = (seq->mapSize - h->headerSize) / h->frameStride;
+    seq->rebuilt = calloc(seq->frameCount ? seq->frameCount : 1, sizeof(sequence_entry_t));
+    if (!seq->rebuilt)
+        return -1;
+    for (uint64_t i = 0; i < seq->frameCount; i++)
+    {
+        seq->rebuilt[i].offset = h->headerSize + i * h->frameStride;
+        seq->rebuilt[i].size = h->frameSize;
+    }
+    seq->index = seq->rebuilt;
+    printf("Sequence: no index, the recording was not stopped; %lu frames without timestamps.\n",
+           (unsigned long)seq->frameCount);
+    return 0;
+}
+
+static int check(sequence_t *seq)
+{
+    const sequence_header_t *h = seq->header;
+    if (seq->mapSize < SEQUENCE_HEADER_SIZE || memcmp(h->magic, SEQUENCE_MAGIC, sizeof(h->magic)))
+    {
+        printf("Sequence: not a recorded sequence.\n");
+        return -1;
+    }
+    if (h->version != SEQUENCE_VERSION || h->headerSize < sizeof(*h) || h->headerSize > seq->mapSize ||
+        h->frameStride < h->frameSize || !h->frameStride)
+    {
+        printf("Sequence: unsupported version %u or damaged header.\n", h->version);
+        return -1;
+    }
+    if (h->compression > SEQUENCE_COMPRESSION_TILED_ZLIB)
+    {
+        printf("Sequence: unknown compression %u.\n", h->compression);
+        return -1;
+    }
+    if (h->compression == SEQUENCE_COMPRESSION_TILED_ZLIB &&
+        (!h->width || !h->height || h->frameSize % ((uint64_t)h->width * h->height) ||
+         tile_codec_init(&seq->codec, h->width, h->height, (uint32_t)(h->frameSize / ((uint64_t)h->width * h->height)),
+                         h->tileRows, 0, 0) ||
+         seq->codec.tileRows != h->tileRows))
+    {
+        printf("Sequence: damaged header of a compressed sequence.\n");
+        return -1;
+    }
+    if (!h->indexOffset)
+    {
+        if (h->compression != SEQUENCE_COMPRESSION_NONE)
+        {
+            printf("Sequence: a compressed recording that was not stopped has no index to find its frames.\n");
+            return -1;
+        }
+        return rebuild_index(seq);
+    }
+    if (h->indexOffset > seq->mapSize || h->frameCount > (seq->mapSize - h->indexOffset) / sizeof(sequence_entry_t))
+    {
+        printf("Sequence: index past the end of the file.\n");
+        return -1;
+    }
+    seq->index = (const sequence_entry_t *)(seq->map + h->indexOffset);
+    seq->frameCount = h->frameCount;
+    // checked once here, so sequence_frame only looks the entry up
+    for (uint64_t i = 0; i < seq->frameCount; i++)
+        if (seq->index[i].offset > h->indexOffset || seq->index[i].size > h->indexOffset - seq->index[i].offset)
+        {
+            printf("Sequence: frame %lu points outside the payloads.\n", (unsigned long)i);
+            return -1;
+        }
+    return 0;
+}
+
+int sequence_open(sequence_t *seq, const char *path)
+{
+    struct stat st;
+    memset(seq, 0, sizeof(*seq));
+    seq->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (seq->fd < 0 || fstat(seq->fd, &st))
+    {
+        printf("Sequence: cannot open %s - %s\n", path, strerror(errno));
+        sequence_close(seq);
+        return -1;
+    }
+    seq->mapSize = (size_t)st.st_size;
+    void *map = seq->mapSize ? mmap(NULL, seq->mapSize, PROT_READ, MAP_SHARED, seq->fd, 0) : MAP_FAILED;
+    if (map == MAP_FAILED)
+    {
+        printf("Sequence: cannot map %s - %s\n", path, seq->mapSize ? strerror(errno) : "empty file");
+        sequence_close(seq);
+        return -1;
+    }
+    seq->map = map;
+    seq->header = (const sequence_header_t *)seq->map;
+    if (check(seq))
+    {
+        sequence_close(seq);
+        return -1;
+    }
+    return 0;
+}
+
+const uint8_t *sequence_frame(const sequence_t *seq, uint64_t n, const sequence_entry_t **entry)
+{
+    if (n >= seq->frameCount)
+        return NULL;
+    if (entry)
+        *entry = &seq->index[n];
+    return seq->map + seq->index[n].offset;
+}
+
+int sequence_decode(const sequence_t *seq, uint64_t n, worker_pool_t *pool, uint8_t *frame)
+{
+    const sequence_entry_t *entry;
+    const uint8_t *payload = sequence_frame(seq, n, &entry);
+    if (!payload)
+        return -1;
+    if (seq->header->compression == SEQUENCE_COMPRESSION_NONE)
+    {
+        if (entry->size < seq->header->frameSize)
+            return -1;
+        memcpy(frame, payload, seq->header->frameSize);
+        return 0;
+    }
+    return tile_codec_decode(&seq->codec, pool, payload, entry->size, frame);
+}
+
+void sequence_close(sequence_t *seq)
+{
+    if (seq->map)
+        munmap((void *)seq->map, seq->mapSize);
+    if (seq->fd >= 0)
+        close(seq->fd);
+    free(seq->rebuilt);
+    memset(seq, 0, sizeof(*seq));
+    seq->fd = -1;
+}
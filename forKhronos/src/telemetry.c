@@ -0,0 +1,197 @@
+#include "myCode/telemetry.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TELEMETRY_SAME_CLOCK_WINDOW_NS 1000000000ll
+
+static const char *histogramNames[TELEMETRY_HISTOGRAMS] = {
+    "acquire->callback",
+    "callback->copied",
+    "copied->uploaded",
+    "uploaded->drawn",
+    "drawn->swapped",
+    "acquire->swapped",
+    "upload stall",
+};
+
+static int bucket_index(uint64_t ns)
+{
+    if (ns < (1u << TELEMETRY_SUB_BUCKET_BITS))
+        return (int)ns;
+    int msb = 63 - __builtin_clzll(ns);
+    int sub = (int)(ns >> (msb - TELEMETRY_SUB_BUCKET_BITS)) & ((1 << TELEMETRY_SUB_BUCKET_BITS) - 1);
+    int index = ((msb - TELEMETRY_SUB_BUCKET_BITS + 1) << TELEMETRY_SUB_BUCKET_BITS) + sub;
+    return index < TELEMETRY_BUCKETS ? index : TELEMETRY_BUCKETS - 1;
+}
+
+// midpoint of the values that land in a bucket
+static double bucket_value(int index)
+{
+    if (index < (1 << TELEMETRY_SUB_BUCKET_BITS))
+        return index;
+    int msb = (index >> TELEMETRY_SUB_BUCKET_BITS) + TELEMETRY_SUB_BUCKET_BITS - 1;
+    int sub = index & ((1 << TELEMETRY_SUB_BUCKET_BITS) - 1);
+    double width = (double)(1ull << (msb - TELEMETRY_SUB_BUCKET_BITS));
+    return ((1 << TELEMETRY_SUB_BUCKET_BITS) + sub) * width + width / 2.0;
+}
+
+static void histogram_add(telemetry_histogram_t *histogram, uint64_t ns)
+{
+    atomic_fetch_add_explicit(&histogram->buckets[bucket_index(ns)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->count, 1, memory_order_relaxed);
+    uint_fast64_t max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+    while (ns > max && !atomic_compare_exchange_weak_explicit(&histogram->max, &max, ns, memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+static double percentile(const uint64_t *buckets, uint64_t count, double fraction)
+{
+    uint64_t rank = (uint64_t)(fraction * (double)count + 0.5);
+    uint64_t seen = 0;
+    if (rank == 0)
+        rank = 1;
+    for (int i = 0; i < TELEMETRY_BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+            return bucket_value(i);
+    }
+    return 0.0;
+}
+
+static void print_table(const char *title, uint64_t buckets[TELEMETRY_HISTOGRAMS][TELEMETRY_BUCKETS],
+                        const uint64_t *counts, const uint64_t *max)
+{
+    printf("%s\n%-20s %9s %9s %9s %9s\n", title, "latency [ms]", "p50", "p99", "max", "frames");
+    for (int h = 0; h < TELEMETRY_HISTOGRAMS; h++)
+    {
+        if (!counts[h])
+            continue;
+        printf("%-20s %9.3f %9.3f %9.3f %9lu\n", histogramNames[h],
+               percentile(buckets[h], counts[h], 0.50) / 1e6,
+               percentile(buckets[h], counts[h], 0.99) / 1e6,
+               max[h] / 1e6, (unsigned long)counts[h]);
+    }
+}
+
+void telemetry_init(telemetry_t *telemetry, double dumpIntervalSeconds)
+{
+    for (int h = 0; h < TELEMETRY_HISTOGRAMS; h++)
+    {
+        for (int i = 0; i < TELEMETRY_BUCKETS; i++)
+            atomic_init(&telemetry->histograms[h].buckets[i], 0);
+        atomic_init(&telemetry->histograms[h].count, 0);
+        atomic_init(&telemetry->histograms[h].max, 0);
+    }
+    telemetry->clockOffsetNs = 0;
+    telemetry->clockOffsetValid = 0;
+    telemetry->dumpIntervalNs = (uint64_t)(dumpIntervalSeconds * 1e9);
+    telemetry->lastDumpNs = frame_clock_ns();
+    memset(telemetry->previous, 0, sizeof(telemetry->previous));
+    memset(telemetry->previousCount, 0, sizeof(telemetry->previousCount));
+}
+
+void telemetry_frame_begin(telemetry_frame_t *frame, const frame_desc_t *desc)
+{
+    memset(frame, 0, sizeof(*frame));
+    frame->stamps[STAMP_ACQUIRED] = desc->timestamp;
+    frame->stamps[STAMP_CALLBACK] = desc->receivedNs;
+}
+
+void telemetry_stamp(telemetry_frame_t *frame, telemetry_stamp_t stamp)
+{
+    frame->stamps[stamp] = frame_clock_ns();
+}
+
+void telemetry_upload_stall(telemetry_frame_t *frame, uint64_t stallNs)
+{
+    frame->uploadStallNs = stallNs;
+    frame->hasUploadStall = 1;
+}
+
+void telemetry_record(telemetry_t *telemetry, const telemetry_frame_t *frame)
+{
+    const uint64_t *stamps = frame->stamps;
+    uint64_t acquired = 0;
+
+    if (stamps[STAMP_ACQUIRED] && stamps[STAMP_CALLBACK])
+    {
+        int64_t transfer = (int64_t)(stamps[STAMP_CALLBACK] - stamps[STAMP_ACQUIRED]);
+        if (transfer >= 0 && transfer < TELEMETRY_SAME_CLOCK_WINDOW_NS)
+        {
+            // grabber timestamps are host monotonic time, use them as they are
+            telemetry->clockOffsetNs = 0;
+            telemetry->clockOffsetValid = 1;
+        }
+        else if (!telemetry->clockOffsetValid || transfer < telemetry->clockOffsetNs)
+        {
+            telemetry->clockOffsetNs = transfer;
+            telemetry->clockOffsetValid = 1;
+        }
+        acquired = stamps[STAMP_ACQUIRED] + telemetry->clockOffsetNs;
+    }
+
+    uint64_t previous = acquired;
+    for (int s = STAMP_CALLBACK; s < TELEMETRY_STAMPS; s++)
+    {
+        // stages a mode skips (no copy in zero-copy mode) carry the previous stamp forward
+        uint64_t now = stamps[s] ? stamps[s] : previous;
+        if (previous && now >= previous)
+            histogram_add(&telemetry->histograms[s - 1], now - previous);
+        previous = now;
+    }
+    if (acquired && stamps[STAMP_SWAPPED] >= acquired)
+        histogram_add(&telemetry->histograms[TELEMETRY_TOTAL], stamps[STAMP_SWAPPED] - acquired);
+    if (frame->hasUploadStall)
+        histogram_add(&telemetry->histograms[TELEMETRY_UPLOAD_STALL], frame->uploadStallNs);
+}
+
+void telemetry_dump_periodic(telemetry_t *telemetry)
+{
+    uint64_t now = frame_clock_ns();
+    if (!telemetry->dumpIntervalNs || now - telemetry->lastDumpNs < telemetry->dumpIntervalNs)
+        return;
+
+    static uint64_t interval[TELEMETRY_HISTOGRAMS][TELEMETRY_BUCKETS];
+    uint64_t counts[TELEMETRY_HISTOGRAMS], max[TELEMETRY_HISTOGRAMS];
+    for (int h = 0; h < TELEMETRY_HISTOGRAMS; h++)
+    {
+        counts[h] = 0;
+        for (int i = 0; i < TELEMETRY_BUCKETS; i++)
+        {
+            uint64_t total = atomic_load_explicit(&telemetry->histograms[h].buckets[i], memory_order_relaxed);
+            interval[h][i] = total - telemetry->previous[h][i];
+            telemetry->previous[h][i] = total;
+            counts[h] += interval[h][i];
+        }
+        // max is not windowed, the interval table shows the highest bucket instead
+        max[h] = 0;
+        for (int i = TELEMETRY_BUCKETS - 1; i >= 0; i--)
+            if (interval[h][i])
+            {
+                max[h] = (uint64_t)bucket_value(i);
+                break;
+            }
+    }
+    char title[64];
+    snprintf(title, sizeof(title), "\nLatency, last %.1f s:", (now - telemetry->lastDumpNs) / 1e9);
+    print_table(title, interval, counts, max);
+    telemetry->lastDumpNs = now;
+}
+
+void telemetry_dump(telemetry_t *telemetry)
+{
+    static uint64_t totals[TELEMETRY_HISTOGRAMS][TELEMETRY_BUCKETS];
+    uint64_t counts[TELEMETRY_HISTOGRAMS], max[TELEMETRY_HISTOGRAMS];
+    for (int h = 0; h < TELEMETRY_HISTOGRAMS; h++)
+    {
+        counts[h] = 0;
+        for (int i = 0; i < TELEMETRY_BUCKETS; i++)
+        {
+            totals[h][i] = atomic_load_explicit(&telemetry->histograms[h].buckets[i], memory_order_relaxed);
+            counts[h] += totals[h][i];
+        }
+        max[h] = atomic_load_explicit(&telemetry->histograms[h].max, memory_order_relaxed);
+    }
+    print_table("\nLatency, whole run:", totals, counts, max);
+}
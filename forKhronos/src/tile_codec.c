@@ -0,0 +1,224 @@
+#include "myCode/tile_codec.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct decode_job_t
+{
+    const tile_codec_t *codec;
+    const uint8_t *payload;
+    size_t offsets[TILE_CODEC_MAX_TILES];
+    const uint32_t *sizes;
+    uint8_t *frame;
+    atomic_int failed;
+} decode_job_t;
+
+// same colour one step to the left: the next pixel but one in a Bayer row, the next pixel in RGB
+static size_t predictor_distance(const tile_codec_t *codec)
+{
+    return codec->bytesPerPixel == 1 ? 2 : codec->bytesPerPixel;
+}
+
+static uint32_t tile_rows(const tile_codec_t *codec, uint32_t tile)
+{
+    uint32_t first = tile * codec->tileRows;
+    return first + codec->tileRows <= codec->height ? codec->tileRows : codec->height - first;
+}
+
+// independent bytes, the compiler vectorises it
+static void filter_row(const uint8_t *src, uint8_t *dst, size_t size, size_t distance)
+{
+    memcpy(dst, src, distance < size ? distance : size);
+    for (size_t x = distance; x < size; x++)
+        dst[x] = (uint8_t)(src[x] - src[x - distance]);
+}
+
+static void unfilter_row(uint8_t *row, size_t size, size_t distance)
+{
+    for (size_t x = distance; x < size; x++)
+        row[x] = (uint8_t)(row[x] + row[x - distance]);
+}
+
+int tile_codec_init(tile_codec_t *codec, uint32_t width, uint32_t height, uint32_t bytesPerPixel, uint32_t tileRows,
+                    int level, int strategy)
+{
+    memset(codec, 0, sizeof(*codec));
+    codec->width = width;
+    codec->height = height;
+    codec->bytesPerPixel = bytesPerPixel;
+    codec->rowSize = (size_t)width * bytesPerPixel;
+    codec->tileRows = (tileRows < 2 ? 2 : tileRows + 1) & ~1u;
+    codec->tileCount = (height + codec->tileRows - 1) / codec->tileRows;
+    codec->level = level;
+    codec->strategy = strategy;
+    if (!width || !height || !bytesPerPixel || codec->tileCount > TILE_CODEC_MAX_TILES)
+    {
+        printf("Tile codec: %ux%u in tiles of %u rows is more than %d tiles.\n", width, height, codec->tileRows,
+               TILE_CODEC_MAX_TILES);
+        return -1;
+    }
+    if (level <= 0)
+        return 0;
+
+    codec->streams = calloc(codec->tileCount, sizeof(z_stream));
+    codec->rows = malloc(codec->tileCount * codec->rowSize);
+    if (!codec->streams || !codec->rows)
+    {
+        tile_codec_destroy(codec);
+        return -1;
+    }
+    for (uint32_t t = 0; t < codec->tileCount; t++)
+        if (deflateInit2(&codec->streams[t], level, Z_DEFLATED, MAX_WBITS, 8, strategy) != Z_OK)
+        {
+            // the ones after t were never initialised
+            codec->tileCount = t;
+            tile_codec_destroy(codec);
+            return -1;
+        }
+    codec->tileBound = deflateBound(&codec->streams[0], (uLong)(codec->tileRows * codec->rowSize));
+    codec->tiles = malloc(codec->tileCount * codec->tileBound);
+    if (!codec->tiles)
+    {
+        tile_codec_destroy(codec);
+        return -1;
+    }
+    return 0;
+}
+
+size_t tile_codec_bound(const tile_codec_t *codec)
+{
+    return codec->tileCount * (sizeof(uint32_t) + codec->tileBound);
+}
+
+typedef struct encode_job_t
+{
+    tile_codec_t *codec;
+    const uint8_t *frame;
+    atomic_int failed;
+} encode_job_t;
+
+// one tile, filtered a row at a time into a buffer that stays in cache while deflate reads it
+static void encode_tile(void *context, int task)
+{
+    encode_job_t *job = context;
+    tile_codec_t *codec = job->codec;
+    z_stream *zs = &codec->streams[task];
+    uint8_t *row = codec->rows + task * codec->rowSize;
+    uint32_t rows = tile_rows(codec, (uint32_t)task);
+    const uint8_t *src = job->frame + (size_t)task * codec->tileRows * codec->rowSize;
+    size_t distance = predictor_distance(codec);
+
+    deflateReset(zs);
+    zs->next_out = codec->tiles + task * codec->tileBound;
+    zs->avail_out = (uInt)codec->tileBound;
+    int ret = Z_OK;
+    for (uint32_t r = 0; r < rows && ret == Z_OK; r++)
+    {
+        // deflate takes the whole row into its window before it returns, the buffer is free again
+        filter_row(src + r * codec->rowSize, row, codec->rowSize, distance);
+        zs->next_in = row;
+        zs->avail_in = (uInt)codec->rowSize;
+        ret = deflate(zs, r + 1 == rows ? Z_FINISH : Z_NO_FLUSH);
+    }
+    if (ret != Z_STREAM_END)
+        atomic_store(&job->failed, 1);
+    codec->sizes[task] = (uint32_t)zs->total_out;
+}
+
+size_t tile_codec_encode(tile_codec_t *codec, worker_pool_t *pool, const uint8_t *frame, uint8_t *payload)
+{
+    if (codec->level <= 0)
+        return 0;
+    encode_job_t job = {codec, frame, 0};
+    if (pool)
+        worker_pool_run(pool, encode_tile, &job, (int)codec->tileCount);
+    else
+        for (uint32_t t = 0; t < codec->tileCount; t++)
+            encode_tile(&job, (int)t);
+    if (atomic_load(&job.failed))
+        return 0;
+
+    memcpy(payload, codec->sizes, codec->tileCount * sizeof(uint32_t));
+    size_t size = codec->tileCount * sizeof(uint32_t);
+    for (uint32_t t = 0; t < codec->tileCount; t++)
+    {
+        memcpy(payload + size, codec->tiles + t * codec->tileBound, codec->sizes[t]);
+        size += codec->sizes[t];
+    }
+    return size;
+}
+
+static void decode_tile(void *context, int task)
+{
+    decode_job_t *job = context;
+    const tile_codec_t *codec = job->codec;
+    uint32_t rows = tile_rows(codec, (uint32_t)task);
+    uint8_t *dst = job->frame + (size_t)task * codec->tileRows * codec->rowSize;
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit(&zs) != Z_OK)
+    {
+        atomic_store(&job->failed, 1);
+        return;
+    }
+    zs.next_in = (Bytef *)(job->payload + job->offsets[task]);
+    zs.avail_in = job->sizes[task];
+    size_t distance = predictor_distance(codec);
+    int ret = Z_OK;
+    uint32_t r = 0;
+    // a row at a time, undone while inflate's output is still in cache
+    for (; r < rows && ret == Z_OK; r++)
+    {
+        zs.next_out = dst + r * codec->rowSize;
+        zs.avail_out = (uInt)codec->rowSize;
+        ret = inflate(&zs, r + 1 == rows ? Z_FINISH : Z_SYNC_FLUSH);
+        if (zs.avail_out)
+            break;
+        unfilter_row(dst + r * codec->rowSize, codec->rowSize, distance);
+    }
+    inflateEnd(&zs);
+    // a stream ending early on a row boundary leaves the rows after it unwritten
+    if (ret != Z_STREAM_END || zs.avail_out || r != rows)
+        atomic_store(&job->failed, 1);
+}
+
+int tile_codec_decode(const tile_codec_t *codec, worker_pool_t *pool, const uint8_t *payload, size_t size,
+                      uint8_t *frame)
+{
+    decode_job_t job;
+    size_t offset = codec->tileCount * sizeof(uint32_t);
+    if (size < offset)
+        return -1;
+    job.codec = codec;
+    job.payload = payload;
+    job.sizes = (const uint32_t *)payload;
+    job.frame = frame;
+    atomic_init(&job.failed, 0);
+    for (uint32_t t = 0; t < codec->tileCount; t++)
+    {
+        job.offsets[t] = offset;
+        offset += job.sizes[t];
+        if (offset > size)
+            return -1;
+    }
+    if (pool)
+        worker_pool_run(pool, decode_tile, &job, (int)codec->tileCount);
+    else
+        for (uint32_t t = 0; t < codec->tileCount; t++)
+            decode_tile(&job, (int)t);
+    return atomic_load(&job.failed) ? -1 : 0;
+}
+
+void tile_codec_destroy(tile_codec_t *codec)
+{
+    if (codec->streams)
+        for (uint32_t t = 0; t < codec->tileCount; t++)
+            deflateEnd(&codec->streams[t]);
+    free(codec->streams);
+    free(codec->rows);
+    free(codec->tiles);
+    codec->streams = NULL;
+    codec->rows = NULL;
+    codec->tiles = NULL;
+}
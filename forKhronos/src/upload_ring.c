@@ -0,0 +1,107 @@
+#include "myCode/upload_ring.h"
+#include "myCode/frame_clock.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// glClientWaitSync slice, and how long a fence may take before the upload is considered lost
+#define UPLOAD_RING_WAIT_NS 1000000ull
+#define UPLOAD_RING_GIVE_UP_NS 1000000000ull
+
+int upload_ring_create(upload_ring_t *ring, GLuint count, GLsizeiptr size)
+{
+    ring->count = count;
+    ring->next = 0;
+    ring->size = size;
+    ring->lastStallNs = 0;
+    ring->stallMaxNs = 0;
+    ring->stallTotalNs = 0;
+    ring->stalledFrames = 0;
+    ring->frames = 0;
+    ring->slots = calloc(count, sizeof(upload_ring_slot_t));
+    GLuint *pbos = calloc(count, sizeof(GLuint));
+    generate_buffers(count, pbos);
+    for (GLuint i = 0; i < count; i++)
+        ring->slots[i].pbo = pbos[i];
+    free(pbos);
+
+    for (GLuint i = 0; i < count; i++)
+    {
+        ring->slots[i].mapped = create_persistent_mapped_buffer(GL_PIXEL_UNPACK_BUFFER, ring->slots[i].pbo, size, GL_MAP_WRITE_BIT);
+        if (!ring->slots[i].mapped)
+        {
+            upload_ring_destroy(ring);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+GLvoid *upload_ring_begin(upload_ring_t *ring)
+{
+    upload_ring_slot_t *slot = &ring->slots[ring->next];
+    ring->lastStallNs = 0;
+    ring->frames++;
+    if (!slot->fence)
+        return slot->mapped;
+
+    // the common case, the upload from count frames ago is long done
+    if (fence_signaled(slot->fence, 0))
+    {
+        delete_fence(slot->fence);
+        slot->fence = NULL;
+        return slot->mapped;
+    }
+
+    uint64_t start = frame_clock_ns();
+    int signaled = 0;
+    while (!signaled && frame_clock_ns() - start < UPLOAD_RING_GIVE_UP_NS)
+        signaled = fence_signaled(slot->fence, UPLOAD_RING_WAIT_NS);
+    uint64_t stall = frame_clock_ns() - start;
+
+    ring->lastStallNs = stall;
+    ring->stallTotalNs += stall;
+    ring->stalledFrames++;
+    if (stall > ring->stallMaxNs)
+        ring->stallMaxNs = stall;
+    if (!signaled)
+    {
+        fprintf(stderr, "In file: %s, line: %d Upload fence of PBO %u never signaled\n", __FILE__, __LINE__, slot->pbo);
+        return NULL;
+    }
+    delete_fence(slot->fence);
+    slot->fence = NULL;
+    return slot->mapped;
+}
+
+void upload_ring_upload(upload_ring_t *ring, GLsizei width, GLsizei height, GLenum format, GLenum type)
+{
+    upload_ring_slot_t *slot = &ring->slots[ring->next];
+    bind_buffer(GL_PIXEL_UNPACK_BUFFER, slot->pbo);
+    update_texture_from_buffer(GL_TEXTURE_2D, 0, 0, width, height, format, type, (void *)0);
+    bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    slot->fence = insert_fence();
+    ring->next = (ring->next + 1) % ring->count;
+}
+
+void upload_ring_print_stats(upload_ring_t *ring)
+{
+    printf("Upload ring: %u PBOs, %lu of %lu frames waited for a free PBO, avg %.3f ms, max %.3f ms\n", ring->count,
+           (unsigned long)ring->stalledFrames, (unsigned long)ring->frames,
+           ring->stalledFrames ? ring->stallTotalNs / 1e6 / ring->stalledFrames : 0.0, ring->stallMaxNs / 1e6);
+}
+
+void upload_ring_destroy(upload_ring_t *ring)
+{
+    if (!ring->slots)
+        return;
+    // deleting a mapped buffer unmaps it
+    for (GLuint i = 0; i < ring->count; i++)
+    {
+        if (ring->slots[i].fence)
+            delete_fence(ring->slots[i].fence);
+        delete_buffers(1, &ring->slots[i].pbo);
+    }
+    free(ring->slots);
+    ring->slots = NULL;
+    ring->count = 0;
+}
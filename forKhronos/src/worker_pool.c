@@ -0,0 +1,119 @@
+#define _GNU_SOURCE
+#include "myCode/worker_pool.h"
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+
+static void run_tasks(worker_pool_t *pool)
+{
+    int task;
+    while ((task = atomic_fetch_add_explicit(&pool->nextTask, 1, memory_order_relaxed)) < pool->tasks)
+        pool->fn(pool->context, task);
+}
+
+static void *worker_thread(void *arg)
+{
+    worker_pool_t *pool = ((worker_pool_worker_t *)arg)->pool;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;)
+    {
+        while (!pool->quit && pool->generation == seen)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->quit)
+            break;
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_tasks(pool);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+int worker_pool_init(worker_pool_t *pool, int threads, int firstCpu)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0)
+        threads = cpus > 0 ? (int)cpus : 1;
+    if (threads > WORKER_POOL_MAX_THREADS)
+        threads = WORKER_POOL_MAX_THREADS;
+
+    pool->threads = 1;
+    pool->workerCount = 0;
+    pool->generation = 0;
+    pool->busy = 0;
+    pool->quit = 0;
+    pool->tasks = 0;
+    atomic_init(&pool->nextTask, 0);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (int i = 0; i < threads - 1; i++)
+    {
+        pool->workers[i].pool = pool;
+        if (pthread_create(&pool->workers[i].thread, NULL, worker_thread, &pool->workers[i]))
+        {
+            printf("worker_pool: failed to start worker %d, running with %d threads\n", i, pool->threads);
+            return -1;
+        }
+        if (firstCpu >= 0 && cpus > 1)
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET((firstCpu + 1 + i) % cpus, &set);
+            pthread_setaffinity_np(pool->workers[i].thread, sizeof(set), &set);
+        }
+        pool->workerCount++;
+        pool->threads++;
+    }
+    return 0;
+}
+
+void worker_pool_run(worker_pool_t *pool, worker_pool_fn fn, void *context, int tasks)
+{
+    if (pool->workerCount == 0 || tasks <= 1)
+    {
+        for (int task = 0; task < tasks; task++)
+            fn(context, task);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->context = context;
+    pool->tasks = tasks;
+    atomic_store_explicit(&pool->nextTask, 0, memory_order_relaxed);
+    pool->busy = pool->workerCount;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    run_tasks(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void worker_pool_destroy(worker_pool_t *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->workerCount; i++)
+        pthread_join(pool->workers[i].thread, NULL);
+    pool->workerCount = 0;
+    pool->threads = 1;
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+}
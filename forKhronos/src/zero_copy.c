@@ -0,0 +1,117 @@
+#include "myCode/zero_copy.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static zero_copy_buffer_t *find_buffer(zero_copy_t *zc, STREAM_BUFFER_HANDLE bufferHandle)
+{
+    for (GLuint i = 0; i < zc->count; i++)
+        if (zc->buffers[i].bufferHandle == bufferHandle)
+            return &zc->buffers[i];
+    return NULL;
+}
+
+int zero_copy_create(zero_copy_t *zc, CAMHANDLE camHandle, GLuint count)
+{
+    int ret;
+    size_t payloadSize = 0;
+
+    zc->buffers = NULL;
+    zc->count = 0;
+    zc->streamHandle = INVALID_STREAMHANDLE;
+    if (FGSTATUS_OK != (ret = KYFG_StreamCreate(camHandle, &zc->streamHandle, 0)))
+    {
+        printf("KYFG_StreamCreate - %x\n", ret);
+        return -1;
+    }
+    ret = KYFG_StreamGetInfo(zc->streamHandle, KY_STREAM_INFO_PAYLOAD_SIZE, &payloadSize, NULL, NULL);
+    if (FGSTATUS_OK != ret || payloadSize == 0)
+    {
+        printf("KYFG_StreamGetInfo(KY_STREAM_INFO_PAYLOAD_SIZE) - %x, %lu bytes\n", ret, (unsigned long)payloadSize);
+        zero_copy_destroy(zc);
+        return -1;
+    }
+
+    zc->size = payloadSize;
+    zc->count = count;
+    zc->buffers = calloc(count, sizeof(zero_copy_buffer_t));
+    GLuint *pbos = calloc(count, sizeof(GLuint));
+    generate_buffers(count, pbos);
+    for (GLuint i = 0; i < count; i++)
+        zc->buffers[i].pbo = pbos[i];
+    free(pbos);
+
+    for (GLuint i = 0; i < count; i++)
+    {
+        zero_copy_buffer_t *buffer = &zc->buffers[i];
+        buffer->mapped = create_persistent_mapped_buffer(GL_PIXEL_UNPACK_BUFFER, buffer->pbo, zc->size, GL_MAP_WRITE_BIT);
+        if (!buffer->mapped)
+        {
+            zero_copy_destroy(zc);
+            return -1;
+        }
+        ret = KYFG_BufferAnnounce(zc->streamHandle, buffer->mapped, zc->size, buffer, &buffer->bufferHandle);
+        if (FGSTATUS_OK != ret)
+        {
+            printf("KYFG_BufferAnnounce - %x\n", ret);
+            zero_copy_destroy(zc);
+            return -1;
+        }
+    }
+
+    ret = KYFG_BufferQueueAll(zc->streamHandle, KY_ACQ_QUEUE_UNQUEUED, KY_ACQ_QUEUE_INPUT);
+    printf("KYFG_BufferQueueAll - %x\n", ret);
+    printf("Zero-copy stream: %u persistently mapped buffers of %ld bytes\n", zc->count, (long)zc->size);
+    return FGSTATUS_OK == ret ? 0 : -1;
+}
+
+int zero_copy_upload(zero_copy_t *zc, const frame_desc_t *frame, GLsizei width, GLsizei height, GLenum format, GLenum type)
+{
+    zero_copy_buffer_t *buffer = find_buffer(zc, frame->bufferHandle);
+    if (!buffer)
+        return -1;
+    bind_buffer(GL_PIXEL_UNPACK_BUFFER, buffer->pbo);
+    update_texture_from_buffer(GL_TEXTURE_2D, 0, 0, width, height, format, type, (void *)0);
+    bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    buffer->fence = insert_fence();
+    return 0;
+}
+
+void zero_copy_recycle(zero_copy_t *zc)
+{
+    for (GLuint i = 0; i < zc->count; i++)
+    {
+        zero_copy_buffer_t *buffer = &zc->buffers[i];
+        if (buffer->fence && fence_signaled(buffer->fence, 0))
+        {
+            delete_fence(buffer->fence);
+            buffer->fence = NULL;
+            KYFG_BufferToQueue(buffer->bufferHandle, KY_ACQ_QUEUE_INPUT);
+        }
+    }
+}
+
+void zero_copy_release(const frame_desc_t *frame, void *context)
+{
+    (void)context;
+    KYFG_BufferToQueue(frame->bufferHandle, KY_ACQ_QUEUE_INPUT);
+}
+
+void zero_copy_destroy(zero_copy_t *zc)
+{
+    if (zc->streamHandle != INVALID_STREAMHANDLE)
+        KYFG_StreamDelete(zc->streamHandle);
+    zc->streamHandle = INVALID_STREAMHANDLE;
+    if (!zc->buffers)
+        return;
+    // deleting a mapped buffer unmaps it
+    for (GLuint i = 0; i < zc->count; i++)
+    {
+        if (zc->buffers[i].fence)
+            delete_fence(zc->buffers[i].fence);
+        delete_buffers(1, &zc->buffers[i].pbo);
+    }
+    free(zc->buffers);
+    zc->buffers = NULL;
+    zc->count = 0;
+    zc->streamHandle = INVALID_STREAMHANDLE;
+}